@@ -20,6 +20,7 @@
 //
 #include    "communicator/communicator_connection.h"
 
+#include    "communicator/coroutine.h"
 #include    "communicator/exception.h"
 #include    "communicator/names.h"
 
@@ -47,6 +48,11 @@
 #include    <edhttp/uri.h>
 
 
+// C++
+//
+#include    <functional>
+
+
 // last include
 //
 #include    <snapdev/poison.h>
@@ -113,12 +119,82 @@ advgetopt::option const g_options[] =
 
 
 
+/** \brief Get the current date in microseconds.
+ *
+ * This is the unit used by the ed::timer dates.
+ *
+ * \return The current date in microseconds.
+ */
+std::int64_t current_date()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+/** \brief The timer of the request deadlines.
+ *
+ * The ed::timer the communicator_connection derives from belongs to
+ * the classes deriving from it. The deadlines of the requests and
+ * status waiters use this separate timer instead. It calls the
+ * \p callback each time it times out.
+ */
+class request_timer
+    : public ed::timer
+{
+public:
+    typedef std::function<void()>   callback_t;
+
+    request_timer(callback_t const & callback)
+        : timer(-1)
+        , f_callback(callback)
+    {
+        set_name("communicator_request_timer");
+    }
+
+    // ed::timer implementation
+    //
+    virtual void process_timeout() override
+    {
+        f_callback();
+    }
+
+private:
+    callback_t              f_callback = callback_t();
+};
+
+
 class communicator_interface
 {
 public:
+    typedef std::function<bool(ed::message & msg)>  reply_handler_t;
+
     virtual             ~communicator_interface() {}
 
     virtual bool        is_connected() const = 0;
+
+    void set_reply_handler(reply_handler_t const & handler)
+    {
+        f_reply_handler = handler;
+    }
+
+    /** \brief Give the replies to our requests to the reply handler.
+     *
+     * The replies go directly to the request which is waiting for them
+     * instead of going through the dispatcher.
+     *
+     * \param[in] msg  The message just received.
+     *
+     * \return true if \p msg was a reply and was processed.
+     */
+    bool process_reply(ed::message & msg)
+    {
+        return f_reply_handler != nullptr
+            && f_reply_handler(msg);
+    }
+
+private:
+    reply_handler_t     f_reply_handler = reply_handler_t();
 };
 
 
@@ -152,6 +228,14 @@ public:
     {
         return local_stream_client_permanent_message_connection::is_connected();
     }
+
+    virtual void process_message(ed::message & msg) override
+    {
+        if(!process_reply(msg))
+        {
+            local_stream_client_permanent_message_connection::process_message(msg);
+        }
+    }
 };
 
 
@@ -185,6 +269,14 @@ public:
     {
         return tcp_client_permanent_message_connection::is_connected();
     }
+
+    virtual void process_message(ed::message & msg) override
+    {
+        if(!process_reply(msg))
+        {
+            tcp_client_permanent_message_connection::process_message(msg);
+        }
+    }
 };
 
 
@@ -214,6 +306,14 @@ public:
         // UDP is not really ever "connected"
         return true;
     }
+
+    virtual void process_message(ed::message & msg) override
+    {
+        if(!process_reply(msg))
+        {
+            udp_server_message_connection::process_message(msg);
+        }
+    }
 };
 
 
@@ -262,6 +362,7 @@ communicator_connection::communicator_connection(
     , f_communicator(ed::communicator::instance())
     , f_service_name(service_name)
     , f_dispatcher(std::make_shared<ed::dispatcher>(this))
+    , f_request_timer(std::make_shared<request_timer>(std::bind(&communicator_connection::expire_requests, this)))
 {
     if(f_service_name.empty())
     {
@@ -299,10 +400,24 @@ communicator_connection::communicator_connection(
 
 /** \brief Destroy the communicator_connection.
  *
- * The communicator_connection needed a virtual destructor so here it is.
+ * The requests and status waiters still pending get called with
+ * REQUEST_STATUS_CANCELED so the coroutines awaiting them are resumed
+ * and their frames destroyed instead of leaked.
  */
 communicator_connection::~communicator_connection()
 {
+    f_pending_requests.cancel_all();
+
+    if(f_request_timer_added)
+    {
+        f_communicator->remove_connection(f_request_timer);
+    }
+
+    if(f_communicator_connection != nullptr)
+    {
+        std::dynamic_pointer_cast<communicator_interface>(f_communicator_connection)
+                ->set_reply_handler(communicator_interface::reply_handler_t());
+    }
 }
 
 
@@ -528,6 +643,9 @@ void communicator_connection::process_communicator_options()
     }
     d->set_dispatcher(get_dispatcher());
 
+    std::dynamic_pointer_cast<communicator_interface>(f_communicator_connection)
+            ->set_reply_handler(std::bind(&communicator_connection::process_reply, this, std::placeholders::_1));
+
     if(!f_communicator->add_connection(f_communicator_connection))
     {
         f_communicator_connection.reset();
@@ -572,6 +690,228 @@ bool communicator_connection::send_message(ed::message & msg, bool cache)
 }
 
 
+/** \brief Send a request and wait for its reply asynchronously.
+ *
+ * This function attaches a correlation identifier to \p msg and sends
+ * it. When the reply arrives, \p callback gets called with
+ * REQUEST_STATUS_REPLY and the reply. The reply does not go through the
+ * dispatcher, so no match is required for it. Any number of requests
+ * can be in flight at the same time.
+ *
+ * If no reply is received within \p timeout, the \p callback is called
+ * with REQUEST_STATUS_TIMEOUT and an empty message. The timeout uses
+ * a private timer which is part of the ed::communicator only while
+ * requests are pending. The ed::timer of the communicator_connection
+ * itself is not used.
+ *
+ * The service replying must use pending_requests::set_reply() to
+ * prepare its reply.
+ *
+ * \param[in,out] msg  The request to send.
+ * \param[in] callback  The function called with the reply or on timeout.
+ * \param[in] timeout  How long to wait for the reply.
+ *
+ * \return The identifier of the request, which can be used to cancel
+ * it, or REQUEST_ID_NONE if the message could not be sent, in which
+ * case the \p callback does not get called.
+ */
+pending_requests::request_id_t communicator_connection::request(
+      ed::message & msg
+    , pending_requests::reply_callback_t const & callback
+    , std::chrono::microseconds timeout)
+{
+    pending_requests::request_id_t const id(f_pending_requests.add(
+              callback
+            , current_date() + timeout.count()));
+    pending_requests::set_correlation_id(msg, id);
+    if(!send_message(msg))
+    {
+        f_pending_requests.cancel(id);
+        return pending_requests::REQUEST_ID_NONE;
+    }
+
+    update_request_timeout();
+
+    return id;
+}
+
+
+/** \brief Send a request from a coroutine.
+ *
+ * This function returns an awaitable. The request is sent when the
+ * coroutine awaits the result:
+ *
+ * \code
+ *     communicator::request_result const r(co_await f_messenger->request(msg, 2s));
+ * \endcode
+ *
+ * See coroutine.h for details.
+ *
+ * \param[in,out] msg  The request to send.
+ * \param[in] timeout  How long to wait for the reply.
+ *
+ * \return The awaitable which sends \p msg and waits for the reply.
+ */
+request_awaitable communicator_connection::request(
+      ed::message & msg
+    , std::chrono::microseconds timeout)
+{
+    return request_awaitable(*this, msg, timeout);
+}
+
+
+/** \brief Cancel a request.
+ *
+ * The callback of the request does not get called. If the reply arrives
+ * later, it gets dropped.
+ *
+ * \param[in] id  The identifier returned by request().
+ *
+ * \return true if the request was still pending.
+ */
+bool communicator_connection::cancel_request(pending_requests::request_id_t id)
+{
+    bool const result(f_pending_requests.cancel(id));
+    update_request_timeout();
+    return result;
+}
+
+
+/** \brief Get the number of requests waiting for a reply.
+ *
+ * \return The number of requests in flight.
+ */
+std::size_t communicator_connection::pending_request_count() const
+{
+    return f_pending_requests.size();
+}
+
+
+/** \brief Wait for a service to reach a given status.
+ *
+ * The \p callback gets called once with REQUEST_STATUS_REPLY and the
+ * STATUS message, the first time a STATUS message reports that
+ * \p service has \p status (usually "up" or "down").
+ *
+ * This function sends a SERVICE_STATUS message to the communicator
+ * daemon so if the service already has that status, the callback gets
+ * called as soon as the daemon replies.
+ *
+ * Like a request, the wait ends with REQUEST_STATUS_TIMEOUT once the
+ * \p timeout is reached and with REQUEST_STATUS_CANCELED when the
+ * connection gets closed by unregister_communicator(). It can also be
+ * canceled with cancel_request(), in which case the callback does not
+ * get called.
+ *
+ * \param[in] service  The name of the service to watch.
+ * \param[in] status  The expected status.
+ * \param[in] callback  The function to call once the status is reached.
+ * \param[in] timeout  How long to wait for the status.
+ *
+ * \return The identifier of the wait, which can be used to cancel it.
+ */
+pending_requests::request_id_t communicator_connection::wait_for_status(
+      std::string const & service
+    , std::string const & status
+    , pending_requests::reply_callback_t const & callback
+    , std::chrono::microseconds timeout)
+{
+    pending_requests::request_id_t const id(f_pending_requests.add_status_waiter(
+              service
+            , status
+            , callback
+            , current_date() + timeout.count()));
+    update_request_timeout();
+
+    ed::message service_status_msg;
+    service_status_msg.set_command(g_name_communicator_cmd_service_status);
+    service_status_msg.set_service(g_name_communicator_service_communicatord);
+    service_status_msg.add_parameter(g_name_communicator_param_service, service);
+    send_message(service_status_msg);
+
+    return id;
+}
+
+
+/** \brief Wait for a service to reach a given status from a coroutine.
+ *
+ * \code
+ *     if(co_await f_messenger->wait_for_status("cluckd", communicator::g_name_communicator_value_up, 1min))
+ *     {
+ *         ...cluckd is up...
+ *     }
+ * \endcode
+ *
+ * The coroutine always gets resumed: once the status is reached, once
+ * the \p timeout is reached, or when the connection is closed. The
+ * request_result tells which one happened.
+ *
+ * \param[in] service  The name of the service to watch.
+ * \param[in] status  The expected status.
+ * \param[in] timeout  How long to wait for the status.
+ *
+ * \return The awaitable which resumes once the wait is over.
+ */
+status_awaitable communicator_connection::wait_for_status(
+      std::string const & service
+    , std::string const & status
+    , std::chrono::microseconds timeout)
+{
+    return status_awaitable(*this, service, status, timeout);
+}
+
+
+/** \brief Time out the requests which did not receive a reply.
+ *
+ * The request timer is set to the deadline of the oldest pending
+ * request and calls this function when it times out.
+ */
+void communicator_connection::expire_requests()
+{
+    f_pending_requests.expire(current_date());
+    update_request_timeout();
+}
+
+
+bool communicator_connection::process_reply(ed::message & msg)
+{
+    if(!f_pending_requests.complete(msg))
+    {
+        return false;
+    }
+
+    update_request_timeout();
+    return true;
+}
+
+
+/** \brief Set the request timer to the next request deadline.
+ *
+ * The timer only fires if it is part of the ed::communicator. So while
+ * requests or status waiters are pending, this function makes sure it
+ * is. Once none are left, it removes the timer again so the event loop
+ * does not run forever because of an idle timer.
+ */
+void communicator_connection::update_request_timeout()
+{
+    std::int64_t const deadline(f_pending_requests.next_deadline());
+    f_request_timer->set_timeout_date(deadline);
+
+    if(deadline != -1)
+    {
+        if(!f_request_timer_added)
+        {
+            f_request_timer_added = f_communicator->add_connection(f_request_timer);
+        }
+    }
+    else if(f_request_timer_added)
+    {
+        f_request_timer_added = false;
+        f_communicator->remove_connection(f_request_timer);
+    }
+}
+
+
 /** \brief The communicator STATUS message.
  *
  * Whenever the communicator obtains or loses a connection with a
@@ -608,9 +948,14 @@ void communicator_connection::msg_status(ed::message & msg)
     {
         return;
     }
-    service_status(
-          msg.get_parameter(::communicator::g_name_communicator_param_service)
-        , msg.get_parameter(::communicator::g_name_communicator_param_status));
+    std::string const service(msg.get_parameter(::communicator::g_name_communicator_param_service));
+    std::string const status(msg.get_parameter(::communicator::g_name_communicator_param_status));
+    service_status(service, status);
+
+    if(f_pending_requests.status_changed(msg) > 0)
+    {
+        update_request_timeout();
+    }
 }
 
 
@@ -622,6 +967,12 @@ void communicator_connection::msg_status(ed::message & msg)
  * The process takes the \p quitting parameter to know whether the communicator
  * itself is quitting (true) or not (false).
  *
+ * When the connection gets closed (\p quitting is true or the connection
+ * cannot send an UNREGISTER), the pending requests and status waiters
+ * get called with REQUEST_STATUS_CANCELED, which also resumes the
+ * coroutines awaiting them. Otherwise they end when the daemon replies
+ * or when they time out.
+ *
  * \param[in] quitting  true if the communicator daemon itself is quitting.
  */
 void communicator_connection::unregister_communicator(bool quitting)
@@ -636,6 +987,9 @@ void communicator_connection::unregister_communicator(bool quitting)
         {
             f_communicator->remove_connection(f_communicator_connection);
             f_communicator_connection.reset();
+
+            f_pending_requests.cancel_all();
+            update_request_timeout();
         }
         else
         {
@@ -644,6 +998,13 @@ void communicator_connection::unregister_communicator(bool quitting)
             messenger->unregister_service();
         }
     }
+    else
+    {
+        // never connected or already closed, nothing will answer
+        //
+        f_pending_requests.cancel_all();
+        update_request_timeout();
+    }
 }
 
 
@@ -667,6 +1028,38 @@ void request_failure(ed::message & msg)
 }
 
 
+/** \brief Log an exception which left a coroutine task.
+ *
+ * A communicator::task is resumed from the callbacks of the
+ * communicator_connection. An exception leaving the coroutine would
+ * otherwise go through the pending requests and the event loop which
+ * are not in a state to handle it. Instead, it gets logged here and
+ * the coroutine ends.
+ *
+ * \param[in] e  The exception which left the coroutine.
+ */
+void task_exception(std::exception_ptr e) noexcept
+{
+    try
+    {
+        std::rethrow_exception(e);
+    }
+    catch(std::exception const & ex)
+    {
+        SNAP_LOG_ERROR
+            << "a communicator::task coroutine ended with an exception: "
+            << ex.what()
+            << SNAP_LOG_SEND;
+    }
+    catch(...)
+    {
+        SNAP_LOG_ERROR
+            << "a communicator::task coroutine ended with an unknown exception."
+            << SNAP_LOG_SEND;
+    }
+}
+
+
 
 } // namespace communicator
 // vim: ts=4 sw=4 et
@@ -17,6 +17,11 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
+// self
+//
+#include    <communicator/pending_requests.h>
+
+
 
 // advgetopt
 //
@@ -42,6 +47,7 @@
 
 // C++
 //
+#include    <chrono>
 #include    <string_view>
 
 
@@ -64,6 +70,10 @@ constexpr std::string_view      g_communicator_any_ip_port = snapdev::join_strin
 
 
 
+class request_awaitable;
+class status_awaitable;
+
+
 class communicator_connection
     : public ed::timer
     , public ed::dispatcher_support
@@ -72,6 +82,8 @@ class communicator_connection
 public:
     typedef std::shared_ptr<communicator_connection>   pointer_t;
 
+    static constexpr std::chrono::microseconds  DEFAULT_REQUEST_TIMEOUT = std::chrono::seconds(10);
+
                                 communicator_connection(
                                       advgetopt::getopt & opts
                                     , std::string const & service_name);
@@ -89,18 +101,47 @@ public:
     //
     virtual bool                send_message(ed::message & msg, bool cache = false) override;
 
+    // request/reply
+    //
+    pending_requests::request_id_t
+                                request(
+                                      ed::message & msg
+                                    , pending_requests::reply_callback_t const & callback
+                                    , std::chrono::microseconds timeout = DEFAULT_REQUEST_TIMEOUT);
+    request_awaitable           request(
+                                      ed::message & msg
+                                    , std::chrono::microseconds timeout = DEFAULT_REQUEST_TIMEOUT);
+    bool                        cancel_request(pending_requests::request_id_t id);
+    std::size_t                 pending_request_count() const;
+    pending_requests::request_id_t
+                                wait_for_status(
+                                      std::string const & service
+                                    , std::string const & status
+                                    , pending_requests::reply_callback_t const & callback
+                                    , std::chrono::microseconds timeout = DEFAULT_REQUEST_TIMEOUT);
+    status_awaitable            wait_for_status(
+                                      std::string const & service
+                                    , std::string const & status
+                                    , std::chrono::microseconds timeout = DEFAULT_REQUEST_TIMEOUT);
+
     // new callbacks
     //
     virtual void                service_status(std::string const & service, std::string const & status);
 
 private:
     void                        msg_status(ed::message & msg);
+    bool                        process_reply(ed::message & msg);
+    void                        expire_requests();
+    void                        update_request_timeout();
 
     advgetopt::getopt &         f_opts;
     ed::communicator::pointer_t f_communicator = ed::communicator::pointer_t();
     std::string                 f_service_name = std::string();
     ed::dispatcher::pointer_t   f_dispatcher = ed::dispatcher::pointer_t();
     ed::connection::pointer_t   f_communicator_connection = ed::connection::pointer_t();
+    pending_requests            f_pending_requests = pending_requests();
+    ed::timer::pointer_t        f_request_timer = ed::timer::pointer_t();
+    bool                        f_request_timer_added = false;
 };
 
 
@@ -0,0 +1,253 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Coroutine support for the communicator_connection.
+ *
+ * The awaitables defined here let a service written in C++20 wait for
+ * a reply or a service status without a chain of callbacks:
+ *
+ * \code
+ *     communicator::task my_service::start()
+ *     {
+ *         if(!co_await f_messenger->wait_for_status("cluckd", "up", 1min))
+ *         {
+ *             co_return;      // timed out or the connection was closed
+ *         }
+ *
+ *         ed::message msg;
+ *         msg.set_service("cluckd");
+ *         msg.set_command("LOCK");
+ *         communicator::request_result const r(co_await f_messenger->request(msg, 2s));
+ *         if(r)
+ *         {
+ *             ...handle r.f_reply...
+ *         }
+ *     }
+ * \endcode
+ *
+ * The coroutines are resumed from the callbacks of the communicator
+ * connection, which means they always run inside the ed::communicator
+ * event loop, in the thread running that loop.
+ *
+ * Both awaitables have a timeout and get resumed with
+ * REQUEST_STATUS_CANCELED when the connection is closed with
+ * communicator_connection::unregister_communicator(), so a suspended
+ * coroutine always ends up being resumed and its frame destroyed.
+ *
+ * The awaitables do not depend on the \<coroutine> header so the library
+ * itself can be compiled in C++17. The task type is only available when
+ * the compiler supports coroutines.
+ */
+
+// self
+//
+#include    <communicator/communicator_connection.h>
+
+
+// C++
+//
+#include    <exception>
+#if defined(__cpp_impl_coroutine)
+#include    <coroutine>
+#endif
+
+
+
+namespace communicator
+{
+
+
+
+/** \brief The result of a co_await on a request or a status.
+ *
+ * The result converts to true if the reply was received or the status
+ * reached. In the latter case, f_reply is the STATUS message.
+ */
+struct request_result
+{
+    request_status_t            f_status = request_status_t::REQUEST_STATUS_CANCELED;
+    ed::message                 f_reply = ed::message();
+
+    explicit operator bool () const
+    {
+        return f_status == request_status_t::REQUEST_STATUS_REPLY;
+    }
+};
+
+
+/** \brief Awaitable returned by communicator_connection::request().
+ *
+ * The request is sent when the coroutine gets suspended. The coroutine
+ * is resumed once the reply arrives, the request times out, or the
+ * connection is closed.
+ */
+class request_awaitable
+{
+public:
+    request_awaitable(
+              communicator_connection & connection
+            , ed::message & msg
+            , std::chrono::microseconds timeout)
+        : f_connection(connection)
+        , f_message(msg)
+        , f_timeout(timeout)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    template<typename H>
+    bool await_suspend(H handle)
+    {
+        pending_requests::request_id_t const id(f_connection.request(
+                  f_message
+                , [this, handle](request_status_t status, ed::message & reply)
+                  {
+                      f_result.f_status = status;
+                      f_result.f_reply = reply;
+                      handle.resume();
+                  }
+                , f_timeout));
+
+        // if the message could not be sent, resume immediately with
+        // REQUEST_STATUS_CANCELED
+        //
+        return id != pending_requests::REQUEST_ID_NONE;
+    }
+
+    request_result await_resume()
+    {
+        return std::move(f_result);
+    }
+
+private:
+    communicator_connection &   f_connection;
+    ed::message &               f_message;
+    std::chrono::microseconds   f_timeout = std::chrono::microseconds();
+    request_result              f_result = request_result();
+};
+
+
+/** \brief Awaitable returned by communicator_connection::wait_for_status().
+ *
+ * The coroutine is resumed once the named service reaches the expected
+ * status, the wait times out, or the connection is closed.
+ */
+class status_awaitable
+{
+public:
+    status_awaitable(
+              communicator_connection & connection
+            , std::string const & service
+            , std::string const & status
+            , std::chrono::microseconds timeout)
+        : f_connection(connection)
+        , f_service(service)
+        , f_status(status)
+        , f_timeout(timeout)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    template<typename H>
+    void await_suspend(H handle)
+    {
+        f_connection.wait_for_status(
+                  f_service
+                , f_status
+                , [this, handle](request_status_t status, ed::message & msg)
+                  {
+                      f_result.f_status = status;
+                      f_result.f_reply = msg;
+                      handle.resume();
+                  }
+                , f_timeout);
+    }
+
+    request_result await_resume()
+    {
+        return std::move(f_result);
+    }
+
+private:
+    communicator_connection &   f_connection;
+    std::string                 f_service = std::string();
+    std::string                 f_status = std::string();
+    std::chrono::microseconds   f_timeout = std::chrono::microseconds();
+    request_result              f_result = request_result();
+};
+
+
+void task_exception(std::exception_ptr e) noexcept;
+
+
+#if defined(__cpp_impl_coroutine)
+/** \brief A coroutine started from the event loop.
+ *
+ * A task starts running immediately and runs until its first co_await.
+ * Nothing waits on it: the frame gets destroyed once the coroutine
+ * returns. An exception leaving the coroutine gets logged and is
+ * otherwise ignored: the code which resumed the coroutine is a callback
+ * of the communicator_connection (a reply, a timeout, a STATUS) which
+ * does not expect the exceptions of another piece of code.
+ */
+class task
+{
+public:
+    struct promise_type
+    {
+        task get_return_object() noexcept
+        {
+            return task();
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return std::suspend_never();
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return std::suspend_never();
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception() noexcept
+        {
+            task_exception(std::current_exception());
+        }
+    };
+};
+#endif
+
+
+
+} // namespace communicator
+// vim: ts=4 sw=4 et
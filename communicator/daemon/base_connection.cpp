@@ -54,10 +54,15 @@
 //
 #include    "base_connection.h"
 
+#include    "remote_connection.h"
+#include    "service_connection.h"
+#include    "unix_connection.h"
+
 
 // communicator
 //
 #include    <communicator/exception.h>
+#include    <communicator/flags.h>
 
 
 // snapdev
@@ -65,6 +70,17 @@
 #include    <snapdev/tokenize_string.h>
 
 
+// snaplogger
+//
+#include    <snaplogger/message.h>
+
+
+// C
+//
+#include    <string.h>
+#include    <sys/ioctl.h>
+
+
 // last include
 //
 #include    <snapdev/poison.h>
@@ -75,6 +91,20 @@ namespace communicator_daemon
 {
 
 
+namespace
+{
+
+
+/** \brief The identifier of the next connection.
+ *
+ * Each connection gets a unique number so the flags raised on its
+ * behalf do not clash with the flags of other connections having
+ * the same name (i.e. several instances of the same service).
+ */
+std::uint64_t               g_next_connection_id = 0;
+
+
+} // no name namespace
 
 
 
@@ -83,14 +113,19 @@ namespace communicator_daemon
  * The constructor saves the communicator server pointer
  * so one can access it from any derived version.
  *
+ * The \p kind parameter defines which class is derived from this
+ * base_connection. This lets the communicatord find out what type
+ * of connection it is dealing with without having to use RTTI.
+ *
  * \param[in] s  The address to the communicator server.
- * \param[in] is_udp  The connection is over UDP (opposed to TCP).
+ * \param[in] kind  The kind of connection being created.
  */
 base_connection::base_connection(
           communicatord * s
-        , bool is_udp)
+        , connection_kind_t kind)
     : f_server(s)
-    , f_is_udp(is_udp)
+    , f_connection_id(++g_next_connection_id)
+    , f_kind(kind)
 {
 }
 
@@ -324,10 +359,14 @@ std::string base_connection::get_password() const
  * This defines the name of services and thus where to send various
  * messages such as a PING to request a service to start doing work.
  *
+ * The list replaces the previous one since a SERVICES message sends
+ * the complete list each time it changes.
+ *
  * \param[in] services  The list of services this server handles.
  */
 void base_connection::set_services(std::string const & services)
 {
+    f_services.clear();
     snapdev::tokenize_string(f_services, services, { "," });
 }
 
@@ -341,7 +380,7 @@ void base_connection::set_services(std::string const & services)
  */
 void base_connection::get_services(advgetopt::string_set_t & services)
 {
-    f_services.merge(services);
+    services.insert(f_services.begin(), f_services.end());
 }
 
 
@@ -375,6 +414,7 @@ bool base_connection::has_service(std::string const & name)
  */
 void base_connection::set_services_heard_of(std::string const & services)
 {
+    f_services_heard_of.clear();
     snapdev::tokenize_string(f_services_heard_of, services, { "," });
 }
 
@@ -388,7 +428,7 @@ void base_connection::set_services_heard_of(std::string const & services)
  */
 void base_connection::get_services_heard_of(advgetopt::string_set_t & services)
 {
-    f_services_heard_of.merge(services);
+    services.insert(f_services_heard_of.begin(), f_services_heard_of.end());
 }
 
 
@@ -461,6 +501,20 @@ bool base_connection::has_commands() const
 }
 
 
+/** \brief Retrieve the list of commands understood by this connection.
+ *
+ * This function returns a reference to the set of commands received
+ * with the COMMANDS message. It is used to build the index of
+ * connections interested in a given command.
+ *
+ * \return A reference to the set of understood commands.
+ */
+advgetopt::string_set_t const & base_connection::get_commands() const
+{
+    return f_understood_commands;
+}
+
+
 /** \brief Remove a command.
  *
  * This function is used to make the system think that certain command
@@ -507,10 +561,24 @@ bool base_connection::is_remote() const
 }
 
 
+/** \brief Retrieve the kind of this connection.
+ *
+ * The kind is defined on construction and never changes. It tells us
+ * which class derives from this base_connection so we can use a
+ * static_cast<>() instead of a dynamic_cast<>().
+ *
+ * \return The kind of this connection.
+ */
+connection_kind_t base_connection::get_connection_kind() const
+{
+    return f_kind;
+}
+
+
 /** \brief The function returns true if this is a UDP connection.
  *
- * This function returns the f_is_udp flag which is true if the connection
- * represents a UDP (datagram based) connection.
+ * This function returns true if the connection represents a UDP
+ * (datagram based) connection.
  *
  * At this time, we only have one UDP connection recorded here. The connection
  * used to receive "signals".
@@ -519,7 +587,7 @@ bool base_connection::is_remote() const
  */
 bool base_connection::is_udp() const
 {
-    return f_is_udp;
+    return f_kind == connection_kind_t::CONNECTION_KIND_PING;
 }
 
 
@@ -553,8 +621,60 @@ bool base_connection::wants_loadavg() const
 }
 
 
+/** \brief Get the topics this connection subscribed to.
+ *
+ * A local service sends SUBSCRIBE and UNSUBSCRIBE messages to define
+ * the topics it is interested in. The messages published on those
+ * topics get sent to this connection.
+ *
+ * \return A reference to the topics of this connection.
+ */
+topic_matcher & base_connection::get_topics()
+{
+    return f_topics;
+}
+
+
+/** \brief Retrieve the codec of this connection.
+ *
+ * The links between communicator daemons may use the compact framing
+ * negotiated by the CONNECT and ACCEPT messages. The codec remains in
+ * text mode on all the other connections.
+ *
+ * \return A reference to the link codec of this connection.
+ */
+link_codec & base_connection::get_link_codec()
+{
+    return f_link_codec;
+}
+
+
 bool base_connection::send_message_to_connection(ed::message & msg, bool cache, bool only_if_command_known)
 {
+    if(only_if_command_known
+    && !understand_command(msg.get_command()))
+    {
+        return false;
+    }
+
+    // the kind tells us which class we are so we can avoid the RTTI
+    //
+    switch(f_kind)
+    {
+    case connection_kind_t::CONNECTION_KIND_SERVICE:
+        return static_cast<service_connection *>(this)->send_message(msg, cache);
+
+    case connection_kind_t::CONNECTION_KIND_UNIX:
+        return static_cast<unix_connection *>(this)->send_message(msg, cache);
+
+    case connection_kind_t::CONNECTION_KIND_REMOTE:
+        return static_cast<remote_connection *>(this)->send_message(msg, cache);
+
+    default:
+        break;
+
+    }
+
     ed::connection * conn(dynamic_cast<ed::connection *>(this));
     if(conn == nullptr)
     {
@@ -565,15 +685,587 @@ bool base_connection::send_message_to_connection(ed::message & msg, bool cache,
     {
         throw communicator::logic_error("std::dynamic_pointer_cast<ed::connection_with_send_message>() on our ed::connection failed.");
     }
-    if(!only_if_command_known
-    || understand_command(msg.get_command()))
+    return conn_msg->send_message(msg, cache);
+}
+
+
+
+/** \brief Check whether this connection accepts raw messages.
+ *
+ * Only the connections with a buffered output (TCP and Unix stream
+ * connections from local services) can be sent a message which was
+ * already serialized. The remote connections only accept ed::message
+ * objects.
+ *
+ * A link using the compact framing cannot be sent the text shared with
+ * the other connections either; its send_message() encodes the message.
+ * Neither can a connection writing its bulk messages in batches; its
+ * send_message() may hold the message.
+ *
+ * \return true if send_raw_message() can be used with this connection.
+ */
+bool base_connection::can_send_raw_message() const
+{
+    return (f_kind == connection_kind_t::CONNECTION_KIND_SERVICE
+            || f_kind == connection_kind_t::CONNECTION_KIND_UNIX)
+        && !f_link_codec.is_compact()
+        && !f_bulk_batches;
+}
+
+
+/** \brief Send a message which is already serialized.
+ *
+ * This function writes \p data as is to the output buffer of this
+ * connection. The data must be a complete message including the
+ * ending newline character.
+ *
+ * This is used to forward messages without having to parse and
+ * serialize them again and to send the same message to many
+ * connections with a single serialization.
+ *
+ * When the output queue is used, a \p priority message (i.e. a control
+ * message such as STOP or CLUSTER_DOWN) is written ahead of the bulk
+ * messages already queued. When the queue is full, bulk messages get
+ * dropped to make room for it, unless the overflow policy is
+ * OVERFLOW_POLICY_SERVICE_BUSY. With that policy, the senders of the
+ * queued messages were not told about a problem, so these messages are
+ * kept and the control message gets refused like any other message.
+ * The caller then sends a SERVICE_BUSY reply to its sender (see
+ * is_busy()). The control messages count against the limits, so the
+ * priority lane cannot grow past them either. On a compressed link,
+ * the queued messages are never dropped (see make_room_for_output()).
+ *
+ * \param[in] data  The message to send, with its newline.
+ * \param[in] priority  Whether the message goes in the priority lane.
+ *
+ * \return true if the whole message was added to the output buffer.
+ */
+bool base_connection::send_raw_message(encoded_message_t const & data, bool priority)
+{
+    if(data == nullptr)
+    {
+        return false;
+    }
+
+    if(!make_room_for_output(priority))
+    {
+        return false;
+    }
+
+    if(f_output_coalescing)
+    {
+        // keep a reference, no copy; the buffer gets written along
+        // the other messages queued in this event loop iteration
+        //
+        if(f_output_queue.push(data, priority))
+        {
+            return flush_output();
+        }
+        return true;
+    }
+
+    ssize_t r(-1);
+    switch(f_kind)
+    {
+    case connection_kind_t::CONNECTION_KIND_SERVICE:
+        r = static_cast<service_connection *>(this)->write(data->data(), data->length());
+        break;
+
+    case connection_kind_t::CONNECTION_KIND_UNIX:
+        r = static_cast<unix_connection *>(this)->write(data->data(), data->length());
+        break;
+
+    default:
+        return false;
+
+    }
+
+    if(r > 0)
+    {
+        f_written_output += static_cast<std::size_t>(r);
+    }
+
+    return r == static_cast<ssize_t>(data->length());
+}
+
+
+/** \brief Make sure the output queue can accept one more message.
+ *
+ * A slow consumer cannot make the queue grow without bounds. When the
+ * queue is full, the overflow policy decides whether queued messages
+ * get dropped to make room (see send_raw_message()) or the new message
+ * gets refused.
+ *
+ * On a link compressed with a dictionary, the queued messages may
+ * define dictionary entries used by the following messages, so they
+ * are never dropped. The new message gets refused instead. The caller
+ * checks the queue with this function before compressing the message
+ * so a refused message does not change the dictionary.
+ *
+ * \param[in] priority  Whether the message goes in the priority lane.
+ *
+ * \return true if the message can be added to the queue.
+ */
+bool base_connection::make_room_for_output(bool priority)
+{
+    if(!f_output_coalescing
+    || !f_output_queue.is_full())
+    {
+        return true;
+    }
+
+    set_output_overflow(true);
+    if(f_overflow_policy == overflow_policy_t::OVERFLOW_POLICY_SERVICE_BUSY
+    || f_link_codec.is_compressing()
+    || (!priority
+            && f_overflow_policy != overflow_policy_t::OVERFLOW_POLICY_DROP_OLDEST)
+    || !f_output_queue.drop_oldest())
+    {
+        f_output_queue.drop_newest();
+        return false;
+    }
+
+    return true;
+}
+
+
+/** \brief Encode and send a message on the raw stream.
+ *
+ * The connections which queue their output cannot let the
+ * eventdispatcher write messages to their output buffer. Their
+ * send_message() calls this function instead. The message is encoded
+ * in text, then sent with send_raw_message() in the lane matching its
+ * priority.
+ *
+ * \param[in] msg  The message to send.
+ *
+ * \return true if the message was sent or queued.
+ */
+bool base_connection::send_stream_message(ed::message const & msg)
+{
+    return send_raw_message(encode_message(msg), is_priority_message(msg));
+}
+
+
+/** \brief Check whether a message goes in the priority lane.
+ *
+ * The control messages are defined by the priority_commands parameter
+ * of the communicator daemon.
+ *
+ * \param[in] msg  The message to check.
+ *
+ * \return true if the message is a control message.
+ */
+bool base_connection::is_priority_message(ed::message const & msg) const
+{
+    return f_server != nullptr
+        && f_server->is_priority_command(msg.get_command());
+}
+
+
+/** \brief Send a message serializing it at most once.
+ *
+ * When the same message is sent to many connections, this function
+ * serializes it the first time it is needed and saves the result in
+ * \p encoded. The following calls reuse that buffer as is.
+ *
+ * Connections which do not support raw messages (i.e. the
+ * remote_connection) get the \p msg sent the normal way.
+ *
+ * \param[in] msg  The message to send.
+ * \param[in,out] encoded  The serialized message, set on the first call.
+ *
+ * \return true if the message was sent.
+ */
+bool base_connection::send_encoded_message(
+      ed::message & msg
+    , encoded_message_t & encoded)
+{
+    if(!can_send_raw_message())
+    {
+        return send_message_to_connection(msg);
+    }
+
+    if(encoded == nullptr)
+    {
+        encoded = encode_message(msg);
+    }
+    return send_raw_message(encoded, is_priority_message(msg));
+}
+
+
+/** \brief Serialize a message for send_raw_message().
+ *
+ * The result is the message as it appears on the wire, including the
+ * ending newline. The buffer is immutable and can be shared between
+ * all the connections receiving the same message.
+ *
+ * \param[in] msg  The message to serialize.
+ *
+ * \return The shared buffer with the serialized message.
+ */
+base_connection::encoded_message_t base_connection::encode_message(ed::message const & msg)
+{
+    std::string data(msg.to_message());
+    data += '\n';
+    return std::make_shared<std::string const>(std::move(data));
+}
+
+
+/** \brief Turn on the output coalescing on this connection.
+ *
+ * When turned on, the messages sent to this connection are not copied
+ * to the output buffer of the connection. Instead, a reference to the
+ * encoded messages is saved in an output_queue and all the messages
+ * queued within one event loop iteration are written with a single
+ * system call.
+ *
+ * The \p threshold defines the number of bytes which can be queued
+ * before the queue gets flushed immediately. Use 0 to turn off the
+ * feature.
+ *
+ * Only plain TCP and Unix connections support this feature. Encrypted
+ * connections have to go through the BIO.
+ *
+ * \param[in] threshold  The maximum number of bytes to queue or 0.
+ */
+void base_connection::set_output_coalescing(std::size_t threshold)
+{
+    f_output_coalescing = threshold > 0
+                    && (f_kind == connection_kind_t::CONNECTION_KIND_SERVICE
+                        || f_kind == connection_kind_t::CONNECTION_KIND_UNIX);
+    if(f_output_coalescing)
     {
-        return conn_msg->send_message(msg, cache);
+        f_output_queue.set_flush_threshold(threshold);
     }
-    return false;
 }
 
 
+/** \brief Check whether the output of this connection is coalesced.
+ *
+ * \return true if the messages go through the output_queue.
+ */
+bool base_connection::is_output_coalescing() const
+{
+    return f_output_coalescing;
+}
+
+
+/** \brief Check whether messages are waiting in the output queue.
+ *
+ * The connections use this function in their is_writer() so the
+ * ed::communicator wakes them up when the socket is writable.
+ *
+ * \return true if the output queue is not empty.
+ */
+bool base_connection::has_queued_output() const
+{
+    return !f_output_queue.empty();
+}
+
+
+/** \brief Write the output queue to the socket.
+ *
+ * This function writes as much of the output queue as the socket
+ * accepts with one system call.
+ *
+ * \return false if an error occurred, in which case the queue is cleared.
+ */
+bool base_connection::flush_output()
+{
+    std::size_t const queued(f_output_queue.size());
+    if(f_output_queue.flush(get_socket()) < 0)
+    {
+        int const e(errno);
+        SNAP_LOG_DEBUG
+            << "flushing the output queue of connection \""
+            << get_connection_name()
+            << "\" failed with errno: "
+            << e
+            << " -- "
+            << strerror(e)
+            << SNAP_LOG_SEND;
+        f_output_queue.clear();
+        return false;
+    }
+    f_written_output += queued - f_output_queue.size();
+
+    if(f_output_overflow
+    && f_output_queue.empty())
+    {
+        // the consumer caught up
+        //
+        set_output_overflow(false);
+    }
+
+    return true;
+}
+
+
+/** \brief Retrieve the output queue.
+ *
+ * This is used to gather the statistics of the output coalescing.
+ *
+ * \return A reference to the output queue of this connection.
+ */
+output_queue const & base_connection::get_output_queue() const
+{
+    return f_output_queue;
+}
+
+
+/** \brief Get the number of bytes not yet sent to the peer.
+ *
+ * This is the size of the output queue, when used, plus the bytes
+ * still in the kernel send buffer of the socket. The latter exists for
+ * all the stream connections, including the TLS connections and the
+ * ones without output coalescing. When the kernel buffer is full, the
+ * eventdispatcher keeps the rest in its own buffer, which is not
+ * visible here, but the connection already ranks as the busiest.
+ *
+ * The routing table calls this function for each instance of a service
+ * for each message it forwards, so the kernel buffer size (an ioctl())
+ * is only read once every PENDING_OUTPUT_REFRESH, which covers the
+ * messages handled in one event loop iteration. In between, the bytes
+ * written with send_raw_message() get added to the last value read so
+ * a burst of messages still gets spread between the instances.
+ *
+ * \return The number of bytes waiting to be sent.
+ */
+std::size_t base_connection::get_pending_output() const
+{
+    std::chrono::steady_clock::time_point const now(std::chrono::steady_clock::now());
+    if(now - f_kernel_output_date >= PENDING_OUTPUT_REFRESH)
+    {
+        int unsent(0);
+        int const s(get_socket());
+        f_kernel_output = s != -1
+                       && ioctl(s, TIOCOUTQ, &unsent) == 0
+                       && unsent > 0
+                            ? static_cast<std::size_t>(unsent)
+                            : 0;
+        f_written_output = 0;
+        f_kernel_output_date = now;
+    }
+
+    return f_output_queue.size() + f_kernel_output + f_written_output;
+}
+
+
+/** \brief Limit the size of the output queue of this connection.
+ *
+ * A service which does not read its socket fast enough would otherwise
+ * have its messages accumulate in the daemon memory. Once the queue
+ * reaches \p max_messages or \p max_bytes (0 means no limit), the
+ * \p policy defines what happens to new messages:
+ *
+ * * OVERFLOW_POLICY_DROP_OLDEST -- the oldest queued messages get
+ *   dropped to make room;
+ * * OVERFLOW_POLICY_DROP_NEWEST -- the new message gets dropped;
+ * * OVERFLOW_POLICY_SERVICE_BUSY -- the new message gets dropped and
+ *   the sender receives a SERVICE_BUSY reply (see is_busy()).
+ *
+ * The limits are enforced by the output queue. If the output coalescing
+ * is turned off, the queue gets used anyway with a threshold of 1 byte
+ * so each message is still written immediately. The connections which
+ * write their bulk messages in batches (see set_bulk_batches()) do not
+ * use the output queue; the limits apply to their held messages.
+ *
+ * \param[in] max_messages  The maximum number of messages in the queue.
+ * \param[in] max_bytes  The maximum number of bytes in the queue.
+ * \param[in] policy  What to do with new messages once the queue is full.
+ */
+void base_connection::set_output_limits(
+      std::size_t max_messages
+    , std::size_t max_bytes
+    , overflow_policy_t policy)
+{
+    f_output_queue.set_limits(max_messages, max_bytes);
+    f_held_messages.set_limits(max_messages, max_bytes);
+    f_overflow_policy = policy;
+
+    if(!f_output_coalescing
+    && !f_bulk_batches
+    && f_output_queue.has_limits())
+    {
+        set_output_coalescing(1);
+    }
+}
+
+
+/** \brief Retrieve the overflow policy of this connection.
+ *
+ * \return The policy applied once the output queue is full.
+ */
+overflow_policy_t base_connection::get_overflow_policy() const
+{
+    return f_overflow_policy;
+}
+
+
+/** \brief Check whether the sender should be told this service is busy.
+ *
+ * \return true if the output queue or the held messages are full and
+ * the overflow policy is OVERFLOW_POLICY_SERVICE_BUSY.
+ */
+bool base_connection::is_busy() const
+{
+    return f_overflow_policy == overflow_policy_t::OVERFLOW_POLICY_SERVICE_BUSY
+        && ((f_output_coalescing && f_output_queue.is_full())
+            || (f_bulk_batches && f_held_messages.is_full()));
+}
+
+
+/** \brief Write the bulk messages in batches.
+ *
+ * The connections which cannot use the output queue (the links to the
+ * other communicator daemons and the encrypted connections) write their
+ * bulk messages in batches of held_messages::BULK_BATCH messages. The
+ * control messages get written immediately so they wait behind at most
+ * one batch. The other bulk messages are held until the output buffer
+ * is empty.
+ *
+ * \param[in] bulk_batches  Whether this connection uses bulk batches.
+ */
+void base_connection::set_bulk_batches(bool bulk_batches)
+{
+    f_bulk_batches = bulk_batches;
+}
+
+
+/** \brief Check whether this connection writes its bulk messages in batches.
+ *
+ * \return true if the bulk messages may be held.
+ */
+bool base_connection::has_bulk_batches() const
+{
+    return f_bulk_batches;
+}
+
+
+/** \brief Hold a bulk message until the next batch.
+ *
+ * The held messages are limited like the output queue. Once full, the
+ * overflow policy applies: the oldest held messages get dropped with
+ * OVERFLOW_POLICY_DROP_OLDEST, otherwise \p msg gets refused, in which
+ * case the caller sends a SERVICE_BUSY reply with
+ * OVERFLOW_POLICY_SERVICE_BUSY (see is_busy()).
+ *
+ * The held messages are not yet encoded so dropping one does not
+ * affect the dictionary of a compressed link.
+ *
+ * \param[in] msg  The bulk message to hold.
+ * \param[in] cache  Whether to cache the message while disconnected.
+ *
+ * \return true if the message is held, false if it was refused.
+ */
+bool base_connection::hold_message(ed::message & msg, bool cache)
+{
+    if(f_held_messages.is_full())
+    {
+        set_output_overflow(true);
+        if(f_overflow_policy != overflow_policy_t::OVERFLOW_POLICY_DROP_OLDEST
+        || !f_held_messages.drop_oldest())
+        {
+            f_held_messages.drop_newest();
+            return false;
+        }
+    }
+
+    f_held_messages.push(msg, cache);
+    return true;
+}
+
+
+/** \brief Retrieve the bulk messages held by this connection.
+ *
+ * \return A reference to the held messages.
+ */
+held_messages & base_connection::get_held_messages()
+{
+    return f_held_messages;
+}
+
+
+/** \brief Raise or take down the slow consumer flag.
+ *
+ * When the output queue of a connection overflows, a flag named after
+ * the connection gets raised so administrators can see which consumer
+ * is slow. The flag is taken down once the queue is empty again or the
+ * connection is gone.
+ *
+ * Several connections can have the same name (i.e. several instances
+ * of a service), so the name of the flag also includes the identifier
+ * of the connection. The name is saved when the flag is raised since
+ * the name of the connection can change before the flag gets taken
+ * down (i.e. on an UNREGISTER).
+ *
+ * \param[in] overflow  Whether the output queue overflowed.
+ */
+void base_connection::set_output_overflow(bool overflow)
+{
+    if(f_output_overflow == overflow)
+    {
+        return;
+    }
+    f_output_overflow = overflow;
+
+    if(overflow)
+    {
+        // flag names are limited to [a-z0-9-]
+        //
+        f_overflow_flag_name = "connection-";
+        for(char c : get_connection_name())
+        {
+            if(c >= 'A' && c <= 'Z')
+            {
+                c |= 0x20;
+            }
+            if((c >= 'a' && c <= 'z')
+            || (c >= '0' && c <= '9'))
+            {
+                f_overflow_flag_name += c;
+            }
+            else if(f_overflow_flag_name.back() != '-')
+            {
+                f_overflow_flag_name += '-';
+            }
+        }
+        if(f_overflow_flag_name.back() != '-')
+        {
+            f_overflow_flag_name += '-';
+        }
+        f_overflow_flag_name += std::to_string(f_connection_id);
+
+        SNAP_LOG_WARNING
+            << "the output queue of connection \""
+            << get_connection_name()
+            << "\" is full; messages to this consumer are being dropped."
+            << SNAP_LOG_SEND;
+
+        communicator::flag::pointer_t flag(COMMUNICATOR_FLAG_UP(
+                      "communicatord"
+                    , "slow-consumer"
+                    , f_overflow_flag_name
+                    , "the output queue of connection \""
+                        + get_connection_name()
+                        + "\" is full; the service is not reading its"
+                          " messages fast enough and some are being dropped."
+                ));
+        flag->set_priority(75);
+        flag->add_tag("network");
+        flag->add_tag("performance");
+        flag->save();
+    }
+    else
+    {
+        communicator::flag::pointer_t flag(COMMUNICATOR_FLAG_DOWN(
+                      "communicatord"
+                    , "slow-consumer"
+                    , f_overflow_flag_name));
+        flag->save();
+    }
+}
 
 } // namespace communicator_daemon
 // vim: ts=4 sw=4 et
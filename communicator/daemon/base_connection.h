@@ -30,6 +30,10 @@
 // self
 //
 #include    "communicatord.h"
+#include    "held_messages.h"
+#include    "link_codec.h"
+#include    "output_queue.h"
+#include    "topic_matcher.h"
 
 
 // eventdispatcher
@@ -37,6 +41,12 @@
 #include    <eventdispatcher/connection.h>
 
 
+// C++
+//
+#include    <chrono>
+#include    <cstdint>
+
+
 
 namespace communicator_daemon
 {
@@ -57,10 +67,13 @@ class base_connection
 public:
     typedef std::shared_ptr<base_connection>    pointer_t;
     typedef std::vector<pointer_t>              vector_t;
+    typedef std::shared_ptr<std::string const>  encoded_message_t;
+
+    static constexpr std::chrono::milliseconds  PENDING_OUTPUT_REFRESH = std::chrono::milliseconds(1);
 
                                 base_connection(
                                       communicatord * s
-                                    , bool is_udp);
+                                    , connection_kind_t kind);
                                 base_connection(base_connection const &) = delete;
     virtual                     ~base_connection();
 
@@ -89,18 +102,56 @@ public:
     void                        add_commands(std::string const & commands);
     bool                        understand_command(std::string const & command);
     bool                        has_commands() const;
+    advgetopt::string_set_t const &
+                                get_commands() const;
     void                        remove_command(std::string const & command);
     void                        mark_as_remote();
     bool                        is_remote() const;
+    connection_kind_t           get_connection_kind() const;
     bool                        is_udp() const;
     void                        set_wants_loadavg(bool wants_loadavg);
     bool                        wants_loadavg() const;
+    topic_matcher &             get_topics();
+    link_codec &                get_link_codec();
 
     // allows us to send messages directly from the base_connection class
     bool                        send_message_to_connection(
                                       ed::message & msg
                                     , bool cache = false
                                     , bool only_if_command_known = false);
+    bool                        can_send_raw_message() const;
+    bool                        send_raw_message(
+                                      encoded_message_t const & data
+                                    , bool priority = false);
+    bool                        make_room_for_output(bool priority);
+    bool                        is_priority_message(ed::message const & msg) const;
+    bool                        send_stream_message(ed::message const & msg);
+    bool                        send_encoded_message(
+                                      ed::message & msg
+                                    , encoded_message_t & encoded);
+
+    static encoded_message_t    encode_message(ed::message const & msg);
+
+    // output coalescing
+    void                        set_output_coalescing(std::size_t threshold);
+    bool                        is_output_coalescing() const;
+    bool                        has_queued_output() const;
+    bool                        flush_output();
+    output_queue const &        get_output_queue() const;
+    std::size_t                 get_pending_output() const;
+    void                        set_output_limits(
+                                      std::size_t max_messages
+                                    , std::size_t max_bytes
+                                    , overflow_policy_t policy);
+    overflow_policy_t           get_overflow_policy() const;
+    bool                        is_busy() const;
+    void                        set_output_overflow(bool overflow);
+
+    // bulk batches
+    void                        set_bulk_batches(bool bulk_batches);
+    bool                        has_bulk_batches() const;
+    bool                        hold_message(ed::message & msg, bool cache);
+    held_messages &             get_held_messages();
 
     virtual int                 get_socket() const = 0;
 
@@ -120,7 +171,21 @@ private:
     std::string                 f_password = std::string();
     bool                        f_remote_connection = false;
     bool                        f_wants_loadavg = false;
-    bool                        f_is_udp = false;
+    topic_matcher               f_topics = topic_matcher();
+    link_codec                  f_link_codec = link_codec();
+    bool                        f_output_coalescing = false;
+    output_queue                f_output_queue = output_queue();
+    overflow_policy_t           f_overflow_policy = overflow_policy_t::OVERFLOW_POLICY_SERVICE_BUSY;
+    bool                        f_output_overflow = false;
+    bool                        f_bulk_batches = false;
+    held_messages               f_held_messages = held_messages();
+    std::string                 f_overflow_flag_name = std::string();
+    mutable std::chrono::steady_clock::time_point
+                                f_kernel_output_date = std::chrono::steady_clock::time_point();
+    mutable std::size_t         f_kernel_output = 0;            // TIOCOUTQ at f_kernel_output_date
+    mutable std::size_t         f_written_output = 0;           // bytes written since f_kernel_output_date
+    std::uint64_t const         f_connection_id;
+    connection_kind_t const     f_kind;
 };
 
 
@@ -0,0 +1,381 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the broadcast_dedup class.
+ *
+ * The broadcast message identifiers are defined as "<server>-<sequence>".
+ * The server name is interned once so each identifier is saved as a
+ * compact (origin, sequence) key in an open addressing hash table with
+ * linear probing. Identifiers which do not follow that format are hashed
+ * instead.
+ *
+ * The keys are also saved in a timing wheel, one bucket per second,
+ * using their timeout to select the bucket. Expiring the old keys only
+ * visits the buckets of the seconds which elapsed since the last call,
+ * so insert(), contains(), and expire() are all amortized O(1). A timeout
+ * further than WHEEL_SIZE seconds in the future stays in its bucket
+ * until a later turn of the wheel.
+ */
+
+// self
+//
+#include    "broadcast_dedup.h"
+
+
+// C++
+//
+#include    <algorithm>
+#include    <limits>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+namespace
+{
+
+
+
+constexpr std::uint32_t     HASHED_ORIGIN = std::numeric_limits<std::uint32_t>::max();
+constexpr std::size_t       NO_SLOT = static_cast<std::size_t>(-1);
+
+
+std::uint64_t mix64(std::uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+
+/** \brief Split a broadcast message identifier.
+ *
+ * \param[in] msgid  The identifier to split.
+ * \param[out] origin  The name of the server which sent the message.
+ * \param[out] sequence  The sequence number of the message on that server.
+ *
+ * \return true if \p msgid is defined as "<server>-<sequence>".
+ */
+bool split_msgid(std::string_view msgid, std::string_view & origin, std::uint64_t & sequence)
+{
+    std::string_view::size_type const pos(msgid.rfind('-'));
+    if(pos == std::string_view::npos
+    || pos == 0
+    || pos + 1 == msgid.length()
+    || msgid.length() - pos - 1 > 19)
+    {
+        return false;
+    }
+
+    sequence = 0;
+    for(char const c : msgid.substr(pos + 1))
+    {
+        if(c < '0' || c > '9')
+        {
+            return false;
+        }
+        sequence = sequence * 10 + (c - '0');
+    }
+    origin = msgid.substr(0, pos);
+
+    return true;
+}
+
+
+std::uint64_t hash_msgid(std::string_view msgid)
+{
+    // FNV-1a
+    //
+    std::uint64_t h(0xCBF29CE484222325ULL);
+    for(char const c : msgid)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+
+
+} // no name namespace
+
+
+
+broadcast_dedup::broadcast_dedup()
+    : f_table(MIN_CAPACITY)
+{
+}
+
+
+/** \brief Check whether a message was already received.
+ *
+ * \param[in] msgid  The broadcast message identifier.
+ *
+ * \return true if \p msgid was inserted and did not yet expire.
+ */
+bool broadcast_dedup::contains(std::string_view msgid) const
+{
+    key_t key;
+    if(!find_key(msgid, key))
+    {
+        return false;
+    }
+    return find(key) != NO_SLOT;
+}
+
+
+/** \brief Remember a message identifier.
+ *
+ * \param[in] msgid  The broadcast message identifier.
+ * \param[in] timeout  The date, in seconds, after which the identifier
+ * can be forgotten.
+ *
+ * \return true if \p msgid was added, false if it was already present.
+ */
+bool broadcast_dedup::insert(std::string_view msgid, time_t timeout)
+{
+    key_t const key(intern_key(msgid));
+    if(find(key) != NO_SLOT)
+    {
+        return false;
+    }
+
+    if((f_size + 1) * 2 > f_table.size())
+    {
+        grow();
+    }
+
+    std::size_t const mask(f_table.size() - 1);
+    std::size_t idx(mix64(key.f_sequence ^ mix64(key.f_origin)) & mask);
+    while(f_table[idx].f_key.f_origin != 0)
+    {
+        idx = (idx + 1) & mask;
+    }
+    f_table[idx].f_key = key;
+    f_table[idx].f_timeout = timeout;
+    ++f_size;
+
+    // a timeout which is already in the past goes in the next bucket
+    // to be visited
+    //
+    time_t const when(std::max(timeout, f_next_expire));
+    f_wheel[static_cast<std::size_t>(when) & (WHEEL_SIZE - 1)].push_back(key);
+
+    return true;
+}
+
+
+/** \brief Forget the identifiers which timed out.
+ *
+ * An identifier is removed once its timeout is before \p now.
+ *
+ * \param[in] now  The current date in seconds.
+ */
+void broadcast_dedup::expire(time_t now)
+{
+    std::size_t count(WHEEL_SIZE);
+    if(f_next_expire != 0)
+    {
+        if(now <= f_next_expire)
+        {
+            return;
+        }
+        count = std::min(static_cast<std::size_t>(now - f_next_expire), WHEEL_SIZE);
+    }
+
+    for(std::size_t c(0); c < count; ++c)
+    {
+        std::vector<key_t> & bucket(f_wheel[(static_cast<std::size_t>(f_next_expire) + c) & (WHEEL_SIZE - 1)]);
+        std::size_t kept(0);
+        for(auto const & key : bucket)
+        {
+            std::size_t const idx(find(key));
+            if(f_table[idx].f_timeout < now)
+            {
+                erase(idx);
+            }
+            else
+            {
+                // timeout is in a later turn of the wheel
+                //
+                bucket[kept] = key;
+                ++kept;
+            }
+        }
+        bucket.resize(kept);
+    }
+
+    f_next_expire = now;
+}
+
+
+bool broadcast_dedup::empty() const
+{
+    return f_size == 0;
+}
+
+
+std::size_t broadcast_dedup::size() const
+{
+    return f_size;
+}
+
+
+std::size_t broadcast_dedup::capacity() const
+{
+    return f_table.size();
+}
+
+
+bool broadcast_dedup::find_key(std::string_view msgid, key_t & key) const
+{
+    std::string_view origin;
+    if(!split_msgid(msgid, origin, key.f_sequence))
+    {
+        key.f_origin = HASHED_ORIGIN;
+        key.f_sequence = hash_msgid(msgid);
+        return true;
+    }
+
+    auto const it(f_origins.find(origin));
+    if(it == f_origins.end())
+    {
+        return false;
+    }
+    key.f_origin = it->second;
+    return true;
+}
+
+
+broadcast_dedup::key_t broadcast_dedup::intern_key(std::string_view msgid)
+{
+    key_t key;
+    std::string_view origin;
+    if(!split_msgid(msgid, origin, key.f_sequence))
+    {
+        key.f_origin = HASHED_ORIGIN;
+        key.f_sequence = hash_msgid(msgid);
+        return key;
+    }
+
+    auto it(f_origins.find(origin));
+    if(it == f_origins.end())
+    {
+        // the number of servers in a cluster is small, we never
+        // remove an origin
+        //
+        it = f_origins.emplace(std::string(origin), static_cast<std::uint32_t>(f_origins.size() + 1)).first;
+    }
+    key.f_origin = it->second;
+    return key;
+}
+
+
+std::size_t broadcast_dedup::find(key_t const & key) const
+{
+    std::size_t const mask(f_table.size() - 1);
+    std::size_t idx(mix64(key.f_sequence ^ mix64(key.f_origin)) & mask);
+    for(;;)
+    {
+        slot_t const & s(f_table[idx]);
+        if(s.f_key.f_origin == 0)
+        {
+            return NO_SLOT;
+        }
+        if(s.f_key.f_origin == key.f_origin
+        && s.f_key.f_sequence == key.f_sequence)
+        {
+            return idx;
+        }
+        idx = (idx + 1) & mask;
+    }
+}
+
+
+/** \brief Remove the slot at \p index.
+ *
+ * The following slots of the same cluster are shifted back so the
+ * table does not need tombstones.
+ *
+ * \param[in] index  The index of the slot to remove.
+ */
+void broadcast_dedup::erase(std::size_t index)
+{
+    std::size_t const mask(f_table.size() - 1);
+    std::size_t hole(index);
+    std::size_t idx(index);
+    for(;;)
+    {
+        idx = (idx + 1) & mask;
+        slot_t const & s(f_table[idx]);
+        if(s.f_key.f_origin == 0)
+        {
+            break;
+        }
+
+        // move the slot to the hole unless its home is between the
+        // hole and its current position
+        //
+        std::size_t const home(mix64(s.f_key.f_sequence ^ mix64(s.f_key.f_origin)) & mask);
+        if(((idx - home) & mask) >= ((idx - hole) & mask))
+        {
+            f_table[hole] = s;
+            hole = idx;
+        }
+    }
+    f_table[hole] = slot_t();
+    --f_size;
+}
+
+
+void broadcast_dedup::grow()
+{
+    table_t old(f_table.size() * 2);
+    old.swap(f_table);
+
+    std::size_t const mask(f_table.size() - 1);
+    for(auto const & s : old)
+    {
+        if(s.f_key.f_origin != 0)
+        {
+            std::size_t idx(mix64(s.f_key.f_sequence ^ mix64(s.f_key.f_origin)) & mask);
+            while(f_table[idx].f_key.f_origin != 0)
+            {
+                idx = (idx + 1) & mask;
+            }
+            f_table[idx] = s;
+        }
+    }
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,99 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the broadcast_dedup class.
+ *
+ * The broadcast_dedup remembers the identifiers of the broadcast messages
+ * received recently so a message reaching this daemon through several
+ * neighbors is only handled once. Each identifier is kept until the
+ * timeout of its message.
+ */
+
+// C++
+//
+#include    <array>
+#include    <cstdint>
+#include    <map>
+#include    <string>
+#include    <string_view>
+#include    <vector>
+
+
+// C
+//
+#include    <time.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+class broadcast_dedup
+{
+public:
+    static constexpr std::size_t    WHEEL_SIZE = 64;            // in seconds, power of 2
+    static constexpr std::size_t    MIN_CAPACITY = 64;          // power of 2
+
+                                    broadcast_dedup();
+
+    bool                            contains(std::string_view msgid) const;
+    bool                            insert(std::string_view msgid, time_t timeout);
+    void                            expire(time_t now);
+    bool                            empty() const;
+    std::size_t                     size() const;
+    std::size_t                     capacity() const;
+
+private:
+    struct key_t
+    {
+        std::uint32_t               f_origin = 0;           // 0 means the slot is empty
+        std::uint64_t               f_sequence = 0;
+    };
+
+    struct slot_t
+    {
+        key_t                       f_key = key_t();
+        time_t                      f_timeout = 0;
+    };
+
+    typedef std::vector<slot_t>                 table_t;
+    typedef std::array<std::vector<key_t>, WHEEL_SIZE>
+                                                wheel_t;
+
+    bool                            find_key(std::string_view msgid, key_t & key) const;
+    key_t                           intern_key(std::string_view msgid);
+    std::size_t                     find(key_t const & key) const;
+    void                            erase(std::size_t index);
+    void                            grow();
+
+    std::map<std::string, std::uint32_t, std::less<>>
+                                    f_origins = std::map<std::string, std::uint32_t, std::less<>>();
+    table_t                         f_table = table_t();
+    wheel_t                         f_wheel = wheel_t();
+    std::size_t                     f_size = 0;
+    time_t                          f_next_expire = 0;      // first second not yet expired
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -22,6 +22,32 @@
  * The Communicator is able to memorize messages it receives when the
  * destination is not yet known. The structure here is used to manage that
  * cache.
+ *
+ * The cached messages are saved in a queue per service. When a service
+ * registers, only its own queue gets replayed, in the order in which
+ * the messages arrived.
+ *
+ * A message which times out gets removed by a hierarchical timing wheel.
+ * The first level has one slot per second for the next 64 seconds, the
+ * second level one slot per 64 seconds, and the third level one slot per
+ * 4096 seconds. When the time of a slot of an upper level comes, its
+ * messages move down one level. A message moves at most twice before it
+ * times out, so remove_old_messages() only costs the number of messages
+ * which timed out, not the size of the cache.
+ *
+ * Messages which only signal something, such as PING or RELOADCONFIG,
+ * do not need to be sent more than once. The commands declared with
+ * set_coalesce() have a key made of the command and the value of some
+ * of their parameters. A service queue keeps only the newest message
+ * for each key, which saves memory and avoids sending the same signal
+ * hundreds of times once the service registers.
+ *
+ * The memory used by the cache can be capped. The limits are checked
+ * each time a new message gets cached. Messages which already timed out
+ * are removed first. If that is not enough, the eviction policy either
+ * drops existing messages or rejects the new one. The sender of a dropped
+ * message is told about it the same way as if the message had not been
+ * cached in the first place (see set_evicted_callback()).
  */
 
 // self
@@ -45,9 +71,10 @@
 #include    <snaplogger/message.h>
 
 
-// snapdev
+// C++
 //
-#include    <snapdev/tokenize_string.h>
+#include    <algorithm>
+#include    <cmath>
 
 
 // last include
@@ -61,11 +88,109 @@ namespace communicator_daemon
 
 
 
-/** \brief Cache the specified message.
+namespace
+{
+
+
+
+/** \brief Compute the size of a message without serializing it.
  *
- * This function caches the specified message.
+ * This is the length of the message as written by to_message(), the
+ * fields and their separators, except that the characters which get
+ * escaped or quoted in parameter values are not counted. It avoids
+ * serializing each message we cache when the journal is not used.
+ *
+ * \param[in] msg  The message to measure.
+ *
+ * \return The size of the message in bytes.
+ */
+std::size_t message_size(ed::message const & msg)
+{
+    std::size_t size(msg.get_command().length());
+    if(!msg.get_sent_from_server().empty()
+    || !msg.get_sent_from_service().empty())
+    {
+        // "<server:service "
+        //
+        size += msg.get_sent_from_server().length()
+              + msg.get_sent_from_service().length()
+              + 3;
+    }
+    if(!msg.get_server().empty())
+    {
+        size += msg.get_server().length() + 1;
+    }
+    if(!msg.get_service().empty())
+    {
+        size += msg.get_service().length() + 1;
+    }
+    for(auto const & p : msg.get_all_parameters())
+    {
+        // " name=value" or ";name=value"
+        //
+        size += 1 + p.first.length() + 1 + p.second.length();
+    }
+    return size;
+}
+
+
+
+} // no name namespace
+
+
+
+/** \brief Convert the name of an eviction policy.
+ *
+ * The supported names are "oldest", "lowest-ttl", and "reject".
+ *
+ * \param[in] name  The name of the eviction policy.
+ * \param[out] eviction  The corresponding policy if \p name is valid.
+ *
+ * \return true if \p name is valid.
+ */
+bool string_to_eviction(std::string const & name, eviction_t & eviction)
+{
+    if(name == "oldest")
+    {
+        eviction = eviction_t::EVICTION_OLDEST;
+        return true;
+    }
+    if(name == "lowest-ttl")
+    {
+        eviction = eviction_t::EVICTION_LOWEST_TTL;
+        return true;
+    }
+    if(name == "reject")
+    {
+        eviction = eviction_t::EVICTION_REJECT;
+        return true;
+    }
+    return false;
+}
+
+
+char const * eviction_to_string(eviction_t eviction)
+{
+    switch(eviction)
+    {
+    case eviction_t::EVICTION_OLDEST:
+        return "oldest";
+
+    case eviction_t::EVICTION_LOWEST_TTL:
+        return "lowest-ttl";
+
+    case eviction_t::EVICTION_REJECT:
+        return "reject";
+
+    }
+
+    return "unknown";
+}
+
+
+/** \brief Parse the value of the "cache" parameter of a message.
  *
- * The "cache" parameter in a message supports the following parameters:
+ * The value is a list of options separated by semicolons:
  *
  * * "no[=true]" -- do not cache the message
  * * "reply[=true]" -- send a reply to the sender to let them know that the
@@ -74,112 +199,252 @@ namespace communicator_daemon
  *   is an approximation; the default is 60 seconds; durations can be defined
  *   with a time such as 1m for one minute and 3h for three hours
  *
- * \warning
- * The `reply=true` has no effect if the message gets cached. In that case,
- * the function always returns cache_message_t::CACHE_MESSAGE_CACHED.
- *
- * \todo
- * Limit the cache size.
+ * As for the "no" and "reply" options, their presence is enough, the
+ * value is ignored. Unknown options are ignored.
  *
- * \todo
- * Do not cache more than one signal message (i.e. PING, STOP, LOG...)
- * Problem is: how do we know that a message is a signal message?
+ * This function is called for each message which gets cached. It does
+ * not allocate memory unless the TTL uses a unit or an error gets logged.
  *
- * \param[in] msg  The message to save in the cache.
- *
- * \return one of the CACHE_MESSAGE_... values.
+ * \param[in] value  The value of the "cache" parameter.
+ * \param[in,out] param  The options found in \p value.
  */
-cache_message_t cache::cache_message(ed::message & msg)
+void parse_cache_parameter(std::string_view value, cache_parameter & param)
 {
-    std::string cache_value;
-    if(msg.has_parameter(communicator::g_name_communicator_param_cache))
+    while(!value.empty())
     {
-        cache_value = msg.get_parameter(communicator::g_name_communicator_param_cache);
-    }
-
-    // convert `cache` in a map of name/value parameters
-    //
-    std::list<std::string> cache_parameters;
-    snapdev::tokenize_string(cache_parameters, cache_value, { ";" }, true);
-    std::map<std::string, std::string> params;
-    for(auto const & p : cache_parameters)
-    {
-        std::string::size_type pos(p.find('='));
-        if(pos == std::string::npos)
+        std::string_view::size_type const end(value.find(';'));
+        std::string_view const p(value.substr(0, end));
+        value.remove_prefix(end == std::string_view::npos ? value.length() : end + 1);
+        if(p.empty())
         {
-            params[p] = "true"; // a.k.a. defined
+            continue;
         }
-        else if(pos == 0)
+
+        std::string_view::size_type const pos(p.find('='));
+        if(pos == 0)
         {
             SNAP_LOG_NOTICE
                 << "invalid cache parameter \""
                 << p
                 << "\"; expected \"<name>[=<value>]\"; \"<name>\" is missing, it cannot be empty."
                 << SNAP_LOG_SEND;
+            continue;
         }
-        else
-        {
-            params[p.substr(0, pos)] = p.substr(pos + 1);
-        }
-    }
 
-    // should we send a reply to the sender?
-    //
-    cache_message_t response(cache_message_t::CACHE_MESSAGE_IGNORE);
-    {
-        auto it(params.find("reply"));
-        if(it != params.end())
+        std::string_view const name(p.substr(0, pos));
+        if(name == "no")
         {
-            response = cache_message_t::CACHE_MESSAGE_REPLY;
+            param.f_no = true;
         }
-    }
-
-    // are we allowed to cache this message?
-    {
-        auto it(params.find("no"));
-        if(it != params.end())
+        else if(name == "reply")
         {
-            return response;
+            param.f_reply = true;
         }
-    }
+        else if(name == "ttl")
+        {
+            // a plain number of seconds is the common case, avoid the
+            // duration validator for it
+            //
+            std::string_view const ttl(pos == std::string_view::npos
+                                            ? std::string_view("true")
+                                            : p.substr(pos + 1));
+            double seconds(0.0);
+            bool valid(!ttl.empty() && ttl.length() <= 9);
+            std::int64_t number(0);
+            for(char const c : ttl)
+            {
+                if(c < '0' || c > '9')
+                {
+                    valid = false;
+                    break;
+                }
+                number = number * 10 + c - '0';
+            }
+            if(valid)
+            {
+                seconds = static_cast<double>(number);
+            }
+            else
+            {
+                valid = advgetopt::validator_duration::convert_string(
+                          std::string(ttl)
+                        , advgetopt::validator_duration::VALIDATOR_DURATION_DEFAULT_FLAGS
+                        , seconds);
+            }
 
-    std::int64_t ttl(60);
-    {
-        // get TTL if defined (1 min. per default)
-        //
-        auto it(params.find("ttl"));
-        if(it != params.end())
-        {
-            double value(0.0);
-            if(!advgetopt::validator_duration::convert_string(
-                      it->second
-                    , advgetopt::validator_duration::VALIDATOR_DURATION_DEFAULT_FLAGS
-                    , value))
+            if(!valid)
             {
                 SNAP_LOG_ERROR
                     << "cache TTL parameter is not a valid integer ("
-                    << it->second
+                    << ttl
                     << ")."
                     << SNAP_LOG_SEND;
+                param.f_ttl = cache_parameter::DEFAULT_TTL;
             }
-            else if(value < 10.0 || value > 86400.0)
+            else if(seconds < static_cast<double>(cache_parameter::MIN_TTL)
+                 || seconds > static_cast<double>(cache_parameter::MAX_TTL))
             {
                 SNAP_LOG_UNIMPORTANT
                     << "cache TTL is out of range ("
-                    << it->second
-                    << "); expected a number between 10 and 86400."
+                    << ttl
+                    << "); expected a number between "
+                    << cache_parameter::MIN_TTL
+                    << " and "
+                    << cache_parameter::MAX_TTL
+                    << "."
                     << SNAP_LOG_SEND;
+                param.f_ttl = cache_parameter::DEFAULT_TTL;
             }
             else
             {
-                ttl = static_cast<std::int64_t>(ceil(value));
+                param.f_ttl = static_cast<std::int64_t>(ceil(seconds));
             }
         }
     }
+}
+
+
+/** \brief Limit the size of the whole cache.
+ *
+ * The size of a message does not include the escaping of its parameter
+ * values so it can be a little smaller than the serialized message.
+ *
+ * \param[in] max_messages  The maximum number of messages, 0 for no limit.
+ * \param[in] max_bytes  The maximum number of bytes, 0 for no limit.
+ */
+void cache::set_limits(std::size_t max_messages, std::size_t max_bytes)
+{
+    f_max_messages = max_messages;
+    f_max_bytes = max_bytes;
+}
+
+
+/** \brief Limit the size of the cache of each service.
+ *
+ * These limits apply to each service separately. They prevent one
+ * service which is down for a while from using the entire cache.
+ *
+ * \param[in] max_messages  The maximum number of messages, 0 for no limit.
+ * \param[in] max_bytes  The maximum number of bytes, 0 for no limit.
+ */
+void cache::set_service_limits(std::size_t max_messages, std::size_t max_bytes)
+{
+    f_service_max_messages = max_messages;
+    f_service_max_bytes = max_bytes;
+}
+
+
+void cache::set_eviction(eviction_t eviction)
+{
+    f_eviction = eviction;
+}
+
+
+eviction_t cache::get_eviction() const
+{
+    return f_eviction;
+}
+
+
+/** \brief Set the function called when a cached message gets dropped.
+ *
+ * The message was accepted by cache_message() but it has to make room
+ * for a newer message. The \p callback receives that message and
+ * whether its sender asked for a reply (i.e. "cache=reply").
+ *
+ * Messages which time out are not reported.
+ *
+ * \param[in] callback  The function to call with the evicted messages.
+ */
+void cache::set_evicted_callback(evicted_callback_t callback)
+{
+    f_evicted_callback = callback;
+}
+
+
+/** \brief Coalesce the messages with \p command.
+ *
+ * Once a message with \p command is cached for a service, a newer
+ * message with the same command and the same values for \p parameters
+ * replaces it. The replaced message is not reported as evicted since
+ * the newer message gets sent instead.
+ *
+ * For example, coalescing "STATUS" with the "service" parameter keeps
+ * the last STATUS of each service.
+ *
+ * \param[in] command  The command of the messages to coalesce.
+ * \param[in] parameters  The parameters which have to match too, if any.
+ */
+void cache::set_coalesce(std::string const & command, parameter_list_t const & parameters)
+{
+    f_coalesce[command] = parameters;
+}
+
+
+void cache::clear_coalesce()
+{
+    f_coalesce.clear();
+}
+
+
+/** \brief Cache the specified message.
+ *
+ * This function caches the specified message.
+ *
+ * The "cache" parameter of the message defines whether the message can
+ * be cached, for how long, and whether the sender wants a reply when it
+ * is not (see parse_cache_parameter()).
+ *
+ * \warning
+ * The `reply=true` has no effect if the message gets cached. In that case,
+ * the function always returns cache_message_t::CACHE_MESSAGE_CACHED.
+ * If the message gets evicted later, the evicted callback is told about
+ * the `reply=true`.
+ *
+ * When the message does not fit in the limits of the cache and the
+ * eviction policy is EVICTION_REJECT, the message is not cached and
+ * the function returns as if `no=true` had been specified.
+ *
+ * A message with a command defined with set_coalesce() replaces the
+ * previous instance of that message, if still in the cache.
+ *
+ * \param[in] msg  The message to save in the cache.
+ *
+ * \return one of the CACHE_MESSAGE_... values.
+ */
+cache_message_t cache::cache_message(ed::message & msg)
+{
+    cache_parameter param;
+    if(msg.has_parameter(communicator::g_name_communicator_param_cache))
+    {
+        std::string const value(msg.get_parameter(communicator::g_name_communicator_param_cache));
+        parse_cache_parameter(value, param);
+    }
+
+    // should we send a reply to the sender?
+    //
+    cache_message_t const response(param.f_reply
+                ? cache_message_t::CACHE_MESSAGE_REPLY
+                : cache_message_t::CACHE_MESSAGE_IGNORE);
+
+    // are we allowed to cache this message?
+    //
+    if(param.f_no)
+    {
+        return response;
+    }
 
     // save the message
     //
-    f_message_cache.emplace_back(time(nullptr) + ttl, msg);
+    time_t const timeout(time(nullptr) + param.f_ttl);
+    if(!add_message(msg, message_size(msg), timeout, param.f_reply, f_sequence + 1))
+    {
+        return response;
+    }
+    if(f_journal.is_open())
+    {
+        f_journal.append(f_sequence, timeout, param.f_reply, msg.to_message());
+    }
 
 //#ifdef _DEBUG
 //    // to make sure we get messages cached as expected
@@ -198,15 +463,123 @@ cache_message_t cache::cache_message(ed::message & msg)
 }
 
 
+/** \brief Save the messages of the cache in a journal.
+ *
+ * The messages found in the journal are added back to the cache. This
+ * is how the messages survive a restart of the daemon. The messages
+ * which timed out while the daemon was not running are dropped.
+ *
+ * Then each message added to or removed from the cache gets recorded
+ * in the journal.
+ *
+ * \param[in] filename  The path to the journal file.
+ *
+ * \return true if the journal is ready.
+ */
+bool cache::open_journal(std::string const & filename)
+{
+    if(!f_journal.open(filename))
+    {
+        return false;
+    }
+
+    time_t const now(time(nullptr));
+    std::size_t restored(0);
+    f_journal.replay([this, now, &restored](
+              std::uint64_t id
+            , time_t timeout
+            , bool reply
+            , std::string const & message)
+        {
+            ed::message msg;
+            if(now > timeout
+            || !msg.from_message(message)
+            || !add_message(msg, message_size(msg), timeout, reply, id))
+            {
+                f_journal.remove(id);
+                return;
+            }
+            ++restored;
+        });
+
+    SNAP_LOG_INFO
+        << "restored "
+        << restored
+        << " cached messages from \""
+        << filename
+        << "\"."
+        << SNAP_LOG_SEND;
+
+    return true;
+}
+
+
+/** \brief Compact the journal if it is worth it.
+ *
+ * The journal grows each time a message gets added to or removed from
+ * the cache. This function rewrites the journal when most of it is
+ * made of messages already removed from the cache. It is expected to
+ * be called from a timer.
+ *
+ * Each call copies at most cache_journal::COMPACTION_STEP bytes so a
+ * large journal gets compacted over several calls.
+ *
+ * \return true if the compaction is not complete yet and this function
+ * should be called again soon.
+ */
+bool cache::compact_journal()
+{
+    if(!f_journal.is_compacting()
+    && !f_journal.needs_compaction())
+    {
+        return false;
+    }
+
+    f_journal.compact();
+    return f_journal.is_compacting();
+}
+
+
+/** \brief Remove the messages which timed out.
+ *
+ * The timing wheel gets advanced to the current time. Only the messages
+ * which timed out are looked at.
+ *
+ * This function is expected to be called from a timer. The messages
+ * which timed out and were not yet removed are never sent anyway.
+ */
 void cache::remove_old_messages()
+{
+    remove_old_messages(time(nullptr));
+}
+
+
+/** \brief Remove the messages which timed out by \p now.
+ *
+ * \param[in] now  The current time.
+ */
+void cache::remove_old_messages(time_t now)
+{
+    wheel_advance(now);
+}
+
+
+/** \brief Process all the cached messages.
+ *
+ * The \p callback is called with each message which did not yet time
+ * out. If it returns true, the message is removed from the cache.
+ *
+ * \param[in] callback  The function called with each message.
+ */
+void cache::process_messages(callback_t callback)
 {
     time_t const now(time(nullptr));
-    auto it(f_message_cache.begin());
-    while(it != f_message_cache.end())
+    for(auto it(f_services.begin()); it != f_services.end(); )
     {
-        if(now > it->f_timeout_timestamp)
+        process_queue(it->second, callback, now);
+        if(it->second.f_queue.empty())
         {
-            it = f_message_cache.erase(it);
+            it = f_services.erase(it);
         }
         else
         {
@@ -216,16 +589,541 @@ void cache::remove_old_messages()
 }
 
 
-void cache::process_messages(std::function<bool(ed::message & msg)> callback)
+/** \brief Process the cached messages of one service.
+ *
+ * This function is called when \p service registers. The \p callback
+ * gets called with the messages sent to that service, in the order in
+ * which they were received. The messages of the other services are not
+ * looked at.
+ *
+ * \param[in] service  The name of the service.
+ * \param[in] callback  The function called with each message; if it
+ * returns true, the message is removed from the cache.
+ */
+void cache::process_messages(std::string const & service, callback_t callback)
 {
-    time_t const now(time(nullptr));
-    auto it(f_message_cache.begin());
-    while(it != f_message_cache.end())
+    auto it(f_services.find(service));
+    if(it == f_services.end())
+    {
+        return;
+    }
+
+    process_queue(it->second, callback, time(nullptr));
+    if(it->second.f_queue.empty())
     {
-        if(callback(it->f_message)
-        || now > it->f_timeout_timestamp)
+        f_services.erase(it);
+    }
+}
+
+
+bool cache::empty() const
+{
+    return f_count == 0;
+}
+
+
+std::size_t cache::size() const
+{
+    return f_count;
+}
+
+
+std::size_t cache::size(std::string const & service) const
+{
+    auto const it(f_services.find(service));
+    if(it == f_services.end())
+    {
+        return 0;
+    }
+    return it->second.f_queue.size();
+}
+
+
+std::size_t cache::get_bytes() const
+{
+    return f_bytes;
+}
+
+
+std::size_t cache::get_bytes(std::string const & service) const
+{
+    auto const it(f_services.find(service));
+    if(it == f_services.end())
+    {
+        return 0;
+    }
+    return it->second.f_bytes;
+}
+
+
+std::uint64_t cache::get_evicted() const
+{
+    return f_evicted;
+}
+
+
+std::uint64_t cache::get_rejected() const
+{
+    return f_rejected;
+}
+
+
+std::uint64_t cache::get_coalesced() const
+{
+    return f_coalesced;
+}
+
+
+/** \brief Build the coalesce key of a message.
+ *
+ * \param[in] msg  The message to check.
+ *
+ * \return The key, or an empty string if the command of \p msg does
+ * not get coalesced.
+ */
+std::string cache::coalesce_key(ed::message const & msg) const
+{
+    if(f_coalesce.empty())
+    {
+        return std::string();
+    }
+    auto const it(f_coalesce.find(msg.get_command()));
+    if(it == f_coalesce.end())
+    {
+        return std::string();
+    }
+
+    std::string key(msg.get_command());
+    for(auto const & name : it->second)
+    {
+        key += '\0';
+        if(msg.has_parameter(name))
+        {
+            key += '=';
+            key += msg.get_parameter(name);
+        }
+    }
+    return key;
+}
+
+
+/** \brief Add a message to the queue of its service.
+ *
+ * Messages which timed out get removed and the limits of the cache get
+ * enforced before the message is added.
+ *
+ * \param[in] msg  The message to add.
+ * \param[in] size  The size of the message in bytes.
+ * \param[in] timeout  When the message times out.
+ * \param[in] reply  Whether the sender wants a reply if the message gets
+ * dropped.
+ * \param[in] sequence  The identifier of the message.
+ *
+ * \return true if the message was added, false if it was rejected.
+ */
+bool cache::add_message(
+      ed::message & msg
+    , std::size_t size
+    , time_t timeout
+    , bool reply
+    , std::uint64_t sequence)
+{
+    std::string const & service_name(msg.get_service());
+    auto it(f_services.find(service_name));
+
+    if(over_limits(size)
+    || (it != f_services.end() && over_service_limits(it->second, size)))
+    {
+        remove_old_messages();
+        it = f_services.find(service_name);
+    }
+
+    // a newer signal replaces the one already cached, but only if the
+    // newer one gets cached, otherwise we would lose both
+    //
+    std::string key(coalesce_key(msg));
+    bool rejected(false);
+    if(!key.empty()
+    && it != f_services.end())
+    {
+        auto const previous(it->second.f_coalesced.find(key));
+        if(previous != it->second.f_coalesced.end())
+        {
+            if(can_replace(it->second, *previous->second, size))
+            {
+                erase(it->second, previous->second);
+                ++f_coalesced;
+                if(it->second.f_queue.empty())
+                {
+                    f_services.erase(it);
+                    it = f_services.end();
+                }
+            }
+            else
+            {
+                rejected = true;
+            }
+        }
+    }
+
+    if(rejected
+    || !make_room(it, size))
+    {
+        ++f_rejected;
+        SNAP_LOG_DEBUG
+            << "cache is full, message \""
+            << msg.get_command()
+            << "\" to \""
+            << service_name
+            << "\" not cached."
+            << SNAP_LOG_SEND;
+        return false;
+    }
+
+    if(it == f_services.end())
+    {
+        it = f_services.emplace(service_name, service_cache()).first;
+        it->second.f_name = service_name;
+    }
+    f_sequence = std::max(f_sequence, sequence);
+    message_cache::queue_t & queue(it->second.f_queue);
+    queue.push_back(message_cache{ timeout, msg, size, sequence, reply });
+    if(!key.empty())
+    {
+        queue.back().f_coalesce_key = key;
+        it->second.f_coalesced[std::move(key)] = std::prev(queue.end());
+    }
+    if(f_wheel_time == 0)
+    {
+        f_wheel_time = time(nullptr);
+    }
+    wheel_insert(wheel_entry{ &it->second, std::prev(queue.end()) }, f_wheel_time + 1);
+    it->second.f_bytes += size;
+    ++f_count;
+    f_bytes += size;
+
+    return true;
+}
+
+
+bool cache::over_limits(std::size_t size) const
+{
+    return (f_max_messages != 0 && f_count >= f_max_messages)
+        || (f_max_bytes != 0 && f_bytes + size > f_max_bytes);
+}
+
+
+bool cache::over_service_limits(service_cache const & service, std::size_t size) const
+{
+    return (f_service_max_messages != 0 && service.f_queue.size() >= f_service_max_messages)
+        || (f_service_max_bytes != 0 && service.f_bytes + size > f_service_max_bytes);
+}
+
+
+/** \brief Check whether a message can replace a coalesced message.
+ *
+ * The \p previous message gets removed only if make_room() is then
+ * going to accept the new message. make_room() can only refuse a
+ * message larger than a limit or, with the EVICTION_REJECT policy,
+ * a message which does not fit once \p previous is gone.
+ *
+ * \param[in] service  The service cache holding \p previous.
+ * \param[in] previous  The coalesced message to replace.
+ * \param[in] size  The size of the new message.
+ *
+ * \return true if the new message can replace \p previous.
+ */
+bool cache::can_replace(
+      service_cache const & service
+    , message_cache const & previous
+    , std::size_t size) const
+{
+    if((f_max_bytes != 0 && size > f_max_bytes)
+    || (f_service_max_bytes != 0 && size > f_service_max_bytes))
+    {
+        return false;
+    }
+
+    if(f_eviction != eviction_t::EVICTION_REJECT)
+    {
+        return true;
+    }
+
+    return (f_max_messages == 0 || f_count <= f_max_messages)
+        && (f_max_bytes == 0 || f_bytes - previous.f_size + size <= f_max_bytes)
+        && (f_service_max_messages == 0 || service.f_queue.size() <= f_service_max_messages)
+        && (f_service_max_bytes == 0 || service.f_bytes - previous.f_size + size <= f_service_max_bytes);
+}
+
+
+/** \brief Check whether \p lhs gets evicted before \p rhs.
+ *
+ * \param[in] lhs  The first message to compare.
+ * \param[in] rhs  The second message to compare.
+ *
+ * \return true if \p lhs is a better candidate for eviction.
+ */
+bool cache::evict_first(message_cache const & lhs, message_cache const & rhs) const
+{
+    if(f_eviction == eviction_t::EVICTION_LOWEST_TTL
+    && lhs.f_timeout_timestamp != rhs.f_timeout_timestamp)
+    {
+        return lhs.f_timeout_timestamp < rhs.f_timeout_timestamp;
+    }
+    return lhs.f_sequence < rhs.f_sequence;
+}
+
+
+/** \brief Drop messages until a message of \p size bytes fits.
+ *
+ * The limits of the service are checked first. Then the limits of the
+ * whole cache, in which case the messages of any service can be evicted.
+ *
+ * With the EVICTION_OLDEST policy, only the first message of each queue
+ * needs to be checked since a queue is in arrival order. The other
+ * policies look at all the messages. This only happens when the cache
+ * is full.
+ *
+ * \param[in] service  The queue of the service receiving the new message
+ * or f_services.end() if that service has no messages yet.
+ * \param[in] size  The size of the new message.
+ *
+ * \return true if the message can be added to the cache.
+ */
+bool cache::make_room(service_map_t::iterator service, std::size_t size)
+{
+    // a message larger than a limit never fits
+    //
+    if((f_max_bytes != 0 && size > f_max_bytes)
+    || (f_service_max_bytes != 0 && size > f_service_max_bytes))
+    {
+        return false;
+    }
+
+    if(service != f_services.end())
+    {
+        while(over_service_limits(service->second, size))
+        {
+            if(f_eviction == eviction_t::EVICTION_REJECT)
+            {
+                return false;
+            }
+            message_cache::queue_t & queue(service->second.f_queue);
+            auto victim(queue.begin());
+            if(f_eviction != eviction_t::EVICTION_OLDEST)
+            {
+                for(auto it(std::next(victim)); it != queue.end(); ++it)
+                {
+                    if(evict_first(*it, *victim))
+                    {
+                        victim = it;
+                    }
+                }
+            }
+            evict(service->second, victim);
+        }
+    }
+
+    while(over_limits(size))
+    {
+        if(f_eviction == eviction_t::EVICTION_REJECT)
+        {
+            return false;
+        }
+        auto victim_service(f_services.end());
+        message_cache::queue_t::iterator victim;
+        for(auto it(f_services.begin()); it != f_services.end(); ++it)
+        {
+            message_cache::queue_t & queue(it->second.f_queue);
+            auto const last(f_eviction == eviction_t::EVICTION_OLDEST && !queue.empty()
+                                    ? std::next(queue.begin())
+                                    : queue.end());
+            for(auto m(queue.begin()); m != last; ++m)
+            {
+                if(victim_service == f_services.end()
+                || evict_first(*m, *victim))
+                {
+                    victim_service = it;
+                    victim = m;
+                }
+            }
+        }
+        evict(victim_service->second, victim);
+        if(victim_service != service
+        && victim_service->second.f_queue.empty())
+        {
+            f_services.erase(victim_service);
+        }
+    }
+
+    return true;
+}
+
+
+/** \brief Remove a message from the cache to make room.
+ *
+ * The evicted callback is called with the message once it was removed.
+ *
+ * \param[in] service  The service cache holding the message.
+ * \param[in] it  The message to evict.
+ */
+void cache::evict(service_cache & service, message_cache::queue_t::iterator it)
+{
+    ed::message msg(std::move(it->f_message));
+    bool const reply(it->f_reply);
+    erase(service, it);
+    ++f_evicted;
+
+    SNAP_LOG_DEBUG
+        << "cache is full, message \""
+        << msg.get_command()
+        << "\" to \""
+        << msg.get_service()
+        << "\" evicted."
+        << SNAP_LOG_SEND;
+
+    if(f_evicted_callback != nullptr)
+    {
+        f_evicted_callback(msg, reply);
+    }
+}
+
+
+/** \brief Remove a message from the cache.
+ *
+ * The message is removed from its queue, the coalesce keys, the timing
+ * wheel, and the journal. The queue of the service is not removed even if empty.
+ *
+ * \param[in] service  The service cache holding the message.
+ * \param[in] it  The message to remove.
+ */
+void cache::erase(service_cache & service, message_cache::queue_t::iterator it)
+{
+    if(!it->f_coalesce_key.empty())
+    {
+        service.f_coalesced.erase(it->f_coalesce_key);
+    }
+    wheel_remove(*it);
+    f_journal.remove(it->f_sequence);
+    service.f_bytes -= it->f_size;
+    f_bytes -= it->f_size;
+    --f_count;
+    service.f_queue.erase(it);
+}
+
+
+/** \brief Add a message to the timing wheel.
+ *
+ * The level is selected by how far the timeout is from the time of the
+ * wheel. The slot is selected by the timeout itself so the slot of the
+ * upper levels come in order as the time goes.
+ *
+ * \param[in] entry  The message to add to the wheel.
+ * \param[in] earliest  The first second which was not yet processed; a
+ * message which already timed out gets removed on that second.
+ */
+void cache::wheel_insert(wheel_entry const & entry, time_t earliest)
+{
+    // a message times out once the current time is after its timeout
+    //
+    message_cache & m(*entry.f_message);
+    time_t expire(std::max(m.f_timeout_timestamp + 1, earliest));
+
+    std::size_t level(0);
+    while(level + 1 < WHEEL_LEVELS
+       && expire - f_wheel_time >= static_cast<time_t>(1) << (WHEEL_BITS * (level + 1)))
+    {
+        ++level;
+    }
+    if(level == WHEEL_LEVELS - 1)
+    {
+        // beyond the last level, the message goes down again when that
+        // slot comes and gets added back at the right place
+        //
+        expire = std::min(expire, f_wheel_time + (static_cast<time_t>(1) << (WHEEL_BITS * WHEEL_LEVELS)) - 1);
+    }
+    std::size_t const slot((expire >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1));
+
+    wheel_slot_t & s(f_wheel[level][slot]);
+    m.f_wheel_level = static_cast<std::uint8_t>(level);
+    m.f_wheel_slot = static_cast<std::uint8_t>(slot);
+    m.f_wheel_index = s.size();
+    s.push_back(entry);
+}
+
+
+void cache::wheel_remove(message_cache const & m)
+{
+    wheel_slot_t & s(f_wheel[m.f_wheel_level][m.f_wheel_slot]);
+    if(m.f_wheel_index + 1 != s.size())
+    {
+        s[m.f_wheel_index] = s.back();
+        s[m.f_wheel_index].f_message->f_wheel_index = m.f_wheel_index;
+    }
+    s.pop_back();
+}
+
+
+/** \brief Remove the messages which timed out up to \p now.
+ *
+ * Each second between the last call and \p now gets processed: the
+ * slots of the upper levels which start at that second move down and
+ * the messages of the first level slot time out.
+ *
+ * \param[in] now  The current time.
+ */
+void cache::wheel_advance(time_t now)
+{
+    if(f_count == 0)
+    {
+        f_wheel_time = now;
+        return;
+    }
+
+    while(f_wheel_time < now)
+    {
+        ++f_wheel_time;
+        for(std::size_t level(WHEEL_LEVELS - 1); level > 0; --level)
         {
-            it = f_message_cache.erase(it);
+            if((f_wheel_time & ((static_cast<time_t>(1) << (WHEEL_BITS * level)) - 1)) != 0)
+            {
+                continue;
+            }
+            wheel_slot_t entries;
+            entries.swap(f_wheel[level][(f_wheel_time >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1)]);
+            for(auto const & e : entries)
+            {
+                wheel_insert(e, f_wheel_time);
+            }
+        }
+
+        wheel_slot_t & s(f_wheel[0][f_wheel_time & (WHEEL_SIZE - 1)]);
+        while(!s.empty())
+        {
+            service_cache * service(s.back().f_service);
+            erase(*service, s.back().f_message);
+            if(service->f_queue.empty())
+            {
+                f_services.erase(f_services.find(service->f_name));
+            }
+        }
+    }
+}
+
+
+void cache::process_queue(
+      service_cache & service
+    , callback_t const & callback
+    , time_t now)
+{
+    for(auto it(service.f_queue.begin()); it != service.f_queue.end(); )
+    {
+        if(now > it->f_timeout_timestamp
+        || callback(it->f_message))
+        {
+            auto const next(std::next(it));
+            erase(service, it);
+            it = next;
         }
         else
         {
@@ -235,6 +1133,5 @@ void cache::process_messages(std::function<bool(ed::message & msg)> callback)
 }
 
 
-
 } // namespace communicator_daemon
 // vim: ts=4 sw=4 et
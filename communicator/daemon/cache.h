@@ -23,8 +23,30 @@
  * The Communicator is able to memorize messages it receives when the
  * destination is not yet available. The class here is used to manage that
  * cache.
+ *
+ * The messages are kept in one queue per destination service so the
+ * messages of a service which just registered can be sent without
+ * looking at the messages of the other services.
+ *
+ * The cache can be limited in number of messages and in bytes, globally
+ * and per service. When a limit is reached, the eviction policy decides
+ * whether older messages get dropped or the new message gets rejected.
+ *
+ * The cache can also be saved in a journal so the messages survive a
+ * restart of the daemon.
+ *
+ * The messages which time out are found with a hierarchical timing
+ * wheel so removing them does not require a scan of the whole cache.
+ *
+ * Signal messages such as PING or RELOADCONFIG can be coalesced: only
+ * the newest instance of such a message is kept for each service.
  */
 
+// self
+//
+#include    "cache_journal.h"
+
+
 // eventdispatcher
 //
 #include    <eventdispatcher/message.h>
@@ -32,8 +54,14 @@
 
 // C++
 //
+#include    <array>
+#include    <cstdint>
 #include    <functional>
 #include    <list>
+#include    <string>
+#include    <string_view>
+#include    <unordered_map>
+#include    <vector>
 
 
 
@@ -49,25 +77,159 @@ enum class cache_message_t
 };
 
 
+enum class eviction_t
+{
+    EVICTION_OLDEST,            // drop the messages received first
+    EVICTION_LOWEST_TTL,        // drop the messages closest to their timeout
+    EVICTION_REJECT,            // keep the cached messages, reject the new one
+};
+
+
+bool                    string_to_eviction(std::string const & name, eviction_t & eviction);
+char const *            eviction_to_string(eviction_t eviction);
+
+
+/** \brief The options found in the "cache" parameter of a message.
+ *
+ * See parse_cache_parameter() for details.
+ */
+struct cache_parameter
+{
+    static constexpr std::int64_t   DEFAULT_TTL = 60;           // in seconds
+    static constexpr std::int64_t   MIN_TTL = 10;
+    static constexpr std::int64_t   MAX_TTL = 86400;
+
+    bool                f_no = false;
+    bool                f_reply = false;
+    std::int64_t        f_ttl = DEFAULT_TTL;
+};
+
+
+void                    parse_cache_parameter(std::string_view value, cache_parameter & param);
+
+
 class cache
 {
 public:
+    typedef std::function<bool(ed::message & msg)>      callback_t;
+    typedef std::function<void(ed::message & msg, bool reply)>
+                                                        evicted_callback_t;
+    typedef std::vector<std::string>                    parameter_list_t;
+
+    void                set_limits(std::size_t max_messages, std::size_t max_bytes);
+    void                set_service_limits(std::size_t max_messages, std::size_t max_bytes);
+    void                set_eviction(eviction_t eviction);
+    eviction_t          get_eviction() const;
+    void                set_evicted_callback(evicted_callback_t callback);
+    void                set_coalesce(std::string const & command, parameter_list_t const & parameters);
+    void                clear_coalesce();
+
+    bool                open_journal(std::string const & filename);
+    bool                compact_journal();
     cache_message_t     cache_message(ed::message & msg);
     void                remove_old_messages();
-    void                process_messages(std::function<bool(ed::message & msg)> callback);
+    void                remove_old_messages(time_t now);
+    void                process_messages(callback_t callback);
+    void                process_messages(std::string const & service, callback_t callback);
+    bool                empty() const;
+    std::size_t         size() const;
+    std::size_t         size(std::string const & service) const;
+    std::size_t         get_bytes() const;
+    std::size_t         get_bytes(std::string const & service) const;
+    std::uint64_t       get_evicted() const;
+    std::uint64_t       get_rejected() const;
+    std::uint64_t       get_coalesced() const;
 
 private:
+    static constexpr std::size_t    WHEEL_BITS = 6;
+    static constexpr std::size_t    WHEEL_SIZE = 1 << WHEEL_BITS;   // slots per level
+    static constexpr std::size_t    WHEEL_LEVELS = 3;               // 64s, 1h08m, 72h49m
+
+    class service_cache;
+
     class message_cache
     {
     public:
-        typedef std::list<message_cache>  list_t;
+        typedef std::list<message_cache>  queue_t;
 
         time_t              f_timeout_timestamp = 0;            // when that message is to be removed from the cache even if it wasn't sent to its destination
         ed::message         f_message = ed::message();          // the message
+        std::size_t         f_size = 0;                         // size of the message in bytes
+        std::uint64_t       f_sequence = 0;                     // arrival order across all the services
+        bool                f_reply = false;                    // the sender wants to know when the message gets dropped
+        std::string         f_coalesce_key = std::string();     // empty unless the command gets coalesced
+        std::uint8_t        f_wheel_level = 0;                  // position of this message in the timing wheel
+        std::uint8_t        f_wheel_slot = 0;
+        std::size_t         f_wheel_index = 0;
+    };
+
+    class wheel_entry
+    {
+    public:
+        service_cache *     f_service = nullptr;
+        message_cache::queue_t::iterator
+                            f_message = message_cache::queue_t::iterator();
+    };
+
+    typedef std::vector<wheel_entry>                                    wheel_slot_t;
+    typedef std::array<std::array<wheel_slot_t, WHEEL_SIZE>, WHEEL_LEVELS> wheel_t;
+
+    class service_cache
+    {
+    public:
+        std::string         f_name = std::string();             // name of the service
+        message_cache::queue_t
+                            f_queue = message_cache::queue_t(); // messages in arrival order
+        std::size_t         f_bytes = 0;                        // total size of the messages in f_queue
+        std::unordered_map<std::string, message_cache::queue_t::iterator>
+                            f_coalesced = std::unordered_map<std::string, message_cache::queue_t::iterator>(); // coalesce key -> newest message
     };
 
-    message_cache::list_t
-                        f_message_cache = message_cache::list_t();
+    typedef std::unordered_map<std::string, service_cache>  service_map_t;
+
+    bool                add_message(
+                              ed::message & msg
+                            , std::size_t size
+                            , time_t timeout
+                            , bool reply
+                            , std::uint64_t sequence);
+    std::string         coalesce_key(ed::message const & msg) const;
+    bool                over_limits(std::size_t size) const;
+    bool                over_service_limits(service_cache const & service, std::size_t size) const;
+    bool                can_replace(
+                              service_cache const & service
+                            , message_cache const & previous
+                            , std::size_t size) const;
+    bool                evict_first(message_cache const & lhs, message_cache const & rhs) const;
+    bool                make_room(service_map_t::iterator service, std::size_t size);
+    void                evict(service_cache & service, message_cache::queue_t::iterator it);
+    void                erase(service_cache & service, message_cache::queue_t::iterator it);
+    void                wheel_insert(wheel_entry const & entry, time_t earliest);
+    void                wheel_remove(message_cache const & m);
+    void                wheel_advance(time_t now);
+    void                process_queue(
+                              service_cache & service
+                            , callback_t const & callback
+                            , time_t now);
+
+    service_map_t       f_services = service_map_t();           // service name -> messages in arrival order
+    std::size_t         f_count = 0;                            // total number of cached messages
+    std::size_t         f_bytes = 0;                            // total size of the cached messages
+    std::size_t         f_max_messages = 0;                     // 0 means no limit
+    std::size_t         f_max_bytes = 0;
+    std::size_t         f_service_max_messages = 0;
+    std::size_t         f_service_max_bytes = 0;
+    eviction_t          f_eviction = eviction_t::EVICTION_OLDEST;
+    evicted_callback_t  f_evicted_callback = evicted_callback_t();
+    std::uint64_t       f_sequence = 0;
+    std::uint64_t       f_evicted = 0;                          // messages dropped to make room
+    std::uint64_t       f_rejected = 0;                         // messages not cached because of the limits
+    std::uint64_t       f_coalesced = 0;                        // messages replaced by a newer instance
+    std::unordered_map<std::string, parameter_list_t>
+                        f_coalesce = std::unordered_map<std::string, parameter_list_t>(); // command -> parameters of the coalesce key
+    cache_journal       f_journal = cache_journal();
+    wheel_t             f_wheel = wheel_t();
+    time_t              f_wheel_time = 0;                       // last second processed by the timing wheel
 };
 
 
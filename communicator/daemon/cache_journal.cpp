@@ -0,0 +1,770 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the cache_journal class.
+ *
+ * The journal starts with a header (JOURNAL_MAGIC) followed by records.
+ * A record saves a message added to the cache (RECORD_MESSAGE) or the
+ * identifier of a message removed from the cache (RECORD_REMOVE). Each
+ * record is aligned to 8 bytes. The unused part of the file is all
+ * zeroes, so the first record with a type of 0 marks the end of the
+ * journal.
+ *
+ * The type of a record is written last. If the daemon gets killed while
+ * writing a record, that record is ignored on the next start.
+ *
+ * Removing messages makes the journal grow too. Once the removed records
+ * use more space than the messages still in the cache, compact() writes
+ * a new journal with only the messages still in the cache. The copy is
+ * incremental: each call scans at most COMPACTION_STEP bytes of the
+ * journal so the owner can call it from a timer without blocking the
+ * event loop for longer than one such copy.
+ */
+
+// self
+//
+#include    "cache_journal.h"
+
+
+// snaplogger
+//
+#include    <snaplogger/message.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <cerrno>
+#include    <cstddef>
+#include    <cstring>
+#include    <vector>
+
+
+// C
+//
+#include    <fcntl.h>
+#include    <sys/mman.h>
+#include    <sys/stat.h>
+#include    <unistd.h>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+namespace
+{
+
+
+
+constexpr char const        JOURNAL_MAGIC[8] = { 'C', 'M', 'C', 'J', 'R', 'N', 'L', '1' };
+constexpr std::size_t       HEADER_SIZE = 16;
+
+constexpr std::uint16_t     RECORD_MESSAGE = 1;
+constexpr std::uint16_t     RECORD_REMOVE = 2;
+
+constexpr std::uint16_t     FLAG_REPLY = 0x0001;
+
+
+
+} // no name namespace
+
+
+
+cache_journal::cache_journal()
+{
+}
+
+
+cache_journal::~cache_journal()
+{
+    close();
+}
+
+
+/** \brief Open the journal.
+ *
+ * The file gets created if it does not exist yet. Otherwise the existing
+ * records are loaded so replay() can return the messages which were in
+ * the cache when the daemon stopped.
+ *
+ * A file which is not a journal is restarted from scratch.
+ *
+ * \param[in] filename  The path to the journal file.
+ *
+ * \return true if the journal is ready.
+ */
+bool cache_journal::open(std::string const & filename)
+{
+    close();
+
+    int const fd(::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600));
+    if(fd < 0)
+    {
+        int const e(errno);
+        SNAP_LOG_ERROR
+            << "could not open cache journal \""
+            << filename
+            << "\" (errno: "
+            << e
+            << ", "
+            << strerror(e)
+            << ")."
+            << SNAP_LOG_SEND;
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    std::size_t capacity(static_cast<std::size_t>(st.st_size));
+    bool initialize(capacity < HEADER_SIZE);
+    if(initialize)
+    {
+        capacity = MINIMUM_SIZE;
+        if(ftruncate(fd, capacity) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+    }
+
+    f_filename = filename;
+    if(!map(fd, capacity))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    if(!initialize
+    && memcmp(f_data, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+    {
+        SNAP_LOG_ERROR
+            << "file \""
+            << filename
+            << "\" is not a cache journal; starting a new one."
+            << SNAP_LOG_SEND;
+        initialize = true;
+    }
+    if(initialize)
+    {
+        memset(f_data, 0, f_capacity);
+        memcpy(f_data, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    }
+
+    return load();
+}
+
+
+void cache_journal::close()
+{
+    abort_compaction();
+    if(f_data != nullptr)
+    {
+        munmap(f_data, f_capacity);
+        f_data = nullptr;
+    }
+    if(f_fd >= 0)
+    {
+        ::close(f_fd);
+        f_fd = -1;
+    }
+    f_capacity = 0;
+    f_end = 0;
+    f_live_bytes = 0;
+    f_records.clear();
+}
+
+
+bool cache_journal::is_open() const
+{
+    return f_data != nullptr;
+}
+
+
+/** \brief Call \p callback with each message still in the journal.
+ *
+ * The messages are returned in the order in which they were appended.
+ * The callback is allowed to append and remove messages.
+ *
+ * \param[in] callback  The function called with each message.
+ */
+void cache_journal::replay(replay_callback_t callback)
+{
+    std::vector<std::size_t> offsets;
+    offsets.reserve(f_records.size());
+    for(auto const & r : f_records)
+    {
+        offsets.push_back(r.second);
+    }
+    std::sort(offsets.begin(), offsets.end());
+
+    for(auto const offset : offsets)
+    {
+        // the callback may have removed this message or grown the
+        // mapping, so always re-read the record
+        //
+        record_t const record(read_record(offset));
+        auto const it(f_records.find(record.f_id));
+        if(it == f_records.end()
+        || it->second != offset)
+        {
+            continue;
+        }
+        std::string const message(f_data + offset + sizeof(record_t), record.f_size);
+        callback(
+              record.f_id
+            , record.f_timeout
+            , (record.f_flags & FLAG_REPLY) != 0
+            , message);
+    }
+}
+
+
+/** \brief Save a message in the journal.
+ *
+ * \param[in] id  The identifier of the message, unique in this journal.
+ * \param[in] timeout  When the message times out.
+ * \param[in] reply  Whether the sender wants a reply if the message gets
+ * dropped.
+ * \param[in] message  The message serialized with to_message().
+ *
+ * \return true if the message was saved.
+ */
+bool cache_journal::append(
+      std::uint64_t id
+    , time_t timeout
+    , bool reply
+    , std::string const & message)
+{
+    if(f_data == nullptr)
+    {
+        return false;
+    }
+
+    std::size_t const size(record_size(message.length()));
+    if(f_end + size > f_capacity
+    && !grow(std::max(f_capacity * 2, f_end + size)))
+    {
+        return false;
+    }
+
+    record_t record;
+    record.f_type = RECORD_MESSAGE;
+    record.f_flags = reply ? FLAG_REPLY : 0;
+    record.f_size = static_cast<std::uint32_t>(message.length());
+    record.f_id = id;
+    record.f_timeout = timeout;
+    write_record(f_data, f_end, record, message.data());
+
+    f_records[id] = f_end;
+    f_end += size;
+    f_live_bytes += size;
+
+    return true;
+}
+
+
+/** \brief Mark a message as removed from the cache.
+ *
+ * \param[in] id  The identifier used when the message was appended.
+ */
+void cache_journal::remove(std::uint64_t id)
+{
+    auto const it(f_records.find(id));
+    if(it == f_records.end())
+    {
+        return;
+    }
+    f_live_bytes -= record_size(read_record(it->second).f_size);
+    f_records.erase(it);
+
+    record_t record;
+    record.f_type = RECORD_REMOVE;
+    record.f_id = id;
+    std::size_t const size(record_size(0));
+
+    // a compaction in progress may already have copied that message
+    //
+    auto const copy(f_compact_records.find(id));
+    if(copy != f_compact_records.end())
+    {
+        f_compact_records.erase(copy);
+        if(grow_compaction(size))
+        {
+            write_record(f_compact_data, f_compact_end, record, nullptr);
+            f_compact_end += size;
+        }
+        else
+        {
+            abort_compaction();
+        }
+    }
+
+    if(f_end + size > f_capacity
+    && !grow(f_capacity * 2))
+    {
+        // the message comes back on a restart, the service will receive
+        // it twice which is better than losing it
+        //
+        return;
+    }
+
+    write_record(f_data, f_end, record, nullptr);
+    f_end += size;
+}
+
+
+/** \brief Check whether compact() would recover enough space.
+ *
+ * \return true if the removed messages use more space than the messages
+ * still in the journal.
+ */
+bool cache_journal::needs_compaction() const
+{
+    if(f_data == nullptr)
+    {
+        return false;
+    }
+
+    std::size_t const dead(f_end - HEADER_SIZE - f_live_bytes);
+    return dead >= COMPACTION_THRESHOLD
+        && dead > f_live_bytes;
+}
+
+
+/** \brief Check whether a compaction is in progress.
+ *
+ * \return true if compact() has to be called again to complete the
+ * compaction.
+ */
+bool cache_journal::is_compacting() const
+{
+    return f_compact_data != nullptr;
+}
+
+
+/** \brief Rewrite the journal with only the messages still in the cache.
+ *
+ * The new journal is written in a temporary file which replaces the
+ * current journal once complete. If anything fails, the current journal
+ * is kept as is.
+ *
+ * Each call scans at most \p step bytes of the current journal, which
+ * bounds the time spent in the event loop to one memcpy() of that size.
+ * The journal can be used between two calls: the messages appended in
+ * the meantime get copied when reached and the messages removed after
+ * they were copied get removed from the new journal too. Call the
+ * function again while is_compacting() returns true.
+ *
+ * \param[in] step  The maximum number of bytes of the journal to scan.
+ *
+ * \return true if the journal was compacted.
+ */
+bool cache_journal::compact(std::size_t step)
+{
+    if(f_data == nullptr)
+    {
+        return false;
+    }
+
+    if(f_compact_data == nullptr
+    && !start_compaction())
+    {
+        return false;
+    }
+
+    std::size_t scanned(0);
+    while(f_compact_offset < f_end
+       && scanned < step)
+    {
+        record_t const record(read_record(f_compact_offset));
+        std::size_t const size(record_size(record.f_size));
+        if(record.f_type == RECORD_MESSAGE)
+        {
+            auto const it(f_records.find(record.f_id));
+            if(it != f_records.end()
+            && it->second == f_compact_offset)
+            {
+                if(!grow_compaction(size))
+                {
+                    abort_compaction();
+                    return false;
+                }
+                memcpy(f_compact_data + f_compact_end, f_data + f_compact_offset, size);
+                f_compact_records[record.f_id] = f_compact_end;
+                f_compact_end += size;
+            }
+        }
+        f_compact_offset += size;
+        scanned += size;
+    }
+
+    if(f_compact_offset < f_end)
+    {
+        return false;
+    }
+
+    return finish_compaction();
+}
+
+
+/** \brief Number of messages in the journal.
+ *
+ * \return The number of messages appended and not yet removed.
+ */
+std::size_t cache_journal::size() const
+{
+    return f_records.size();
+}
+
+
+std::size_t cache_journal::get_used_bytes() const
+{
+    return f_end;
+}
+
+
+std::size_t cache_journal::get_live_bytes() const
+{
+    return f_live_bytes;
+}
+
+
+std::size_t cache_journal::record_size(std::size_t message_size)
+{
+    return (sizeof(record_t) + message_size + 7) & ~static_cast<std::size_t>(7);
+}
+
+
+cache_journal::record_t cache_journal::read_record(std::size_t offset) const
+{
+    record_t record;
+    memcpy(&record, f_data + offset, sizeof(record));
+    return record;
+}
+
+
+void cache_journal::write_record(
+      char * data
+    , std::size_t offset
+    , record_t const & record
+    , char const * message)
+{
+    if(message != nullptr)
+    {
+        memcpy(data + offset + sizeof(record_t), message, record.f_size);
+    }
+
+    // write the type last so a partially written record is ignored
+    //
+    record_t r(record);
+    r.f_type = 0;
+    memcpy(data + offset, &r, sizeof(r));
+    memcpy(data + offset + offsetof(record_t, f_type), &record.f_type, sizeof(record.f_type));
+}
+
+
+/** \brief Load the records found in the journal.
+ *
+ * The loading stops at the first record of type 0 or the first invalid
+ * record. Anything after that point gets cleared so the next records
+ * can be appended there.
+ *
+ * \return true if the journal is ready.
+ */
+bool cache_journal::load()
+{
+    std::size_t offset(HEADER_SIZE);
+    while(offset + sizeof(record_t) <= f_capacity)
+    {
+        record_t const record(read_record(offset));
+        std::size_t const size(record_size(record.f_size));
+        if(offset + size > f_capacity)
+        {
+            break;
+        }
+        if(record.f_type == RECORD_MESSAGE)
+        {
+            f_records[record.f_id] = offset;
+            f_live_bytes += size;
+        }
+        else if(record.f_type == RECORD_REMOVE)
+        {
+            auto const it(f_records.find(record.f_id));
+            if(it != f_records.end())
+            {
+                f_live_bytes -= record_size(read_record(it->second).f_size);
+                f_records.erase(it);
+            }
+        }
+        else
+        {
+            break;
+        }
+        offset += size;
+    }
+    f_end = offset;
+
+    // a record interrupted by a crash may have left data after the end
+    //
+    char * const tail(f_data + f_end);
+    std::size_t const tail_size(f_capacity - f_end);
+    if(std::find_if(tail, tail + tail_size, [](char c) { return c != 0; }) != tail + tail_size)
+    {
+        memset(tail, 0, tail_size);
+    }
+
+    return true;
+}
+
+
+bool cache_journal::map(int fd, std::size_t capacity)
+{
+    void * ptr(mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    if(ptr == MAP_FAILED)
+    {
+        int const e(errno);
+        SNAP_LOG_ERROR
+            << "could not map cache journal \""
+            << f_filename
+            << "\" in memory (errno: "
+            << e
+            << ", "
+            << strerror(e)
+            << ")."
+            << SNAP_LOG_SEND;
+        return false;
+    }
+
+    f_fd = fd;
+    f_data = static_cast<char *>(ptr);
+    f_capacity = capacity;
+    return true;
+}
+
+
+/** \brief Make the journal file larger.
+ *
+ * \param[in] capacity  The new size of the file.
+ *
+ * \return true if the journal was resized; on failure, the journal is
+ * left as is.
+ */
+bool cache_journal::grow(std::size_t capacity)
+{
+    if(ftruncate(f_fd, capacity) != 0)
+    {
+        int const e(errno);
+        SNAP_LOG_ERROR
+            << "could not grow cache journal \""
+            << f_filename
+            << "\" to "
+            << capacity
+            << " bytes (errno: "
+            << e
+            << ", "
+            << strerror(e)
+            << ")."
+            << SNAP_LOG_SEND;
+        return false;
+    }
+
+    void * ptr(mremap(f_data, f_capacity, capacity, MREMAP_MAYMOVE));
+    if(ptr == MAP_FAILED)
+    {
+        return false;
+    }
+
+    f_data = static_cast<char *>(ptr);
+    f_capacity = capacity;
+    return true;
+}
+
+
+
+/** \brief Create the temporary file receiving the compacted journal.
+ *
+ * \return true if the compaction can start.
+ */
+bool cache_journal::start_compaction()
+{
+    std::size_t capacity(MINIMUM_SIZE);
+    while(capacity < (HEADER_SIZE + f_live_bytes) * 2)
+    {
+        capacity *= 2;
+    }
+
+    std::string const tmp(f_filename + ".tmp");
+    int const fd(::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if(fd < 0)
+    {
+        return false;
+    }
+    if(ftruncate(fd, capacity) != 0)
+    {
+        ::close(fd);
+        unlink(tmp.c_str());
+        return false;
+    }
+    void * ptr(mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    if(ptr == MAP_FAILED)
+    {
+        ::close(fd);
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    f_compact_fd = fd;
+    f_compact_data = static_cast<char *>(ptr);
+    f_compact_capacity = capacity;
+    memcpy(f_compact_data, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    f_compact_end = HEADER_SIZE;
+    f_compact_offset = HEADER_SIZE;
+    f_compact_records.clear();
+    f_compact_records.reserve(f_records.size());
+
+    return true;
+}
+
+
+/** \brief Make sure the new journal has room for \p size more bytes.
+ *
+ * \param[in] size  The size of the record to write in the new journal.
+ *
+ * \return true if the record fits.
+ */
+bool cache_journal::grow_compaction(std::size_t size)
+{
+    if(f_compact_end + size <= f_compact_capacity)
+    {
+        return true;
+    }
+
+    std::size_t const capacity(std::max(f_compact_capacity * 2, f_compact_end + size));
+    if(ftruncate(f_compact_fd, capacity) != 0)
+    {
+        return false;
+    }
+
+    void * ptr(mremap(f_compact_data, f_compact_capacity, capacity, MREMAP_MAYMOVE));
+    if(ptr == MAP_FAILED)
+    {
+        return false;
+    }
+
+    f_compact_data = static_cast<char *>(ptr);
+    f_compact_capacity = capacity;
+    return true;
+}
+
+
+/** \brief Replace the journal with the compacted one.
+ *
+ * The new journal gets flushed to disk before it replaces the current
+ * one. Otherwise a crash right after the rename() could leave a journal
+ * with missing records.
+ *
+ * \return true if the journal was replaced.
+ */
+bool cache_journal::finish_compaction()
+{
+    std::string const tmp(f_filename + ".tmp");
+    if(msync(f_compact_data, f_compact_capacity, MS_SYNC) != 0
+    || fsync(f_compact_fd) != 0
+    || rename(tmp.c_str(), f_filename.c_str()) != 0)
+    {
+        int const e(errno);
+        SNAP_LOG_ERROR
+            << "could not replace cache journal \""
+            << f_filename
+            << "\" (errno: "
+            << e
+            << ", "
+            << strerror(e)
+            << ")."
+            << SNAP_LOG_SEND;
+        abort_compaction();
+        return false;
+    }
+
+    SNAP_LOG_DEBUG
+        << "cache journal compacted from "
+        << f_end
+        << " to "
+        << f_compact_end
+        << " bytes."
+        << SNAP_LOG_SEND;
+
+    munmap(f_data, f_capacity);
+    ::close(f_fd);
+    f_fd = f_compact_fd;
+    f_data = f_compact_data;
+    f_capacity = f_compact_capacity;
+    f_end = f_compact_end;
+    f_records.swap(f_compact_records);
+
+    f_compact_fd = -1;
+    f_compact_data = nullptr;
+    f_compact_capacity = 0;
+    f_compact_end = 0;
+    f_compact_offset = 0;
+    f_compact_records.clear();
+
+    return true;
+}
+
+
+/** \brief Stop a compaction in progress.
+ *
+ * The temporary file gets deleted. The current journal is not affected.
+ */
+void cache_journal::abort_compaction()
+{
+    if(f_compact_data == nullptr)
+    {
+        return;
+    }
+
+    munmap(f_compact_data, f_compact_capacity);
+    ::close(f_compact_fd);
+    unlink((f_filename + ".tmp").c_str());
+
+    f_compact_fd = -1;
+    f_compact_data = nullptr;
+    f_compact_capacity = 0;
+    f_compact_end = 0;
+    f_compact_offset = 0;
+    f_compact_records.clear();
+}
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,125 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the cache_journal class.
+ *
+ * The cache_journal saves the messages of the cache in a file so they
+ * survive a restart of the daemon. The file is an append-only journal
+ * mapped in memory: adding or removing a message is a copy to memory,
+ * not a system call.
+ */
+
+// C++
+//
+#include    <cstdint>
+#include    <functional>
+#include    <string>
+#include    <unordered_map>
+
+
+// C
+//
+#include    <time.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+class cache_journal
+{
+public:
+    typedef std::function<void(
+                  std::uint64_t id
+                , time_t timeout
+                , bool reply
+                , std::string const & message)>     replay_callback_t;
+
+    static constexpr std::size_t    MINIMUM_SIZE = 64 * 1024;           // initial size of the file
+    static constexpr std::size_t    COMPACTION_THRESHOLD = 64 * 1024;   // minimum number of bytes to recover
+    static constexpr std::size_t    COMPACTION_STEP = 1024 * 1024;      // maximum number of bytes scanned by one call to compact()
+
+                                    cache_journal();
+                                    cache_journal(cache_journal const &) = delete;
+                                    ~cache_journal();
+
+    cache_journal &                 operator = (cache_journal const &) = delete;
+
+    bool                            open(std::string const & filename);
+    void                            close();
+    bool                            is_open() const;
+    void                            replay(replay_callback_t callback);
+    bool                            append(
+                                          std::uint64_t id
+                                        , time_t timeout
+                                        , bool reply
+                                        , std::string const & message);
+    void                            remove(std::uint64_t id);
+    bool                            needs_compaction() const;
+    bool                            is_compacting() const;
+    bool                            compact(std::size_t step = COMPACTION_STEP);
+    std::size_t                     size() const;
+    std::size_t                     get_used_bytes() const;
+    std::size_t                     get_live_bytes() const;
+
+private:
+    struct record_t
+    {
+        std::uint16_t               f_type = 0;             // 0 marks the end of the journal
+        std::uint16_t               f_flags = 0;
+        std::uint32_t               f_size = 0;             // size of the message following this record
+        std::uint64_t               f_id = 0;
+        std::int64_t                f_timeout = 0;
+    };
+
+    typedef std::unordered_map<std::uint64_t, std::size_t>  record_map_t;
+
+    static std::size_t              record_size(std::size_t message_size);
+    record_t                        read_record(std::size_t offset) const;
+    static void                     write_record(char * data, std::size_t offset, record_t const & record, char const * message);
+    bool                            load();
+    bool                            map(int fd, std::size_t capacity);
+    bool                            grow(std::size_t capacity);
+    bool                            start_compaction();
+    bool                            grow_compaction(std::size_t size);
+    bool                            finish_compaction();
+    void                            abort_compaction();
+
+    std::string                     f_filename = std::string();
+    int                             f_fd = -1;
+    char *                          f_data = nullptr;
+    std::size_t                     f_capacity = 0;         // size of the file and of the mapping
+    std::size_t                     f_end = 0;              // offset where the next record gets written
+    std::size_t                     f_live_bytes = 0;       // bytes used by the messages still in the cache
+    record_map_t                    f_records = record_map_t(); // id -> offset of the message record
+    int                             f_compact_fd = -1;
+    char *                          f_compact_data = nullptr;
+    std::size_t                     f_compact_capacity = 0;
+    std::size_t                     f_compact_end = 0;      // offset where the next record gets written in the new journal
+    std::size_t                     f_compact_offset = 0;   // offset of the next record of this journal to copy
+    record_map_t                    f_compact_records = record_map_t(); // id -> offset of the message record in the new journal
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,74 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the cache timer.
+ *
+ * The cache maintenance does not happen while messages get forwarded.
+ * Instead, this timer calls it once in a while.
+ */
+
+// self
+//
+#include    "cache_timer.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+/** \brief Initialize the cache timer.
+ *
+ * \param[in] s  The communicator server owning the cache.
+ */
+cache_timer::cache_timer(communicatord * s)
+    : timer(MAINTENANCE_INTERVAL)
+    , f_server(s)
+{
+    set_name("communicator_cache_timer");
+}
+
+
+/** \brief Run the maintenance of the message cache.
+ *
+ * This function removes the cached messages which timed out and
+ * compacts the cache journal when it is mostly made of messages which
+ * were already removed from the cache.
+ *
+ * The compaction is done in steps. While it is not complete, the timer
+ * ticks every COMPACTION_INTERVAL so the other connections get served
+ * between two steps.
+ */
+void cache_timer::process_timeout()
+{
+    set_timeout_delay(f_server->cache_maintenance()
+            ? COMPACTION_INTERVAL
+            : MAINTENANCE_INTERVAL);
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,69 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Definition of the cache timer.
+ *
+ * The cache timer wakes up periodically to remove the cached messages
+ * which timed out and compact the cache journal.
+ */
+
+// self
+//
+#include    "communicatord.h"
+
+
+// eventdispatcher
+//
+#include    <eventdispatcher/timer.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+class cache_timer
+    : public ed::timer
+{
+public:
+    typedef std::shared_ptr<cache_timer>   pointer_t;
+
+    static constexpr std::int64_t   MAINTENANCE_INTERVAL = 60LL * 1'000'000LL;    // once a minute
+    static constexpr std::int64_t   COMPACTION_INTERVAL = 10'000LL;               // 10ms between two journal compaction steps
+
+                        cache_timer(communicatord * s);
+                        cache_timer(cache_timer const &) = delete;
+    virtual             ~cache_timer() override {}
+
+    cache_timer         operator = (cache_timer const &) = delete;
+
+    // ed::timer implementation
+    //
+    virtual void        process_timeout() override;
+
+private:
+    communicatord *     f_server = nullptr;
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
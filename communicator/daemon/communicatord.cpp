@@ -32,10 +32,13 @@
 //
 #include    "communicatord.h"
 
+#include    "cache_timer.h"
 #include    "gossip_connection.h"
 #include    "interrupt.h"
+#include    "link_codec.h"
 #include    "listener.h"
 #include    "ping.h"
+#include    "raw_message.h"
 #include    "remote_connection.h"
 #include    "remote_communicators.h"
 #include    "service_connection.h"
@@ -47,6 +50,7 @@
 //
 #include    <communicator/exception.h>
 #include    <communicator/flags.h>
+#include    <communicator/interned_names.h>
 #include    <communicator/loadavg.h>
 #include    <communicator/names.h>
 #include    <communicator/version.h>
@@ -104,7 +108,9 @@
 
 // C++
 //
+#include    <algorithm>
 #include    <cmath>
+#include    <set>
 #include    <thread>
 
 
@@ -112,6 +118,7 @@
 //
 #include    <grp.h>
 #include    <pwd.h>
+#include    <stdlib.h>
 
 
 // last include
@@ -159,6 +166,101 @@ std::int64_t        g_broadcast_sequence = 0;
 
 const advgetopt::option g_options[] =
 {
+    advgetopt::define_option(
+          advgetopt::Name("anycast-local-margin")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("10")
+        , advgetopt::Help("when sending a message to server \"~\", keep it on this computer unless a remote computer load is lower by more than this percentage of its capacity.")
+        , advgetopt::Validator("integer(0...1000)")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("broadcast-fanout")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("0")
+        , advgetopt::Help("number of children of each daemon in the \"tree\" strategy or number of random neighbors in the \"gossip\" strategy; 0 means automatic.")
+        , advgetopt::Validator("integer(0...100)")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("broadcast-redundancy")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("2")
+        , advgetopt::Help("with the \"gossip\" strategy and an automatic fan-out, number of neighbors added to ln(number of daemons).")
+        , advgetopt::Validator("integer(0...20)")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("broadcast-strategy")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("flood")
+        , advgetopt::Help("how broadcast messages get forwarded to the other communicator daemons: \"flood\", \"tree\", or \"gossip\".")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("cache-coalesce")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("LOG,PING,RELOADCONFIG,STOP")
+        , advgetopt::Help("comma separated list of COMMAND[:parameter...] of which only the newest message is kept in the cache of each service.")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("cache-eviction")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("oldest")
+        , advgetopt::Help("what to do with new messages once the cache of messages sent to local services which are not running is full: \"oldest\", \"lowest-ttl\", or \"reject\".")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("cache-journal")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("none")
+        , advgetopt::Help("save the cache of messages sent to local services which are not running in a journal under the data path so it survives a restart: \"none\" or \"mmap\".")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("cache-max-bytes")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("67108864")
+        , advgetopt::Help("maximum number of bytes kept in the cache of messages sent to local services which are not running; 0 means no limit.")
+        , advgetopt::Validator("integer(0...4294967295)")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("cache-max-messages")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("100000")
+        , advgetopt::Help("maximum number of messages kept in the cache of messages sent to local services which are not running; 0 means no limit.")
+        , advgetopt::Validator("integer(0...100000000)")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("cache-service-max-bytes")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("16777216")
+        , advgetopt::Help("maximum number of bytes kept in the cache for one service; 0 means no limit.")
+        , advgetopt::Validator("integer(0...4294967295)")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("cache-service-max-messages")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("10000")
+        , advgetopt::Help("maximum number of messages kept in the cache for one service; 0 means no limit.")
+        , advgetopt::Validator("integer(0...100000000)")
+    ),
     advgetopt::define_option(
           advgetopt::Name("certificate")
         , advgetopt::Flags(advgetopt::all_flags<
@@ -185,6 +287,22 @@ const advgetopt::option g_options[] =
         , advgetopt::Help("verify the incoming messages (as per the COMMANDS message).")
 #endif
     ),
+    advgetopt::define_option(
+          advgetopt::Name("compress-plain-links")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("yes")
+        , advgetopt::Help("compress the compact framing of the plain links with the other communicator daemons: \"yes\" or \"no\".")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("compress-secure-links")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("no")
+        , advgetopt::Help("compress the compact framing of the secure links with the other communicator daemons: \"yes\" or \"no\".")
+    ),
     advgetopt::define_option(
           advgetopt::Name("group-name")
         , advgetopt::Flags(advgetopt::all_flags<
@@ -193,6 +311,14 @@ const advgetopt::option g_options[] =
         , advgetopt::DefaultValue("communicator")
         , advgetopt::Help("drop privileges to this group.")
     ),
+    advgetopt::define_option(
+          advgetopt::Name("link-framing")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("compact")
+        , advgetopt::Help("framing offered to the other communicator daemons: \"compact\" or \"text\".")
+    ),
     advgetopt::define_option(
           advgetopt::Name("local-listen")
         , advgetopt::Flags(advgetopt::all_flags<
@@ -253,6 +379,49 @@ const advgetopt::option g_options[] =
         , advgetopt::Help("define a comma separated list of communicatord neighbors.")
         , advgetopt::Validator("address('address=commas spaces required', port, comment)")
     ),
+    advgetopt::define_option(
+          advgetopt::Name("output-coalescing")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("65536")
+        , advgetopt::Help("maximum number of bytes queued on a local connection before the queue gets written immediately; 0 turns off the coalescing of messages.")
+        , advgetopt::Validator("integer(0...16777216)")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("output-queue-max-bytes")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("16777216")
+        , advgetopt::Help("maximum number of bytes waiting to be sent to one connection; 0 means no limit.")
+        , advgetopt::Validator("integer(0...4294967295)")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("output-queue-max-messages")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("100000")
+        , advgetopt::Help("maximum number of messages waiting to be sent to one connection; 0 means no limit.")
+        , advgetopt::Validator("integer(0...100000000)")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("output-queue-overflow")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("service-busy")
+        , advgetopt::Help("what to do with new messages once the output queue of a connection is full: \"drop-oldest\", \"drop-newest\", or \"service-busy\".")
+    ),
+    advgetopt::define_option(
+          advgetopt::Name("priority-commands")
+        , advgetopt::Flags(advgetopt::all_flags<
+              advgetopt::GETOPT_FLAG_REQUIRED
+            , advgetopt::GETOPT_FLAG_GROUP_OPTIONS>())
+        , advgetopt::DefaultValue("CLUSTER_DOWN,CLUSTER_UP,DISCONNECT,HANGUP,QUITTING,SHUTDOWN,STATUS,STOP")
+        , advgetopt::Help("comma separated list of control commands which are sent ahead of the other messages already queued.")
+    ),
     advgetopt::define_option(
           advgetopt::Name("private-key")
         , advgetopt::Flags(advgetopt::all_flags<
@@ -460,9 +629,13 @@ communicatord::communicatord(int argc, char * argv[])
         DISPATCHER_MATCH(communicator::g_name_communicator_cmd_register, &communicatord::msg_register),
         // default in dispatcher: RESTART
         DISPATCHER_MATCH(communicator::g_name_communicator_cmd_service_status, &communicatord::msg_service_status),
+        DISPATCHER_MATCH(communicator::g_name_communicator_cmd_services, &communicatord::msg_services),
         // default in dispatcher: SERVICE_UNAVAILABLE
         DISPATCHER_MATCH(communicator::g_name_communicator_cmd_shutdown, &communicatord::msg_shutdown),
+        DISPATCHER_MATCH(communicator::g_name_communicator_cmd_subscribe, &communicatord::msg_subscribe),
+        DISPATCHER_MATCH(communicator::g_name_communicator_cmd_subscriptions, &communicatord::msg_subscriptions),
         DISPATCHER_MATCH(communicator::g_name_communicator_cmd_unregister, &communicatord::msg_unregister),
+        DISPATCHER_MATCH(communicator::g_name_communicator_cmd_unsubscribe, &communicatord::msg_unsubscribe),
         // default in dispatcher: STOP -- we overload the stop() which gets called by the message implementation
         // default in dispatcher: UNKNOWN -- we overload the function to include more details in the log
 
@@ -513,8 +686,18 @@ int communicatord::init()
         return 1;
     }
 
+    init_output_coalescing();
+    init_output_limits();
+    init_priority_commands();
+    init_link_framing();
+    init_link_compression();
+    init_anycast();
+    init_broadcast();
+    init_cache();
+
     init_max_gossip_timeout();
     load_list_of_local_services();
+    local_services_changed();
     init_interrupt();
 
     if(!init_local_tcp_listener())
@@ -640,6 +823,313 @@ bool communicatord::init_max_connections()
 }
 
 
+/** \brief Retrieve the output coalescing threshold.
+ *
+ * The local connections keep the messages to send in an output queue
+ * and write them all at once when the socket is ready. This parameter
+ * defines the maximum number of bytes kept in that queue before it
+ * gets written immediately.
+ *
+ * A value of 0 means that the output coalescing is turned off.
+ */
+void communicatord::init_output_coalescing()
+{
+    f_output_coalescing = f_opts.get_long("output-coalescing");
+}
+
+
+/** \brief Read the limits of the output queue of the local connections.
+ *
+ * A service which does not read its messages fast enough would make the
+ * daemon memory grow without bounds. The output queue of each local
+ * connection is limited in number of messages and bytes. The overflow
+ * policy defines what happens once the queue is full.
+ */
+void communicatord::init_output_limits()
+{
+    f_output_max_messages = f_opts.get_long("output-queue-max-messages");
+    f_output_max_bytes = f_opts.get_long("output-queue-max-bytes");
+
+    std::string const policy(f_opts.get_string("output-queue-overflow"));
+    if(policy == "drop-oldest")
+    {
+        f_output_overflow_policy = overflow_policy_t::OVERFLOW_POLICY_DROP_OLDEST;
+    }
+    else if(policy == "drop-newest")
+    {
+        f_output_overflow_policy = overflow_policy_t::OVERFLOW_POLICY_DROP_NEWEST;
+    }
+    else
+    {
+        if(policy != "service-busy")
+        {
+            SNAP_LOG_CONFIGURATION_WARNING
+                << "the --output-queue-overflow option must be \"drop-oldest\", \"drop-newest\", or \"service-busy\", not \""
+                << policy
+                << "\"; using \"service-busy\"."
+                << SNAP_LOG_SEND;
+        }
+        f_output_overflow_policy = overflow_policy_t::OVERFLOW_POLICY_SERVICE_BUSY;
+    }
+}
+
+
+/** \brief Read the list of control commands.
+ *
+ * Control commands such as STOP, SHUTDOWN, or CLUSTER_DOWN must reach
+ * their destination even when a connection is backlogged with bulk
+ * messages. Messages with one of these commands go in the priority
+ * lane of the output queue.
+ */
+void communicatord::init_priority_commands()
+{
+    std::vector<std::string> commands;
+    snapdev::tokenize_string(
+              commands
+            , f_opts.get_string("priority-commands")
+            , ","
+            , true
+            , " ");
+    f_priority_commands.clear();
+    f_priority_commands.insert(commands.begin(), commands.end());
+}
+
+
+/** \brief Read the framing offered to the other daemons.
+ *
+ * The links between communicator daemons can replace the well known
+ * names by their interned identifier. Both daemons have to agree on
+ * that framing in the CONNECT/ACCEPT handshake. The "text" value
+ * turns the feature off, which is useful to read the messages with
+ * a network sniffer.
+ */
+void communicatord::init_link_framing()
+{
+    std::string const framing(f_opts.get_string("link-framing"));
+    f_compact_framing = framing == "compact";
+    if(!f_compact_framing
+    && framing != communicator::g_name_communicator_value_text)
+    {
+        SNAP_LOG_CONFIGURATION_WARNING
+            << "the --link-framing option must be \"compact\" or \"text\", not \""
+            << framing
+            << "\"; using \"text\"."
+            << SNAP_LOG_SEND;
+    }
+}
+
+
+/** \brief Read whether the links to the other daemons get compressed.
+ *
+ * The compact framing of a link can also be compressed with a dictionary
+ * (see link_codec). Since the values of the messages can then be guessed
+ * from the length of the encrypted messages, the secure links have their
+ * own parameter. Each daemon decides for the links it accepts and the
+ * links it opens; the compression is used only when both daemons agree.
+ */
+void communicatord::init_link_compression()
+{
+    struct option_t
+    {
+        char const *    f_name = nullptr;
+        bool *          f_flag = nullptr;
+    };
+    option_t const options[] =
+    {
+        { "compress-plain-links", &f_compress_plain_links },
+        { "compress-secure-links", &f_compress_secure_links },
+    };
+    for(auto const & o : options)
+    {
+        std::string const value(f_opts.get_string(o.f_name));
+        *o.f_flag = value == "yes";
+        if(!*o.f_flag
+        && value != "no")
+        {
+            SNAP_LOG_CONFIGURATION_WARNING
+                << "the --"
+                << o.f_name
+                << " option must be \"yes\" or \"no\", not \""
+                << value
+                << "\"; using \"no\"."
+                << SNAP_LOG_SEND;
+        }
+    }
+}
+
+
+/** \brief Check whether a link to another daemon can be compressed.
+ *
+ * \param[in] secure  Whether the link is encrypted.
+ *
+ * \return true if the compression can be offered or accepted on that link.
+ */
+bool communicatord::compress_links(bool secure) const
+{
+    return f_compact_framing
+        && (secure ? f_compress_secure_links : f_compress_plain_links);
+}
+
+
+/** \brief Read the anycast parameters.
+ *
+ * A message sent to server "~" goes to the least busy computer running
+ * the destination service. The local computer is preferred unless its
+ * load is higher than the load of a remote computer by more than
+ * this margin. The margin is a percentage of the capacity of the
+ * computer (i.e. load average divided by the number of processors).
+ */
+void communicatord::init_anycast()
+{
+    f_anycast_local_margin = static_cast<float>(f_opts.get_long("anycast-local-margin")) / 100.0f;
+}
+
+
+/** \brief Read the broadcast dissemination parameters.
+ *
+ * By default, a broadcast message is forwarded to all the neighbors not
+ * yet informed. In large clusters, the "tree" strategy distributes the
+ * work among all the daemons and the "gossip" strategy sends the message
+ * to a few random neighbors.
+ */
+void communicatord::init_broadcast()
+{
+    std::string const name(f_opts.get_string("broadcast-strategy"));
+    strategy_t strategy(strategy_t::STRATEGY_FLOOD);
+    if(!string_to_strategy(name, strategy))
+    {
+        SNAP_LOG_CONFIGURATION_WARNING
+            << "the --broadcast-strategy option must be \"flood\", \"tree\", or \"gossip\", not \""
+            << name
+            << "\"; using \"flood\"."
+            << SNAP_LOG_SEND;
+    }
+    f_dissemination.set_strategy(strategy);
+    f_dissemination.set_fanout(f_opts.get_long("broadcast-fanout"));
+    f_dissemination.set_redundancy(f_opts.get_long("broadcast-redundancy"));
+}
+
+
+/** \brief Read the limits of the message cache.
+ *
+ * Messages sent to a local service which is not running get cached
+ * until that service registers. Without limits, a service which stays
+ * down would make the memory of the daemon grow without bounds.
+ *
+ * A message dropped from the cache to make room is reported to its
+ * sender as if it had not been cached: a SERVICE_UNAVAILABLE if it
+ * used "cache=reply" and a TRANSMISSION_REPORT if it asked for one.
+ *
+ * The commands listed in the --cache-coalesce option are signals: only
+ * the newest instance of such a message is kept in the cache of a
+ * service. Each entry can be followed by the names of the parameters,
+ * separated by colons, which also have to match, as in
+ * "STATUS:service".
+ *
+ * When the cache journal is turned on, the messages cached before the
+ * last restart are added back to the cache here.
+ */
+void communicatord::init_cache()
+{
+    f_local_message_cache.set_limits(
+              f_opts.get_long("cache-max-messages")
+            , f_opts.get_long("cache-max-bytes"));
+    f_local_message_cache.set_service_limits(
+              f_opts.get_long("cache-service-max-messages")
+            , f_opts.get_long("cache-service-max-bytes"));
+
+    std::string const name(f_opts.get_string("cache-eviction"));
+    eviction_t eviction(eviction_t::EVICTION_OLDEST);
+    if(!string_to_eviction(name, eviction))
+    {
+        SNAP_LOG_CONFIGURATION_WARNING
+            << "the --cache-eviction option must be \"oldest\", \"lowest-ttl\", or \"reject\", not \""
+            << name
+            << "\"; using \"oldest\"."
+            << SNAP_LOG_SEND;
+    }
+    f_local_message_cache.set_eviction(eviction);
+
+    // the journal replay below goes through the coalescing too
+    //
+    std::vector<std::string> coalesce;
+    snapdev::tokenize_string(
+              coalesce
+            , f_opts.get_string("cache-coalesce")
+            , ","
+            , true
+            , " ");
+    f_local_message_cache.clear_coalesce();
+    for(auto const & c : coalesce)
+    {
+        cache::parameter_list_t parameters;
+        snapdev::tokenize_string(
+                  parameters
+                , c
+                , ":"
+                , true
+                , " ");
+        if(parameters.empty())
+        {
+            continue;
+        }
+        std::string const command(parameters.front());
+        parameters.erase(parameters.begin());
+        f_local_message_cache.set_coalesce(command, parameters);
+    }
+
+    f_local_message_cache.set_evicted_callback(
+        [this](ed::message & msg, bool reply)
+        {
+            if(reply)
+            {
+                reply_service_unavailable(msg);
+            }
+            transmission_report(msg, false);
+        });
+
+    std::string const journal(f_opts.get_string("cache-journal"));
+    if(journal == "mmap")
+    {
+        std::string const filename(f_opts.get_string("data_path") + "/message-cache.journal");
+        if(!f_local_message_cache.open_journal(filename))
+        {
+            SNAP_LOG_RECOVERABLE_ERROR
+                << "could not open the cache journal \""
+                << filename
+                << "\"; cached messages will be lost on a restart."
+                << SNAP_LOG_SEND;
+        }
+    }
+    else if(journal != "none")
+    {
+        SNAP_LOG_CONFIGURATION_WARNING
+            << "the --cache-journal option must be \"none\" or \"mmap\", not \""
+            << journal
+            << "\"; using \"none\"."
+            << SNAP_LOG_SEND;
+    }
+
+    f_cache_timer = std::make_shared<cache_timer>(this);
+    f_communicator->add_connection(f_cache_timer);
+}
+
+
+/** \brief Cleanup the message cache.
+ *
+ * The cache timer calls this function periodically. It removes the
+ * cached messages which timed out and compacts the cache journal when
+ * needed, so none of that work happens while forwarding messages.
+ *
+ * \return true if the journal compaction is not complete yet.
+ */
+bool communicatord::cache_maintenance()
+{
+    f_local_message_cache.remove_old_messages();
+    return f_local_message_cache.compact_journal();
+}
+
+
 void communicatord::init_max_gossip_timeout()
 {
     if(!f_opts.is_defined("max_gossip_timeout"))
@@ -1443,10 +1933,26 @@ bool communicatord::forward_message(ed::message & msg)
     // if the destination server was specified, we have to forward
     // the message to that specific server
     //
-    std::string const server_name(msg.get_server() == communicator::g_name_communicator_server_me
+    // the interned identifiers let us compare the well known names
+    // with integers instead of strings
+    //
+    std::string const & original_server_name(msg.get_server());
+    communicator::server_id_t server_id(communicator::intern_server(original_server_name));
+    std::string server_name(server_id == communicator::server_id_t::SERVER_ID_ME
                                         ? f_server_name
-                                        : msg.get_server());
+                                        : original_server_name);
     std::string const service(msg.get_service());
+    communicator::service_id_t const service_id(communicator::intern_service(service));
+
+    // anycast, resolve "~" to the least busy server running that service
+    // and from here on treat the message as directed to that server
+    //
+    if(server_id == communicator::server_id_t::SERVER_ID_ANYCAST)
+    {
+        server_name = select_anycast_server(service);
+        server_id = communicator::intern_server(server_name);
+        msg.set_server(server_name);
+    }
 
 #if 1
 SNAP_LOG_VERBOSE
@@ -1464,14 +1970,13 @@ SNAP_LOG_VERBOSE
 
     // broadcasting?
     //
-    if(service == communicator::g_name_communicator_service_public_broadcast
-    || service == communicator::g_name_communicator_service_private_broadcast
-    || service == communicator::g_name_communicator_service_local_broadcast)
+    if(service_id == communicator::service_id_t::SERVICE_ID_PUBLIC_BROADCAST
+    || service_id == communicator::service_id_t::SERVICE_ID_PRIVATE_BROADCAST
+    || service_id == communicator::service_id_t::SERVICE_ID_LOCAL_BROADCAST)
     {
         if(!server_name.empty()
-        && server_name != communicator::g_name_communicator_server_any
-        && (service == communicator::g_name_communicator_service_public_broadcast
-                || service == communicator::g_name_communicator_service_private_broadcast))
+        && server_id != communicator::server_id_t::SERVER_ID_ANY
+        && service_id != communicator::service_id_t::SERVICE_ID_LOCAL_BROADCAST)
         {
             // do not send the message in this case!
             //
@@ -1496,214 +2001,111 @@ SNAP_LOG_ERROR
 SNAP_LOG_ERROR
 << "but we don't broadcast?!?"
 << SNAP_LOG_SEND;
-    base_connection::vector_t accepting_remote_connections;
     bool const all_servers(server_name.empty()
-                || server_name == communicator::g_name_communicator_server_any);
-    bool const remote_servers(server_name == communicator::g_name_communicator_server_remote);
+                || server_id == communicator::server_id_t::SERVER_ID_ANY);
+    bool const remote_servers(server_id == communicator::server_id_t::SERVER_ID_REMOTE);
 
     // service is local, check whether the service is registered,
     // if registered, forward the message immediately
     //
-    ed::connection::vector_t const & connections(f_communicator->get_connections());
-    for(auto const & nc : connections)
-    {
-        base_connection::pointer_t base_conn(std::dynamic_pointer_cast<base_connection>(nc));
-        if(base_conn == nullptr)
+    // the routing table is updated on REGISTER and UNREGISTER and when
+    // a connection gets removed so we do not have to search the entire
+    // list of connections
+    //
+    if(all_servers
+    || remote_servers
+    || server_name == f_server_name)
+    {
+        std::string shard_value;
+        std::string const & shard_key(f_routes.get_shard_parameter(service));
+        if(!shard_key.empty()
+        && msg.has_parameter(shard_key))
         {
-SNAP_LOG_ERROR
-<< "---[forward]--- ignore non base-connection ["
-<< nc->get_name()
-<< "]"
-<< SNAP_LOG_SEND;
-            continue;
+            shard_value = msg.get_parameter(shard_key);
         }
-SNAP_LOG_ERROR
-<< "---[forward]--- test base-connection ["
-<< nc->get_name()
-<< "]"
-<< SNAP_LOG_SEND;
-
-        // verify that there is a server name in all connections
-        // (if not we have a bug somewhere else)
-        //
-        if(base_conn->get_server_name().empty())
+        base_connection::pointer_t base_conn(f_routes.select_local_service(service, shard_value));
+        if(base_conn != nullptr)
         {
-SNAP_LOG_ERROR
-<< "---[forward]--- verify server name ["
-<< nc->get_name()
-<< "]"
-<< SNAP_LOG_SEND;
-            if(!is_debug())
+            // we have such a service, just forward to it now
+            //
+            // TBD: should we remove the service name from the
+            //      message before forwarding?
+            //
+            try
             {
-                // ignore in non-debug versions because a throw
-                // completely breaks communicatord... and it
-                // is not that important at this point without
-                // a programmer debugging this software
+                // helper message for programmers with attention
+                // span having issues
                 //
-                continue;
+                base_connection::pointer_t sender(msg.user_data<base_connection>());
+                if(base_conn == sender)
+                {
+                    SNAP_LOG_WARNING
+                        << "service \""
+                        << service
+                        << "\" just tried to send itself a message. Forgot to change the destination service name?"
+                        << SNAP_LOG_SEND;
+                    return false;
+                }
+
+                if(base_conn->is_busy())
+                {
+                    reply_service_busy(sender, service, msg.get_command());
+                }
+                else if(verify_command(base_conn, msg))
+                {
+                    base_conn->send_message_to_connection(msg);
+                }
             }
-            if(base_conn->get_connection_type() == connection_type_t::CONNECTION_TYPE_DOWN)
+            catch(std::runtime_error const & e)
             {
-                // not connected yet, forget about it
+                // ignore the error because this can come from an
+                // external source (i.e. ed-signal) where an end
+                // user may try to break the whole system!
                 //
-                continue;
+                SNAP_LOG_DEBUG
+                    << "communicatord failed to send a message to connection \""
+                    << base_conn->get_connection_name()
+                    << "\" (error: "
+                    << e.what()
+                    << ")"
+                    << SNAP_LOG_SEND;
             }
 
-            service_connection::pointer_t conn(std::dynamic_pointer_cast<service_connection>(nc));
-            if(conn != nullptr)
-            {
-                throw communicator::missing_name(
-                          "DEBUG: server name missing in service connection \""
-                        + conn->get_name()
-                        + "\"...");
-            }
-            unix_connection::pointer_t unix_conn(std::dynamic_pointer_cast<unix_connection>(nc));
-            if(unix_conn != nullptr)
-            {
-                throw communicator::missing_name(
-                          "DEBUG: server name missing in unix connection \""
-                        + unix_conn->get_name()
-                        + "\"...");
-            }
-
-            switch(base_conn->get_connection_type())
-            {
-            case connection_type_t::CONNECTION_TYPE_DOWN:
-                // already handled above
-                continue;
-
-            case connection_type_t::CONNECTION_TYPE_LOCAL:
-                throw communicator::missing_name(
-                          "DEBUG: server name missing in connection \"local service\"...");
-
-            case connection_type_t::CONNECTION_TYPE_REMOTE:
-                throw communicator::missing_name(
-                          "DEBUG: server name missing in connection \"remote communicatord\"...");
-
-            }
+            // we found a specific service to which we could
+            // forward the message so we can stop here
+            //
+            return false;
         }
+    }
 
-        bool try_remote(true);
-        if(all_servers
-        || server_name == communicator::g_name_communicator_service_private_broadcast
-        || server_name == base_conn->get_server_name())
-        {
-SNAP_LOG_ERROR
-<< "---[forward]--- server name match ["
-<< nc->get_name()
-<< "] server name=["
-<< server_name
-<< "]"
-<< SNAP_LOG_SEND;
-            bool is_service(false);
-            {
-                service_connection::pointer_t conn(std::dynamic_pointer_cast<service_connection>(nc));
-                if(conn != nullptr)
-                {
-                    is_service = true;
-                }
-                else
-                {
-                    unix_connection::pointer_t unix_conn(std::dynamic_pointer_cast<unix_connection>(nc));
-                    if(unix_conn != nullptr)
-                    {
-                        is_service = true;
-                    }
-                }
-            }
-            if(is_service)
-            {
-                ed::connection::pointer_t c(std::dynamic_pointer_cast<ed::connection>(nc));
-                if(c->get_name() == service)
-                {
-                    // we have such a service, just forward to it now
-                    //
-                    // TBD: should we remove the service name from the
-                    //      message before forwarding?
-                    //
-                    try
-                    {
-                        // helper message for programmers with attention
-                        // span having issues
-                        //
-                        base_connection::pointer_t sender(msg.user_data<base_connection>());
-                        if(base_conn == sender)
-                        {
-                            SNAP_LOG_WARNING
-                                << "service \""
-                                << service
-                                << "\" just tried to send itself a message. Forgot to change the destination service name?"
-                                << SNAP_LOG_SEND;
-                            return false;
-                        }
-
-                        if(verify_command(base_conn, msg))
-                        {
-SNAP_LOG_ERROR
-<< "send message to a connection [TBD"
-//<< base_conn->get_name()
-<< "]"
-<< SNAP_LOG_SEND;
-                            base_conn->send_message_to_connection(msg);
-                        }
-                    }
-                    catch(std::runtime_error const & e)
-                    {
-                        // ignore the error because this can come from an
-                        // external source (i.e. ed-signal) where an end
-                        // user may try to break the whole system!
-                        //
-                        SNAP_LOG_DEBUG
-                            << "communicatord failed to send a message to connection \""
-                            << c->get_name()
-                            << "\" (error: "
-                            << e.what()
-                            << ")"
-                            << SNAP_LOG_SEND;
-                    }
-                    // we found a specific service to which we could
-                    // forward the message so we can stop here
-                    //
-                    return false;
-                }
-            }
-        }
-        else
+    // TODO: if we have multiple remote connections that support the
+    //       same service we should randomize which one is to receive
+    //       that message--or even better, check the current server load
+    //
+    // if we cannot find a local service, forward the message to the
+    // remote connections hosting that service; if none of our direct
+    // connections host it, try those that heard of that service; if
+    // the directory does not know about that service at all (it may
+    // be stale), forward the message to all our remote connections;
+    // when a server name is specified, only use the one remote
+    // connection matching that name
+    //
+    base_connection::vector_t accepting_remote_connections;
+    if(all_servers
+    || remote_servers)
+    {
+        accepting_remote_connections = f_routes.find_remote_service(service);
+        if(accepting_remote_connections.empty())
         {
-            try_remote = remote_servers;
+            accepting_remote_connections = f_routes.get_remote_connections();
         }
-SNAP_LOG_ERROR
-<< "---[forward]--- local did not work -- try remote? " << std::boolalpha << try_remote
-<< SNAP_LOG_SEND;
-        if(try_remote)
+    }
+    else
+    {
+        base_connection::pointer_t remote_conn(f_routes.find_remote_server(server_name));
+        if(remote_conn != nullptr)
         {
-            // TODO: limit sending to remote only if they have that service?
-            //       (if we have the 'all_servers' set, otherwise it is not
-            //       required, for sure... also, if we have multiple remote
-            //       connections that support the same service we should
-            //       randomize which one is to receive that message--or
-            //       even better, check the current server load--but
-            //       seriously, if none of our direct connections know
-            //       of that service, we need to check for those that heard
-            //       of that service, and if that is also empty, send to
-            //       all... for now we send to all anyway--plus this section
-            //       is about broadcasting. What we really need is the graph
-            //       and whether we want to send to any one service or
-            //       broadcast)
-            //
-
-            // if this is a remote connection add it to our list of remote
-            // connections and if we cannot find a local service, forward
-            // the message to all our remote connections
-            //
-            connection_type_t const type(base_conn->get_connection_type());
-            if(type == connection_type_t::CONNECTION_TYPE_REMOTE)
-            {
-SNAP_LOG_ERROR
-<< "---[forward]--- register remote connection " << base_conn->get_connection_name()
-<< SNAP_LOG_SEND;
-                accepting_remote_connections.push_back(base_conn);
-            }
+            accepting_remote_connections.push_back(remote_conn);
         }
     }
 SNAP_LOG_ERROR
@@ -1714,7 +2116,7 @@ SNAP_LOG_ERROR
 << "] from local services? all_servers=" << std::boolalpha << all_servers
 << SNAP_LOG_SEND;
 
-    if((all_servers || server_name == f_server_name || server_name == communicator::g_name_communicator_service_private_broadcast)
+    if((all_servers || remote_servers || server_name == f_server_name)
     && f_local_services_list.find(service) != f_local_services_list.end())
     {
         // its a service that is expected on this computer, but it is not
@@ -1726,28 +2128,7 @@ SNAP_LOG_ERROR
         cache_message_t const cached(f_local_message_cache.cache_message(msg));
         if(cached == cache_message_t::CACHE_MESSAGE_REPLY)
         {
-            // let the sender know that the message was not forwarded to
-            // a client
-            //
-            ed::message reply;
-            reply.set_command(ed::g_name_ed_cmd_service_unavailable);
-            reply.set_sent_from_server(f_server_name);
-            reply.set_sent_from_service(communicator::g_name_communicator_service_communicatord);
-            base_connection::pointer_t sender(msg.user_data<base_connection>());
-            if(verify_command(sender, reply))
-            {
-                reply.add_parameter(communicator::g_name_communicator_param_destination_service, service);
-                reply.add_parameter(communicator::g_name_communicator_param_unsent_command, msg.get_command());
-                sender->send_message_to_connection(reply);
-            }
-            else
-            {
-                SNAP_LOG_NOTICE
-                    << "a reply on unavailable service was requested, but \""
-                    << service
-                    << "\" does not support message SERVICE_UNAVAILABLE."
-                    << SNAP_LOG_SEND;
-            }
+            reply_service_unavailable(msg);
         }
         transmission_report(msg, cached == cache_message_t::CACHE_MESSAGE_CACHED);
         return true;
@@ -1788,6 +2169,170 @@ SNAP_LOG_ERROR
 }
 
 
+/** \brief Forward a message without parsing its parameters.
+ *
+ * Most messages sent by local services are directed to another local
+ * service. Those messages only need to be routed, so there is no need
+ * to parse their parameters to then serialize them again.
+ *
+ * This function parses only the header of \p line. If the message is
+ * directed to a local service currently registered with us, then the
+ * original bytes are written to that service connection. Only the
+ * sent from server and service get replaced (if specified).
+ *
+ * In all other cases, the function returns false and the caller has to
+ * go through the full ed::message parser and the normal dispatching.
+ * This includes messages sent to the communicatord itself, messages
+ * to be broadcast or sent to remote computers, messages to services
+ * which are not registered (they may need to be cached), and all the
+ * messages when we are shutting down or debugging messages.
+ *
+ * \param[in] sender  The connection which received the message.
+ * \param[in] line  The message as received on the wire.
+ * \param[in] sent_from_server  The server name to set in the message or
+ * an empty string to keep the one in the message.
+ * \param[in] sent_from_service  The service name to set in the message or
+ * an empty string to keep the one in the message.
+ *
+ * \return true if the message was forwarded.
+ */
+bool communicatord::forward_raw_message(
+      base_connection::pointer_t sender
+    , std::string const & line
+    , std::string const & sent_from_server
+    , std::string const & sent_from_service)
+{
+    if(f_shutdown
+    || f_debug_all_messages)
+    {
+        return false;
+    }
+
+    raw_message raw;
+    if(!raw.parse(line))
+    {
+        return false;
+    }
+
+    // the service must be a registered local service
+    //
+    std::string_view const service_name(raw.get_service());
+    if(service_name.empty()
+    || communicator::intern_service(service_name) != communicator::service_id_t::SERVICE_ID_UNKNOWN)
+    {
+        // no service, the communicatord itself or a broadcast
+        //
+        return false;
+    }
+
+    std::string_view const server_name(raw.get_server());
+    communicator::server_id_t const server_id(communicator::intern_server(server_name));
+    if(!server_name.empty()
+    && server_id == communicator::server_id_t::SERVER_ID_UNKNOWN
+    && server_name != f_server_name)
+    {
+        // a specific remote server
+        //
+        return false;
+    }
+
+    // anycast messages may have to go to another computer
+    //
+    if(server_id == communicator::server_id_t::SERVER_ID_ANYCAST)
+    {
+        return false;
+    }
+
+    // the routing table is keyed by std::string; most service names
+    // fit in the small string buffer so this does not allocate
+    //
+    std::string const service(service_name);
+
+    // the shard key is a parameter of the message, which requires the
+    // message to be parsed
+    //
+    if(!f_routes.get_shard_parameter(service).empty())
+    {
+        return false;
+    }
+
+    // broadcast messages must go through check_broadcast_message()
+    //
+    if(raw.has_parameter(communicator::g_name_communicator_param_broadcast_msgid))
+    {
+        return false;
+    }
+
+    base_connection::pointer_t destination(f_routes.select_local_service(service));
+    if(destination == nullptr
+    || destination == sender
+    || !destination->can_send_raw_message())
+    {
+        return false;
+    }
+
+    if(destination->is_busy())
+    {
+        reply_service_busy(sender, service, std::string(raw.get_command()));
+        return true;
+    }
+
+    std::string data(raw.to_message(sent_from_server, sent_from_service));
+    data += '\n';
+    if(!destination->send_raw_message(
+              std::make_shared<std::string const>(std::move(data))
+            , is_priority_command(raw.get_command())))
+    {
+        SNAP_LOG_DEBUG
+            << "communicatord failed to send a raw message to connection \""
+            << destination->get_connection_name()
+            << "\"."
+            << SNAP_LOG_SEND;
+    }
+
+    return true;
+}
+
+
+/** \brief Let the sender know that its message was not sent.
+ *
+ * The destination service of \p msg is not running and the message
+ * could not be cached (or it was dropped from the cache). The sender
+ * asked to be told with "cache=reply" so it receives a
+ * SERVICE_UNAVAILABLE message.
+ *
+ * \param[in] msg  The message which was not forwarded to its service.
+ */
+void communicatord::reply_service_unavailable(ed::message & msg)
+{
+    ed::message reply;
+    reply.set_command(ed::g_name_ed_cmd_service_unavailable);
+    reply.set_sent_from_server(f_server_name);
+    reply.set_sent_from_service(communicator::g_name_communicator_service_communicatord);
+    base_connection::pointer_t sender(msg.user_data<base_connection>());
+    if(sender == nullptr)
+    {
+        // messages restored from the cache journal have no sender
+        //
+        return;
+    }
+    if(verify_command(sender, reply))
+    {
+        reply.add_parameter(communicator::g_name_communicator_param_destination_service, msg.get_service());
+        reply.add_parameter(communicator::g_name_communicator_param_unsent_command, msg.get_command());
+        sender->send_message_to_connection(reply);
+    }
+    else
+    {
+        SNAP_LOG_NOTICE
+            << "a reply on unavailable service was requested, but \""
+            << msg.get_service()
+            << "\" does not support message SERVICE_UNAVAILABLE."
+            << SNAP_LOG_SEND;
+    }
+}
+
+
 void communicatord::transmission_report(ed::message & msg, bool cached)
 {
     base_connection::pointer_t conn(msg.user_data<base_connection>());
@@ -1852,8 +2397,7 @@ bool communicatord::check_broadcast_message(ed::message const & msg)
     // neighbors included in the message, but just in case...)
     //
     std::string const broadcast_msgid(msg.get_parameter(communicator::g_name_communicator_param_broadcast_msgid));
-    auto const received_it(f_received_broadcast_messages.find(broadcast_msgid));
-    if(received_it != f_received_broadcast_messages.cend())     // message arrived again?
+    if(f_received_broadcast_messages.contains(broadcast_msgid))     // message arrived again?
     {
         // note that although we include neighbors it is normal that
         // this happens in a cluster where some computers are not
@@ -1873,10 +2417,11 @@ bool communicatord::check_broadcast_message(ed::message const & msg)
 bool communicatord::communicator_message(ed::message & msg)
 {
     std::string const server_name(msg.get_server());
+    communicator::server_id_t const server_id(communicator::intern_server(server_name));
 SNAP_LOG_WARNING << "--- server name = [" << server_name << "] -- [" << f_server_name << "]" << SNAP_LOG_SEND;
     if(!server_name.empty()
-    && server_name != communicator::g_name_communicator_server_me       // this is an abbreviation meaning "f_server_name"
-    && server_name != communicator::g_name_communicator_server_any
+    && server_id != communicator::server_id_t::SERVER_ID_ME     // this is an abbreviation meaning "f_server_name"
+    && server_id != communicator::server_id_t::SERVER_ID_ANY
     && server_name != f_server_name)
     {
         // message is not for the communicatord server
@@ -1891,7 +2436,7 @@ SNAP_LOG_WARNING << "--- server test failed for communicator test?" << SNAP_LOG_
     std::string const service(msg.get_service());
 SNAP_LOG_WARNING << "--- service name = [" << service << "] -- [" << communicator::g_name_communicator_service_communicatord << "]" << SNAP_LOG_SEND;
     if(!service.empty()
-    && service != communicator::g_name_communicator_service_communicatord)
+    && communicator::intern_service(service) != communicator::service_id_t::SERVICE_ID_COMMUNICATORD)
     {
         // message is directed to another service
         //
@@ -2040,6 +2585,7 @@ void communicatord::msg_accept(ed::message & msg)
     conn->set_connection_type(connection_type_t::CONNECTION_TYPE_REMOTE);
     std::string const & remote_server_name(msg.get_parameter(communicator::g_name_communicator_param_server_name));
     conn->set_server_name(remote_server_name);
+    f_routes.add_remote_server(remote_server_name, conn);
 
     // reply to a CONNECT, this was to connect to another
     // communicatord on another computer, retrieve the
@@ -2067,9 +2613,22 @@ void communicatord::msg_accept(ed::message & msg)
         add_neighbors(msg.get_parameter(communicator::g_name_communicator_param_neighbors));
     }
 
+    // the remote daemon selected the framing of this link; an older
+    // daemon does not send that parameter and we stay in text
+    //
+    conn->get_link_codec().set_framing(
+            msg.has_parameter(communicator::g_name_communicator_param_framing)
+                ? msg.get_parameter(communicator::g_name_communicator_param_framing)
+                : std::string(communicator::g_name_communicator_value_text));
+    if(msg.has_parameter(communicator::g_name_communicator_param_compression))
+    {
+        conn->get_link_codec().set_compression(msg.get_parameter(communicator::g_name_communicator_param_compression));
+    }
+
     // we just got some new services information,
     // refresh our cache
     //
+    f_routes.set_remote_services(conn);
     refresh_heard_of();
 
     // also request the COMMANDS of this connection with a HELP message
@@ -2148,6 +2707,18 @@ void communicatord::msg_commands(ed::message & msg)
         return;
     }
     conn->add_commands(msg.get_parameter(communicator::g_name_communicator_param_list));
+    f_connections.add_commands(conn);
+
+    // a remote daemon which understands SUBSCRIPTIONS and SERVICES needs
+    // to know which topics are subscribed and which services are offered
+    // on our side
+    //
+    if(conn->get_connection_kind() == connection_kind_t::CONNECTION_KIND_REMOTE
+    || conn->is_remote())
+    {
+        send_subscriptions_table(conn);
+        send_services_table(conn);
+    }
 
     // in normal circumstances, we're done
     //
@@ -2421,6 +2992,7 @@ void communicatord::msg_connect(ed::message & msg)
                 // set the connection type if we are not refusing it
                 //
                 conn->set_connection_type(connection_type_t::CONNECTION_TYPE_REMOTE);
+                f_routes.add_remote_server(remote_server_name, conn);
 
                 // same as ACCEPT (see above) -- maybe we could have
                 // a sub-function...
@@ -2443,6 +3015,7 @@ void communicatord::msg_connect(ed::message & msg)
                 // we just got some new services information,
                 // refresh our cache
                 //
+                f_routes.set_remote_services(conn);
                 refresh_heard_of();
 
                 // the message expects the ACCEPT reply
@@ -2455,9 +3028,10 @@ void communicatord::msg_connect(ed::message & msg)
 
                 // services
                 //
-                if(!f_local_services.empty())
+                std::string const services(get_advertised_services());
+                if(!services.empty())
                 {
-                    reply.add_parameter(communicator::g_name_communicator_param_services, f_local_services);
+                    reply.add_parameter(communicator::g_name_communicator_param_services, services);
                 }
 
                 // heard of
@@ -2467,6 +3041,34 @@ void communicatord::msg_connect(ed::message & msg)
                     reply.add_parameter(communicator::g_name_communicator_param_heard_of, f_services_heard_of);
                 }
 
+                // framing, only if the remote daemon offered some
+                // (older daemons only support the text framing)
+                //
+                if(f_compact_framing
+                && conn->get_connection_kind() == connection_kind_t::CONNECTION_KIND_SERVICE
+                && msg.has_parameter(communicator::g_name_communicator_param_framing))
+                {
+                    std::string const framing(link_codec::negotiate_framing(msg.get_parameter(communicator::g_name_communicator_param_framing)));
+                    reply.add_parameter(
+                              communicator::g_name_communicator_param_framing
+                            , framing);
+
+                    // compression, only along the compact framing
+                    //
+                    if(framing != communicator::g_name_communicator_value_text
+                    && conn->get_link_codec().is_compression_allowed()
+                    && msg.has_parameter(communicator::g_name_communicator_param_compression))
+                    {
+                        std::string const compression(link_codec::negotiate_compression(msg.get_parameter(communicator::g_name_communicator_param_compression)));
+                        if(!compression.empty())
+                        {
+                            reply.add_parameter(
+                                      communicator::g_name_communicator_param_compression
+                                    , compression);
+                        }
+                    }
+                }
+
                 std::string const his_address_str(msg.get_parameter(ed::g_name_ed_param_my_address));
                 addr::addr his_address(addr::string_to_addr(
                           his_address_str
@@ -2522,6 +3124,19 @@ void communicatord::msg_connect(ed::message & msg)
     //verify_command(base, reply); -- we do not yet have a list of commands understood by the other communicator daemon
     conn->send_message_to_connection(reply);
 
+    // the ACCEPT was sent in text, the following messages use the
+    // framing and compression it selected
+    //
+    if(!refuse
+    && reply.has_parameter(communicator::g_name_communicator_param_framing))
+    {
+        conn->get_link_codec().set_framing(reply.get_parameter(communicator::g_name_communicator_param_framing));
+        if(reply.has_parameter(communicator::g_name_communicator_param_compression))
+        {
+            conn->get_link_codec().set_compression(reply.get_parameter(communicator::g_name_communicator_param_compression));
+        }
+    }
+
     if(!refuse)
     {
         // since the connection was not refused
@@ -2578,6 +3193,7 @@ void communicatord::msg_disconnect(ed::message & msg)
         // connection item (unconnected)
         //
         conn->set_connection_type(connection_type_t::CONNECTION_TYPE_DOWN);
+        f_routes.remove_connection(conn);
 
         remote_connection::pointer_t remote_conn(std::dynamic_pointer_cast<remote_connection>(conn));
         if(remote_conn == nullptr)
@@ -2855,6 +3471,61 @@ void communicatord::msg_list_services(ed::message & msg)
         << list
         << SNAP_LOG_SEND;
 
+    std::uint64_t messages(f_output_messages);
+    std::uint64_t syscalls(f_output_syscalls);
+    std::uint64_t dropped(f_output_dropped);
+    for(connection_kind_t const kind : {
+                  connection_kind_t::CONNECTION_KIND_SERVICE
+                , connection_kind_t::CONNECTION_KIND_UNIX })
+    {
+        for(auto const & c : f_connections.get_connections(kind))
+        {
+            messages += c->get_output_queue().get_messages();
+            syscalls += c->get_output_queue().get_syscalls();
+            dropped += c->get_output_queue().get_dropped();
+        }
+    }
+    std::size_t held(0);
+    for(connection_kind_t const kind : {
+                  connection_kind_t::CONNECTION_KIND_SERVICE
+                , connection_kind_t::CONNECTION_KIND_REMOTE })
+    {
+        for(auto const & c : f_connections.get_connections(kind))
+        {
+            held += c->get_held_messages().count();
+            dropped += c->get_held_messages().get_dropped();
+        }
+    }
+    SNAP_LOG_INFO
+        << "output coalescing: "
+        << messages
+        << " messages written with "
+        << syscalls
+        << " system calls ("
+        << (messages > syscalls ? messages - syscalls : 0)
+        << " system calls saved); "
+        << dropped
+        << " messages dropped because of full output queues; "
+        << held
+        << " bulk messages held behind the control messages of remote and encrypted links."
+        << SNAP_LOG_SEND;
+
+    SNAP_LOG_INFO
+        << "message cache: "
+        << f_local_message_cache.size()
+        << " messages using "
+        << f_local_message_cache.get_bytes()
+        << " bytes; "
+        << f_local_message_cache.get_evicted()
+        << " messages evicted and "
+        << f_local_message_cache.get_rejected()
+        << " messages rejected because of the \""
+        << eviction_to_string(f_local_message_cache.get_eviction())
+        << "\" eviction policy; "
+        << f_local_message_cache.get_coalesced()
+        << " messages replaced by a newer instance."
+        << SNAP_LOG_SEND;
+
     // TODO: send a reply so communicators can know of discrepancies
 }
 
@@ -3046,26 +3717,24 @@ void communicatord::msg_register(ed::message & msg)
         return;
     }
 
+    switch(conn->get_connection_kind())
     {
-        unix_connection::pointer_t unix_conn(std::dynamic_pointer_cast<unix_connection>(conn));
-        if(unix_conn == nullptr)
-        {
-            service_connection::pointer_t service_conn(std::dynamic_pointer_cast<service_connection>(conn));
-            if(service_conn == nullptr)
-            {
-                SNAP_LOG_ERROR
-                    << "only local services are expected to "
-                    << communicator::g_name_communicator_cmd_register
-                    << " with the communicatord service."
-                    << SNAP_LOG_SEND;
-                return;
-            }
-            service_conn->properly_named();
-        }
-        else
-        {
-            unix_conn->properly_named();
-        }
+    case connection_kind_t::CONNECTION_KIND_UNIX:
+        static_cast<unix_connection &>(*conn).properly_named();
+        break;
+
+    case connection_kind_t::CONNECTION_KIND_SERVICE:
+        static_cast<service_connection &>(*conn).properly_named();
+        break;
+
+    default:
+        SNAP_LOG_ERROR
+            << "only local services are expected to "
+            << communicator::g_name_communicator_cmd_register
+            << " with the communicatord service."
+            << SNAP_LOG_SEND;
+        return;
+
     }
 
     ed::connection::pointer_t c(std::dynamic_pointer_cast<ed::connection>(conn));
@@ -3084,6 +3753,46 @@ void communicatord::msg_register(ed::message & msg)
 
     conn->set_connection_type(connection_type_t::CONNECTION_TYPE_LOCAL);
 
+    // messages sent to that service can now be forwarded to this connection
+    //
+    f_routes.add_local_service(service_name, conn);
+
+    // several instances of a service can share the messages
+    //
+    if(msg.has_parameter(communicator::g_name_communicator_param_delivery))
+    {
+        std::string const delivery_name(msg.get_parameter(communicator::g_name_communicator_param_delivery));
+        delivery_t const delivery(string_to_delivery(delivery_name));
+        std::string shard_key;
+        if(msg.has_parameter(communicator::g_name_communicator_param_shard_key))
+        {
+            shard_key = msg.get_parameter(communicator::g_name_communicator_param_shard_key);
+        }
+        if(delivery == delivery_t::DELIVERY_FIRST
+        && delivery_name != "first")
+        {
+            SNAP_LOG_WARNING
+                << "unknown delivery \""
+                << delivery_name
+                << "\" for service \""
+                << service_name
+                << "\"; using \"first\"."
+                << SNAP_LOG_SEND;
+        }
+        else if(delivery == delivery_t::DELIVERY_HASH
+             && shard_key.empty())
+        {
+            SNAP_LOG_WARNING
+                << "the \"hash\" delivery of service \""
+                << service_name
+                << "\" requires a \""
+                << communicator::g_name_communicator_param_shard_key
+                << "\" parameter; using \"round-robin\"."
+                << SNAP_LOG_SEND;
+        }
+        f_routes.set_local_delivery(service_name, delivery, shard_key);
+    }
+
     // connection is up now
     //
     conn->connection_started();
@@ -3109,23 +3818,21 @@ void communicatord::msg_register(ed::message & msg)
     conn->send_message_to_connection(ready);
 
     // status changed for this connection
+    // (only the first instance of a service sends an "up" status)
     //
     send_status(c);
+    local_services_changed();
 
     // if we have local messages that were cached, then
     // forward them now
     //
     f_local_message_cache.process_messages(
-        [service_name, conn](ed::message & cached_msg)
-        {
-            if(cached_msg.get_service() != service_name)
-            {
-                return false;
-            }
-
-            conn->send_message_to_connection(cached_msg);
-            return true;
-        });
+          service_name
+        , [conn](ed::message & cached_msg)
+          {
+              conn->send_message_to_connection(cached_msg);
+              return true;
+          });
 }
 
 
@@ -3188,15 +3895,22 @@ void communicatord::msg_service_status(ed::message & msg)
 }
 
 
-void communicatord::msg_shutdown(ed::message & msg)
-{
-    snapdev::NOT_USED(msg);
-
-    stop(true);
-}
-
-
-void communicatord::msg_unregister(ed::message & msg)
+/** \brief A remote communicator daemon sent a list of services.
+ *
+ * Each communicator daemon advertises the services it offers each time
+ * one registers or unregisters. The list is forwarded to the other
+ * remote communicator daemons so they know that those services can be
+ * reached through us.
+ *
+ * Like the SUBSCRIPTIONS, the sequence number makes sure that only the
+ * latest list of a server is kept and that the forwarding stops once
+ * all the daemons know about it. The list received directly from that
+ * server wins over a copy of the same version forwarded by another
+ * daemon.
+ *
+ * \param[in] msg  The SERVICES message.
+ */
+void communicatord::msg_services(ed::message & msg)
 {
     if(!is_tcp_connection(msg))
     {
@@ -3209,19 +3923,245 @@ void communicatord::msg_unregister(ed::message & msg)
         return;
     }
 
-    if(!msg.has_parameter(communicator::g_name_communicator_param_service))
+    if(conn->get_connection_kind() != connection_kind_t::CONNECTION_KIND_REMOTE
+    && !conn->is_remote())
     {
         SNAP_LOG_ERROR
-            << communicator::g_name_communicator_cmd_unregister
-            << " was called without a \""
-            << communicator::g_name_communicator_param_service
-            << "\" parameter, which is mandatory."
+            << communicator::g_name_communicator_cmd_services
+            << " is only accepted from a remote communicator daemon."
             << SNAP_LOG_SEND;
         return;
     }
 
-    // mark connection as being DOWN
-    //
+    if(!msg.has_parameter(communicator::g_name_communicator_param_server_name)
+    || !msg.has_parameter(communicator::g_name_communicator_param_sequence)
+    || !msg.has_parameter(communicator::g_name_communicator_param_services))
+    {
+        SNAP_LOG_ERROR
+            << communicator::g_name_communicator_cmd_services
+            << " was received without the \""
+            << communicator::g_name_communicator_param_server_name
+            << "\", \""
+            << communicator::g_name_communicator_param_sequence
+            << "\" and \""
+            << communicator::g_name_communicator_param_services
+            << "\" parameters, which are mandatory."
+            << SNAP_LOG_SEND;
+        return;
+    }
+
+    std::string const origin(msg.get_parameter(communicator::g_name_communicator_param_server_name));
+    if(origin == f_server_name)
+    {
+        // our own list came back
+        //
+        return;
+    }
+
+    std::uint64_t const sequence(msg.get_integer_parameter(communicator::g_name_communicator_param_sequence));
+    bool const direct(origin == conn->get_server_name());
+    auto it(f_remote_services.find(origin));
+    if(it != f_remote_services.end()
+    && (it->second.f_sequence > sequence
+        || (it->second.f_sequence == sequence && !direct)))
+    {
+        // we already have this list or a newer one
+        //
+        return;
+    }
+
+    remote_services_t & remote(f_remote_services[origin]);
+    bool const forward(remote.f_sequence != sequence);
+    base_connection::pointer_t const previous(remote.f_via.lock());
+    remote.f_sequence = sequence;
+    remote.f_services = msg.get_parameter(communicator::g_name_communicator_param_services);
+    remote.f_via = conn;
+
+    if(previous != nullptr
+    && previous != conn)
+    {
+        refresh_remote_services(previous);
+    }
+    refresh_remote_services(conn);
+
+    if(forward)
+    {
+        for(auto const & rc : f_routes.get_remote_connections())
+        {
+            if(rc != conn)
+            {
+                send_services(rc, origin, sequence, remote.f_services);
+            }
+        }
+    }
+}
+
+
+void communicatord::msg_shutdown(ed::message & msg)
+{
+    snapdev::NOT_USED(msg);
+
+    stop(true);
+}
+
+
+/** \brief A local service subscribes to a topic.
+ *
+ * The messages broadcast with a "topic" parameter matching the pattern
+ * of the SUBSCRIBE message get sent to this service. If no other local
+ * service subscribed to that pattern, the remote communicator daemons
+ * are told about it so they start forwarding those messages to us.
+ *
+ * \param[in] msg  The SUBSCRIBE message.
+ */
+void communicatord::msg_subscribe(ed::message & msg)
+{
+    base_connection::pointer_t conn(msg.user_data<base_connection>());
+    if(!is_local_subscriber(conn, msg))
+    {
+        return;
+    }
+
+    std::string const topic(msg.get_parameter(communicator::g_name_communicator_param_topic));
+    if(conn->get_topics().add(topic)
+    && f_local_topics.add(topic))
+    {
+        local_topics_changed();
+    }
+}
+
+
+/** \brief A remote communicator daemon sent a list of topics.
+ *
+ * Each communicator daemon advertises the topics its local services
+ * subscribed to. The list is forwarded to the other remote communicator
+ * daemons so the messages published on those topics can reach that
+ * server through us.
+ *
+ * The sequence number makes sure that only the latest list of a server
+ * is kept and that the forwarding stops once all the daemons know about
+ * it.
+ *
+ * \param[in] msg  The SUBSCRIPTIONS message.
+ */
+void communicatord::msg_subscriptions(ed::message & msg)
+{
+    if(!is_tcp_connection(msg))
+    {
+        return;
+    }
+
+    base_connection::pointer_t conn(msg.user_data<base_connection>());
+    if(conn == nullptr)
+    {
+        return;
+    }
+
+    if(conn->get_connection_kind() != connection_kind_t::CONNECTION_KIND_REMOTE
+    && !conn->is_remote())
+    {
+        SNAP_LOG_ERROR
+            << communicator::g_name_communicator_cmd_subscriptions
+            << " is only accepted from a remote communicator daemon."
+            << SNAP_LOG_SEND;
+        return;
+    }
+
+    if(!msg.has_parameter(communicator::g_name_communicator_param_server_name)
+    || !msg.has_parameter(communicator::g_name_communicator_param_sequence)
+    || !msg.has_parameter(communicator::g_name_communicator_param_topics))
+    {
+        SNAP_LOG_ERROR
+            << communicator::g_name_communicator_cmd_subscriptions
+            << " was received without the \""
+            << communicator::g_name_communicator_param_server_name
+            << "\", \""
+            << communicator::g_name_communicator_param_sequence
+            << "\" and \""
+            << communicator::g_name_communicator_param_topics
+            << "\" parameters, which are mandatory."
+            << SNAP_LOG_SEND;
+        return;
+    }
+
+    std::string const origin(msg.get_parameter(communicator::g_name_communicator_param_server_name));
+    if(origin == f_server_name)
+    {
+        // our own list came back
+        //
+        return;
+    }
+
+    std::uint64_t const sequence(msg.get_integer_parameter(communicator::g_name_communicator_param_sequence));
+    auto it(f_remote_topics.find(origin));
+    if(it != f_remote_topics.end()
+    && it->second.f_sequence >= sequence)
+    {
+        // we already have this list or a newer one
+        //
+        return;
+    }
+
+    std::string const topics(msg.get_parameter(communicator::g_name_communicator_param_topics));
+    remote_topics_t & remote(f_remote_topics[origin]);
+    remote.f_sequence = sequence;
+    remote.f_topics = topics;
+    remote.f_via = conn;
+    remote.f_matcher.clear();
+    std::vector<std::string> patterns;
+    snapdev::tokenize_string(patterns, topics, { "," }, true);
+    for(auto const & p : patterns)
+    {
+        if(!topic_matcher::is_valid_pattern(p))
+        {
+            SNAP_LOG_WARNING
+                << "ignoring invalid topic pattern \""
+                << p
+                << "\" subscribed on server \""
+                << origin
+                << "\"."
+                << SNAP_LOG_SEND;
+            continue;
+        }
+        remote.f_matcher.add(p);
+    }
+
+    for(auto const & rc : f_routes.get_remote_connections())
+    {
+        if(rc != conn)
+        {
+            send_subscriptions(rc, origin, sequence, topics);
+        }
+    }
+}
+
+
+void communicatord::msg_unregister(ed::message & msg)
+{
+    if(!is_tcp_connection(msg))
+    {
+        return;
+    }
+
+    base_connection::pointer_t conn(msg.user_data<base_connection>());
+    if(conn == nullptr)
+    {
+        return;
+    }
+
+    if(!msg.has_parameter(communicator::g_name_communicator_param_service))
+    {
+        SNAP_LOG_ERROR
+            << communicator::g_name_communicator_cmd_unregister
+            << " was called without a \""
+            << communicator::g_name_communicator_param_service
+            << "\" parameter, which is mandatory."
+            << SNAP_LOG_SEND;
+        return;
+    }
+
+    // mark connection as being DOWN
+    //
     conn->set_connection_type(connection_type_t::CONNECTION_TYPE_DOWN);
 
     // connection is down now
@@ -3233,6 +4173,14 @@ void communicatord::msg_unregister(ed::message & msg)
     ed::connection::pointer_t c(std::dynamic_pointer_cast<ed::connection>(conn));
     if(c != nullptr)
     {
+        // do not forward any more messages to that connection
+        //
+        f_routes.remove_local_service(c->get_name(), conn);
+        local_services_changed();
+
+        // the service is down only once its last instance is gone
+        // which send_status() verifies in the routing table
+        //
         send_status(c);
 
         // now remove the service name
@@ -3254,6 +4202,30 @@ void communicatord::msg_unregister(ed::message & msg)
 }
 
 
+/** \brief A local service unsubscribes from a topic.
+ *
+ * The \p msg must include the same pattern as the one used in the
+ * SUBSCRIBE message.
+ *
+ * \param[in] msg  The UNSUBSCRIBE message.
+ */
+void communicatord::msg_unsubscribe(ed::message & msg)
+{
+    base_connection::pointer_t conn(msg.user_data<base_connection>());
+    if(!is_local_subscriber(conn, msg))
+    {
+        return;
+    }
+
+    std::string const topic(msg.get_parameter(communicator::g_name_communicator_param_topic));
+    if(conn->get_topics().remove(topic)
+    && f_local_topics.remove(topic))
+    {
+        local_topics_changed();
+    }
+}
+
+
 
 
 void communicatord::broadcast_message(
@@ -3261,10 +4233,14 @@ void communicatord::broadcast_message(
     , base_connection::vector_t const & accepting_remote_connections)
 {
     std::string broadcast_msgid;
-    std::string informed_neighbors;
+    std::string origin(f_connection_address.to_ipv4or6_string(addr::STRING_IP_ADDRESS));
+    neighbor_ids::informed_t informed;
     int hops(0);
+    bool flood(false);
     time_t timeout(0);
 
+    update_neighbor_ids();
+
     // note: the "broadcast_msgid" is required when we end up sending that
     //       message forward to some other computers; so we have to go
     //       through that if() block; however, the timeout was already
@@ -3286,13 +4262,18 @@ void communicatord::broadcast_message(
             return;
         }
 
+        // forget about the "received messages" that have now timed out
+        // (such are not going to be forwarded since we check the timeout
+        // of a message early and prevent the broadcasting in that case)
+        //
+        f_received_broadcast_messages.expire(now);
+
         // check whether we already received that message, if so ignore
         // the second instance (it should not happen with the list of
         // neighbors included in the message, but just in case...)
         //
         broadcast_msgid = msg.get_parameter(communicator::g_name_communicator_param_broadcast_msgid);
-        auto const received_it(f_received_broadcast_messages.find(broadcast_msgid));
-        if(received_it != f_received_broadcast_messages.cend())     // message arrived again?
+        if(!f_received_broadcast_messages.insert(broadcast_msgid, timeout))     // message arrived again?
         {
             // note that although we include neighbors it is normal that
             // this happens in a cluster where some computers are not
@@ -3305,64 +4286,120 @@ void communicatord::broadcast_message(
             return;
         }
 
-        // delete "received messages" that have now timed out (because
-        // such are not going to be forwarded since we check the timeout
-        // of a message early and prevent the broadcasting in that case)
+        // the neighbors already informed are sent as a bitmap (or Bloom
+        // filter); older daemons send a list of IP addresses instead
         //
-        // XXX: I am thinking that this loop should probably be run before
-        //      the "broadcast_timeout" test above...
-        //
-        for(auto it(f_received_broadcast_messages.cbegin()); it != f_received_broadcast_messages.cend(); )
+        if(msg.has_parameter(communicator::g_name_communicator_param_broadcast_informed))
         {
-            if(it->second < now)
-            {
-                // this one timed out, we do not need to keep it in this
-                // list, so erase
-                //
-                it = f_received_broadcast_messages.erase(it);
-            }
-            else
+            informed = f_neighbor_ids.decode(msg.get_parameter(communicator::g_name_communicator_param_broadcast_informed));
+        }
+        else if(msg.has_parameter(communicator::g_name_communicator_param_broadcast_informed_neighbors))
+        {
+            std::vector<std::string> informed_neighbors;
+            snapdev::tokenize_string(
+                      informed_neighbors
+                    , msg.get_parameter(communicator::g_name_communicator_param_broadcast_informed_neighbors)
+                    , { "," }
+                    , true);
+            for(auto const & n : informed_neighbors)
             {
-                ++it;
+                f_neighbor_ids.insert(informed, n);
             }
         }
 
-        // add the new message after we check for timed out entries
-        // so that way we avoid going through this new entry within
-        // the previous loop
+        // get the number of hops this message already performed
         //
-        f_received_broadcast_messages[broadcast_msgid] = timeout;
+        hops = msg.get_integer_parameter("broadcast_hops");
 
-        // Note: we skip the canonicalization on this list of neighbors
-        //       because we assume only us (communicatord) handles
-        //       that message and we know that it is already
-        //       canonicalized here
+        // the dissemination strategies need to know where the message
+        // comes from and whether it is being flooded
         //
-        informed_neighbors = msg.get_parameter(communicator::g_name_communicator_param_broadcast_informed_neighbors);
-
-        // get the number of hops this message already performed
+        // the tree is ranked from the list of members of each daemon;
+        // when the sender used a different list (or did not say, as
+        // older daemons do), our tree would not match theirs and some
+        // daemons would never receive the message, so flood instead
         //
-        hops = msg.get_integer_parameter("broadcast_hops");
+        if(msg.has_parameter(communicator::g_name_communicator_param_broadcast_origin))
+        {
+            origin = msg.get_parameter(communicator::g_name_communicator_param_broadcast_origin);
+        }
+        flood = msg.has_parameter(communicator::g_name_communicator_param_broadcast_flood)
+             || !informed.f_same_members;
     }
 
-    advgetopt::string_set_t informed_neighbors_list;
-    snapdev::tokenize_string(
-              informed_neighbors_list
-            , informed_neighbors
-            , { "," }
-            , true);
+    // a message with a "topic" only goes to the services which subscribed
+    // to that topic and to the neighbors leading to such services
+    //
+    std::string topic;
+    std::set<base_connection::pointer_t> topic_neighbors;
+    if(msg.has_parameter(communicator::g_name_communicator_param_topic))
+    {
+        topic = msg.get_parameter(communicator::g_name_communicator_param_topic);
+        if(!topic_matcher::is_valid_topic(topic))
+        {
+            SNAP_LOG_ERROR
+                << "message \""
+                << msg.get_command()
+                << "\" has an invalid topic \""
+                << topic
+                << "\"; message dropped."
+                << SNAP_LOG_SEND;
+            return;
+        }
+        for(auto const & remote : f_remote_topics)
+        {
+            if(remote.second.f_matcher.match(topic))
+            {
+                base_connection::pointer_t const via(remote.second.f_via.lock());
+                if(via != nullptr)
+                {
+                    topic_neighbors.insert(via);
+                }
+            }
+        }
+    }
 
     // we always broadcast to all local services
     //
-    ed::connection::vector_t broadcast_connection;
+    base_connection::vector_t broadcast_connection;
+    std::vector<std::string> broadcast_address;
+
+    // add a remote connection to the list of connections to broadcast
+    // to unless that neighbor was already informed
+    //
+    auto add_broadcast_connection = [this, &broadcast_connection, &broadcast_address, &informed, &topic, &topic_neighbors](
+                  base_connection::pointer_t const & bc
+                , addr::addr const & a)
+    {
+        if(!topic.empty()
+        && topic_neighbors.find(bc) == topic_neighbors.end())
+        {
+            // no subscribers to that topic on that side
+            //
+            return;
+        }
+
+        std::string const address(a.to_ipv4or6_string(addr::STRING_IP_ADDRESS));
+        if(!f_neighbor_ids.contains(informed, address)
+        && std::find(broadcast_address.begin(), broadcast_address.end(), address) == broadcast_address.end())
+        {
+            // not in the list of informed neighbors, we keep bc in a
+            // list that we can use to actually send the broadcast
+            // message
+            //
+            broadcast_connection.push_back(bc);
+            broadcast_address.push_back(address);
+        }
+    };
 
     if(accepting_remote_connections.empty())
     {
         std::string destination(communicator::g_name_communicator_service_private_broadcast);
         std::string const service(msg.get_service());
-        if(service != communicator::g_name_communicator_service_local_broadcast
-        && service != communicator::g_name_communicator_service_private_broadcast
-        && service != communicator::g_name_communicator_service_public_broadcast)
+        communicator::service_id_t const service_id(communicator::intern_service(service));
+        if(service_id != communicator::service_id_t::SERVICE_ID_LOCAL_BROADCAST
+        && service_id != communicator::service_id_t::SERVICE_ID_PRIVATE_BROADCAST
+        && service_id != communicator::service_id_t::SERVICE_ID_PUBLIC_BROADCAST)
         {
             // try with the server name instead (which may be "." or "?" or "*")
             // TODO: clean this up; I think only "*" is valid here...
@@ -3377,165 +4414,143 @@ void communicatord::broadcast_message(
         {
             destination = service;
         }
-        bool const all(hops < 5 && destination == communicator::g_name_communicator_service_public_broadcast);
-        bool const remote(hops < 5 && (all || destination == communicator::g_name_communicator_service_private_broadcast));
+        communicator::service_id_t const destination_id(communicator::intern_service(destination));
+        int const max_hops(f_dissemination.get_max_hops());
+        bool const all(hops < max_hops && destination_id == communicator::service_id_t::SERVICE_ID_PUBLIC_BROADCAST);
+        bool const remote(hops < max_hops && (all || destination_id == communicator::service_id_t::SERVICE_ID_PRIVATE_BROADCAST));
+        std::string const command(msg.get_command());
 
-        ed::connection::vector_t const & connections(f_communicator->get_connections());
 SNAP_LOG_WARNING
 << "broadcasting message "
-<< msg.get_command()
+<< command
 << " to "
-<< connections.size()
+<< f_connections.size()
 << " connections with destination ["
 << destination
 << "]..."
 << SNAP_LOG_SEND;
-        for(auto const & nc : connections)
+        // local services which understand the command get the message;
+        // services connected through the Unix socket are always local
+        // and TCP services are local when connected on the loopback
+        //
+        // the message is serialized once and the same buffer is used
+        // for all the local services
+        //
+        base_connection::encoded_message_t encoded;
+        for(auto const & bc : f_connections.get_subscribers(command)) // destination: "*" or "?" or "."
         {
-            // try for a service or communicatord that connected to us
-            //
-            unix_connection::pointer_t unix_conn(std::dynamic_pointer_cast<unix_connection>(nc));
-            if(unix_conn != nullptr)
+            if(!topic.empty()
+            && !bc->get_topics().match(topic))
             {
-SNAP_LOG_WARNING
-<< "forward message to ["
-<< unix_conn->get_name()
-<< "] msg=["
-<< msg.to_string()
-<< "] understand_command=["
-<< std::boolalpha << unix_conn->understand_command(msg.get_command())
-<< "]..."
-<< SNAP_LOG_SEND;
-                if(unix_conn->understand_command(msg.get_command())) // destination: "*" or "?" or "."
-                {
-                    //verify_command(unix_conn, message); -- we reach this line only if the command is understood, it is therefore good
-                    unix_conn->send_message(msg);
-                }
                 continue;
             }
-            service_connection::pointer_t conn(std::dynamic_pointer_cast<service_connection>(nc));
-SNAP_LOG_WARNING
-<< "checking connection ["
-<< nc->get_name()
-<< "]..."
-<< SNAP_LOG_SEND;
-            remote_connection::pointer_t remote_conn;
-            if(conn == nullptr)
-            {
-                remote_conn = std::dynamic_pointer_cast<remote_connection>(nc);
-            }
-SNAP_LOG_WARNING
-<< "recognized connection? ["
-<< std::boolalpha << (conn != nullptr)
-<< " / "
-<< (remote_conn != nullptr)
-<< "]..."
-<< SNAP_LOG_SEND;
-            bool broadcast(false);
-            if(conn != nullptr)
+
+            switch(bc->get_connection_kind())
             {
-SNAP_LOG_WARNING
-<< "local broadcasting checking ["
-<< conn->get_name()
-<< "]..."
-<< SNAP_LOG_SEND;
-                switch(conn->get_address().get_network_type())
+            case connection_kind_t::CONNECTION_KIND_UNIX:
+                //verify_command(unix_conn, message); -- we reach this line only if the command is understood, it is therefore good
+                bc->send_encoded_message(msg, encoded);
+                break;
+
+            case connection_kind_t::CONNECTION_KIND_SERVICE:
+                if(static_cast<service_connection &>(*bc).get_address().get_network_type() == addr::network_type_t::NETWORK_TYPE_LOOPBACK)
                 {
-                case addr::network_type_t::NETWORK_TYPE_LOOPBACK:
-                    // these are localhost services, avoid sending the
-                    // message if the destination does not know the
-                    // command
-                    //
-                    if(conn->understand_command(msg.get_command())) // destination: "*" or "?" or "."
-                    {
-                        //verify_command(conn, message); -- we reach this line only if the command is understood, it is therefore good
-SNAP_LOG_WARNING
-<< "forward message to ["
-<< conn->get_name()
-<< "] msg=["
-<< msg.to_string()
-<< "]..."
-<< SNAP_LOG_SEND;
-                        conn->send_message(msg);
-                    }
-                    break;
+                    //verify_command(conn, message); -- we reach this line only if the command is understood, it is therefore good
+                    bc->send_encoded_message(msg, encoded);
+                }
+                break;
 
-                case addr::network_type_t::NETWORK_TYPE_PRIVATE:
-                    // these are computers within the same local network (LAN)
-                    // we forward messages if at least 'remote' is true
-                    //
-                    broadcast = remote; // destination: "*" or "?"
-                    break;
+            default:
+                break;
 
-                case addr::network_type_t::NETWORK_TYPE_PUBLIC:
-                    // these are computers in another data center
-                    // we forward messages only when 'all' is true
-                    //
-                    broadcast = all; // destination: "*"
-                    break;
+            }
+        }
+
+        // try for a communicatord that connected to us
+        //
+        for(auto const & bc : f_connections.get_connections(connection_kind_t::CONNECTION_KIND_SERVICE))
+        {
+            service_connection & conn(static_cast<service_connection &>(*bc));
+            addr::addr const & a(conn.get_address());
+            switch(a.get_network_type())
+            {
+            case addr::network_type_t::NETWORK_TYPE_LOOPBACK:
+                // these are localhost services, the message was already
+                // sent above if the destination understands the command
+                //
+                break;
 
-                default:
-                    // unknown/unexpected type of IP address, totally ignore
-                    break;
+            case addr::network_type_t::NETWORK_TYPE_PRIVATE:
+                // these are computers within the same local network (LAN)
+                // we forward messages if at least 'remote' is true
+                //
+                if(remote) // destination: "*" or "?"
+                {
+                    add_broadcast_connection(bc, a);
+                }
+                break;
 
+            case addr::network_type_t::NETWORK_TYPE_PUBLIC:
+                // these are computers in another data center
+                // we forward messages only when 'all' is true
+                //
+                if(all) // destination: "*"
+                {
+                    add_broadcast_connection(bc, a);
                 }
+                break;
+
+            default:
+                // unknown/unexpected type of IP address, totally ignore
+                break;
+
             }
-            else if(remote_conn != nullptr)
+        }
+
+        // another communicatord we connected to
+        //
+        for(auto const & bc : f_connections.get_connections(connection_kind_t::CONNECTION_KIND_REMOTE))
+        {
+            addr::addr const & a(static_cast<remote_connection &>(*bc).get_address());
+            switch(a.get_network_type())
             {
-                // another communicatord that connected to us
-                //
-                switch(remote_conn->get_address().get_network_type())
+            case addr::network_type_t::NETWORK_TYPE_LOOPBACK:
                 {
-                case addr::network_type_t::NETWORK_TYPE_LOOPBACK:
+                    static bool warned(false);
+                    if(!warned)
                     {
-                        static bool warned(false);
-                        if(!warned)
-                        {
-                            warned = true;
-                            SNAP_LOG_WARNING
-                                << "remote communicator was connected on a LOOPBACK IP address..."
-                                << SNAP_LOG_SEND;
-                        }
+                        warned = true;
+                        SNAP_LOG_WARNING
+                            << "remote communicator was connected on a LOOPBACK IP address..."
+                            << SNAP_LOG_SEND;
                     }
-                    break;
-
-                case addr::network_type_t::NETWORK_TYPE_PRIVATE:
-                    // these are computers within the same local network (LAN)
-                    // we forward messages if at least 'remote' is true
-                    //
-                    broadcast = remote; // destination: "*" or "?"
-                    break;
-
-                case addr::network_type_t::NETWORK_TYPE_PUBLIC:
-                    // these are computers in another data center
-                    // we forward messages only when 'all' is true
-                    //
-                    broadcast = all; // destination: "*"
-                    break;
-
-                default:
-                    // unknown/unexpected type of IP address, totally ignore
-                    break;
+                }
+                break;
 
+            case addr::network_type_t::NETWORK_TYPE_PRIVATE:
+                // these are computers within the same local network (LAN)
+                // we forward messages if at least 'remote' is true
+                //
+                if(remote) // destination: "*" or "?"
+                {
+                    add_broadcast_connection(bc, a);
                 }
-            }
-            if(broadcast)
-            {
-                // get the IP address of the local connection or remote communicatord
+                break;
+
+            case addr::network_type_t::NETWORK_TYPE_PUBLIC:
+                // these are computers in another data center
+                // we forward messages only when 'all' is true
                 //
-                std::string const address((conn != nullptr
-                            ? conn->get_address()
-                            : remote_conn->get_address()).to_ipv4or6_string(addr::STRING_IP_ADDRESS));
-                auto it(informed_neighbors_list.find(address));
-                if(it == informed_neighbors_list.end())
+                if(all) // destination: "*"
                 {
-                    // not in the list of informed neighbors, add it and
-                    // keep nc in a list that we can use to actually send
-                    // the broadcast message
-                    //
-                    informed_neighbors_list.insert(address);
-                    broadcast_connection.push_back(nc);
+                    add_broadcast_connection(bc, a);
                 }
+                break;
+
+            default:
+                // unknown/unexpected type of IP address, totally ignore
+                break;
+
             }
         }
     }
@@ -3544,47 +4559,56 @@ SNAP_LOG_WARNING
         // we already have a list, copy that list only as it is already
         // well defined
         //
-        std::for_each(
-            accepting_remote_connections.begin(),
-            accepting_remote_connections.end(),
-            [&broadcast_connection, &informed_neighbors_list](auto const & nc)
+        for(auto const & bc : accepting_remote_connections)
+        {
+            switch(bc->get_connection_kind())
             {
-                // the dynamic_cast<>() should always work in this direction
-                //
-                service_connection::pointer_t conn(std::dynamic_pointer_cast<service_connection>(nc));
-                if(conn != nullptr)
-                {
-                    std::string const address(conn->get_address().to_ipv4or6_string(addr::STRING_IP_ADDRESS));
-                    auto it(informed_neighbors_list.find(address));
-                    if(it == informed_neighbors_list.end())
-                    {
-                        // not in the list of informed neighbors, add it and
-                        // keep conn in a list that we can use to actually
-                        // send the broadcast message
-                        //
-                        informed_neighbors_list.insert(address);
-                        broadcast_connection.push_back(conn);
-                    }
-                }
-                else
-                {
-                    remote_connection::pointer_t remote_conn(std::dynamic_pointer_cast<remote_connection>(nc));
-                    if(remote_conn != nullptr)
-                    {
-                        std::string const address(remote_conn->get_address().to_ipv4or6_string(addr::STRING_IP_ADDRESS));
-                        auto it(informed_neighbors_list.find(address));
-                        if(it == informed_neighbors_list.end())
-                        {
-                            // not in the list of informed neighbors, add it and
-                            // keep conn in a list that we can use to actually
-                            // send the broadcast message
-                            //
-                            informed_neighbors_list.insert(address);
-                            broadcast_connection.push_back(remote_conn);
-                        }
-                    }
-                }
-            });
+            case connection_kind_t::CONNECTION_KIND_SERVICE:
+                add_broadcast_connection(bc, static_cast<service_connection &>(*bc).get_address());
+                break;
+
+            case connection_kind_t::CONNECTION_KIND_REMOTE:
+                add_broadcast_connection(bc, static_cast<remote_connection &>(*bc).get_address());
+                break;
+
+            default:
+                // only TCP connections can be remote communicators
+                break;
+
+            }
+        }
+    }
+
+    std::string const self(f_connection_address.to_ipv4or6_string(addr::STRING_IP_ADDRESS));
+    if(accepting_remote_connections.empty()
+    && !broadcast_connection.empty())
+    {
+        // only keep the neighbors selected by the dissemination strategy
+        //
+        std::vector<std::int32_t> candidates;
+        candidates.reserve(broadcast_address.size());
+        for(auto const & address : broadcast_address)
+        {
+            candidates.push_back(f_neighbor_ids.get_id(address));
+        }
+        std::vector<std::size_t> const selected(f_dissemination.select(
+                  candidates
+                , f_neighbor_ids.get_id(self)
+                , f_neighbor_ids.get_id(origin)
+                , f_neighbor_ids.size()
+                , flood));
+
+        base_connection::vector_t selected_connection;
+        std::vector<std::string> selected_address;
+        selected_connection.reserve(selected.size());
+        selected_address.reserve(selected.size());
+        for(auto const idx : selected)
+        {
+            selected_connection.push_back(broadcast_connection[idx]);
+            selected_address.push_back(broadcast_address[idx]);
+        }
+        broadcast_connection.swap(selected_connection);
+        broadcast_address.swap(selected_address);
     }
 
     if(!broadcast_connection.empty())
@@ -3594,13 +4618,14 @@ SNAP_LOG_WARNING
         // information in the message
         //
         std::string const originator(f_connection_address.to_ipv4or6_string(addr::STRING_IP_BRACKET_ADDRESS));
-        auto it(informed_neighbors_list.find(originator));
-        if(it != informed_neighbors_list.end())
+
+        // include self since we already know of the message too!
+        // (no need for others to send it back to us)
+        //
+        f_neighbor_ids.insert(informed, self);
+        for(auto const & address : broadcast_address)
         {
-            // include self since we already know of the message too!
-            // (no need for others to send it back to us)
-            //
-            informed_neighbors_list.insert(originator);
+            f_neighbor_ids.insert(informed, address);
         }
 
         // message is considered 'const', so we need to create a copy
@@ -3638,6 +4663,16 @@ SNAP_LOG_WARNING
         //
         broadcast_msg.add_parameter(communicator::g_name_communicator_param_broadcast_originator, originator);
 
+        // the tree is rooted at the daemon which first broadcast the
+        // message; once a daemon falls back to flooding, the others
+        // have to flood too
+        //
+        broadcast_msg.add_parameter(communicator::g_name_communicator_param_broadcast_origin, origin);
+        if(flood)
+        {
+            broadcast_msg.add_parameter(communicator::g_name_communicator_param_broadcast_flood, communicator::g_name_communicator_value_true);
+        }
+
         // define a timeout if this is the originator
         //
         if(timeout == 0)
@@ -3653,24 +4688,15 @@ SNAP_LOG_WARNING
         // be sent is not known until later.)
         //
         broadcast_msg.add_parameter(
-                  communicator::g_name_communicator_param_broadcast_informed_neighbors
-                , snapdev::join_strings(informed_neighbors_list, ","));
+                  communicator::g_name_communicator_param_broadcast_informed
+                , f_neighbor_ids.encode(informed));
 
+        // serialize the message only once for all the connections
+        //
+        base_connection::encoded_message_t encoded;
         for(auto const & bc : broadcast_connection)
         {
-            service_connection::pointer_t conn(std::dynamic_pointer_cast<service_connection>(bc));
-            if(conn != nullptr)
-            {
-                conn->send_message(broadcast_msg);
-            }
-            else
-            {
-                remote_connection::pointer_t remote_conn(std::dynamic_pointer_cast<remote_connection>(bc));
-                if(remote_conn != nullptr) // this should always be true, but to be double sure...
-                {
-                    remote_conn->send_message(broadcast_msg);
-                }
-            }
+            bc->send_encoded_message(broadcast_msg, encoded);
         }
     }
 }
@@ -3781,33 +4807,35 @@ void communicatord::send_status(
         //
         // TODO: use the broadcast_message() function instead? (with service set to ".")
         //
-        ed::connection::vector_t const & all_connections(f_communicator->get_connections());
-        for(auto const & conn : all_connections)
+        // a service with several instances is up when its first instance
+        // registers and down when its last instance is gone; the other
+        // instances do not change the status of the service
+        //
+        routing_table::connection_pointer_t const instance(f_routes.find_local_service(connection->get_name()));
+        if(instance != nullptr
+        && instance != base_connection)
         {
-            service_connection::pointer_t sc(std::dynamic_pointer_cast<service_connection>(conn));
-            if(sc != nullptr)
-            {
-                if(sc->understand_command(communicator::g_name_communicator_cmd_status))
-                {
-                    // send that STATUS message
-                    //
-                    //verify_command(sc, reply); -- we reach this line only if the command is understood
-                    sc->send_message(reply);
-                }
-                continue;
-            }
+            return;
+        }
 
-            unix_connection::pointer_t unix_conn(std::dynamic_pointer_cast<unix_connection>(conn));
-            if(unix_conn != nullptr)
+        // only local services (TCP and Unix) can receive the STATUS
+        //
+        base_connection::encoded_message_t encoded;
+        for(auto const & conn : f_connections.get_subscribers(communicator::g_name_communicator_cmd_status))
+        {
+            switch(conn->get_connection_kind())
             {
-                if(unix_conn->understand_command(communicator::g_name_communicator_cmd_status))
-                {
-                    // send that STATUS message
-                    //
-                    //verify_command(sc, reply); -- we reach this line only if the command is understood
-                    unix_conn->send_message(reply);
-                }
-                continue;
+            case connection_kind_t::CONNECTION_KIND_SERVICE:
+            case connection_kind_t::CONNECTION_KIND_UNIX:
+                // send that STATUS message
+                //
+                //verify_command(sc, reply); -- we reach this line only if the command is understood
+                conn->send_encoded_message(reply, encoded);
+                break;
+
+            default:
+                break;
+
             }
         }
     }
@@ -4077,6 +5105,7 @@ void communicatord::add_neighbors(std::string const & new_neighbors)
         if(f_all_neighbors.insert(a.get_from()).second)
         {
             changed = true;
+            f_neighbor_ids_dirty = true;
 
             // in case we are already running we want to also add
             // the corresponding connection
@@ -4129,6 +5158,7 @@ void communicatord::remove_neighbor(std::string const & neighbor)
     if(it != f_all_neighbors.end())
     {
         f_all_neighbors.erase(it);
+        f_neighbor_ids_dirty = true;
         save_neighbors();
     }
 
@@ -4194,6 +5224,7 @@ void communicatord::read_neighbors()
             }
 
             f_all_neighbors.insert(a.get_from());
+            f_neighbor_ids_dirty = true;
             f_remote_communicators->add_remote_communicator(a.get_from());
         }
     }
@@ -4287,17 +5318,12 @@ void communicatord::refresh_heard_of()
     f_services_heard_of_list.clear();
 
     // first gather all the services we have access to
-    ed::connection::vector_t const & all_connections(f_communicator->get_connections());
-    for(auto const & connection : all_connections)
+    for(auto const & c : f_connections.get_connections(connection_kind_t::CONNECTION_KIND_SERVICE))
     {
-        service_connection::pointer_t c(std::dynamic_pointer_cast<service_connection>(connection));
-        if(c != nullptr)
-        {
-            // get list of services and heard services
-            //
-            c->get_services(f_services_heard_of_list);
-            c->get_services_heard_of(f_services_heard_of_list);
-        }
+        // get list of services and heard services
+        //
+        c->get_services(f_services_heard_of_list);
+        c->get_services_heard_of(f_services_heard_of_list);
     }
 
     // now remove services we are in control of
@@ -4526,6 +5552,9 @@ void communicatord::stop(bool quitting)
     //
     f_communicator->remove_connection(f_interrupt.lock());  // TCP/IP
 
+    f_communicator->remove_connection(f_cache_timer);       // timer
+    f_cache_timer.reset();
+
     f_communicator->remove_connection(f_local_listener);    // TCP/IP
     f_local_listener.reset();
 
@@ -4590,14 +5619,24 @@ void communicatord::process_connected(ed::connection::pointer_t conn)
         {
             connect.add_parameter(communicator::g_name_communicator_param_neighbors, f_explicit_neighbors);
         }
-        if(!f_local_services.empty())
+        std::string const services(get_advertised_services());
+        if(!services.empty())
         {
-            connect.add_parameter(communicator::g_name_communicator_param_services, f_local_services);
+            connect.add_parameter(communicator::g_name_communicator_param_services, services);
         }
         if(!f_services_heard_of.empty())
         {
             connect.add_parameter(communicator::g_name_communicator_param_heard_of, f_services_heard_of);
         }
+        if(f_compact_framing)
+        {
+            connect.add_parameter(communicator::g_name_communicator_param_framing, link_codec::get_framing_name());
+            base->get_link_codec().offer_framing();
+            if(base->get_link_codec().is_compression_allowed())
+            {
+                connect.add_parameter(communicator::g_name_communicator_param_compression, link_codec::get_compression_name());
+            }
+        }
         base->send_message_to_connection(connect);
     }
 
@@ -4613,6 +5652,618 @@ void communicatord::connection_lost(addr::addr const & remote_addr)
 }
 
 
+/** \brief A connection is gone, forget about it.
+ *
+ * This function is called whenever a connection gets removed from the
+ * ed::communicator or loses its connection to a remote communicator
+ * daemon. It removes the connection from the routing table so we do
+ * not attempt to forward messages to it anymore. When it was a local
+ * service, the remote daemons get our new list of services.
+ *
+ * \param[in] conn  The connection that is going away.
+ */
+void communicatord::forget_connection(base_connection::pointer_t conn)
+{
+    f_routes.remove_connection(conn);
+    remove_subscriptions(conn);
+    remove_remote_services(conn);
+    local_services_changed();
+}
+
+
+/** \brief Add a new connection to the registry.
+ *
+ * The listeners and the remote communicators call this function each
+ * time they add a new base_connection to the ed::communicator. The
+ * registry sorts the connections by kind so the functions that need
+ * to go through one kind of connections only do not have to check the
+ * type of each connection with a dynamic_cast<>().
+ *
+ * \param[in] conn  The connection to register.
+ */
+void communicatord::register_connection(base_connection::pointer_t conn)
+{
+    f_connections.add_connection(conn);
+}
+
+
+/** \brief Remove a connection from the registry and routing table.
+ *
+ * This function is called when a connection gets removed from the
+ * ed::communicator. It is removed from the registry and we make sure
+ * that we forget about all of its routes.
+ *
+ * \param[in] conn  The connection being removed.
+ */
+void communicatord::unregister_connection(base_connection::pointer_t conn)
+{
+    if(conn != nullptr)
+    {
+        // keep the statistics of the connections which are gone
+        //
+        f_output_messages += conn->get_output_queue().get_messages();
+        f_output_syscalls += conn->get_output_queue().get_syscalls();
+        f_output_dropped += conn->get_output_queue().get_dropped()
+                          + conn->get_held_messages().get_dropped();
+
+        // a slow consumer which is gone is not slow anymore
+        //
+        conn->set_output_overflow(false);
+    }
+    f_connections.remove_connection(conn);
+    forget_connection(conn);
+}
+
+
+/** \brief Get the registry of connections.
+ *
+ * Plugins that need to go through a specific kind of connections can
+ * use this registry instead of the ed::communicator list of connections.
+ *
+ * \return A reference to the registry of connections.
+ */
+connection_registry const & communicatord::get_connection_registry() const
+{
+    return f_connections;
+}
+
+
+/** \brief Get the output coalescing threshold for new connections.
+ *
+ * \return The maximum number of bytes to queue or 0 if turned off.
+ */
+std::size_t communicatord::get_output_coalescing() const
+{
+    return f_output_coalescing;
+}
+
+
+/** \brief Limit the output queue of a new connection.
+ *
+ * The listeners call this function on each new connection and the
+ * remote communicators on each new remote_connection. The connections
+ * which write their bulk messages in batches (the encrypted ones and
+ * the links to other communicator daemons) apply the limits to their
+ * held messages instead.
+ *
+ * \param[in] conn  The new connection.
+ */
+void communicatord::apply_output_limits(base_connection::pointer_t conn) const
+{
+    conn->set_output_limits(
+              f_output_max_messages
+            , f_output_max_bytes
+            , f_output_overflow_policy);
+}
+
+
+/** \brief Check whether a command is a control command.
+ *
+ * \param[in] command  The name of the command to check.
+ *
+ * \return true if messages with that command go in the priority lane.
+ */
+bool communicatord::is_priority_command(std::string_view const & command) const
+{
+    return f_priority_commands.find(command) != f_priority_commands.end();
+}
+
+
+/** \brief Select the server which receives an anycast message.
+ *
+ * A message sent to server "~" goes to one computer running the
+ * destination service: the one with the lowest load average as
+ * collected by the loadavg plugin. The local computer is preferred
+ * when its load is within the anycast-local-margin of the best remote
+ * computer, which avoids a network hop for a small gain.
+ *
+ * The load averages are read from the loadavg file at most once per
+ * second.
+ *
+ * \param[in] service  The name of the destination service.
+ *
+ * \return The name of the selected server, or "*" if no computer is
+ * known to run that service, in which case the normal routing applies.
+ */
+std::string communicatord::select_anycast_server(std::string const & service)
+{
+    time_t const now(time(nullptr));
+    if(now != f_loadavg_loaded)
+    {
+        f_loadavg_loaded = now;
+        f_loadavg = communicator::loadavg_file();
+        f_loadavg.load();
+
+        // same computation as the loadavg plugin: the load is relative
+        // to the number of processors
+        //
+        double avg(0.0);
+        f_local_loadavg = getloadavg(&avg, 1) == 1
+                ? static_cast<float>(avg / std::max(1U, std::thread::hardware_concurrency()))
+                : -1.0f;
+    }
+
+    // the loadavg plugin saves the load of each remote computer by IP
+    // address with the port forced to LOCAL_PORT
+    //
+    base_connection::vector_t const remote_connections(f_routes.find_remote_service(service));
+    base_connection::pointer_t best_conn;
+    float best_avg(0.0f);
+    for(auto const & conn : remote_connections)
+    {
+        addr::addr a(conn->get_connection_address());
+        a.set_port(communicator::LOCAL_PORT);
+        sockaddr_in6 address = {};
+        a.get_ipv6(address);
+        communicator::loadavg_item const * item(f_loadavg.find(address));
+        if(item != nullptr
+        && (best_conn == nullptr || item->f_avg < best_avg))
+        {
+            best_conn = conn;
+            best_avg = item->f_avg;
+        }
+    }
+
+    if(f_routes.find_local_service(service) != nullptr
+    && (best_conn == nullptr
+        || f_local_loadavg < 0.0f
+        || f_local_loadavg <= best_avg + f_anycast_local_margin))
+    {
+        return f_server_name;
+    }
+
+    if(best_conn != nullptr)
+    {
+        return best_conn->get_server_name();
+    }
+
+    // no load information, any one of the remote computers will do
+    //
+    if(!remote_connections.empty())
+    {
+        return remote_connections.front()->get_server_name();
+    }
+
+    return communicator::g_name_communicator_server_any;
+}
+
+
+/** \brief Tell the sender that the destination service is busy.
+ *
+ * When the output queue of the destination is full and its overflow
+ * policy is "service-busy", the message is dropped and the sender
+ * receives a SERVICE_BUSY message instead. The sender can then retry
+ * later or slow down.
+ *
+ * Senders which did not declare SERVICE_BUSY in their list of commands
+ * do not get the reply since they would not understand it.
+ *
+ * \param[in] sender  The connection which sent the dropped message.
+ * \param[in] service  The name of the busy service.
+ * \param[in] command  The command of the dropped message.
+ */
+void communicatord::reply_service_busy(
+      base_connection::pointer_t sender
+    , std::string const & service
+    , std::string const & command)
+{
+    SNAP_LOG_DEBUG
+        << "service \""
+        << service
+        << "\" is busy, message \""
+        << command
+        << "\" dropped."
+        << SNAP_LOG_SEND;
+
+    if(sender == nullptr
+    || (sender->has_commands()
+        && !sender->understand_command(communicator::g_name_communicator_cmd_service_busy)))
+    {
+        return;
+    }
+
+    ed::message reply;
+    reply.set_command(communicator::g_name_communicator_cmd_service_busy);
+    reply.set_sent_from_server(f_server_name);
+    reply.set_sent_from_service(communicator::g_name_communicator_service_communicatord);
+    reply.add_parameter(communicator::g_name_communicator_param_destination_service, service);
+    reply.add_parameter(communicator::g_name_communicator_param_unsent_command, command);
+    sender->send_message_to_connection(reply);
+}
+
+
+/** \brief Verify a SUBSCRIBE or UNSUBSCRIBE message.
+ *
+ * Only local services can subscribe to topics. The remote communicator
+ * daemons advertise the topics of their own services with the
+ * SUBSCRIPTIONS message instead.
+ *
+ * \param[in] conn  The connection which sent \p msg.
+ * \param[in] msg  The SUBSCRIBE or UNSUBSCRIBE message.
+ *
+ * \return true if \p msg is valid and can be applied to \p conn.
+ */
+bool communicatord::is_local_subscriber(base_connection::pointer_t conn, ed::message & msg)
+{
+    if(conn == nullptr
+    || !is_tcp_connection(msg))
+    {
+        return false;
+    }
+
+    if(conn->get_connection_kind() != connection_kind_t::CONNECTION_KIND_UNIX
+    && (conn->get_connection_kind() != connection_kind_t::CONNECTION_KIND_SERVICE
+        || conn->is_remote()))
+    {
+        SNAP_LOG_ERROR
+            << msg.get_command()
+            << " is only accepted from a local service."
+            << SNAP_LOG_SEND;
+        return false;
+    }
+
+    if(!msg.has_parameter(communicator::g_name_communicator_param_topic))
+    {
+        SNAP_LOG_ERROR
+            << msg.get_command()
+            << " was received without the \""
+            << communicator::g_name_communicator_param_topic
+            << "\" parameter, which is mandatory."
+            << SNAP_LOG_SEND;
+        return false;
+    }
+
+    std::string const topic(msg.get_parameter(communicator::g_name_communicator_param_topic));
+    if(!topic_matcher::is_valid_pattern(topic))
+    {
+        SNAP_LOG_ERROR
+            << msg.get_command()
+            << " was received with an invalid topic pattern \""
+            << topic
+            << "\"."
+            << SNAP_LOG_SEND;
+        return false;
+    }
+
+    return true;
+}
+
+
+/** \brief Tell the remote daemons about our new list of topics.
+ *
+ * This function is called each time a pattern gets added to or
+ * removed from the list of topics subscribed by our local services.
+ *
+ * The sequence number is based on the current time so a daemon which
+ * restarts does not reuse the sequence numbers of its previous run.
+ */
+void communicatord::local_topics_changed()
+{
+    f_local_topics_sequence = std::max(
+              f_local_topics_sequence + 1
+            , static_cast<std::uint64_t>(time(nullptr)) * 1'000'000ULL);
+
+    std::string const topics(snapdev::join_strings(f_local_topics.get_patterns(), ","));
+    for(auto const & rc : f_routes.get_remote_connections())
+    {
+        send_subscriptions(rc, f_server_name, f_local_topics_sequence, topics);
+    }
+}
+
+
+/** \brief Send a SUBSCRIPTIONS message to a remote daemon.
+ *
+ * The message is only sent if the remote daemon understands it.
+ *
+ * \param[in] conn  The connection to the remote daemon.
+ * \param[in] origin  The name of the server where the subscribers are.
+ * \param[in] sequence  The version of the list of topics.
+ * \param[in] topics  The comma separated list of topic patterns.
+ */
+void communicatord::send_subscriptions(
+      base_connection::pointer_t conn
+    , std::string const & origin
+    , std::uint64_t sequence
+    , std::string const & topics)
+{
+    ed::message subscriptions;
+    subscriptions.set_command(communicator::g_name_communicator_cmd_subscriptions);
+    subscriptions.set_sent_from_server(f_server_name);
+    subscriptions.set_sent_from_service(communicator::g_name_communicator_service_communicatord);
+    subscriptions.add_parameter(communicator::g_name_communicator_param_server_name, origin);
+    subscriptions.add_parameter(communicator::g_name_communicator_param_sequence, std::to_string(sequence));
+    subscriptions.add_parameter(communicator::g_name_communicator_param_topics, topics);
+    conn->send_message_to_connection(subscriptions, false, true);
+}
+
+
+/** \brief Send all the topics we know about to a new remote daemon.
+ *
+ * This includes the topics of our local services and the topics of the
+ * other servers we heard of, except those we learned from \p conn.
+ *
+ * \param[in] conn  The connection to the new remote daemon.
+ */
+void communicatord::send_subscriptions_table(base_connection::pointer_t conn)
+{
+    if(f_local_topics_sequence != 0)
+    {
+        send_subscriptions(
+                  conn
+                , f_server_name
+                , f_local_topics_sequence
+                , snapdev::join_strings(f_local_topics.get_patterns(), ","));
+    }
+
+    for(auto const & remote : f_remote_topics)
+    {
+        if(remote.second.f_via.lock() != conn)
+        {
+            send_subscriptions(
+                      conn
+                    , remote.first
+                    , remote.second.f_sequence
+                    , remote.second.f_topics);
+        }
+    }
+}
+
+
+/** \brief Forget the topics of a connection.
+ *
+ * A local service going away does not receive published messages
+ * anymore. A remote daemon going away does not provide a path to its
+ * subscribers anymore; the lists learned through it are sent again
+ * once it reconnects.
+ *
+ * \param[in] conn  The connection being removed.
+ */
+void communicatord::remove_subscriptions(base_connection::pointer_t conn)
+{
+    if(conn == nullptr)
+    {
+        return;
+    }
+
+    bool changed(false);
+    for(auto const & p : conn->get_topics().get_patterns())
+    {
+        if(f_local_topics.remove(p))
+        {
+            changed = true;
+        }
+    }
+    conn->get_topics().clear();
+    if(changed)
+    {
+        local_topics_changed();
+    }
+
+    for(auto it(f_remote_topics.begin()); it != f_remote_topics.end(); )
+    {
+        base_connection::pointer_t const via(it->second.f_via.lock());
+        if(via == nullptr
+        || via == conn)
+        {
+            it = f_remote_topics.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+
+/** \brief Get the list of services we advertise.
+ *
+ * This is the list of services expected on this computer plus the
+ * services currently registered with us, since a service does not have
+ * to be listed to register.
+ *
+ * \return The comma separated list of services.
+ */
+std::string communicatord::get_advertised_services() const
+{
+    advgetopt::string_set_t services(f_local_services_list);
+    for(auto const & s : f_routes.get_local_service_names())
+    {
+        services.insert(s);
+    }
+    return snapdev::join_strings(services, ",");
+}
+
+
+/** \brief Tell the remote daemons about our new list of services.
+ *
+ * This function is called each time a local service registers or goes
+ * away. If the list of advertised services changed, a SERVICES message
+ * is sent to all the remote daemons so their directory does not keep
+ * sending messages to us for a service we do not offer anymore (or
+ * flooding a message for a service which we now offer).
+ *
+ * The sequence number works the same way as the one of the topics.
+ */
+void communicatord::local_services_changed()
+{
+    std::string const services(get_advertised_services());
+    if(f_local_services_sequence != 0
+    && services == f_advertised_services)
+    {
+        return;
+    }
+
+    f_advertised_services = services;
+    f_local_services_sequence = std::max(
+              f_local_services_sequence + 1
+            , static_cast<std::uint64_t>(time(nullptr)) * 1'000'000ULL);
+
+    for(auto const & rc : f_routes.get_remote_connections())
+    {
+        send_services(rc, f_server_name, f_local_services_sequence, services);
+    }
+}
+
+
+/** \brief Send a SERVICES message to a remote daemon.
+ *
+ * The message is only sent if the remote daemon understands it.
+ *
+ * \param[in] conn  The connection to the remote daemon.
+ * \param[in] origin  The name of the server offering the services.
+ * \param[in] sequence  The version of the list of services.
+ * \param[in] services  The comma separated list of services.
+ */
+void communicatord::send_services(
+      base_connection::pointer_t conn
+    , std::string const & origin
+    , std::uint64_t sequence
+    , std::string const & services)
+{
+    ed::message services_msg;
+    services_msg.set_command(communicator::g_name_communicator_cmd_services);
+    services_msg.set_sent_from_server(f_server_name);
+    services_msg.set_sent_from_service(communicator::g_name_communicator_service_communicatord);
+    services_msg.add_parameter(communicator::g_name_communicator_param_server_name, origin);
+    services_msg.add_parameter(communicator::g_name_communicator_param_sequence, std::to_string(sequence));
+    services_msg.add_parameter(communicator::g_name_communicator_param_services, services);
+    conn->send_message_to_connection(services_msg, false, true);
+}
+
+
+/** \brief Send all the services we know about to a new remote daemon.
+ *
+ * This includes our own services and the services of the other servers
+ * we heard of, except those we learned from \p conn.
+ *
+ * \param[in] conn  The connection to the new remote daemon.
+ */
+void communicatord::send_services_table(base_connection::pointer_t conn)
+{
+    send_services(
+              conn
+            , f_server_name
+            , f_local_services_sequence
+            , f_advertised_services);
+
+    for(auto const & remote : f_remote_services)
+    {
+        if(remote.second.f_via.lock() != conn)
+        {
+            send_services(
+                      conn
+                    , remote.first
+                    , remote.second.f_sequence
+                    , remote.second.f_services);
+        }
+    }
+}
+
+
+/** \brief Update the directory entries of a remote daemon.
+ *
+ * Once a remote daemon sends SERVICES messages, the lists it sent in
+ * its CONNECT or ACCEPT get replaced: its services are the ones of its
+ * own SERVICES message and the services it heard of are the ones of
+ * the other servers reached through it.
+ *
+ * \param[in] conn  The connection to the remote daemon.
+ */
+void communicatord::refresh_remote_services(base_connection::pointer_t conn)
+{
+    advgetopt::string_set_t heard_of;
+    for(auto const & remote : f_remote_services)
+    {
+        if(remote.second.f_via.lock() != conn)
+        {
+            continue;
+        }
+        if(remote.first == conn->get_server_name())
+        {
+            conn->set_services(remote.second.f_services);
+        }
+        else
+        {
+            snapdev::tokenize_string(heard_of, remote.second.f_services, { "," }, true);
+        }
+    }
+    conn->set_services_heard_of(snapdev::join_strings(heard_of, ","));
+
+    f_routes.set_remote_services(conn);
+    refresh_heard_of();
+}
+
+
+/** \brief Forget the services learned through a connection.
+ *
+ * The lists are sent again by the remote daemon once it reconnects.
+ * In the meantime, messages for those services get sent to all the
+ * remote daemons.
+ *
+ * \param[in] conn  The connection being removed.
+ */
+void communicatord::remove_remote_services(base_connection::pointer_t conn)
+{
+    for(auto it(f_remote_services.begin()); it != f_remote_services.end(); )
+    {
+        base_connection::pointer_t const via(it->second.f_via.lock());
+        if(via == nullptr
+        || via == conn)
+        {
+            it = f_remote_services.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+
+/** \brief Refresh the identifiers of the neighbors.
+ *
+ * The identifiers used to encode the informed neighbors of a broadcast
+ * message are based on the list of all the known neighbors. This
+ * function recalculates them after that list changed.
+ */
+void communicatord::update_neighbor_ids()
+{
+    if(!f_neighbor_ids_dirty)
+    {
+        return;
+    }
+    f_neighbor_ids_dirty = false;
+
+    std::vector<std::string> addresses;
+    addresses.reserve(f_all_neighbors.size());
+    for(auto const & a : f_all_neighbors)
+    {
+        addresses.push_back(a.to_ipv4or6_string(addr::STRING_IP_ADDRESS));
+    }
+    f_neighbor_ids.set_members(addresses);
+}
+
+
 
 
 } // namespace communicator_daemon
@@ -26,13 +26,21 @@
 
 // self
 //
+#include    "broadcast_dedup.h"
 #include    "cache.h"
+#include    "connection_registry.h"
+#include    "dissemination.h"
+#include    "neighbor_ids.h"
+#include    "output_queue.h"
+#include    "routing_table.h"
+#include    "topic_matcher.h"
 #include    "utils.h"
 
 
 // communicator
 //
 #include    <communicator/communicator_connection.h>
+#include    <communicator/loadavg.h>
 
 
 // eventdispatcher
@@ -61,6 +69,12 @@
 #include    <libaddr/addr.h>
 
 
+// C++
+//
+#include    <set>
+#include    <string_view>
+
+
 
 namespace communicator_daemon
 {
@@ -117,7 +131,26 @@ public:
                                         , ed::message const & msg);
     void                        process_connected(ed::connection::pointer_t connection);
     void                        connection_lost(addr::addr const & remote_addr);
+    void                        forget_connection(std::shared_ptr<base_connection> conn);
+    void                        register_connection(std::shared_ptr<base_connection> conn);
+    void                        unregister_connection(std::shared_ptr<base_connection> conn);
+    connection_registry const & get_connection_registry() const;
+    std::size_t                 get_output_coalescing() const;
+    void                        apply_output_limits(std::shared_ptr<base_connection> conn) const;
+    bool                        cache_maintenance();
+    bool                        is_priority_command(std::string_view const & command) const;
+    std::string                 select_anycast_server(std::string const & service);
+    void                        reply_service_busy(
+                                          std::shared_ptr<base_connection> sender
+                                        , std::string const & service
+                                        , std::string const & command);
+    bool                        compress_links(bool secure) const;
     bool                        forward_message(ed::message & msg);
+    bool                        forward_raw_message(
+                                          std::shared_ptr<base_connection> sender
+                                        , std::string const & line
+                                        , std::string const & sent_from_server
+                                        , std::string const & sent_from_service);
     void                        broadcast_message(
                                           ed::message & message
                                         , std::vector<std::shared_ptr<base_connection>> const & accepting_remote_connections = std::vector<std::shared_ptr<base_connection>>());
@@ -145,14 +178,43 @@ public:
     void                        msg_refuse(ed::message & msg);
     void                        msg_register(ed::message & msg);
     void                        msg_service_status(ed::message & msg);
+    void                        msg_services(ed::message & msg);
     void                        msg_shutdown(ed::message & msg);
+    void                        msg_subscribe(ed::message & msg);
+    void                        msg_subscriptions(ed::message & msg);
     void                        msg_unregister(ed::message & msg);
+    void                        msg_unsubscribe(ed::message & msg);
 
 private:
+    struct remote_services_t
+    {
+        std::uint64_t           f_sequence = 0;
+        std::string             f_services = std::string();
+        std::weak_ptr<base_connection>
+                                f_via = std::weak_ptr<base_connection>();
+    };
+
+    struct remote_topics_t
+    {
+        std::uint64_t           f_sequence = 0;
+        std::string             f_topics = std::string();
+        topic_matcher           f_matcher = topic_matcher();
+        std::weak_ptr<base_connection>
+                                f_via = std::weak_ptr<base_connection>();
+    };
+
     int                         init();
     void                        init_server_name();
     void                        init_server_ownership();
     bool                        init_max_connections();
+    void                        init_output_coalescing();
+    void                        init_output_limits();
+    void                        init_priority_commands();
+    void                        init_link_framing();
+    void                        init_link_compression();
+    void                        init_anycast();
+    void                        init_broadcast();
+    void                        init_cache();
     void                        init_max_gossip_timeout();
     void                        load_list_of_local_services();
     void                        init_interrupt();
@@ -170,7 +232,28 @@ private:
     bool                        shutting_down(ed::message & msg);
     bool                        check_broadcast_message(ed::message const & msg);
     bool                        communicator_message(ed::message & msg);
+    void                        reply_service_unavailable(ed::message & msg);
     void                        transmission_report(ed::message & msg, bool cached);
+    bool                        is_local_subscriber(std::shared_ptr<base_connection> conn, ed::message & msg);
+    void                        local_topics_changed();
+    void                        send_subscriptions(
+                                          std::shared_ptr<base_connection> conn
+                                        , std::string const & origin
+                                        , std::uint64_t sequence
+                                        , std::string const & topics);
+    void                        send_subscriptions_table(std::shared_ptr<base_connection> conn);
+    void                        remove_subscriptions(std::shared_ptr<base_connection> conn);
+    std::string                 get_advertised_services() const;
+    void                        local_services_changed();
+    void                        send_services(
+                                          std::shared_ptr<base_connection> conn
+                                        , std::string const & origin
+                                        , std::uint64_t sequence
+                                        , std::string const & services);
+    void                        send_services_table(std::shared_ptr<base_connection> conn);
+    void                        refresh_remote_services(std::shared_ptr<base_connection> conn);
+    void                        remove_remote_services(std::shared_ptr<base_connection> conn);
+    void                        update_neighbor_ids();
 
     advgetopt::getopt               f_opts;
     ed::dispatcher::pointer_t       f_dispatcher = ed::dispatcher::pointer_t();
@@ -183,6 +266,7 @@ private:
     ed::communicator::pointer_t     f_communicator = ed::communicator::pointer_t();
     ed::connection::weak_pointer_t  f_interrupt = ed::connection::pointer_t();        // signalfd
     ed::connection::pointer_t       f_stable_clock = ed::connection::pointer_t();     // timer (also generates cppprocess objects)
+    ed::connection::pointer_t       f_cache_timer = ed::connection::pointer_t();      // timer
     ed::connection::pointer_t       f_local_listener = ed::connection::pointer_t();   // TCP/IP
     ed::connection::pointer_t       f_remote_listener = ed::connection::pointer_t();  // TCP/IP
     ed::connection::pointer_t       f_secure_listener = ed::connection::pointer_t();  // TCP/IP
@@ -195,16 +279,45 @@ private:
     advgetopt::string_set_t         f_services_heard_of_list = advgetopt::string_set_t();
     std::string                     f_explicit_neighbors = std::string();
     addr::addr::set_t               f_all_neighbors = addr::addr::set_t();
+    neighbor_ids                    f_neighbor_ids = neighbor_ids();
+    dissemination                   f_dissemination = dissemination();
+    bool                            f_neighbor_ids_dirty = true;
     std::shared_ptr<remote_communicators>
                                     f_remote_communicators = std::shared_ptr<remote_communicators>();
     std::size_t                     f_max_connections = COMMUNICATORD_MAX_CONNECTIONS;
     std::size_t                     f_max_pending_connections = COMMUNICATORD_MAX_CONNECTIONS;
     std::size_t                     f_total_count_sent = 0; // f_all_neighbors.size() sent along CLUSTERUP/DOWN/COMPLETE/INCOMPLETE
+    std::size_t                     f_output_coalescing = output_queue::DEFAULT_FLUSH_THRESHOLD;
+    std::uint64_t                   f_output_messages = 0;  // statistics of the connections which are gone
+    std::uint64_t                   f_output_syscalls = 0;
+    std::uint64_t                   f_output_dropped = 0;
+    std::size_t                     f_output_max_messages = output_queue::DEFAULT_MAX_MESSAGES;
+    std::size_t                     f_output_max_bytes = output_queue::DEFAULT_MAX_BYTES;
+    overflow_policy_t               f_output_overflow_policy = overflow_policy_t::OVERFLOW_POLICY_SERVICE_BUSY;
+    std::set<std::string, std::less<>>
+                                    f_priority_commands = std::set<std::string, std::less<>>();    // std::less<> to search with a string_view
+    bool                            f_compact_framing = true;
+    bool                            f_compress_plain_links = true;
+    bool                            f_compress_secure_links = false;
+    float                           f_anycast_local_margin = 0.1f;
+    communicator::loadavg_file      f_loadavg = communicator::loadavg_file();
+    time_t                          f_loadavg_loaded = 0;
+    float                           f_local_loadavg = -1.0f;
     int                             f_default_remote_port = communicator::REMOTE_PORT;
     bool                            f_shutdown = false;
     bool                            f_debug_all_messages = false;
     cache                           f_local_message_cache = cache();
-    std::map<std::string, time_t>   f_received_broadcast_messages = (std::map<std::string, time_t>());
+    routing_table                   f_routes = routing_table();
+    connection_registry             f_connections = connection_registry();
+    broadcast_dedup                 f_received_broadcast_messages = broadcast_dedup();
+    topic_matcher                   f_local_topics = topic_matcher();
+    std::uint64_t                   f_local_topics_sequence = 0;
+    std::map<std::string, remote_topics_t>
+                                    f_remote_topics = std::map<std::string, remote_topics_t>();     // server name -> topics subscribed on that server
+    std::string                     f_advertised_services = std::string();
+    std::uint64_t                   f_local_services_sequence = 0;
+    std::map<std::string, remote_services_t>
+                                    f_remote_services = std::map<std::string, remote_services_t>(); // server name -> services offered by that server
     std::string                     f_cluster_status = std::string();
     std::string                     f_cluster_complete = std::string();
     serverplugins::collection::pointer_t
@@ -0,0 +1,263 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the connection registry.
+ *
+ * The registry holds one list of connections per connection kind. The
+ * listeners add new connections and the connections remove themselves
+ * when they get removed from the ed::communicator.
+ *
+ * The lists are expected to be small enough that adding and removing
+ * in a vector is faster than using a set, especially since the lists
+ * are read much more often than they are modified.
+ *
+ * The registry also includes an index of the connections by command.
+ * Each time a connection sends us its list of COMMANDS, the connection
+ * gets added to the list of subscribers of each one of these commands.
+ * This way a message such as STATUS is sent to the connections which
+ * understand it without having to check every single connection.
+ */
+
+// self
+//
+#include    "connection_registry.h"
+
+#include    "base_connection.h"
+
+
+// communicator
+//
+#include    <communicator/exception.h>
+
+
+// C++
+//
+#include    <algorithm>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+/** \brief Add a connection to the registry.
+ *
+ * The connection is added to the list matching its kind. Adding the
+ * same connection twice has no effect.
+ *
+ * \param[in] conn  The connection to add.
+ */
+void connection_registry::add_connection(connection_pointer_t conn)
+{
+    if(conn == nullptr)
+    {
+        return;
+    }
+
+    std::size_t const kind(static_cast<std::size_t>(conn->get_connection_kind()));
+    if(kind >= f_connections.size())
+    {
+        throw communicator::logic_error("connection_registry::add_connection() called with a connection of an invalid kind.");
+    }
+
+    connection_vector_t & list(f_connections[kind]);
+    if(std::find(list.begin(), list.end(), conn) == list.end())
+    {
+        list.push_back(conn);
+    }
+}
+
+
+/** \brief Remove a connection from the registry.
+ *
+ * This function is called when a connection is removed from the
+ * ed::communicator.
+ *
+ * The order of the connections in a list is not important so the
+ * function moves the last item in place of the removed item.
+ *
+ * \param[in] conn  The connection to remove.
+ */
+void connection_registry::remove_connection(connection_pointer_t conn)
+{
+    if(conn == nullptr)
+    {
+        return;
+    }
+
+    std::size_t const kind(static_cast<std::size_t>(conn->get_connection_kind()));
+    if(kind >= f_connections.size())
+    {
+        return;
+    }
+
+    connection_vector_t & list(f_connections[kind]);
+    auto it(std::find(list.begin(), list.end(), conn));
+    if(it != list.end())
+    {
+        *it = list.back();
+        list.pop_back();
+    }
+
+    remove_commands(conn);
+}
+
+
+/** \brief Get the list of connections of the specified kind.
+ *
+ * The returned vector is a reference to the internal list. Make a copy
+ * if you are going to remove connections while looping through it.
+ *
+ * \param[in] kind  The kind of connections to return.
+ *
+ * \return A reference to the list of connections of that kind.
+ */
+connection_registry::connection_vector_t const & connection_registry::get_connections(connection_kind_t kind) const
+{
+    std::size_t const idx(static_cast<std::size_t>(kind));
+    if(idx >= f_connections.size())
+    {
+        throw communicator::logic_error("connection_registry::get_connections() called with an invalid kind.");
+    }
+    return f_connections[idx];
+}
+
+
+/** \brief Total number of connections in the registry.
+ *
+ * \return The number of connections of all kinds.
+ */
+std::size_t connection_registry::size() const
+{
+    std::size_t count(0);
+    for(auto const & list : f_connections)
+    {
+        count += list.size();
+    }
+    return count;
+}
+
+
+
+/** \brief Index the commands understood by a connection.
+ *
+ * This function is called after a connection sent us a COMMANDS
+ * message. Each command it understands gets this connection added to
+ * its list of subscribers.
+ *
+ * The function can be called multiple times with the same connection.
+ * It will not be added more than once to a given list.
+ *
+ * Connections which are not (or not anymore) part of the registry are
+ * ignored so the index never keeps a removed connection alive.
+ *
+ * \param[in] conn  The connection which understands new commands.
+ */
+void connection_registry::add_commands(connection_pointer_t conn)
+{
+    if(conn == nullptr)
+    {
+        return;
+    }
+
+    std::size_t const kind(static_cast<std::size_t>(conn->get_connection_kind()));
+    if(kind >= f_connections.size())
+    {
+        return;
+    }
+    connection_vector_t const & registered(f_connections[kind]);
+    if(std::find(registered.begin(), registered.end(), conn) == registered.end())
+    {
+        return;
+    }
+
+    for(auto const & command : conn->get_commands())
+    {
+        connection_vector_t & list(f_subscribers[command]);
+        if(std::find(list.begin(), list.end(), conn) == list.end())
+        {
+            list.push_back(conn);
+        }
+    }
+}
+
+
+/** \brief Get the list of connections which understand \p command.
+ *
+ * The list includes connections of all kinds. The caller is expected
+ * to check the kind if only some of the connections are expected to
+ * receive the message.
+ *
+ * \param[in] command  The name of the command.
+ *
+ * \return The list of connections which understand that command.
+ */
+connection_registry::connection_vector_t const & connection_registry::get_subscribers(std::string const & command) const
+{
+    static connection_vector_t const no_subscribers = connection_vector_t();
+
+    auto it(f_subscribers.find(command));
+    if(it == f_subscribers.end())
+    {
+        return no_subscribers;
+    }
+    return it->second;
+}
+
+
+/** \brief Remove a connection from the command index.
+ *
+ * When a connection gets removed from the registry, we also remove it
+ * from the lists of subscribers. Commands without any subscribers are
+ * removed from the index.
+ *
+ * \param[in] conn  The connection being removed.
+ */
+void connection_registry::remove_commands(connection_pointer_t conn)
+{
+    for(auto const & command : conn->get_commands())
+    {
+        auto it(f_subscribers.find(command));
+        if(it == f_subscribers.end())
+        {
+            continue;
+        }
+
+        connection_vector_t & list(it->second);
+        auto c(std::find(list.begin(), list.end(), conn));
+        if(c != list.end())
+        {
+            *c = list.back();
+            list.pop_back();
+        }
+        if(list.empty())
+        {
+            f_subscribers.erase(it);
+        }
+    }
+}
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,96 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the connection registry.
+ *
+ * The communicator daemon keeps its connections sorted by kind so the
+ * functions that only need to work on one kind of connection (i.e. the
+ * Unix connections) do not have to go through all the connections and
+ * cast each one of them to find out its type.
+ */
+
+// C++
+//
+#include    <array>
+#include    <memory>
+#include    <string>
+#include    <unordered_map>
+#include    <vector>
+
+
+
+namespace communicator_daemon
+{
+
+
+class base_connection;
+
+
+/** \brief The kind of object a base_connection is.
+ *
+ * Each class derived from the base_connection is given a kind. This
+ * allows us to know the type of the object without having to use a
+ * dynamic_cast<>().
+ *
+ * \note
+ * This is not the same as the connection_type_t which changes with the
+ * status of the connection (i.e. REGISTER, CONNECT, DISCONNECT...).
+ */
+enum class connection_kind_t
+{
+    CONNECTION_KIND_SERVICE,    // service_connection: a TCP client (local service or remote communicatord connecting to us)
+    CONNECTION_KIND_UNIX,       // unix_connection: a local service connected through the Unix socket
+    CONNECTION_KIND_REMOTE,     // remote_connection: we are connected to a remote communicatord
+    CONNECTION_KIND_PING,       // ping: the UDP signal listener
+
+    CONNECTION_KIND_COUNT
+};
+
+
+class connection_registry
+{
+public:
+    typedef std::shared_ptr<base_connection>    connection_pointer_t;
+    typedef std::vector<connection_pointer_t>   connection_vector_t;
+
+    void                        add_connection(connection_pointer_t conn);
+    void                        remove_connection(connection_pointer_t conn);
+    connection_vector_t const & get_connections(connection_kind_t kind) const;
+    std::size_t                 size() const;
+
+    void                        add_commands(connection_pointer_t conn);
+    connection_vector_t const & get_subscribers(std::string const & command) const;
+
+private:
+    typedef std::array<connection_vector_t, static_cast<std::size_t>(connection_kind_t::CONNECTION_KIND_COUNT)>
+                                connections_by_kind_t;
+    typedef std::unordered_map<std::string, connection_vector_t>
+                                subscribers_t;
+
+    void                        remove_commands(connection_pointer_t conn);
+
+    connections_by_kind_t       f_connections = connections_by_kind_t();
+    subscribers_t               f_subscribers = subscribers_t();     // command -> connections understanding that command
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,353 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the dissemination class.
+ *
+ * The candidates are the neighbors connected to this daemon which were
+ * not yet informed of the message. Each candidate is given as its
+ * neighbor identifier (see neighbor_ids) or -1 if unknown.
+ *
+ * Flooding sends the message to all the candidates. When the originator
+ * knows all the other daemons, it ends up sending N - 1 messages itself
+ * and in a partially connected cluster many daemons receive the message
+ * several times.
+ *
+ * The spanning tree is derived from the list of members: the members
+ * are ranked starting at the originator and the member of rank r sends
+ * the message to the members of rank r * k + 1 to r * k + k. Each daemon
+ * receives the message once and sends at most k messages. The members
+ * which are unknown to us only receive the message from the originator.
+ *
+ * All the daemons have to rank the same list of members, otherwise their
+ * trees differ and some daemons would not receive the message. The
+ * caller checks the digest of the list of the sender (see
+ * neighbor_ids::decode()) and sets the flood flag when it differs.
+ *
+ * The tree expects all the daemons to be connected to each other, which
+ * is the case once they all know about each other. When a member of our
+ * subtree is not connected to us, nobody else would send it the message
+ * so we switch to flooding. The message then gets flagged so the other
+ * daemons also flood it.
+ *
+ * Gossiping sends the message to k random candidates. With
+ * k = ln(N) + c, all the daemons receive the message with a probability
+ * of about e^(-e^(-c)); the redundancy c is therefore the parameter
+ * which trades messages for reliability. Remember that the list of
+ * informed neighbors travels with the message so a daemon does not pick
+ * a neighbor which is known to already have the message.
+ *
+ * \warning
+ * Gossip is best effort. Nothing detects nor repairs a daemon which was
+ * not picked by any of its neighbors, so from time to time a broadcast
+ * message does not reach all the daemons (the broadcast-benchmark tool
+ * reports the worst coverage). In a full mesh, it also sends about k
+ * times more messages than flooding, since most of the picked neighbors
+ * already received the message from another daemon.
+ */
+
+// self
+//
+#include    "dissemination.h"
+
+
+// C++
+//
+#include    <algorithm>
+#include    <cmath>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+/** \brief Convert the name of a strategy.
+ *
+ * \param[in] name  One of "flood", "tree", or "gossip".
+ * \param[out] strategy  The corresponding strategy.
+ *
+ * \return true if \p name is valid.
+ */
+bool string_to_strategy(std::string const & name, strategy_t & strategy)
+{
+    if(name == "flood")
+    {
+        strategy = strategy_t::STRATEGY_FLOOD;
+        return true;
+    }
+    if(name == "tree")
+    {
+        strategy = strategy_t::STRATEGY_TREE;
+        return true;
+    }
+    if(name == "gossip")
+    {
+        strategy = strategy_t::STRATEGY_GOSSIP;
+        return true;
+    }
+    return false;
+}
+
+
+char const * strategy_to_string(strategy_t strategy)
+{
+    switch(strategy)
+    {
+    case strategy_t::STRATEGY_FLOOD:
+        return "flood";
+
+    case strategy_t::STRATEGY_TREE:
+        return "tree";
+
+    case strategy_t::STRATEGY_GOSSIP:
+        return "gossip";
+
+    }
+
+    return "unknown";
+}
+
+
+dissemination::dissemination()
+    : f_random(std::random_device()())
+{
+}
+
+
+void dissemination::set_strategy(strategy_t strategy)
+{
+    f_strategy = strategy;
+}
+
+
+strategy_t dissemination::get_strategy() const
+{
+    return f_strategy;
+}
+
+
+/** \brief Set the number of neighbors each daemon forwards to.
+ *
+ * For the tree, this is the number of children of each member. For
+ * gossip, this is the number of random neighbors.
+ *
+ * \param[in] fanout  The fan-out or 0 to calculate it automatically.
+ */
+void dissemination::set_fanout(std::size_t fanout)
+{
+    f_fanout = fanout;
+}
+
+
+/** \brief Set the redundancy of the automatic gossip fan-out.
+ *
+ * \param[in] redundancy  The number of neighbors added to ln(N).
+ */
+void dissemination::set_redundancy(std::size_t redundancy)
+{
+    f_redundancy = redundancy;
+}
+
+
+/** \brief Get the fan-out used with the current strategy.
+ *
+ * \param[in] members  The number of daemons in the cluster.
+ *
+ * \return The fan-out, 0 when flooding.
+ */
+std::size_t dissemination::get_fanout(std::size_t members) const
+{
+    switch(f_strategy)
+    {
+    case strategy_t::STRATEGY_FLOOD:
+        return 0;
+
+    case strategy_t::STRATEGY_TREE:
+        return f_fanout == 0 ? DEFAULT_TREE_FANOUT : f_fanout;
+
+    case strategy_t::STRATEGY_GOSSIP:
+        if(f_fanout != 0)
+        {
+            return f_fanout;
+        }
+        return static_cast<std::size_t>(std::ceil(std::log(std::max<std::size_t>(members, 2))))
+                + f_redundancy;
+
+    }
+
+    return 0;
+}
+
+
+/** \brief The maximum number of hops of a broadcast message.
+ *
+ * Flooding keeps its historical limit. The tree is as deep as
+ * log_k(N) and the gossip stops once all the daemons know about the
+ * message, so these only use a safety limit.
+ *
+ * \return The maximum number of hops.
+ */
+int dissemination::get_max_hops() const
+{
+    return f_strategy == strategy_t::STRATEGY_FLOOD
+                ? FLOOD_MAX_HOPS
+                : MAX_HOPS;
+}
+
+
+/** \brief Select the neighbors to forward a message to.
+ *
+ * \param[in] candidates  The identifiers of the neighbors not yet
+ * informed, -1 for unknown neighbors.
+ * \param[in] self  Our own identifier, -1 if unknown.
+ * \param[in] origin  The identifier of the originator, -1 if unknown.
+ * \param[in] members  The number of members in the cluster.
+ * \param[in,out] flood  Whether the message is being flooded; set to
+ * true when the tree cannot be used.
+ *
+ * \return The indexes in \p candidates of the selected neighbors.
+ */
+std::vector<std::size_t> dissemination::select(
+      std::vector<std::int32_t> const & candidates
+    , std::int32_t self
+    , std::int32_t origin
+    , std::size_t members
+    , bool & flood)
+{
+    switch(flood ? strategy_t::STRATEGY_FLOOD : f_strategy)
+    {
+    case strategy_t::STRATEGY_TREE:
+        if(self >= 0
+        && origin >= 0
+        && static_cast<std::size_t>(self) < members
+        && static_cast<std::size_t>(origin) < members)
+        {
+            std::vector<std::size_t> result;
+            if(select_tree(candidates, self, origin, members, result))
+            {
+                return result;
+            }
+        }
+        // without a valid tree, fall back to flooding
+        flood = true;
+        break;
+
+    case strategy_t::STRATEGY_GOSSIP:
+        return select_gossip(candidates, members);
+
+    case strategy_t::STRATEGY_FLOOD:
+        break;
+
+    }
+
+    std::vector<std::size_t> all(candidates.size());
+    for(std::size_t idx(0); idx < all.size(); ++idx)
+    {
+        all[idx] = idx;
+    }
+    return all;
+}
+
+
+bool dissemination::select_tree(
+      std::vector<std::int32_t> const & candidates
+    , std::int32_t self
+    , std::int32_t origin
+    , std::size_t members
+    , std::vector<std::size_t> & result) const
+{
+    std::size_t const fanout(get_fanout(members));
+
+    // rank of each connected candidate
+    //
+    std::size_t const none(static_cast<std::size_t>(-1));
+    std::vector<std::size_t> by_rank(members, none);
+    for(std::size_t idx(0); idx < candidates.size(); ++idx)
+    {
+        if(candidates[idx] < 0
+        || static_cast<std::size_t>(candidates[idx]) >= members)
+        {
+            // unknown neighbors only hear from the originator
+            //
+            if(self == origin)
+            {
+                result.push_back(idx);
+            }
+            continue;
+        }
+        std::size_t const rank((candidates[idx] - origin + members) % members);
+        by_rank[rank] = idx;
+    }
+
+    std::size_t const self_rank((self - origin + members) % members);
+    for(std::size_t child(self_rank * fanout + 1);
+        child <= self_rank * fanout + fanout && child < members;
+        ++child)
+    {
+        if(by_rank[child] == none)
+        {
+            // the members of our subtree are only informed by us
+            // so this one is not connected to us
+            //
+            return false;
+        }
+        result.push_back(by_rank[child]);
+    }
+
+    return true;
+}
+
+
+std::vector<std::size_t> dissemination::select_gossip(
+      std::vector<std::int32_t> const & candidates
+    , std::size_t members)
+{
+    std::size_t const fanout(get_fanout(members));
+    std::vector<std::size_t> result(candidates.size());
+    for(std::size_t idx(0); idx < result.size(); ++idx)
+    {
+        result[idx] = idx;
+    }
+    if(result.size() <= fanout)
+    {
+        return result;
+    }
+
+    // partial Fisher-Yates shuffle
+    //
+    for(std::size_t idx(0); idx < fanout; ++idx)
+    {
+        std::uniform_int_distribution<std::size_t> pick(idx, result.size() - 1);
+        std::swap(result[idx], result[pick(f_random)]);
+    }
+    result.resize(fanout);
+
+    return result;
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,100 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the dissemination class.
+ *
+ * The dissemination class selects the neighbors to which a broadcast
+ * message gets forwarded. By default, the message is sent to all the
+ * neighbors not yet informed (flooding). The spanning tree spreads
+ * the sending work among all the daemons. Gossip is best effort: it
+ * may miss a daemon and there is no repair step.
+ */
+
+// C++
+//
+#include    <cstdint>
+#include    <random>
+#include    <string>
+#include    <vector>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+enum class strategy_t
+{
+    STRATEGY_FLOOD,         // send to all the neighbors not yet informed
+    STRATEGY_TREE,          // send to our children in a tree rooted at the originator
+    STRATEGY_GOSSIP,        // send to a few random neighbors
+};
+
+
+bool                        string_to_strategy(std::string const & name, strategy_t & strategy);
+char const *                strategy_to_string(strategy_t strategy);
+
+
+class dissemination
+{
+public:
+    static constexpr int            FLOOD_MAX_HOPS = 5;
+    static constexpr int            MAX_HOPS = 32;
+    static constexpr std::size_t    DEFAULT_TREE_FANOUT = 4;
+    static constexpr std::size_t    DEFAULT_REDUNDANCY = 2;
+
+                                    dissemination();
+
+    void                            set_strategy(strategy_t strategy);
+    strategy_t                      get_strategy() const;
+    void                            set_fanout(std::size_t fanout);
+    void                            set_redundancy(std::size_t redundancy);
+    std::size_t                     get_fanout(std::size_t members) const;
+    int                             get_max_hops() const;
+
+    std::vector<std::size_t>        select(
+                                          std::vector<std::int32_t> const & candidates
+                                        , std::int32_t self
+                                        , std::int32_t origin
+                                        , std::size_t members
+                                        , bool & flood);
+
+private:
+    bool                            select_tree(
+                                          std::vector<std::int32_t> const & candidates
+                                        , std::int32_t self
+                                        , std::int32_t origin
+                                        , std::size_t members
+                                        , std::vector<std::size_t> & result) const;
+    std::vector<std::size_t>        select_gossip(
+                                          std::vector<std::int32_t> const & candidates
+                                        , std::size_t members);
+
+    strategy_t                      f_strategy = strategy_t::STRATEGY_FLOOD;
+    std::size_t                     f_fanout = 0;       // 0 means automatic
+    std::size_t                     f_redundancy = DEFAULT_REDUNDANCY;
+    std::mt19937                    f_random = std::mt19937();
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
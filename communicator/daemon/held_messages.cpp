@@ -0,0 +1,225 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the held_messages class.
+ *
+ * The eventdispatcher writes the messages of a connection in the order
+ * they are sent. To let the control messages go ahead of a backlog,
+ * the bulk messages are given to the eventdispatcher in batches of
+ * BULK_BATCH messages. The next batch is only sent once the output
+ * buffer is empty. In the meantime, the bulk messages are held in this
+ * object and the control messages are sent immediately, so they wait
+ * behind at most one batch.
+ *
+ * The held messages are not yet encoded. A link using the compact
+ * framing or compression encodes them once they leave this object, so
+ * dropping a held message never breaks the dictionary of a link.
+ *
+ * The object does not decide what to do once full. The connection
+ * applies its overflow policy using is_full(), drop_oldest(), and
+ * drop_newest(), like with the output_queue.
+ */
+
+// self
+//
+#include    "held_messages.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+/** \brief Set the maximum number of messages and bytes held.
+ *
+ * Use 0 to not limit one or the other.
+ *
+ * \param[in] max_messages  The maximum number of messages held.
+ * \param[in] max_bytes  The maximum number of bytes held.
+ */
+void held_messages::set_limits(std::size_t max_messages, std::size_t max_bytes)
+{
+    f_max_messages = max_messages;
+    f_max_bytes = max_bytes;
+}
+
+
+/** \brief Check whether one of the limits was reached.
+ *
+ * \return true if no more messages should be held.
+ */
+bool held_messages::is_full() const
+{
+    return (f_max_messages != 0 && f_messages.size() >= f_max_messages)
+        || (f_max_bytes != 0 && f_size >= f_max_bytes);
+}
+
+
+/** \brief Drop the oldest messages until there is room for a new one.
+ *
+ * \return true if the object is not full anymore.
+ */
+bool held_messages::drop_oldest()
+{
+    while(is_full()
+       && !f_messages.empty())
+    {
+        f_size -= f_messages.front().f_size;
+        f_messages.pop_front();
+        ++f_dropped;
+    }
+
+    return !is_full();
+}
+
+
+/** \brief Count a message which was not held because the object is full.
+ */
+void held_messages::drop_newest()
+{
+    ++f_dropped;
+}
+
+
+/** \brief Check whether a bulk message can be sent immediately.
+ *
+ * A bulk message can be sent immediately if no other bulk messages are
+ * held and the current batch is not complete. In that case, the message
+ * is counted in the current batch.
+ *
+ * \return true if the message can be sent now, false if it has to be
+ * held.
+ */
+bool held_messages::add_to_batch()
+{
+    if(!f_messages.empty()
+    || f_batch >= BULK_BATCH)
+    {
+        return false;
+    }
+
+    ++f_batch;
+    return true;
+}
+
+
+/** \brief The output buffer is empty, a new batch can start.
+ */
+void held_messages::end_batch()
+{
+    f_batch = 0;
+}
+
+
+/** \brief Hold a bulk message until the next batch.
+ *
+ * \param[in] msg  The message to hold.
+ * \param[in] cache  Whether to cache the message while disconnected.
+ */
+void held_messages::push(ed::message const & msg, bool cache)
+{
+    std::size_t const size(f_max_bytes != 0 ? msg.to_message().length() : 0);
+    f_messages.push_back(held_message_t{ msg, cache, size });
+    f_size += size;
+}
+
+
+/** \brief Retrieve the next held message of the current batch.
+ *
+ * \param[out] held  The message to send.
+ *
+ * \return true if \p held was set, false once the batch is complete or
+ * no more messages are held.
+ */
+bool held_messages::next(held_message_t & held)
+{
+    if(f_messages.empty()
+    || f_batch >= BULK_BATCH)
+    {
+        return false;
+    }
+
+    held = std::move(f_messages.front());
+    f_messages.pop_front();
+    f_size -= held.f_size;
+    ++f_batch;
+    return true;
+}
+
+
+/** \brief Take all the held messages.
+ *
+ * This is used when the connection is lost. The batch starts over.
+ *
+ * \return The messages which were held, oldest first.
+ */
+held_messages::queue_t held_messages::release()
+{
+    queue_t result;
+    result.swap(f_messages);
+    f_size = 0;
+    f_batch = 0;
+    return result;
+}
+
+
+bool held_messages::empty() const
+{
+    return f_messages.empty();
+}
+
+
+/** \brief Get the number of messages held.
+ *
+ * \return The number of messages waiting for the next batch.
+ */
+std::size_t held_messages::count() const
+{
+    return f_messages.size();
+}
+
+
+/** \brief Get the number of bytes held.
+ *
+ * The size of the messages is only computed when the number of bytes
+ * is limited.
+ *
+ * \return The number of bytes waiting for the next batch.
+ */
+std::size_t held_messages::size() const
+{
+    return f_size;
+}
+
+
+std::uint64_t held_messages::get_dropped() const
+{
+    return f_dropped;
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,92 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the held_messages class.
+ *
+ * The connections which cannot use an output_queue (the links to other
+ * communicator daemons and the encrypted connections) write their bulk
+ * messages in batches. The held_messages keeps the bulk messages which
+ * wait for the current batch to be written.
+ *
+ * Like the output_queue, it can be limited in number of messages and
+ * bytes so a slow peer does not make the daemon memory grow without
+ * bounds.
+ */
+
+// eventdispatcher
+//
+#include    <eventdispatcher/message.h>
+
+
+// C++
+//
+#include    <cstdint>
+#include    <deque>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+class held_messages
+{
+public:
+    struct held_message_t
+    {
+        ed::message                 f_message = ed::message();
+        bool                        f_cache = false;
+        std::size_t                 f_size = 0;
+    };
+
+    typedef std::deque<held_message_t>  queue_t;
+
+    static constexpr std::size_t    BULK_BATCH = 64;    // messages written before waiting for an empty buffer
+
+    void                            set_limits(std::size_t max_messages, std::size_t max_bytes);
+    bool                            is_full() const;
+    bool                            drop_oldest();
+    void                            drop_newest();
+
+    bool                            add_to_batch();
+    void                            end_batch();
+    void                            push(ed::message const & msg, bool cache);
+    bool                            next(held_message_t & held);
+    queue_t                         release();
+    bool                            empty() const;
+    std::size_t                     count() const;
+    std::size_t                     size() const;
+
+    std::uint64_t                   get_dropped() const;
+
+private:
+    queue_t                         f_messages = queue_t();
+    std::size_t                     f_batch = 0;        // bulk messages written since the buffer was last empty
+    std::size_t                     f_size = 0;         // total bytes held
+    std::size_t                     f_max_messages = 0; // 0 means no limit
+    std::size_t                     f_max_bytes = 0;    // 0 means no limit
+    std::uint64_t                   f_dropped = 0;
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,717 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the link_codec class.
+ *
+ * The links between communicator daemons always have a remote_connection
+ * on one side. That connection reads and writes its messages through the
+ * eventdispatcher which only supports the text format, with or without
+ * TLS. The compact framing therefore remains a valid text message: the
+ * command, the service names and the parameter names defined in names.an
+ * are replaced by an underscore followed by their interned identifier
+ * in decimal:
+ *
+ * \code
+ *     <snap1:communicatord cluster/HANGUP broadcast_hops=1;server_name=snap2
+ *     <snap1:_2 _1/_17 _3=1;_48=snap2
+ * \endcode
+ *
+ * The command of a compact message always starts with an underscore.
+ * A name which is not interned is sent as is, except that a name which
+ * starts with an underscore gets one more underscore. Since a name
+ * cannot start with a digit, the receiver can always tell an identifier
+ * from a literal name.
+ *
+ * The identifiers depend on the names.an file the daemon was compiled
+ * with. The name of the framing includes a fingerprint of all the
+ * tables so two daemons only use it when their tables are identical.
+ * Older daemons do not send the "framing" parameter in their CONNECT
+ * and ACCEPT messages and keep using the plain text format.
+ *
+ * The links are not compressed with a byte oriented algorithm such as
+ * deflate since the eventdispatcher reads and writes lines of text on
+ * the remote_connection side. Instead, the compact framing can also be
+ * compressed with a dictionary when both daemons agree on it (see the
+ * "compression" parameter of CONNECT and ACCEPT). A parameter value
+ * found in the dictionary is replaced by an at sign followed by its
+ * identifier and a server name by an underscore followed by its
+ * identifier. Once "snap1" and "snap2" are in the dictionary, the
+ * message above becomes:
+ *
+ * \code
+ *     <_64:_2 _1/_17 _3=1;_48=@65
+ * \endcode
+ *
+ * The dictionary starts with the values of names.an and the names of
+ * the message definitions. The values repeated in the stream of messages
+ * get added to it. Such an entry is defined in the reserved "_0"
+ * parameter of the first message using it, as a list of
+ * "<identifier>:<length>:<value>" (see link_dictionary for details).
+ * In the compact framing, a value which starts with an at sign and a
+ * server name which starts with an underscore get that character
+ * doubled, whether the compression is in use or not.
+ */
+
+// self
+//
+#include    "link_codec.h"
+
+
+// communicator
+//
+#include    <communicator/interned_names.h>
+#include    <communicator/names.h>
+
+
+// snapdev
+//
+#include    <snapdev/tokenize_string.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <charconv>
+#include    <iomanip>
+#include    <sstream>
+#include    <string>
+#include    <vector>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+namespace
+{
+
+
+
+constexpr char const    g_compact_framing_prefix[] = "compact2-";
+constexpr char const    g_dictionary_compression[] = "dict1";
+constexpr char const    g_definitions_parameter[] = "_0";
+
+
+
+/** \brief Encode one name.
+ *
+ * \param[in] name  The name to encode.
+ * \param[in] id  The interned identifier of \p name, 0 if unknown.
+ * \param[in] force  Always add the underscore (i.e. the command).
+ *
+ * \return The encoded name.
+ */
+std::string encode_name(std::string const & name, std::uint16_t id, bool force)
+{
+    if(id != 0)
+    {
+        std::string const encoded('_' + std::to_string(id));
+        if(force
+        || encoded.length() < name.length())
+        {
+            return encoded;
+        }
+    }
+
+    if(force
+    || (!name.empty() && name[0] == '_'))
+    {
+        return '_' + name;
+    }
+
+    return name;
+}
+
+
+/** \brief Decode one name.
+ *
+ * \param[in] name  The name to decode.
+ * \param[in] names  The table of the names of that type.
+ * \param[in] force  The name must start with an underscore (i.e. the command).
+ * \param[out] result  The decoded name.
+ *
+ * \return false if the name is not valid.
+ */
+template<std::size_t N>
+bool decode_name(
+      std::string const & name
+    , std::string_view const (&names)[N]
+    , bool force
+    , std::string & result)
+{
+    if(name.empty()
+    || name[0] != '_')
+    {
+        result = name;
+        return !force;
+    }
+
+    if(name.length() >= 2
+    && name[1] >= '0'
+    && name[1] <= '9')
+    {
+        std::size_t id(0);
+        char const * end(name.data() + name.length());
+        auto const r(std::from_chars(name.data() + 1, end, id));
+        if(r.ec != std::errc()
+        || r.ptr != end
+        || id == 0
+        || id > N)
+        {
+            return false;
+        }
+        result = names[id - 1];
+        return true;
+    }
+
+    result = name.substr(1);
+    return !result.empty();
+}
+
+
+
+} // no name namespace
+
+
+
+/** \class link_codec
+ * \brief Encode and decode the messages of a daemon link.
+ *
+ * Each base_connection has a link_codec. It remains in text mode unless
+ * the CONNECT/ACCEPT handshake selects the compact framing.
+ *
+ * The connecting daemon offers its framing in the CONNECT message. The
+ * accepting daemon selects the framing in its ACCEPT reply, which is
+ * still sent as text, and switches its own connection right after. The
+ * connecting daemon switches when it receives the ACCEPT.
+ *
+ * The compact messages are self-identifying. The text messages which
+ * were sent before the switch get decoded as is. Also, the connecting
+ * daemon decodes compact messages as soon as it offered the framing,
+ * since a control message may be written ahead of the ACCEPT reply.
+ *
+ * The compression works the same way, with the "compression" parameter.
+ * The dictionary entries defined by a message are used by the following
+ * messages, so the messages must reach the other daemon in the order
+ * they were encoded. The messages which can be written ahead of others
+ * (i.e. the control messages of the priority lane) only use the preset
+ * dictionary (see the \p static_only parameter of encode()).
+ */
+
+
+/** \brief Get the name of the compact framing of this daemon.
+ *
+ * \return The name of the framing, including the fingerprint of the
+ * interned names.
+ */
+std::string link_codec::get_framing_name()
+{
+    std::stringstream ss;
+    ss << g_compact_framing_prefix
+       << std::hex
+       << std::setfill('0')
+       << std::setw(8)
+       << communicator::g_interned_names_fingerprint;
+    return ss.str();
+}
+
+
+/** \brief Select the framing to use from the list offered by the peer.
+ *
+ * \param[in] offered  The comma separated list of framings offered.
+ *
+ * \return The name of our compact framing if offered, "text" otherwise.
+ */
+std::string link_codec::negotiate_framing(std::string const & offered)
+{
+    std::string const framing(get_framing_name());
+    std::vector<std::string> names;
+    snapdev::tokenize_string(
+              names
+            , offered
+            , ","
+            , true
+            , " ");
+    if(std::find(names.begin(), names.end(), framing) != names.end())
+    {
+        return framing;
+    }
+    return communicator::g_name_communicator_value_text;
+}
+
+
+/** \brief Get the name of the dictionary compression.
+ *
+ * \return The name of the compression offered in the CONNECT message.
+ */
+std::string link_codec::get_compression_name()
+{
+    return g_dictionary_compression;
+}
+
+
+/** \brief Select the compression to use from the list offered by the peer.
+ *
+ * \param[in] offered  The comma separated list of compressions offered.
+ *
+ * \return The name of our compression if offered, an empty string otherwise.
+ */
+std::string link_codec::negotiate_compression(std::string const & offered)
+{
+    std::vector<std::string> names;
+    snapdev::tokenize_string(
+              names
+            , offered
+            , ","
+            , true
+            , " ");
+    if(std::find(names.begin(), names.end(), g_dictionary_compression) != names.end())
+    {
+        return g_dictionary_compression;
+    }
+    return std::string();
+}
+
+
+/** \brief Mark that our compact framing was offered to the peer.
+ *
+ * From now on, the compact messages received get decoded even though
+ * the messages sent remain in text until set_framing() gets called.
+ */
+void link_codec::offer_framing()
+{
+    f_offered = true;
+}
+
+
+/** \brief Set the framing selected by the handshake.
+ *
+ * Any name other than our compact framing name selects the text format.
+ *
+ * \param[in] framing  The name of the framing.
+ */
+void link_codec::set_framing(std::string const & framing)
+{
+    f_compact = framing == get_framing_name();
+    f_offered = f_compact;
+}
+
+
+/** \brief Check whether the messages get encoded.
+ *
+ * \return true if the compact framing is in use.
+ */
+bool link_codec::is_compact() const
+{
+    return f_compact;
+}
+
+
+/** \brief Check whether the messages received have to be decoded.
+ *
+ * \return true if the compact framing was offered or is in use.
+ */
+bool link_codec::is_decoding() const
+{
+    return f_offered || f_compact;
+}
+
+
+/** \brief Define whether this link may be compressed.
+ *
+ * This is a setting of the link (see the compress_plain_links and
+ * compress_secure_links parameters). It is not changed by reset().
+ *
+ * \param[in] allow  Whether the compression can be offered or accepted.
+ */
+void link_codec::allow_compression(bool allow)
+{
+    f_compression_allowed = allow;
+}
+
+
+/** \brief Check whether this link may be compressed.
+ *
+ * \return true if the compression can be offered or accepted.
+ */
+bool link_codec::is_compression_allowed() const
+{
+    return f_compression_allowed;
+}
+
+
+/** \brief Set the compression selected by the handshake.
+ *
+ * The compression is only used along the compact framing, so this
+ * function must be called after set_framing(). Any name other than our
+ * compression name turns the compression off.
+ *
+ * \param[in] compression  The name of the compression.
+ */
+void link_codec::set_compression(std::string const & compression)
+{
+    f_compressing = f_compression_allowed
+                 && f_compact
+                 && compression == g_dictionary_compression;
+}
+
+
+/** \brief Check whether the values get compressed.
+ *
+ * \return true if the dictionary compression is in use.
+ */
+bool link_codec::is_compressing() const
+{
+    return f_compressing;
+}
+
+
+/** \brief Go back to the text format.
+ *
+ * This is called when the connection is lost. The next connection
+ * negotiates its framing and compression again and starts with empty
+ * dictionaries.
+ */
+void link_codec::reset()
+{
+    f_offered = false;
+    f_compact = false;
+    f_compressing = false;
+    f_send_dictionary.clear();
+    f_receive_dictionary.clear();
+}
+
+
+/** \brief Encode a message in the compact framing.
+ *
+ * The function does not check whether the compact framing is in use.
+ * The caller is expected to call is_compact() first.
+ *
+ * When the compression is in use, the values get replaced by a reference
+ * to the dictionary when shorter. A message which may be written ahead
+ * of the messages encoded before it must set \p static_only to true so
+ * it does not use or define any entry of the dynamic part of the
+ * dictionary.
+ *
+ * \param[in] msg  The message to encode.
+ * \param[in] static_only  Only use the preset dictionary.
+ *
+ * \return A copy of \p msg with its names and values replaced.
+ */
+ed::message link_codec::encode(ed::message const & msg, bool static_only)
+{
+    std::set<std::size_t> used;
+    std::string definitions;
+
+    ed::message result;
+    result.set_command(encode_name(
+              msg.get_command()
+            , static_cast<std::uint16_t>(communicator::intern_command(msg.get_command()))
+            , true));
+    if(!msg.get_service().empty())
+    {
+        result.set_service(encode_name(
+                  msg.get_service()
+                , static_cast<std::uint16_t>(communicator::intern_service(msg.get_service()))
+                , false));
+    }
+    if(!msg.get_sent_from_service().empty())
+    {
+        result.set_sent_from_service(encode_name(
+                  msg.get_sent_from_service()
+                , static_cast<std::uint16_t>(communicator::intern_service(msg.get_sent_from_service()))
+                , false));
+    }
+
+    // the server names are host names, they are not interned but they
+    // are good candidates for the dictionary
+    //
+    if(!msg.get_server().empty())
+    {
+        result.set_server(compress(msg.get_server(), '_', static_only, used, definitions));
+    }
+    if(!msg.get_sent_from_server().empty())
+    {
+        result.set_sent_from_server(compress(msg.get_sent_from_server(), '_', static_only, used, definitions));
+    }
+
+    for(auto const & p : msg.get_all_parameters())
+    {
+        result.add_parameter(
+                  encode_name(
+                      p.first
+                    , static_cast<std::uint16_t>(communicator::intern_parameter(p.first))
+                    , false)
+                , compress(p.second, '@', static_only, used, definitions));
+    }
+
+    if(!definitions.empty())
+    {
+        result.add_parameter(g_definitions_parameter, definitions);
+    }
+
+    return result;
+}
+
+
+/** \brief Decode a message received in the compact framing.
+ *
+ * A message which command does not start with an underscore was sent
+ * before the peer switched to the compact framing and is left as is.
+ *
+ * The dictionary entries defined by the message are saved before its
+ * references get resolved.
+ *
+ * This function has to be called before the user data gets attached
+ * to the message since the decoded message replaces \p msg.
+ *
+ * \param[in,out] msg  The message to decode.
+ *
+ * \return false if the message includes an invalid identifier or
+ * reference.
+ */
+bool link_codec::decode(ed::message & msg)
+{
+    std::string const & command(msg.get_command());
+    if(command.empty()
+    || command[0] != '_')
+    {
+        return true;
+    }
+
+    if(msg.has_parameter(g_definitions_parameter)
+    && !define(msg.get_parameter(g_definitions_parameter)))
+    {
+        return false;
+    }
+
+    ed::message result;
+    std::string name;
+    if(!decode_name(command, communicator::detail::g_command_names, true, name))
+    {
+        return false;
+    }
+    result.set_command(name);
+    if(!msg.get_service().empty())
+    {
+        if(!decode_name(msg.get_service(), communicator::detail::g_service_names, false, name))
+        {
+            return false;
+        }
+        result.set_service(name);
+    }
+    if(!msg.get_sent_from_service().empty())
+    {
+        if(!decode_name(msg.get_sent_from_service(), communicator::detail::g_service_names, false, name))
+        {
+            return false;
+        }
+        result.set_sent_from_service(name);
+    }
+    std::string value;
+    if(!msg.get_server().empty())
+    {
+        if(!decompress(msg.get_server(), '_', value))
+        {
+            return false;
+        }
+        result.set_server(value);
+    }
+    if(!msg.get_sent_from_server().empty())
+    {
+        if(!decompress(msg.get_sent_from_server(), '_', value))
+        {
+            return false;
+        }
+        result.set_sent_from_server(value);
+    }
+
+    for(auto const & p : msg.get_all_parameters())
+    {
+        if(p.first == g_definitions_parameter)
+        {
+            continue;
+        }
+        if(!decode_name(p.first, communicator::detail::g_parameter_names, false, name)
+        || !decompress(p.second, '@', value))
+        {
+            return false;
+        }
+        result.add_parameter(name, value);
+    }
+
+    msg = result;
+    return true;
+}
+
+
+/** \brief Compress one value.
+ *
+ * The value is replaced by the \p introducer followed by its identifier
+ * when found in the dictionary and the reference is shorter. Otherwise
+ * the value gets added to the dictionary (see link_dictionary::add()) and
+ * if it gets a slot, its definition is appended to \p definitions.
+ *
+ * A literal value which starts with the \p introducer gets it doubled.
+ *
+ * \param[in] value  The value to compress.
+ * \param[in] introducer  The character starting a reference.
+ * \param[in] static_only  Only use the preset dictionary.
+ * \param[in,out] used  The identifiers used by this message so far.
+ * \param[in,out] definitions  The definitions of this message so far.
+ *
+ * \return The reference or the escaped value.
+ */
+std::string link_codec::compress(
+      std::string const & value
+    , char introducer
+    , bool static_only
+    , std::set<std::size_t> & used
+    , std::string & definitions)
+{
+    if(f_compressing
+    && !value.empty())
+    {
+        std::size_t id(f_send_dictionary.find(value, static_only));
+        if(id == 0
+        && !static_only
+        && 1 + std::to_string(f_send_dictionary.next_id()).length() < value.length())
+        {
+            id = f_send_dictionary.add(value, used);
+            if(id != 0)
+            {
+                definitions += std::to_string(id);
+                definitions += ':';
+                definitions += std::to_string(value.length());
+                definitions += ':';
+                definitions += value;
+            }
+        }
+        if(id != 0)
+        {
+            std::string const reference(introducer + std::to_string(id));
+            if(reference.length() < value.length())
+            {
+                used.insert(id);
+                return reference;
+            }
+        }
+    }
+
+    if(!value.empty()
+    && value[0] == introducer)
+    {
+        return introducer + value;
+    }
+
+    return value;
+}
+
+
+/** \brief Decompress one value.
+ *
+ * \param[in] value  The value as received.
+ * \param[in] introducer  The character starting a reference.
+ * \param[out] result  The decompressed value.
+ *
+ * \return false if \p value is a reference to an unknown entry.
+ */
+bool link_codec::decompress(
+      std::string const & value
+    , char introducer
+    , std::string & result) const
+{
+    if(value.empty()
+    || value[0] != introducer)
+    {
+        result = value;
+        return true;
+    }
+
+    if(value.length() >= 2
+    && value[1] == introducer)
+    {
+        result = value.substr(1);
+        return true;
+    }
+
+    std::size_t id(0);
+    char const * end(value.data() + value.length());
+    auto const r(std::from_chars(value.data() + 1, end, id));
+    if(r.ec != std::errc()
+    || r.ptr != end)
+    {
+        return false;
+    }
+
+    return f_receive_dictionary.get(id, result);
+}
+
+
+/** \brief Save the dictionary entries defined by a message.
+ *
+ * \param[in] definitions  The list of "<identifier>:<length>:<value>".
+ *
+ * \return false if \p definitions is not valid.
+ */
+bool link_codec::define(std::string const & definitions)
+{
+    char const * s(definitions.data());
+    char const * const end(s + definitions.length());
+    while(s < end)
+    {
+        std::size_t id(0);
+        auto r(std::from_chars(s, end, id));
+        if(r.ec != std::errc()
+        || r.ptr == end
+        || *r.ptr != ':')
+        {
+            return false;
+        }
+        std::size_t length(0);
+        r = std::from_chars(r.ptr + 1, end, length);
+        if(r.ec != std::errc()
+        || r.ptr == end
+        || *r.ptr != ':'
+        || static_cast<std::size_t>(end - r.ptr - 1) < length)
+        {
+            return false;
+        }
+        s = r.ptr + 1;
+        if(!f_receive_dictionary.define(id, std::string(s, length)))
+        {
+            return false;
+        }
+        s += length;
+    }
+
+    return true;
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
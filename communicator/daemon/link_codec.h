@@ -0,0 +1,96 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the link_codec class.
+ *
+ * The link_codec class replaces the well known names of the messages
+ * sent between two communicator daemons with their interned identifier
+ * once both daemons agreed on the compact framing. It can also replace
+ * the values found in its link_dictionary with a reference.
+ */
+
+// self
+//
+#include    "link_dictionary.h"
+
+
+// eventdispatcher
+//
+#include    <eventdispatcher/message.h>
+
+
+// C++
+//
+#include    <set>
+#include    <string>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+class link_codec
+{
+public:
+    static std::string              get_framing_name();
+    static std::string              negotiate_framing(std::string const & offered);
+    static std::string              get_compression_name();
+    static std::string              negotiate_compression(std::string const & offered);
+
+    void                            offer_framing();
+    void                            set_framing(std::string const & framing);
+    bool                            is_compact() const;
+    bool                            is_decoding() const;
+    void                            allow_compression(bool allow);
+    bool                            is_compression_allowed() const;
+    void                            set_compression(std::string const & compression);
+    bool                            is_compressing() const;
+    void                            reset();
+
+    ed::message                     encode(ed::message const & msg, bool static_only = false);
+    bool                            decode(ed::message & msg);
+
+private:
+    std::string                     compress(
+                                          std::string const & value
+                                        , char introducer
+                                        , bool static_only
+                                        , std::set<std::size_t> & used
+                                        , std::string & definitions);
+    bool                            decompress(
+                                          std::string const & value
+                                        , char introducer
+                                        , std::string & result) const;
+    bool                            define(std::string const & definitions);
+
+    bool                            f_offered = false;
+    bool                            f_compact = false;
+    bool                            f_compression_allowed = false;
+    bool                            f_compressing = false;
+    link_dictionary                 f_send_dictionary = link_dictionary();
+    link_dictionary                 f_receive_dictionary = link_dictionary();
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,239 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the link_dictionary class.
+ *
+ * The identifiers 1 to get_static_size() are the entries of the preset
+ * dictionary. The following DYNAMIC_SLOTS identifiers are the slots of
+ * the table of repeated values. The sender assigns the slots in a round
+ * robin manner and sends each assignment along the first message which
+ * uses it. The receiver saves the assignments as it reads the messages,
+ * so both tables remain identical as long as the messages are received
+ * in the order they were encoded.
+ *
+ * A value gets a slot the second time it is seen. That way the values
+ * which are never repeated, such as the message identifiers, do not
+ * push the useful values out of the table.
+ */
+
+// self
+//
+#include    "link_dictionary.h"
+
+
+// communicator
+//
+#include    <communicator/interned_names.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <functional>
+#include    <iterator>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+/** \class link_dictionary
+ * \brief One direction of the dictionary of a compressed link.
+ *
+ * The sender uses find(), next_id() and add(). The receiver uses
+ * define() and get(). A link has one dictionary for each direction.
+ */
+
+
+/** \brief Get the number of entries in the preset dictionary.
+ *
+ * \return The number of values generated from names.an and the message
+ * definitions.
+ */
+std::size_t link_dictionary::get_static_size()
+{
+    return std::size(communicator::detail::g_dictionary_values);
+}
+
+
+/** \brief Search a value in the dictionary.
+ *
+ * \param[in] value  The value to search.
+ * \param[in] static_only  Only search the preset dictionary.
+ *
+ * \return The identifier of the value or 0 if not found.
+ */
+std::size_t link_dictionary::find(std::string_view value, bool static_only) const
+{
+    std::size_t const id(communicator::intern_dictionary_value(value));
+    if(id != 0
+    || static_only)
+    {
+        return id;
+    }
+
+    auto const it(f_ids.find(value));
+    if(it == f_ids.end())
+    {
+        return 0;
+    }
+    return it->second;
+}
+
+
+/** \brief Get the identifier the next call to add() would assign.
+ *
+ * The caller uses this identifier to know whether a reference would be
+ * shorter than the value itself.
+ *
+ * \return The identifier of the next slot.
+ */
+std::size_t link_dictionary::next_id() const
+{
+    return get_static_size() + 1 + f_next;
+}
+
+
+/** \brief Add a value to the table of repeated values.
+ *
+ * The first time a value is added, it is only remembered. The second
+ * time it gets the next slot, unless that slot is used by the message
+ * being encoded (see \p in_use).
+ *
+ * \param[in] value  The value to add.
+ * \param[in] in_use  The identifiers already used by the current message.
+ *
+ * \return The identifier of the new slot or 0.
+ */
+std::size_t link_dictionary::add(std::string const & value, std::set<std::size_t> const & in_use)
+{
+    if(value.empty()
+    || value.length() > MAX_LENGTH)
+    {
+        return 0;
+    }
+
+    std::size_t const h(std::hash<std::string>()(value));
+    if(f_seen.erase(h) == 0)
+    {
+        if(f_seen.size() >= SEEN_LIMIT)
+        {
+            f_seen.clear();
+        }
+        f_seen.insert(h);
+        return 0;
+    }
+
+    std::size_t const id(next_id());
+    if(in_use.count(id) != 0)
+    {
+        return 0;
+    }
+
+    std::string & slot(f_slots[f_next]);
+    if(!slot.empty())
+    {
+        f_ids.erase(slot);
+    }
+    slot = value;
+    f_ids[value] = id;
+    f_next = (f_next + 1) % DYNAMIC_SLOTS;
+
+    return id;
+}
+
+
+/** \brief Save the value of a slot as sent by the other side.
+ *
+ * \param[in] id  The identifier of the slot.
+ * \param[in] value  The new value of the slot.
+ *
+ * \return false if \p id is not a slot identifier or \p value is empty.
+ */
+bool link_dictionary::define(std::size_t id, std::string const & value)
+{
+    std::size_t const first(get_static_size() + 1);
+    if(id < first
+    || id >= first + DYNAMIC_SLOTS
+    || value.empty())
+    {
+        return false;
+    }
+
+    f_slots[id - first] = value;
+    return true;
+}
+
+
+/** \brief Get the value of an identifier.
+ *
+ * \param[in] id  The identifier of the value.
+ * \param[out] value  The value of that identifier.
+ *
+ * \return false if \p id is not valid or its slot was never defined.
+ */
+bool link_dictionary::get(std::size_t id, std::string & value) const
+{
+    std::size_t const first(get_static_size() + 1);
+    if(id == 0
+    || id >= first + DYNAMIC_SLOTS)
+    {
+        return false;
+    }
+
+    if(id < first)
+    {
+        value = communicator::detail::g_dictionary_values[id - 1];
+        return true;
+    }
+
+    std::string const & slot(f_slots[id - first]);
+    if(slot.empty())
+    {
+        return false;
+    }
+    value = slot;
+    return true;
+}
+
+
+/** \brief Forget all the repeated values.
+ *
+ * This is used when a connection is lost. The next connection starts
+ * with an empty table on both sides.
+ */
+void link_dictionary::clear()
+{
+    std::fill(f_slots.begin(), f_slots.end(), std::string());
+    f_ids.clear();
+    f_seen.clear();
+    f_next = 0;
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,78 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the link_dictionary class.
+ *
+ * The link_dictionary class holds the values which can be replaced by
+ * a reference in the messages sent on a compressed daemon link: the
+ * preset dictionary generated from names.an and the message definitions
+ * and a table of the values repeated in the stream of messages.
+ */
+
+// C++
+//
+#include    <cstdint>
+#include    <functional>
+#include    <map>
+#include    <set>
+#include    <string>
+#include    <string_view>
+#include    <unordered_set>
+#include    <vector>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+class link_dictionary
+{
+public:
+    static constexpr std::size_t    DYNAMIC_SLOTS = 1024;
+    static constexpr std::size_t    MAX_LENGTH = 256;           // longer values are not added to the table
+    static constexpr std::size_t    SEEN_LIMIT = 4096;          // values seen once before that set gets cleared
+
+    static std::size_t              get_static_size();
+
+    // sender side
+    std::size_t                     find(std::string_view value, bool static_only) const;
+    std::size_t                     next_id() const;
+    std::size_t                     add(std::string const & value, std::set<std::size_t> const & in_use);
+
+    // receiver side
+    bool                            define(std::size_t id, std::string const & value);
+    bool                            get(std::size_t id, std::string & value) const;
+
+    void                            clear();
+
+private:
+    std::vector<std::string>        f_slots = std::vector<std::string>(DYNAMIC_SLOTS);
+    std::map<std::string, std::size_t, std::less<>>
+                                    f_ids = std::map<std::string, std::size_t, std::less<>>();
+    std::unordered_set<std::size_t> f_seen = std::unordered_set<std::size_t>();
+    std::size_t                     f_next = 0;
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -107,6 +107,7 @@ listener::listener(
             , true)
     , f_server(s)
     , f_local(local)
+    , f_secure(!certificate.empty() && !private_key.empty())
     , f_server_name(server_name)
 {
     //set_name(...) -- this is done in the server.cpp because the listener
@@ -202,8 +203,23 @@ void listener::process_accept()
                 + ": "
                 + service->get_remote_address().to_ipv4or6_string(addr::STRING_IP_BRACKET_ADDRESS | addr::STRING_IP_PORT));
         service->mark_as_remote();
+        service->get_link_codec().allow_compression(f_server->compress_links(f_secure));
     }
 
+    // the output queue writes directly to the socket, which is not
+    // possible on an encrypted connection, which writes its bulk
+    // messages in batches instead
+    //
+    if(f_secure)
+    {
+        service->set_bulk_batches(true);
+    }
+    else
+    {
+        service->set_output_coalescing(f_server->get_output_coalescing());
+    }
+    f_server->apply_output_limits(service);
+
     if(!ed::communicator::instance()->add_connection(service))
     {
         // this should never happen here since each new creates a
@@ -213,6 +229,10 @@ void listener::process_accept()
             << "new client tcp connection could not be added to the ed::communicator list of connections."
             << SNAP_LOG_SEND;
     }
+    else
+    {
+        f_server->register_connection(service);
+    }
 }
 
 
@@ -71,6 +71,7 @@ public:
 private:
     communicatord *     f_server = nullptr;
     bool const          f_local = false;
+    bool const          f_secure = false;
     std::string const   f_server_name;
     std::string         f_username = std::string();
     std::string         f_password = std::string();
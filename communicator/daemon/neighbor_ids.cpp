@@ -0,0 +1,417 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the neighbor_ids class.
+ *
+ * The identifier of a daemon is its index in the sorted list of the IP
+ * addresses of all the known neighbors. Since that list may differ from
+ * one daemon to another while the cluster changes, a bitmap includes a
+ * digest of the list used to encode it. A daemon with a different list
+ * ignores the bitmap and considers that no neighbors were informed. The
+ * only side effect is that some neighbors receive the message twice and
+ * the second copy gets dropped by the broadcast_dedup.
+ *
+ * Past BITMAP_LIMIT members, the addresses are hashed in a Bloom filter
+ * instead. The filter does not depend on the list of members. However,
+ * a false positive means a neighbor is not sent the message by this
+ * daemon; it will generally receive it from another relay.
+ *
+ * Both encodings include the digest. The decode() function reports
+ * whether it matches ours since the tree dissemination strategy also
+ * needs all the daemons to rank the same list of members.
+ *
+ * The encoded value is:
+ *
+ * \code
+ *     b<digest>:<bitmap>       -- digest and bitmap in hexadecimal
+ *     f<digest>:<filter>       -- digest and Bloom filter in hexadecimal
+ * \endcode
+ */
+
+// self
+//
+#include    "neighbor_ids.h"
+
+
+// C++
+//
+#include    <algorithm>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+namespace
+{
+
+
+
+char const g_hex_digits[] = "0123456789abcdef";
+
+
+std::uint64_t fnv1a(std::string_view s, std::uint64_t h = 0xCBF29CE484222325ULL)
+{
+    for(char const c : s)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+
+std::uint64_t mix64(std::uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+
+int hex_value(char c)
+{
+    if(c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+
+bool hex_to_bytes(std::string_view hex, std::vector<std::uint8_t> & bytes)
+{
+    if((hex.length() & 1) != 0)
+    {
+        return false;
+    }
+    bytes.resize(hex.length() / 2);
+    for(std::size_t idx(0); idx < bytes.size(); ++idx)
+    {
+        int const hi(hex_value(hex[idx * 2]));
+        int const lo(hex_value(hex[idx * 2 + 1]));
+        if(hi < 0 || lo < 0)
+        {
+            return false;
+        }
+        bytes[idx] = static_cast<std::uint8_t>(hi * 16 + lo);
+    }
+    return true;
+}
+
+
+bool hex_to_digest(std::string_view hex, std::uint64_t & digest)
+{
+    if(hex.length() != 16)
+    {
+        return false;
+    }
+    digest = 0;
+    for(char const c : hex)
+    {
+        int const v(hex_value(c));
+        if(v < 0)
+        {
+            return false;
+        }
+        digest = digest * 16 + v;
+    }
+    return true;
+}
+
+
+void bytes_to_hex(std::vector<std::uint8_t> const & bytes, std::string & hex)
+{
+    for(auto const b : bytes)
+    {
+        hex += g_hex_digits[b >> 4];
+        hex += g_hex_digits[b & 15];
+    }
+}
+
+
+
+} // no name namespace
+
+
+
+/** \brief Define the list of members of the cluster.
+ *
+ * \param[in] addresses  The IP addresses of all the known communicator
+ * daemons, including this one.
+ */
+void neighbor_ids::set_members(std::vector<std::string> const & addresses)
+{
+    std::vector<std::string> sorted(addresses);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    f_ids.clear();
+    f_digest = 0xCBF29CE484222325ULL;
+    for(std::size_t idx(0); idx < sorted.size(); ++idx)
+    {
+        f_ids[sorted[idx]] = static_cast<std::int32_t>(idx);
+        f_digest = fnv1a(sorted[idx], f_digest);
+        f_digest = fnv1a("\n", f_digest);
+    }
+}
+
+
+std::size_t neighbor_ids::size() const
+{
+    return f_ids.size();
+}
+
+
+/** \brief Get the identifier of a member.
+ *
+ * \param[in] address  The IP address of the member.
+ *
+ * \return The identifier or -1 if \p address is not a member.
+ */
+std::int32_t neighbor_ids::get_id(std::string_view address) const
+{
+    auto const it(f_ids.find(address));
+    if(it == f_ids.end())
+    {
+        return -1;
+    }
+    return it->second;
+}
+
+
+std::uint64_t neighbor_ids::get_digest() const
+{
+    return f_digest;
+}
+
+
+/** \brief Decode the informed neighbors of a message.
+ *
+ * An invalid value or a bitmap encoded with a different list of members
+ * returns an empty set. A Bloom filter remains valid with a different
+ * list of members.
+ *
+ * The f_same_members field of the result is true only when the value
+ * was encoded with the same list of members as ours.
+ *
+ * \param[in] value  The value of the "broadcast_informed" parameter.
+ *
+ * \return The set of informed neighbors.
+ */
+neighbor_ids::informed_t neighbor_ids::decode(std::string_view value) const
+{
+    informed_t informed;
+    if(value.empty())
+    {
+        return informed;
+    }
+
+    std::string_view::size_type const pos(value.find(':'));
+    std::uint64_t digest(0);
+    if(pos == std::string_view::npos
+    || !hex_to_digest(value.substr(1, pos - 1), digest))
+    {
+        return informed_t();
+    }
+    informed.f_same_members = digest == f_digest;
+
+    switch(value[0])
+    {
+    case 'b':
+        if(!informed.f_same_members
+        || !hex_to_bytes(value.substr(pos + 1), informed.f_bits)
+        || informed.f_bits.size() != (f_ids.size() + 7) / 8)
+        {
+            informed.f_bits.clear();
+        }
+        break;
+
+    case 'f':
+        if(!hex_to_bytes(value.substr(pos + 1), informed.f_bits))
+        {
+            return informed_t();
+        }
+        informed.f_bloom = true;
+        break;
+
+    default:
+        return informed_t();
+
+    }
+
+    return informed;
+}
+
+
+/** \brief Encode a set of informed neighbors.
+ *
+ * \param[in] informed  The set to encode.
+ *
+ * \return The value to save in the "broadcast_informed" parameter.
+ */
+std::string neighbor_ids::encode(informed_t const & informed) const
+{
+    std::string result;
+    if(informed.f_bits.empty())
+    {
+        return result;
+    }
+
+    result.reserve(18 + informed.f_bits.size() * 2);
+    result += informed.f_bloom ? 'f' : 'b';
+    for(int shift(60); shift >= 0; shift -= 4)
+    {
+        result += g_hex_digits[(f_digest >> shift) & 15];
+    }
+    result += ':';
+    bytes_to_hex(informed.f_bits, result);
+
+    return result;
+}
+
+
+/** \brief Mark a neighbor as informed.
+ *
+ * An address which is not a member cannot be saved in a bitmap. In
+ * that case the function returns true and the set does not change.
+ *
+ * \param[in,out] informed  The set of informed neighbors.
+ * \param[in] address  The IP address of the neighbor.
+ *
+ * \return true if the neighbor was not yet informed.
+ */
+bool neighbor_ids::insert(informed_t & informed, std::string_view address) const
+{
+    if(informed.f_bits.empty())
+    {
+        if(f_ids.empty())
+        {
+            return true;
+        }
+        informed.f_bloom = f_ids.size() > BITMAP_LIMIT;
+        informed.f_bits.resize(informed.f_bloom
+                    ? f_ids.size() * BLOOM_BITS_PER_MEMBER / 8
+                    : (f_ids.size() + 7) / 8);
+    }
+
+    if(informed.f_bloom)
+    {
+        std::size_t positions[BLOOM_HASHES];
+        bloom_positions(address, informed.f_bits.size() * 8, positions);
+        bool added(false);
+        for(auto const p : positions)
+        {
+            std::uint8_t const mask(1 << (p & 7));
+            if((informed.f_bits[p >> 3] & mask) == 0)
+            {
+                informed.f_bits[p >> 3] |= mask;
+                added = true;
+            }
+        }
+        return added;
+    }
+
+    std::int32_t const id(get_id(address));
+    if(id < 0)
+    {
+        return true;
+    }
+    std::uint8_t const mask(1 << (id & 7));
+    if((informed.f_bits[id >> 3] & mask) != 0)
+    {
+        return false;
+    }
+    informed.f_bits[id >> 3] |= mask;
+    return true;
+}
+
+
+/** \brief Check whether a neighbor was informed.
+ *
+ * \param[in] informed  The set of informed neighbors.
+ * \param[in] address  The IP address of the neighbor.
+ *
+ * \return true if the neighbor is in the set. With a Bloom filter, the
+ * result may be a false positive.
+ */
+bool neighbor_ids::contains(informed_t const & informed, std::string_view address) const
+{
+    if(informed.f_bits.empty())
+    {
+        return false;
+    }
+
+    if(informed.f_bloom)
+    {
+        std::size_t positions[BLOOM_HASHES];
+        bloom_positions(address, informed.f_bits.size() * 8, positions);
+        for(auto const p : positions)
+        {
+            if((informed.f_bits[p >> 3] & (1 << (p & 7))) == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::int32_t const id(get_id(address));
+    return id >= 0
+        && (informed.f_bits[id >> 3] & (1 << (id & 7))) != 0;
+}
+
+
+void neighbor_ids::bloom_positions(
+      std::string_view address
+    , std::size_t bits
+    , std::size_t * positions)
+{
+    // double hashing: h1 + i * h2
+    //
+    std::uint64_t const h1(mix64(fnv1a(address)));
+    std::uint64_t const h2(mix64(h1) | 1);
+    for(std::size_t i(0); i < BLOOM_HASHES; ++i)
+    {
+        positions[i] = (h1 + i * h2) % bits;
+    }
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,83 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the neighbor_ids class.
+ *
+ * The neighbor_ids class gives a small numeric identifier to each
+ * communicator daemon of the cluster and uses those identifiers to
+ * encode the set of daemons already informed of a broadcast message
+ * as a bitmap, or as a Bloom filter in very large clusters.
+ */
+
+// C++
+//
+#include    <cstdint>
+#include    <map>
+#include    <string>
+#include    <string_view>
+#include    <vector>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+class neighbor_ids
+{
+public:
+    static constexpr std::size_t    BITMAP_LIMIT = 1024;        // switch to a Bloom filter above this number of members
+    static constexpr std::size_t    BLOOM_BITS_PER_MEMBER = 8;
+    static constexpr std::size_t    BLOOM_HASHES = 3;
+
+    /** \brief The set of informed neighbors of one message. */
+    struct informed_t
+    {
+        std::vector<std::uint8_t>   f_bits = std::vector<std::uint8_t>();
+        bool                        f_bloom = false;
+        bool                        f_same_members = false;     // set by decode()
+    };
+
+    void                            set_members(std::vector<std::string> const & addresses);
+    std::size_t                     size() const;
+    std::int32_t                    get_id(std::string_view address) const;
+    std::uint64_t                   get_digest() const;
+
+    informed_t                      decode(std::string_view value) const;
+    std::string                     encode(informed_t const & informed) const;
+    bool                            insert(informed_t & informed, std::string_view address) const;
+    bool                            contains(informed_t const & informed, std::string_view address) const;
+
+private:
+    static void                     bloom_positions(
+                                              std::string_view address
+                                            , std::size_t bits
+                                            , std::size_t * positions);
+
+    std::map<std::string, std::int32_t, std::less<>>
+                                    f_ids = std::map<std::string, std::int32_t, std::less<>>();
+    std::uint64_t                   f_digest = 0;
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,381 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the output_queue class.
+ *
+ * Each message sent to a connection used to be appended to the output
+ * buffer of that connection and then written with one write() call
+ * per event loop iteration. The output_queue keeps a reference to the
+ * encoded messages instead (no copy, the same buffer is shared between
+ * all the connections receiving a broadcast) and writes them all at
+ * once with a vectored sendmsg() call.
+ *
+ * The latency is bounded by one event loop iteration: the queue is
+ * flushed as soon as the socket is writable. The flush threshold caps
+ * the amount of data kept in memory. Once reached, the caller is
+ * expected to flush the queue immediately.
+ *
+ * The limits cap the queue of a consumer which does not read its
+ * socket fast enough. The queue itself does not decide what to do
+ * once full. The connection applies its overflow policy using
+ * is_full(), drop_oldest(), and drop_newest().
+ *
+ * The queue has two lanes. The priority lane is used for the control
+ * messages (STOP, SHUTDOWN, CLUSTER_DOWN, etc.) and it gets written
+ * first. Only a message already partially written goes before it since
+ * it cannot be interrupted without corrupting the stream.
+ */
+
+// self
+//
+#include    "output_queue.h"
+
+
+// C++
+//
+#include    <algorithm>
+
+
+// C
+//
+#include    <errno.h>
+#include    <sys/socket.h>
+#include    <sys/uio.h>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+/** \brief Set the number of bytes which triggers an immediate flush.
+ *
+ * \param[in] threshold  The number of bytes, at least 1.
+ */
+void output_queue::set_flush_threshold(std::size_t threshold)
+{
+    f_flush_threshold = std::max(static_cast<std::size_t>(1), threshold);
+}
+
+
+std::size_t output_queue::get_flush_threshold() const
+{
+    return f_flush_threshold;
+}
+
+
+/** \brief Set the maximum size of the queue.
+ *
+ * The queue is considered full once it holds \p max_messages messages
+ * or \p max_bytes bytes. Use 0 to not limit one or the other.
+ *
+ * \param[in] max_messages  The maximum number of messages in the queue.
+ * \param[in] max_bytes  The maximum number of bytes in the queue.
+ */
+void output_queue::set_limits(std::size_t max_messages, std::size_t max_bytes)
+{
+    f_max_messages = max_messages;
+    f_max_bytes = max_bytes;
+}
+
+
+/** \brief Check whether a limit was defined.
+ *
+ * \return true if the number of messages or bytes is limited.
+ */
+bool output_queue::has_limits() const
+{
+    return f_max_messages != 0
+        || f_max_bytes != 0;
+}
+
+
+/** \brief Check whether the queue reached one of its limits.
+ *
+ * \return true if no more messages should be added to the queue.
+ */
+bool output_queue::is_full() const
+{
+    return (f_max_messages != 0 && count() >= f_max_messages)
+        || (f_max_bytes != 0 && f_size >= f_max_bytes);
+}
+
+
+/** \brief Drop the oldest messages until the queue is not full anymore.
+ *
+ * Only the bulk messages get dropped. The message being written is
+ * kept since dropping its end would corrupt the stream and the control
+ * messages are never dropped.
+ *
+ * \return true if the queue is not full anymore.
+ */
+bool output_queue::drop_oldest()
+{
+    while(is_full()
+       && !f_buffers.empty())
+    {
+        f_size -= f_buffers.front()->length();
+        f_buffers.pop_front();
+        ++f_dropped;
+    }
+
+    return !is_full();
+}
+
+
+/** \brief Count a message which was not added because the queue is full.
+ *
+ * The connection calls this function instead of push() when the message
+ * gets dropped so the statistics include it.
+ */
+void output_queue::drop_newest()
+{
+    ++f_dropped;
+}
+
+
+/** \brief Add a message to the queue.
+ *
+ * The buffer is not copied. It must not be modified until written.
+ *
+ * A \p priority message goes after the other priority messages but
+ * ahead of all the bulk messages. The priority messages count against
+ * the limits like the bulk messages. Since drop_oldest() only removes
+ * bulk messages, the connection can make room for a control message
+ * unless the queue is full of control messages or its overflow policy
+ * does not allow dropping queued messages.
+ *
+ * \param[in] data  The encoded message.
+ * \param[in] priority  Whether this is a control message.
+ *
+ * \return true if the queue reached the flush threshold.
+ */
+bool output_queue::push(buffer_t const & data, bool priority)
+{
+    if(data == nullptr
+    || data->empty())
+    {
+        return needs_flush();
+    }
+
+    if(priority)
+    {
+        f_priority.push_back(data);
+    }
+    else
+    {
+        f_buffers.push_back(data);
+    }
+    f_size += data->length();
+    ++f_messages;
+
+    return needs_flush();
+}
+
+
+bool output_queue::empty() const
+{
+    return f_partial == nullptr
+        && f_priority.empty()
+        && f_buffers.empty();
+}
+
+
+/** \brief Get the number of bytes waiting to be written.
+ *
+ * \return The number of bytes in the queue.
+ */
+std::size_t output_queue::size() const
+{
+    return f_size;
+}
+
+
+/** \brief Get the number of messages waiting to be written.
+ *
+ * \return The number of messages in the queue.
+ */
+std::size_t output_queue::count() const
+{
+    return (f_partial == nullptr ? 0 : 1)
+        + f_priority.size()
+        + f_buffers.size();
+}
+
+
+bool output_queue::needs_flush() const
+{
+    return f_size >= f_flush_threshold;
+}
+
+
+/** \brief Write as much of the queue as possible.
+ *
+ * This function writes the queued messages with one sendmsg() call.
+ * If the socket cannot accept everything, the rest remains in the
+ * queue for the next call.
+ *
+ * The MSG_NOSIGNAL flag is used so a peer closing its end of the
+ * socket generates an EPIPE error instead of a SIGPIPE.
+ *
+ * \param[in] fd  The socket to write to.
+ *
+ * \return The number of bytes written or -1 on an error other than
+ * EAGAIN, in which case errno is set.
+ */
+ssize_t output_queue::flush(int fd)
+{
+    if(empty())
+    {
+        return 0;
+    }
+
+    // the message being written, then the priority lane, then the bulk
+    //
+    iovec iov[MAX_IOVEC];
+    std::size_t used(0);
+    if(f_partial != nullptr)
+    {
+        iov[0].iov_base = const_cast<char *>(f_partial->data() + f_offset);
+        iov[0].iov_len = f_partial->length() - f_offset;
+        ++used;
+    }
+    for(auto const * lane : { &f_priority, &f_buffers })
+    {
+        for(auto const & b : *lane)
+        {
+            if(used >= MAX_IOVEC)
+            {
+                break;
+            }
+            iov[used].iov_base = const_cast<char *>(b->data());
+            iov[used].iov_len = b->length();
+            ++used;
+        }
+    }
+
+    msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = used;
+
+    ++f_syscalls;
+    ssize_t const r(sendmsg(fd, &msg, MSG_NOSIGNAL));
+    if(r < 0)
+    {
+        // on Linux EWOULDBLOCK is the same as EAGAIN
+        //
+        if(errno == EAGAIN
+        || errno == EINTR)
+        {
+            return 0;
+        }
+        return -1;
+    }
+
+    std::size_t written(r);
+    f_size -= written;
+    while(written > 0)
+    {
+        if(f_partial == nullptr)
+        {
+            std::deque<buffer_t> & lane(f_priority.empty() ? f_buffers : f_priority);
+            f_partial = lane.front();
+            lane.pop_front();
+        }
+        std::size_t const available(f_partial->length() - f_offset);
+        if(written < available)
+        {
+            f_offset += written;
+            break;
+        }
+        written -= available;
+        f_offset = 0;
+        f_partial.reset();
+    }
+
+    return r;
+}
+
+
+/** \brief Drop all the queued messages.
+ *
+ * This is used when the connection is lost.
+ */
+void output_queue::clear()
+{
+    f_partial.reset();
+    f_priority.clear();
+    f_buffers.clear();
+    f_offset = 0;
+    f_size = 0;
+}
+
+
+/** \brief The number of messages added to this queue.
+ *
+ * \return The total number of messages pushed.
+ */
+std::uint64_t output_queue::get_messages() const
+{
+    return f_messages;
+}
+
+
+/** \brief The number of sendmsg() calls made by this queue.
+ *
+ * \return The total number of system calls.
+ */
+std::uint64_t output_queue::get_syscalls() const
+{
+    return f_syscalls;
+}
+
+
+/** \brief The number of system calls saved by coalescing.
+ *
+ * Without the queue, each message would have required at least one
+ * write() call.
+ *
+ * \return The number of messages minus the number of system calls.
+ */
+std::uint64_t output_queue::get_syscalls_saved() const
+{
+    return f_messages > f_syscalls ? f_messages - f_syscalls : 0;
+}
+
+
+/** \brief The number of messages dropped because the queue was full.
+ *
+ * \return The total number of messages dropped.
+ */
+std::uint64_t output_queue::get_dropped() const
+{
+    return f_dropped;
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
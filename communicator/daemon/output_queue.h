@@ -0,0 +1,109 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the output_queue class.
+ *
+ * The output_queue keeps the messages to be written to a connection
+ * until the socket is ready. All the messages queued in one event loop
+ * iteration are then written with a single vectored sendmsg() call.
+ *
+ * The queue can be limited in number of messages and bytes so a slow
+ * consumer does not make the daemon memory grow without bounds.
+ *
+ * Control messages go in a priority lane which is written before the
+ * bulk messages already queued.
+ */
+
+// C++
+//
+#include    <cstdint>
+#include    <deque>
+#include    <memory>
+#include    <string>
+
+
+// C
+//
+#include    <sys/types.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+enum class overflow_policy_t
+{
+    OVERFLOW_POLICY_DROP_OLDEST,
+    OVERFLOW_POLICY_DROP_NEWEST,
+    OVERFLOW_POLICY_SERVICE_BUSY,
+};
+
+
+class output_queue
+{
+public:
+    typedef std::shared_ptr<std::string const>  buffer_t;
+
+    static constexpr std::size_t    DEFAULT_FLUSH_THRESHOLD = 64 * 1024;
+    static constexpr std::size_t    DEFAULT_MAX_MESSAGES = 100'000;
+    static constexpr std::size_t    DEFAULT_MAX_BYTES = 16 * 1024 * 1024;
+    static constexpr std::size_t    MAX_IOVEC = 64;
+
+    void                            set_flush_threshold(std::size_t threshold);
+    std::size_t                     get_flush_threshold() const;
+    void                            set_limits(std::size_t max_messages, std::size_t max_bytes);
+    bool                            has_limits() const;
+    bool                            is_full() const;
+    bool                            drop_oldest();
+    void                            drop_newest();
+
+    bool                            push(buffer_t const & data, bool priority = false);
+    bool                            empty() const;
+    std::size_t                     size() const;
+    std::size_t                     count() const;
+    bool                            needs_flush() const;
+    ssize_t                         flush(int fd);
+    void                            clear();
+
+    std::uint64_t                   get_messages() const;
+    std::uint64_t                   get_syscalls() const;
+    std::uint64_t                   get_syscalls_saved() const;
+    std::uint64_t                   get_dropped() const;
+
+private:
+    buffer_t                        f_partial = buffer_t();                 // buffer being written
+    std::size_t                     f_offset = 0;                           // bytes of f_partial already written
+    std::deque<buffer_t>            f_priority = std::deque<buffer_t>();    // control messages
+    std::deque<buffer_t>            f_buffers = std::deque<buffer_t>();     // bulk messages
+    std::size_t                     f_size = 0;         // total bytes not yet written
+    std::size_t                     f_flush_threshold = DEFAULT_FLUSH_THRESHOLD;
+    std::size_t                     f_max_messages = 0;     // 0 means no limit
+    std::size_t                     f_max_bytes = 0;        // 0 means no limit
+    std::uint64_t                   f_messages = 0;
+    std::uint64_t                   f_syscalls = 0;
+    std::uint64_t                   f_dropped = 0;
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
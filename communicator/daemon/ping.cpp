@@ -59,7 +59,7 @@ namespace communicator_daemon
  */
 ping::ping(communicatord * s, addr::addr const & address)
     : udp_server_message_connection(address)
-    , base_connection(s, true)
+    , base_connection(s, connection_kind_t::CONNECTION_KIND_PING)
 {
 }
 
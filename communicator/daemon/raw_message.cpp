@@ -0,0 +1,291 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the raw_message class.
+ *
+ * A message sent between services looks like this:
+ *
+ * \code
+ *     <sent_from_server:sent_from_service server:service/COMMAND param=value;...
+ * \endcode
+ *
+ * The communicatord only needs the part before the parameters to route
+ * a message. The raw_message parses that header into views on the line
+ * and keeps a view on the rest of the line so the message can be
+ * forwarded without going through a full ed::message parse and
+ * serialization and without allocating memory for each field.
+ *
+ * \warning
+ * The raw_message keeps views on the \p line passed to the parse()
+ * function. That string must remain valid as long as the raw_message
+ * is used.
+ */
+
+// self
+//
+#include    "raw_message.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+namespace
+{
+
+
+bool is_command_char(char c)
+{
+    return (c >= 'A' && c <= 'Z')
+        || (c >= '0' && c <= '9')
+        || c == '_';
+}
+
+
+bool is_name_char(char c)
+{
+    // we stop on any character that has a meaning in the header
+    //
+    return c != ':'
+        && c != '/'
+        && c != ' '
+        && c != '<'
+        && c != ';'
+        && c != '='
+        && c != '\n'
+        && c != '\r';
+}
+
+
+} // no name namespace
+
+
+
+/** \brief Parse the header of a message.
+ *
+ * This function parses the sent from server and service, the server and
+ * service and the command of a message. The parameters are not parsed.
+ *
+ * The function is strict. If anything looks wrong, it returns false
+ * and the caller is expected to use the full ed::message parser
+ * which will properly report errors.
+ *
+ * \param[in] line  The message as received on the wire.
+ *
+ * \return true if the header is valid.
+ */
+bool raw_message::parse(std::string const & line)
+{
+    f_sent_from_server = std::string_view();
+    f_sent_from_service = std::string_view();
+    f_server = std::string_view();
+    f_service = std::string_view();
+    f_command = std::string_view();
+    f_destination = std::string_view();
+    f_parameters = std::string_view();
+
+    std::string_view l(line);
+    std::string_view::size_type pos(0);
+
+    // <sent_from_server:sent_from_service
+    //
+    if(!l.empty() && l[0] == '<')
+    {
+        std::string_view::size_type const colon(l.find(':', 1));
+        if(colon == std::string_view::npos)
+        {
+            return false;
+        }
+        std::string_view::size_type const space(l.find(' ', colon + 1));
+        if(space == std::string_view::npos)
+        {
+            return false;
+        }
+        f_sent_from_server = l.substr(1, colon - 1);
+        f_sent_from_service = l.substr(colon + 1, space - colon - 1);
+        pos = space + 1;
+    }
+
+    std::string_view::size_type const destination(pos);
+
+    // server:service/
+    //
+    std::string_view::size_type end(pos);
+    while(end < l.length() && is_name_char(l[end]))
+    {
+        ++end;
+    }
+    if(end < l.length() && l[end] == ':')
+    {
+        f_server = l.substr(pos, end - pos);
+        pos = end + 1;
+        end = pos;
+        while(end < l.length() && is_name_char(l[end]))
+        {
+            ++end;
+        }
+        if(end >= l.length() || l[end] != '/')
+        {
+            return false;
+        }
+        f_service = l.substr(pos, end - pos);
+        pos = end + 1;
+    }
+    else if(end < l.length() && l[end] == '/')
+    {
+        f_service = l.substr(pos, end - pos);
+        pos = end + 1;
+    }
+
+    // COMMAND
+    //
+    end = pos;
+    while(end < l.length() && is_command_char(l[end]))
+    {
+        ++end;
+    }
+    if(end == pos)
+    {
+        return false;
+    }
+    if(end < l.length() && l[end] != ' ')
+    {
+        return false;
+    }
+    f_command = l.substr(pos, end - pos);
+
+    f_destination = l.substr(destination, end - destination);
+    f_parameters = l.substr(end);
+
+    return true;
+}
+
+
+std::string_view raw_message::get_sent_from_server() const
+{
+    return f_sent_from_server;
+}
+
+
+std::string_view raw_message::get_sent_from_service() const
+{
+    return f_sent_from_service;
+}
+
+
+std::string_view raw_message::get_server() const
+{
+    return f_server;
+}
+
+
+std::string_view raw_message::get_service() const
+{
+    return f_service;
+}
+
+
+std::string_view raw_message::get_command() const
+{
+    return f_command;
+}
+
+
+/** \brief Check whether the message includes the named parameter.
+ *
+ * This function searches the parameters for \p name followed by an
+ * equal sign. It does not parse the values, so a value which includes
+ * the string "<name>=" right after a semicolon would give a false
+ * positive. This is fine since the function is used to decide whether
+ * the message must go through the full parser.
+ *
+ * \param[in] name  The name of the parameter to search.
+ *
+ * \return true if the parameter seems to be defined.
+ */
+bool raw_message::has_parameter(std::string_view const & name) const
+{
+    std::string_view::size_type pos(0);
+    for(;;)
+    {
+        pos = f_parameters.find(name, pos);
+        if(pos == std::string_view::npos)
+        {
+            return false;
+        }
+        if(pos > 0
+        && (f_parameters[pos - 1] == ' ' || f_parameters[pos - 1] == ';')
+        && pos + name.length() < f_parameters.length()
+        && f_parameters[pos + name.length()] == '=')
+        {
+            return true;
+        }
+        ++pos;
+    }
+}
+
+
+/** \brief Regenerate the message with a new sent from server and service.
+ *
+ * The destination, command, and parameters are copied as is from the
+ * original line. Only the sent from part gets replaced. If both
+ * \p sent_from_server and \p sent_from_service are empty, the original
+ * values are kept.
+ *
+ * \param[in] sent_from_server  The name of the server sending the message.
+ * \param[in] sent_from_service  The name of the service sending the message.
+ *
+ * \return The message ready to be written to a connection (without the
+ * ending newline).
+ */
+std::string raw_message::to_message(
+      std::string const & sent_from_server
+    , std::string const & sent_from_service) const
+{
+    bool const keep(sent_from_server.empty() && sent_from_service.empty());
+    std::string_view const server(keep ? f_sent_from_server : std::string_view(sent_from_server));
+    std::string_view const service(keep ? f_sent_from_service : std::string_view(sent_from_service));
+
+    std::string result;
+    result.reserve(server.length() + service.length() + f_destination.length() + f_parameters.length() + 4);
+    if(!server.empty()
+    || !service.empty())
+    {
+        result += '<';
+        result += server;
+        result += ':';
+        result += service;
+        result += ' ';
+    }
+    result += f_destination;
+    result += f_parameters;
+    return result;
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
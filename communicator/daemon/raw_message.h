@@ -0,0 +1,72 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the raw_message class.
+ *
+ * The raw_message class parses only the header of a message as it
+ * arrives on the wire. This is enough for the communicatord to decide
+ * where to forward a message without having to parse its parameters.
+ *
+ * All the fields are views on the line so parsing a message does not
+ * allocate anything.
+ */
+
+// C++
+//
+#include    <string>
+#include    <string_view>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+class raw_message
+{
+public:
+    bool                        parse(std::string const & line);
+
+    std::string_view            get_sent_from_server() const;
+    std::string_view            get_sent_from_service() const;
+    std::string_view            get_server() const;
+    std::string_view            get_service() const;
+    std::string_view            get_command() const;
+    bool                        has_parameter(std::string_view const & name) const;
+
+    std::string                 to_message(
+                                      std::string const & sent_from_server
+                                    , std::string const & sent_from_service) const;
+
+private:
+    std::string_view            f_sent_from_server = std::string_view();
+    std::string_view            f_sent_from_service = std::string_view();
+    std::string_view            f_server = std::string_view();
+    std::string_view            f_service = std::string_view();
+    std::string_view            f_command = std::string_view();
+    std::string_view            f_destination = std::string_view();     // "server:service/COMMAND" as found on the wire
+    std::string_view            f_parameters = std::string_view();      // " name=value;..." as found on the wire
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
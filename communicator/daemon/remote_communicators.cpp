@@ -191,6 +191,7 @@ void remote_communicators::add_remote_communicator(addr::addr const & remote_add
         //       across, then we could use ssl: or tcp: or such)
         //
         remote_connection::pointer_t remote_conn(std::make_shared<remote_connection>(f_server, remote_addr, false));
+        f_server->apply_output_limits(remote_conn);
         f_smaller_ips[remote_addr] = remote_conn;
 
         // make sure not to try to connect to all remote communicators
@@ -228,6 +229,8 @@ void remote_communicators::add_remote_communicator(addr::addr const & remote_add
         }
         else
         {
+            f_server->register_connection(remote_conn);
+
             SNAP_LOG_DEBUG
                 << "new remote connection added for "
                 << addr_str
@@ -511,31 +514,27 @@ std::size_t remote_communicators::count_live_connections() const
     // connection representing a remote connection (i.e. to another
     // communicatord service)
     //
-    ed::connection::vector_t const & all_connections(f_communicator->get_connections());
-    for(auto const & conn : all_connections)
+    connection_registry const & registry(f_server->get_connection_registry());
+    for(auto const & conn : registry.get_connections(connection_kind_t::CONNECTION_KIND_REMOTE))
     {
-        remote_connection::pointer_t rc(std::dynamic_pointer_cast<remote_connection>(conn));
-        if(rc != nullptr)
+        // this is a remote connection by definition (same as f_smaller_ips)
+        //
+        if(static_cast<remote_connection &>(*conn).is_connected())
         {
-            // this is a remote connection by definition (same as f_smaller_ips)
-            //
-            if(rc->is_connected())
-            {
-                ++count;
-            }
+            ++count;
         }
-        else
+    }
+
+    // the service connections are either a local service or a remote
+    // communicator daemon (i.e. those that have a large IP address
+    // connect to us)
+    //
+    for(auto const & conn : registry.get_connections(connection_kind_t::CONNECTION_KIND_SERVICE))
+    {
+        if(conn->is_remote()
+        && conn->get_socket() != -1)
         {
-            // this is either a local service or a remote communicator daemon
-            // (i.e. those that have a large IP address connect to us)
-            //
-            base_connection::pointer_t bc(std::dynamic_pointer_cast<base_connection>(conn));
-            if(bc != nullptr
-            && bc->is_remote()
-            && bc->get_socket() != -1)
-            {
-                ++count;
-            }
+            ++count;
         }
     }
 
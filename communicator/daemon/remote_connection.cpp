@@ -76,6 +76,12 @@ namespace communicator_daemon
  *
  * It also gives us a way to quickly track communicatord objects
  * that REFUSE our connection.
+ *
+ * The eventdispatcher writes the messages of this connection in the
+ * order they are sent. To let the control messages (see the
+ * priority_commands option) go ahead of a backlog, the bulk messages
+ * are written in batches (see held_messages). The held messages are
+ * limited like the output queue of the local connections.
  */
 
 
@@ -101,11 +107,13 @@ remote_connection::remote_connection(
                 ? ed::mode_t::MODE_SECURE
                 : ed::mode_t::MODE_PLAIN)
             , REMOTE_CONNECTION_DEFAULT_TIMEOUT)
-    , base_connection(s, false)
+    , base_connection(s, connection_kind_t::CONNECTION_KIND_REMOTE)
     , f_address(address)
 {
     std::string const addr_str(address.to_ipv4or6_string(addr::STRING_IP_BRACKET_ADDRESS | addr::STRING_IP_PORT));
     set_name(communicator::g_name_communicator_connection_remote_communicator_out + (": " + addr_str));
+    get_link_codec().allow_compression(s->compress_links(secure));
+    set_bulk_batches(true);
 }
 
 
@@ -132,6 +140,21 @@ int remote_connection::get_socket() const
 
 void remote_connection::process_message(ed::message & msg)
 {
+    // the link may use the compact framing
+    //
+    if(get_link_codec().is_decoding()
+    && !get_link_codec().decode(msg))
+    {
+        SNAP_LOG_ERROR
+            << "message \""
+            << msg.to_message()
+            << "\" received from \""
+            << f_server_name
+            << "\" includes an invalid interned name identifier or dictionary reference."
+            << SNAP_LOG_SEND;
+        return;
+    }
+
     if(f_server_name.empty())
     {
         f_server_name = msg.get_sent_from_server();
@@ -145,14 +168,28 @@ void remote_connection::process_message(ed::message & msg)
 
 void remote_connection::process_connection_failed(std::string const & error_message)
 {
+    // the next connection negotiates its framing again and the messages
+    // cached in between have to be in text
+    //
+    get_link_codec().reset();
+
     tcp_client_permanent_message_connection::process_connection_failed(error_message);
 
+    // the eventdispatcher caches the messages which can be cached until
+    // we are connected again
+    //
+    release_held_messages();
+
     SNAP_LOG_ERROR
         << "the connection to a remote communicator failed: \""
         << error_message
         << "\"."
         << SNAP_LOG_SEND;
 
+    // the remote communicator daemon cannot receive messages anymore
+    //
+    f_server->forget_connection(std::dynamic_pointer_cast<base_connection>(shared_from_this()));
+
     // were we connected? if so this is a hang up
     //
     if(f_connected
@@ -271,8 +308,15 @@ void remote_connection::process_connected()
         flag->save();
     }
 
+    // the CONNECT message and the messages cached while disconnected
+    // are sent in text, the ACCEPT reply may select the compact framing
+    //
+    get_link_codec().reset();
+
     tcp_client_permanent_message_connection::process_connected();
 
+    get_held_messages().end_batch();
+
     f_server->process_connected(shared_from_this());
 
     // reset the wait to the default 5 minutes
@@ -287,9 +331,58 @@ void remote_connection::process_connected()
 }
 
 
+void remote_connection::connection_removed()
+{
+    tcp_client_permanent_message_connection::connection_removed();
+
+    f_server->unregister_connection(std::dynamic_pointer_cast<base_connection>(shared_from_this()));
+}
+
+
+/** \brief The output buffer of the connection was written.
+ *
+ * This is the time to send the next batch of bulk messages. If there
+ * are none, the default implementation runs (i.e. a connection marked
+ * as done gets removed).
+ */
+void remote_connection::process_empty_buffer()
+{
+    get_held_messages().end_batch();
+    if(!is_connected()
+    || !send_held_messages())
+    {
+        tcp_client_permanent_message_connection::process_empty_buffer();
+    }
+}
+
+
+/** \brief Send a message to the remote communicator daemon.
+ *
+ * The control messages are sent immediately. The other messages are
+ * sent immediately only if no bulk messages are being held and the
+ * current batch is not complete. Otherwise they are held until the
+ * output buffer is empty, unless the held messages reached their
+ * limits, in which case the overflow policy applies (see
+ * base_connection::hold_message()).
+ *
+ * When the connection is down, the eventdispatcher caches the message
+ * if \p cache is true and drops it otherwise.
+ *
+ * \param[in] msg  The message to send.
+ * \param[in] cache  Whether to cache the message while disconnected.
+ *
+ * \return true if the message was sent, held, or cached.
+ */
 bool remote_connection::send_message(ed::message & msg, bool cache)
 {
-    return tcp_client_permanent_message_connection::send_message(msg, cache);
+    if(!is_connected()
+    || is_priority_message(msg)
+    || get_held_messages().add_to_batch())
+    {
+        return send_to_link(msg, cache);
+    }
+
+    return hold_message(msg, cache);
 }
 
 
@@ -299,5 +392,75 @@ addr::addr const & remote_connection::get_address() const
 }
 
 
+/** \brief Send the next batch of held messages.
+ *
+ * Once no more messages are held, the slow consumer flag, if raised,
+ * gets taken down.
+ *
+ * \return true if at least one message was sent.
+ */
+bool remote_connection::send_held_messages()
+{
+    bool sent(false);
+    held_messages::held_message_t held;
+    while(get_held_messages().next(held))
+    {
+        send_to_link(held.f_message, held.f_cache);
+        sent = true;
+    }
+    if(get_held_messages().empty())
+    {
+        set_output_overflow(false);
+    }
+    return sent;
+}
+
+
+/** \brief Give one message to the eventdispatcher.
+ *
+ * When the link uses the compact framing, the message gets encoded
+ * first. While disconnected, the eventdispatcher may cache the message
+ * until the next connection, which may not use the same framing, so it
+ * is kept in text.
+ *
+ * The messages given to the eventdispatcher are written in that order,
+ * including the control messages, so they can all use the dynamic part
+ * of the dictionary when the link is compressed.
+ *
+ * \param[in] msg  The message to send.
+ * \param[in] cache  Whether to cache the message while disconnected.
+ *
+ * \return true if the message was sent or cached.
+ */
+bool remote_connection::send_to_link(ed::message & msg, bool cache)
+{
+    if(is_connected()
+    && get_link_codec().is_compact())
+    {
+        ed::message compact(get_link_codec().encode(msg));
+        return tcp_client_permanent_message_connection::send_message(compact, cache);
+    }
+
+    return tcp_client_permanent_message_connection::send_message(msg, cache);
+}
+
+
+/** \brief Give all the held messages to the eventdispatcher.
+ *
+ * When the connection is lost, the held messages go to the
+ * eventdispatcher which caches the ones that can be cached until
+ * the connection is back and drops the others, as it does with
+ * the messages sent while disconnected.
+ */
+void remote_connection::release_held_messages()
+{
+    for(auto & h : get_held_messages().release())
+    {
+        send_to_link(h.f_message, h.f_cache);
+    }
+    set_output_overflow(false);
+}
+
+
 } // namespace communicator_daemon
 // vim: ts=4 sw=4 et
@@ -67,11 +67,17 @@ public:
     virtual void                    process_message(ed::message & msg) override;
     virtual void                    process_connection_failed(std::string const & error_message) override;
     virtual void                    process_connected() override;
+    virtual void                    connection_removed() override;
+    virtual void                    process_empty_buffer() override;
     virtual bool                    send_message(ed::message & msg, bool cache = false);
 
     addr::addr const &              get_address() const;
 
 private:
+    bool                            send_to_link(ed::message & msg, bool cache);
+    bool                            send_held_messages();
+    void                            release_held_messages();
+
     addr::addr const                f_address;
     int                             f_failures = -1;
     time_t                          f_failure_start_time = 0;
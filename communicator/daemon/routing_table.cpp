@@ -0,0 +1,681 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the routing table.
+ *
+ * The routing table maps the name of a service to the connection of
+ * that service when it is registered on this computer and the name of
+ * a server to the connection of the communicator daemon running on
+ * that server.
+ *
+ * The table gets updated on REGISTER, UNREGISTER, CONNECT, ACCEPT, and
+ * DISCONNECT as well as when a connection gets removed from the
+ * ed::communicator. This way the forward_message() function does not
+ * have to search the entire list of connections for each message.
+ *
+ * The remote service directory is built from the "services" and
+ * "heard_of" parameters of the CONNECT and ACCEPT messages. It maps
+ * each service name to the remote communicator daemons hosting that
+ * service or which heard of it.
+ *
+ * A local service can have several instances (i.e. several processes
+ * registering with the same service name). The routing table keeps all
+ * of them and select_local_service() picks the one which receives the
+ * next message.
+ */
+
+// self
+//
+#include    "routing_table.h"
+
+#include    "base_connection.h"
+
+
+// C++
+//
+#include    <algorithm>
+#include    <functional>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+namespace
+{
+
+
+
+/** \brief Mix the bits of a 64 bit number.
+ *
+ * This is the finalizer of the SplitMix64 generator. It is used to
+ * compute the weight of an instance for a given shard key.
+ *
+ * \param[in] x  The number to mix.
+ *
+ * \return The mixed number.
+ */
+std::uint64_t mix64(std::uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+
+
+} // no name namespace
+
+
+
+/** \brief Convert the name of a delivery strategy.
+ *
+ * The REGISTER message accepts a "delivery" parameter which is one of
+ * "first", "round-robin", "least-outstanding", or "hash". Any other
+ * value, including an empty string, returns DELIVERY_FIRST.
+ *
+ * \param[in] delivery  The name of the delivery strategy.
+ *
+ * \return The corresponding delivery strategy.
+ */
+delivery_t string_to_delivery(std::string const & delivery)
+{
+    if(delivery == "round-robin")
+    {
+        return delivery_t::DELIVERY_ROUND_ROBIN;
+    }
+    if(delivery == "least-outstanding")
+    {
+        return delivery_t::DELIVERY_LEAST_OUTSTANDING;
+    }
+    if(delivery == "hash")
+    {
+        return delivery_t::DELIVERY_HASH;
+    }
+    return delivery_t::DELIVERY_FIRST;
+}
+
+
+/** \brief Add a local service to the routing table.
+ *
+ * This function is called when a service sends us a REGISTER message.
+ * The \p service name is then used to find the connection whenever a
+ * message is sent to that service.
+ *
+ * If other instances of that service are already registered, the new
+ * connection is added at the end of the list of instances. With the
+ * default delivery strategy, the first instance keeps receiving all
+ * the messages, which is the behavior of a service with one instance.
+ *
+ * \param[in] service  The name of the service that just registered.
+ * \param[in] conn  The connection of that service.
+ */
+void routing_table::add_local_service(
+      std::string const & service
+    , connection_pointer_t conn)
+{
+    local_service_t & local(f_local_services[service]);
+    remove_instance(local, connection_pointer_t());
+    for(auto const & i : local.f_instances)
+    {
+        if(i.f_connection.lock() == conn)
+        {
+            return;
+        }
+    }
+
+    local_instance_t instance;
+    instance.f_connection = conn;
+    instance.f_id = ++f_next_instance_id;
+    local.f_instances.push_back(instance);
+}
+
+
+/** \brief Remove a local service instance from the routing table.
+ *
+ * This function removes \p conn from the instances of \p service.
+ * The other instances are left alone. Once the last instance is
+ * removed, the service is forgotten.
+ *
+ * \param[in] service  The name of the service to remove.
+ * \param[in] conn  The connection which is unregistering.
+ */
+void routing_table::remove_local_service(
+      std::string const & service
+    , connection_pointer_t conn)
+{
+    auto it(f_local_services.find(service));
+    if(it == f_local_services.end())
+    {
+        return;
+    }
+
+    remove_instance(it->second, conn);
+    if(it->second.f_instances.empty())
+    {
+        f_local_services.erase(it);
+    }
+}
+
+
+/** \brief Search for a local service connection.
+ *
+ * When the service has several instances, the first live one is
+ * returned. Use select_local_service() to distribute messages.
+ *
+ * \param[in] service  The name of the service to search.
+ *
+ * \return The connection of that service or nullptr if not registered.
+ */
+routing_table::connection_pointer_t routing_table::find_local_service(std::string const & service) const
+{
+    auto it(f_local_services.find(service));
+    if(it == f_local_services.end())
+    {
+        return connection_pointer_t();
+    }
+
+    for(auto const & i : it->second.f_instances)
+    {
+        connection_pointer_t c(i.f_connection.lock());
+        if(c != nullptr)
+        {
+            return c;
+        }
+    }
+
+    return connection_pointer_t();
+}
+
+
+/** \brief Retrieve all the instances of a local service.
+ *
+ * \param[in] service  The name of the service to search.
+ *
+ * \return The live connections of that service, in registration order.
+ */
+routing_table::connection_vector_t routing_table::find_local_instances(std::string const & service) const
+{
+    connection_vector_t result;
+    auto it(f_local_services.find(service));
+    if(it != f_local_services.end())
+    {
+        for(auto const & i : it->second.f_instances)
+        {
+            connection_pointer_t c(i.f_connection.lock());
+            if(c != nullptr)
+            {
+                result.push_back(c);
+            }
+        }
+    }
+    return result;
+}
+
+
+/** \brief Retrieve the names of the services registered locally.
+ *
+ * Only the services with at least one live instance are returned.
+ * This is the list advertised to the remote communicator daemons.
+ *
+ * \return The names of the local services, sorted.
+ */
+std::vector<std::string> routing_table::get_local_service_names() const
+{
+    std::vector<std::string> result;
+    for(auto const & l : f_local_services)
+    {
+        if(std::any_of(
+                  l.second.f_instances.begin()
+                , l.second.f_instances.end()
+                , [](local_instance_t const & i) { return !i.f_connection.expired(); }))
+        {
+            result.push_back(l.first);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+
+/** \brief Define how messages get distributed between instances.
+ *
+ * The strategy applies to all the instances of \p service. It is
+ * generally defined by the REGISTER message of the first instance.
+ *
+ * \param[in] service  The name of a registered service.
+ * \param[in] delivery  The delivery strategy.
+ * \param[in] shard_parameter  With DELIVERY_HASH, the name of the
+ * message parameter used as the shard key.
+ */
+void routing_table::set_local_delivery(
+      std::string const & service
+    , delivery_t delivery
+    , std::string const & shard_parameter)
+{
+    auto it(f_local_services.find(service));
+    if(it == f_local_services.end())
+    {
+        return;
+    }
+
+    it->second.f_delivery = delivery;
+    it->second.f_shard_parameter = delivery == delivery_t::DELIVERY_HASH
+                                        ? shard_parameter
+                                        : std::string();
+}
+
+
+/** \brief Get the name of the parameter used to shard messages.
+ *
+ * \param[in] service  The name of the service.
+ *
+ * \return The name of the parameter or an empty string if the service
+ * does not use the DELIVERY_HASH strategy.
+ */
+std::string const & routing_table::get_shard_parameter(std::string const & service) const
+{
+    static std::string const g_empty;
+
+    auto it(f_local_services.find(service));
+    if(it == f_local_services.end())
+    {
+        return g_empty;
+    }
+
+    return it->second.f_shard_parameter;
+}
+
+
+/** \brief Select the instance which receives the next message.
+ *
+ * The selection depends on the delivery strategy of the service:
+ *
+ * * DELIVERY_FIRST -- the first live instance;
+ * * DELIVERY_ROUND_ROBIN -- each live instance in turn;
+ * * DELIVERY_LEAST_OUTSTANDING -- the instance with the fewest bytes
+ *   not yet sent (see base_connection::get_pending_output()), the round
+ *   robin order breaks ties;
+ * * DELIVERY_HASH -- the instance with the highest weight for
+ *   \p shard_value (rendezvous hashing), so the same key always goes to
+ *   the same instance and only the keys of an instance which goes away
+ *   get moved; without a shard value, this falls back to round robin.
+ *
+ * \param[in] service  The name of the service.
+ * \param[in] shard_value  The value of the shard parameter in the message.
+ *
+ * \return The selected connection or nullptr if the service is not
+ * registered.
+ */
+routing_table::connection_pointer_t routing_table::select_local_service(
+      std::string const & service
+    , std::string const & shard_value)
+{
+    auto it(f_local_services.find(service));
+    if(it == f_local_services.end())
+    {
+        return connection_pointer_t();
+    }
+
+    local_service_t & local(it->second);
+    remove_instance(local, connection_pointer_t());
+    std::size_t const count(local.f_instances.size());
+    if(count == 0)
+    {
+        return connection_pointer_t();
+    }
+
+    delivery_t delivery(local.f_delivery);
+    if(count == 1)
+    {
+        delivery = delivery_t::DELIVERY_FIRST;
+    }
+    else if(delivery == delivery_t::DELIVERY_HASH
+         && shard_value.empty())
+    {
+        delivery = delivery_t::DELIVERY_ROUND_ROBIN;
+    }
+
+    switch(delivery)
+    {
+    case delivery_t::DELIVERY_FIRST:
+        return local.f_instances.front().f_connection.lock();
+
+    case delivery_t::DELIVERY_ROUND_ROBIN:
+        local.f_next = (local.f_next + 1) % count;
+        return local.f_instances[local.f_next].f_connection.lock();
+
+    case delivery_t::DELIVERY_LEAST_OUTSTANDING:
+        {
+            local.f_next = (local.f_next + 1) % count;
+            connection_pointer_t best;
+            std::size_t best_count(0);
+            for(std::size_t idx(0); idx < count; ++idx)
+            {
+                connection_pointer_t c(local.f_instances[(local.f_next + idx) % count].f_connection.lock());
+                std::size_t const outstanding(c->get_pending_output());
+                if(best == nullptr
+                || outstanding < best_count)
+                {
+                    best = c;
+                    best_count = outstanding;
+                }
+            }
+            return best;
+        }
+
+    case delivery_t::DELIVERY_HASH:
+        {
+            std::uint64_t const key(std::hash<std::string>()(shard_value));
+            local_instance_t const * best(nullptr);
+            std::uint64_t best_weight(0);
+            for(auto const & i : local.f_instances)
+            {
+                std::uint64_t const weight(mix64(key ^ mix64(i.f_id)));
+                if(best == nullptr
+                || weight > best_weight)
+                {
+                    best = &i;
+                    best_weight = weight;
+                }
+            }
+            return best->f_connection.lock();
+        }
+
+    }
+
+    return connection_pointer_t();
+}
+
+
+/** \brief Add a remote communicator daemon to the routing table.
+ *
+ * When a CONNECT or an ACCEPT is received, we know the name of the
+ * server on the other side of that connection. This function saves
+ * that name so messages sent to a specific server can directly be
+ * sent to the corresponding communicator daemon.
+ *
+ * \param[in] server_name  The name of the remote server.
+ * \param[in] conn  The connection to that remote server.
+ */
+void routing_table::add_remote_server(
+      std::string const & server_name
+    , connection_pointer_t conn)
+{
+    if(server_name.empty())
+    {
+        return;
+    }
+
+    f_remote_servers[server_name] = conn;
+}
+
+
+/** \brief Search for the connection to a remote server.
+ *
+ * \param[in] server_name  The name of the remote server.
+ *
+ * \return The connection to that server or nullptr if not connected.
+ */
+routing_table::connection_pointer_t routing_table::find_remote_server(std::string const & server_name) const
+{
+    auto it(f_remote_servers.find(server_name));
+    if(it == f_remote_servers.end())
+    {
+        return connection_pointer_t();
+    }
+
+    return it->second.lock();
+}
+
+
+/** \brief Retrieve all the connections to remote communicator daemons.
+ *
+ * This function returns a vector with all the live connections to
+ * other communicator daemons. This is used when a message has to be
+ * sent to any one of the remote servers.
+ *
+ * \return A vector of remote connections.
+ */
+routing_table::connection_vector_t routing_table::get_remote_connections() const
+{
+    connection_vector_t result;
+    result.reserve(f_remote_servers.size());
+    for(auto const & r : f_remote_servers)
+    {
+        connection_pointer_t c(r.second.lock());
+        if(c != nullptr)
+        {
+            result.push_back(c);
+        }
+    }
+    return result;
+}
+
+
+/** \brief Save the services offered by a remote communicator daemon.
+ *
+ * This function is called after we received a CONNECT, an ACCEPT or
+ * a SERVICES message from a remote communicator daemon. The services
+ * and heard of services of that connection are saved in the directory.
+ * Any previous entries for that connection are first removed, so a
+ * service which went away does not keep a stale entry.
+ *
+ * \param[in] conn  The connection to the remote communicator daemon.
+ */
+void routing_table::set_remote_services(connection_pointer_t conn)
+{
+    if(conn == nullptr)
+    {
+        return;
+    }
+
+    remove_peer(f_remote_hosts, conn);
+    remove_peer(f_remote_heard_of, conn);
+
+    advgetopt::string_set_t services;
+    conn->get_services(services);
+    for(auto const & s : services)
+    {
+        f_remote_hosts[s].push_back(conn);
+    }
+
+    advgetopt::string_set_t heard_of;
+    conn->get_services_heard_of(heard_of);
+    for(auto const & s : heard_of)
+    {
+        f_remote_heard_of[s].push_back(conn);
+    }
+}
+
+
+/** \brief Search the remote communicator daemons offering \p service.
+ *
+ * This function returns the list of live connections to remote
+ * communicator daemons which host the specified \p service. If no
+ * such daemon is known, then it returns the daemons which heard of
+ * that service since they can forward the message further.
+ *
+ * When the directory has no live entry for that service, the function
+ * returns an empty vector. The caller is expected to then fall back
+ * to sending the message to all the remote communicator daemons.
+ *
+ * \param[in] service  The name of the service to search.
+ *
+ * \return A vector of remote connections, possibly empty.
+ */
+routing_table::connection_vector_t routing_table::find_remote_service(std::string const & service) const
+{
+    connection_vector_t result(live_peers(f_remote_hosts, service));
+    if(result.empty())
+    {
+        result = live_peers(f_remote_heard_of, service);
+    }
+    return result;
+}
+
+
+/** \brief Remove all the routes going through \p conn.
+ *
+ * This function is called whenever a connection is lost, a remote
+ * communicator daemon sends a DISCONNECT, or the connection gets
+ * removed from the ed::communicator.
+ *
+ * \param[in] conn  The connection being removed.
+ */
+void routing_table::remove_connection(connection_pointer_t conn)
+{
+    for(auto it(f_local_services.begin()); it != f_local_services.end(); )
+    {
+        remove_instance(it->second, conn);
+        if(it->second.f_instances.empty())
+        {
+            it = f_local_services.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for(auto it(f_remote_servers.begin()); it != f_remote_servers.end(); )
+    {
+        connection_pointer_t const c(it->second.lock());
+        if(c == nullptr
+        || c == conn)
+        {
+            it = f_remote_servers.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    remove_peer(f_remote_hosts, conn);
+    remove_peer(f_remote_heard_of, conn);
+}
+
+
+/** \brief Remove an instance from a local service.
+ *
+ * This function removes \p conn and any expired connection from the
+ * instances of \p local. The round robin position is adjusted so it
+ * remains valid.
+ *
+ * \param[in,out] local  The local service to clean up.
+ * \param[in] conn  The connection being removed or nullptr to only
+ * remove the expired connections.
+ */
+void routing_table::remove_instance(local_service_t & local, connection_pointer_t conn)
+{
+    local.f_instances.erase(
+          std::remove_if(
+                  local.f_instances.begin()
+                , local.f_instances.end()
+                , [&conn](auto const & i)
+                {
+                    connection_pointer_t const c(i.f_connection.lock());
+                    return c == nullptr || c == conn;
+                })
+        , local.f_instances.end());
+    if(local.f_next >= local.f_instances.size())
+    {
+        local.f_next = 0;
+    }
+}
+
+
+/** \brief Remove a peer from a directory.
+ *
+ * This function removes \p conn and any expired connection from all
+ * the entries of \p directory. Services which end up without any
+ * peer are removed.
+ *
+ * \param[in,out] directory  The directory to clean up.
+ * \param[in] conn  The connection being removed.
+ */
+void routing_table::remove_peer(directory_t & directory, connection_pointer_t conn)
+{
+    for(auto it(directory.begin()); it != directory.end(); )
+    {
+        peer_vector_t & peers(it->second);
+        peers.erase(
+              std::remove_if(
+                      peers.begin()
+                    , peers.end()
+                    , [&conn](auto const & p)
+                    {
+                        connection_pointer_t const c(p.lock());
+                        return c == nullptr || c == conn;
+                    })
+            , peers.end());
+        if(peers.empty())
+        {
+            it = directory.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+
+/** \brief Get the live peers of a service in \p directory.
+ *
+ * \param[in] directory  The directory to search.
+ * \param[in] service  The name of the service.
+ *
+ * \return The list of live connections found for that service.
+ */
+routing_table::connection_vector_t routing_table::live_peers(
+      directory_t const & directory
+    , std::string const & service)
+{
+    connection_vector_t result;
+    auto it(directory.find(service));
+    if(it != directory.end())
+    {
+        for(auto const & p : it->second)
+        {
+            connection_pointer_t c(p.lock());
+            if(c != nullptr)
+            {
+                result.push_back(c);
+            }
+        }
+    }
+    return result;
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
@@ -0,0 +1,144 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the routing table.
+ *
+ * The Communicator forwards most of the messages it receives to a local
+ * service or a remote communicator daemon. The routing table is used to
+ * find the destination connection without having to go through the
+ * entire list of connections.
+ *
+ * It also includes a directory of the services offered by the remote
+ * communicator daemons so a message sent to a service running on
+ * another computer is forwarded only to the daemons which know about
+ * that service.
+ *
+ * Several instances of the same service can register on one computer.
+ * The messages are then distributed between those instances using the
+ * delivery strategy the service requested.
+ */
+
+// C++
+//
+#include    <cstdint>
+#include    <memory>
+#include    <string>
+#include    <unordered_map>
+#include    <vector>
+
+
+
+namespace communicator_daemon
+{
+
+
+class base_connection;
+
+
+enum class delivery_t
+{
+    DELIVERY_FIRST,                 // the first registered instance gets all the messages
+    DELIVERY_ROUND_ROBIN,           // each instance in turn
+    DELIVERY_LEAST_OUTSTANDING,     // the instance with the fewest bytes not yet sent
+    DELIVERY_HASH,                  // consistent hash of a message parameter
+};
+
+
+delivery_t                  string_to_delivery(std::string const & delivery);
+
+
+class routing_table
+{
+public:
+    typedef std::shared_ptr<base_connection>    connection_pointer_t;
+    typedef std::vector<connection_pointer_t>   connection_vector_t;
+
+    void                    add_local_service(
+                                  std::string const & service
+                                , connection_pointer_t conn);
+    void                    remove_local_service(
+                                  std::string const & service
+                                , connection_pointer_t conn);
+    connection_pointer_t    find_local_service(std::string const & service) const;
+    connection_vector_t     find_local_instances(std::string const & service) const;
+    std::vector<std::string>
+                            get_local_service_names() const;
+    void                    set_local_delivery(
+                                  std::string const & service
+                                , delivery_t delivery
+                                , std::string const & shard_parameter = std::string());
+    std::string const &     get_shard_parameter(std::string const & service) const;
+    connection_pointer_t    select_local_service(
+                                  std::string const & service
+                                , std::string const & shard_value = std::string());
+
+    void                    add_remote_server(
+                                  std::string const & server_name
+                                , connection_pointer_t conn);
+    connection_pointer_t    find_remote_server(std::string const & server_name) const;
+    connection_vector_t     get_remote_connections() const;
+
+    void                    set_remote_services(connection_pointer_t conn);
+    connection_vector_t     find_remote_service(std::string const & service) const;
+
+    void                    remove_connection(connection_pointer_t conn);
+
+private:
+    struct local_instance_t
+    {
+        std::weak_ptr<base_connection>
+                                f_connection = std::weak_ptr<base_connection>();
+        std::uint64_t           f_id = 0;
+    };
+
+    struct local_service_t
+    {
+        std::vector<local_instance_t>
+                                f_instances = std::vector<local_instance_t>();
+        delivery_t              f_delivery = delivery_t::DELIVERY_FIRST;
+        std::string             f_shard_parameter = std::string();
+        std::size_t             f_next = 0;
+    };
+
+    typedef std::unordered_map<std::string, local_service_t>
+                                                local_map_t;
+    typedef std::unordered_map<std::string, std::weak_ptr<base_connection>>
+                                                route_map_t;
+    typedef std::vector<std::weak_ptr<base_connection>>
+                                                peer_vector_t;
+    typedef std::unordered_map<std::string, peer_vector_t>
+                                                directory_t;
+
+    static void             remove_instance(local_service_t & local, connection_pointer_t conn);
+    static void             remove_peer(directory_t & directory, connection_pointer_t conn);
+    static connection_vector_t
+                            live_peers(directory_t const & directory, std::string const & service);
+
+    local_map_t             f_local_services = local_map_t();   // service name -> local service instances
+    std::uint64_t           f_next_instance_id = 0;
+    route_map_t             f_remote_servers = route_map_t();   // server name -> remote communicator daemon connection
+    directory_t             f_remote_hosts = directory_t();     // service name -> remote daemons running that service
+    directory_t             f_remote_heard_of = directory_t();  // service name -> remote daemons which heard of that service
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
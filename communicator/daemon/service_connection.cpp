@@ -36,6 +36,11 @@
 #include    <communicator/names.h>
 
 
+// snaplogger
+//
+#include    <snaplogger/message.h>
+
+
 // last include
 //
 #include    <snapdev/poison.h>
@@ -110,7 +115,7 @@ service_connection::service_connection(
           , ed::tcp_bio_client::pointer_t client
           , std::string const & server_name)
     : tcp_server_client_message_connection(client)
-    , base_connection(s, false)
+    , base_connection(s, connection_kind_t::CONNECTION_KIND_SERVICE)
     , f_server_name(server_name)
     , f_address(client->get_remote_address())  // peer address:port (IP of computer on the other side)
 {
@@ -177,8 +182,56 @@ int service_connection::get_socket() const
 }
 
 
+/** \brief Process a line received from the service.
+ *
+ * Before parsing the whole message, we give the communicatord a chance
+ * to forward it as is to another local service. This saves a full parse
+ * and serialization of the message in the most common case.
+ *
+ * If the message cannot be forwarded that way, the normal processing
+ * happens (i.e. parse the message and call process_message()).
+ *
+ * \param[in] line  The line received from the service.
+ */
+void service_connection::process_line(std::string const & line)
+{
+    // remote communicator daemons send messages that we need to parse
+    //
+    if(!is_remote())
+    {
+        base_connection::pointer_t conn(std::static_pointer_cast<service_connection>(shared_from_this()));
+        if(f_server->forward_raw_message(
+                  conn
+                , line
+                , f_named ? f_server_name : std::string()
+                , f_named ? get_name() : std::string()))
+        {
+            return;
+        }
+    }
+
+    tcp_server_client_message_connection::process_line(line);
+}
+
+
 void service_connection::process_message(ed::message & msg)
 {
+    // the link with another communicator daemon may use the compact
+    // framing
+    //
+    if(get_link_codec().is_decoding()
+    && !get_link_codec().decode(msg))
+    {
+        SNAP_LOG_ERROR
+            << "message \""
+            << msg.to_message()
+            << "\" received from \""
+            << get_server_name()
+            << "\" includes an invalid interned name identifier or dictionary reference."
+            << SNAP_LOG_SEND;
+        return;
+    }
+
     // make sure the destination knows who sent that message so it
     // is possible to directly reply to that specific instance of
     // a service
@@ -196,12 +249,169 @@ void service_connection::process_message(ed::message & msg)
 }
 
 
+/** \brief Send a message to this connection.
+ *
+ * When the output coalescing is turned on, the message is encoded and
+ * added to the output queue. It gets written along the other messages
+ * sent within this event loop iteration.
+ *
+ * On a link with another communicator daemon using the compact framing,
+ * the well known names get replaced by their identifier first. The lane
+ * of the message still depends on its original command. When that link
+ * is also compressed, the messages of the priority lane only use the
+ * preset dictionary since they get written ahead of the queued messages
+ * which may define the other entries. A message refused by a full queue
+ * is refused before it gets compressed so the dictionaries remain in
+ * sync.
+ *
+ * The encrypted connections cannot use the output queue. They write
+ * their bulk messages in batches instead, like the remote_connection,
+ * so the control messages wait behind at most one batch. The held
+ * messages are limited like the output queue.
+ *
+ * \param[in] msg  The message to send.
+ * \param[in] cache  Whether the message can be cached (ignored here).
+ *
+ * \return true if the message was sent, queued, or held.
+ */
 bool service_connection::send_message(ed::message & msg, bool cache)
 {
+    if(has_bulk_batches()
+    && !is_priority_message(msg)
+    && !get_held_messages().add_to_batch())
+    {
+        return hold_message(msg, cache);
+    }
+
+    return send_to_link(msg, cache);
+}
+
+
+/** \brief Give one message to the connection.
+ *
+ * \param[in] msg  The message to send.
+ * \param[in] cache  Whether the message can be cached (ignored here).
+ *
+ * \return true if the message was sent or queued.
+ */
+bool service_connection::send_to_link(ed::message & msg, bool cache)
+{
+    if(get_link_codec().is_compact())
+    {
+        if(is_output_coalescing())
+        {
+            bool const priority(is_priority_message(msg));
+            if(!make_room_for_output(priority))
+            {
+                return false;
+            }
+            ed::message compact(get_link_codec().encode(msg, priority));
+            return send_raw_message(encode_message(compact), priority);
+        }
+        ed::message compact(get_link_codec().encode(msg));
+        return tcp_server_client_message_connection::send_message(compact, cache);
+    }
+
+    if(is_output_coalescing())
+    {
+        return send_stream_message(msg);
+    }
+
     return tcp_server_client_message_connection::send_message(msg, cache);
 }
 
 
+/** \brief Check whether we have data to write.
+ *
+ * The messages may be waiting in the output queue or in the output
+ * buffer of the connection.
+ *
+ * \return true if the connection has data to write.
+ */
+bool service_connection::is_writer() const
+{
+    return has_queued_output()
+        || tcp_server_client_message_connection::is_writer();
+}
+
+
+/** \brief Write the output queue and buffer.
+ *
+ * The output queue is written first with a single system call. If the
+ * socket does not accept all the data, we wait for the next event loop
+ * iteration.
+ */
+void service_connection::process_write()
+{
+    if(has_queued_output())
+    {
+        if(!flush_output())
+        {
+            process_error();
+            return;
+        }
+        if(has_queued_output())
+        {
+            return;
+        }
+    }
+
+    if(tcp_server_client_message_connection::is_writer())
+    {
+        tcp_server_client_message_connection::process_write();
+    }
+    else
+    {
+        // the buffer connection calls this function once its buffer
+        // is empty, we need to do the same for the output queue
+        // (i.e. this is how connections marked as done get removed)
+        //
+        process_empty_buffer();
+    }
+}
+
+
+
+/** \brief The output buffer of the connection was written.
+ *
+ * On a connection writing its bulk messages in batches, this is the
+ * time to send the next batch. If there are none, the default
+ * implementation runs (i.e. a connection marked as done gets removed).
+ */
+void service_connection::process_empty_buffer()
+{
+    get_held_messages().end_batch();
+    if(!has_bulk_batches()
+    || !send_held_messages())
+    {
+        tcp_server_client_message_connection::process_empty_buffer();
+    }
+}
+
+
+/** \brief Send the next batch of held messages.
+ *
+ * Once no more messages are held, the slow consumer flag, if raised,
+ * gets taken down.
+ *
+ * \return true if at least one message was sent.
+ */
+bool service_connection::send_held_messages()
+{
+    bool sent(false);
+    held_messages::held_message_t held;
+    while(get_held_messages().next(held))
+    {
+        send_to_link(held.f_message, held.f_cache);
+        sent = true;
+    }
+    if(get_held_messages().empty())
+    {
+        set_output_overflow(false);
+    }
+    return sent;
+}
+
 
 /** \brief We are losing the connection, send a STATUS message.
  *
@@ -284,6 +494,8 @@ void service_connection::connection_removed()
 {
     tcp_server_client_message_connection::connection_removed();
 
+    f_server->unregister_connection(std::dynamic_pointer_cast<base_connection>(shared_from_this()));
+
     if(is_remote())
     {
         addr::addr remote_addr(get_address());
@@ -55,8 +55,12 @@ public:
     virtual int         get_socket() const;
 
     // ed::tcp_server_client_message_connection implementation
+    virtual void        process_line(std::string const & line) override;
     virtual void        process_message(ed::message & msg) override;
     virtual bool        send_message(ed::message & msg, bool cache = false) override;
+    virtual bool        is_writer() const override;
+    virtual void        process_write() override;
+    virtual void        process_empty_buffer() override;
     virtual void        process_timeout() override;
     virtual void        process_error() override;
     virtual void        process_hup() override;
@@ -69,6 +73,9 @@ public:
     void                block_ip();
 
 private:
+    bool                send_to_link(ed::message & msg, bool cache);
+    bool                send_held_messages();
+
     std::string const   f_server_name;
     addr::addr          f_address = addr::addr();
     bool                f_named = false;
@@ -0,0 +1,359 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the topic_matcher class.
+ *
+ * The patterns are compiled in a tree where each level represents one
+ * name of the topic. A node has one child per literal name, a child for
+ * the "*" wildcard, and a flag for the "#" wildcard. Matching a topic
+ * walks the tree, one name at a time, without allocating memory.
+ *
+ * The same pattern can be added several times (i.e. by several
+ * subscribers). A reference counter is kept for each pattern and the
+ * pattern is only removed once that counter reaches zero. The tree is
+ * rebuilt when the set of patterns changes, which is rare compared to
+ * the number of topics matched.
+ */
+
+// self
+//
+#include    "topic_matcher.h"
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+namespace
+{
+
+
+
+bool is_valid_name_char(char c)
+{
+    return (c >= 'a' && c <= 'z')
+        || (c >= 'A' && c <= 'Z')
+        || (c >= '0' && c <= '9')
+        || c == '_'
+        || c == '-';
+}
+
+
+/** \brief Verify a topic or a pattern.
+ *
+ * \param[in] name  The topic or pattern to verify.
+ * \param[in] wildcards  Whether "*" and a final "#" are accepted.
+ *
+ * \return true if \p name is valid.
+ */
+bool is_valid(std::string const & name, bool wildcards)
+{
+    if(name.empty())
+    {
+        return false;
+    }
+
+    std::string_view n(name);
+    for(;;)
+    {
+        std::string_view::size_type const pos(n.find('.'));
+        std::string_view const segment(n.substr(0, pos));
+        if(segment.empty())
+        {
+            return false;
+        }
+        if(wildcards
+        && (segment == "*" || segment == "#"))
+        {
+            if(segment == "#"
+            && pos != std::string_view::npos)
+            {
+                // "#" is only accepted as the last name
+                //
+                return false;
+            }
+        }
+        else
+        {
+            for(char const c : segment)
+            {
+                if(!is_valid_name_char(c))
+                {
+                    return false;
+                }
+            }
+        }
+        if(pos == std::string_view::npos)
+        {
+            return true;
+        }
+        n.remove_prefix(pos + 1);
+    }
+}
+
+
+
+} // no name namespace
+
+
+
+struct topic_matcher::node_t
+{
+    std::map<std::string, std::unique_ptr<node_t>, std::less<>>
+                                f_children = std::map<std::string, std::unique_ptr<node_t>, std::less<>>();
+    std::unique_ptr<node_t>     f_any = std::unique_ptr<node_t>();      // "*"
+    bool                        f_rest = false;                         // "#"
+    bool                        f_end = false;
+
+    bool match(std::string_view topic) const
+    {
+        if(f_rest)
+        {
+            return true;
+        }
+        if(topic.empty())
+        {
+            return f_end;
+        }
+
+        std::string_view::size_type const pos(topic.find('.'));
+        std::string_view const segment(topic.substr(0, pos));
+        std::string_view const rest(pos == std::string_view::npos
+                                        ? std::string_view()
+                                        : topic.substr(pos + 1));
+        auto it(f_children.find(segment));
+        if(it != f_children.end()
+        && it->second->match(rest))
+        {
+            return true;
+        }
+        return f_any != nullptr
+            && f_any->match(rest);
+    }
+};
+
+
+topic_matcher::topic_matcher()
+    : f_root(std::make_unique<node_t>())
+{
+}
+
+
+topic_matcher::topic_matcher(topic_matcher const & rhs)
+    : f_patterns(rhs.f_patterns)
+    , f_root(std::make_unique<node_t>())
+{
+    compile();
+}
+
+
+topic_matcher::~topic_matcher()
+{
+}
+
+
+topic_matcher & topic_matcher::operator = (topic_matcher const & rhs)
+{
+    if(this != &rhs)
+    {
+        f_patterns = rhs.f_patterns;
+        compile();
+    }
+    return *this;
+}
+
+
+/** \brief Check whether a subscription pattern is valid.
+ *
+ * A pattern is a list of names separated by periods. A name is composed
+ * of letters, digits, underscores, and dashes. A name can also be "*"
+ * and the last name can be "#".
+ *
+ * \param[in] pattern  The pattern to check.
+ *
+ * \return true if the pattern is valid.
+ */
+bool topic_matcher::is_valid_pattern(std::string const & pattern)
+{
+    return is_valid(pattern, true);
+}
+
+
+/** \brief Check whether a topic is valid.
+ *
+ * A topic is a pattern without wildcards.
+ *
+ * \param[in] topic  The topic to check.
+ *
+ * \return true if the topic is valid.
+ */
+bool topic_matcher::is_valid_topic(std::string const & topic)
+{
+    return is_valid(topic, false);
+}
+
+
+/** \brief Add a pattern.
+ *
+ * \param[in] pattern  A valid pattern.
+ *
+ * \return true if the pattern was not yet defined.
+ */
+bool topic_matcher::add(std::string const & pattern)
+{
+    if(!is_valid_pattern(pattern))
+    {
+        return false;
+    }
+
+    if(++f_patterns[pattern] != 1)
+    {
+        return false;
+    }
+
+    compile();
+    return true;
+}
+
+
+/** \brief Remove a pattern.
+ *
+ * \param[in] pattern  The pattern to remove.
+ *
+ * \return true if the pattern is not defined anymore.
+ */
+bool topic_matcher::remove(std::string const & pattern)
+{
+    auto it(f_patterns.find(pattern));
+    if(it == f_patterns.end())
+    {
+        return false;
+    }
+
+    --it->second;
+    if(it->second != 0)
+    {
+        return false;
+    }
+
+    f_patterns.erase(it);
+    compile();
+    return true;
+}
+
+
+void topic_matcher::clear()
+{
+    f_patterns.clear();
+    compile();
+}
+
+
+bool topic_matcher::empty() const
+{
+    return f_patterns.empty();
+}
+
+
+bool topic_matcher::has_pattern(std::string const & pattern) const
+{
+    return f_patterns.find(pattern) != f_patterns.end();
+}
+
+
+/** \brief Get the list of patterns.
+ *
+ * \return The patterns, each one listed once, in alphabetical order.
+ */
+std::vector<std::string> topic_matcher::get_patterns() const
+{
+    std::vector<std::string> result;
+    result.reserve(f_patterns.size());
+    for(auto const & p : f_patterns)
+    {
+        result.push_back(p.first);
+    }
+    return result;
+}
+
+
+/** \brief Check whether a topic matches one of the patterns.
+ *
+ * \param[in] topic  The topic of a message.
+ *
+ * \return true if at least one pattern matches \p topic.
+ */
+bool topic_matcher::match(std::string const & topic) const
+{
+    return !f_patterns.empty()
+        && f_root->match(topic);
+}
+
+
+void topic_matcher::compile()
+{
+    f_root = std::make_unique<node_t>();
+    for(auto const & p : f_patterns)
+    {
+        node_t * n(f_root.get());
+        std::string_view pattern(p.first);
+        for(;;)
+        {
+            std::string_view::size_type const pos(pattern.find('.'));
+            std::string_view const segment(pattern.substr(0, pos));
+            if(segment == "#")
+            {
+                n->f_rest = true;
+                break;
+            }
+            std::unique_ptr<node_t> * child(nullptr);
+            if(segment == "*")
+            {
+                child = &n->f_any;
+            }
+            else
+            {
+                child = &n->f_children[std::string(segment)];
+            }
+            if(*child == nullptr)
+            {
+                *child = std::make_unique<node_t>();
+            }
+            n = child->get();
+            if(pos == std::string_view::npos)
+            {
+                n->f_end = true;
+                break;
+            }
+            pattern.remove_prefix(pos + 1);
+        }
+    }
+}
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
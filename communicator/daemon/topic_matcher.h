@@ -0,0 +1,77 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the topic_matcher class.
+ *
+ * A topic is a list of names separated by periods such as
+ * "images.resize.done". A subscription is a pattern which can use
+ * "*" to match exactly one name and "#" as the last name to match
+ * any number of names (including none).
+ */
+
+// C++
+//
+#include    <map>
+#include    <memory>
+#include    <string>
+#include    <string_view>
+#include    <vector>
+
+
+
+namespace communicator_daemon
+{
+
+
+
+class topic_matcher
+{
+public:
+                                topic_matcher();
+                                topic_matcher(topic_matcher const & rhs);
+                                ~topic_matcher();
+
+    topic_matcher &             operator = (topic_matcher const & rhs);
+
+    static bool                 is_valid_pattern(std::string const & pattern);
+    static bool                 is_valid_topic(std::string const & topic);
+
+    bool                        add(std::string const & pattern);
+    bool                        remove(std::string const & pattern);
+    void                        clear();
+    bool                        empty() const;
+    bool                        has_pattern(std::string const & pattern) const;
+    std::vector<std::string>    get_patterns() const;
+    bool                        match(std::string const & topic) const;
+
+private:
+    struct node_t;
+
+    void                        compile();
+
+    std::map<std::string, std::size_t>
+                                f_patterns = std::map<std::string, std::size_t>();    // pattern -> reference count
+    std::unique_ptr<node_t>     f_root;
+};
+
+
+
+} // namespace communicator_daemon
+// vim: ts=4 sw=4 et
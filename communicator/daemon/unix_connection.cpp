@@ -81,7 +81,7 @@ unix_connection::unix_connection(
         , snapdev::raii_fd_t client
         , std::string const & server_name)
     : local_stream_server_client_message_connection(std::move(client))
-    , base_connection(s, false)
+    , base_connection(s, connection_kind_t::CONNECTION_KIND_UNIX)
     , f_server_name(server_name)
 {
 }
@@ -135,6 +135,33 @@ int unix_connection::get_socket() const
 }
 
 
+/** \brief Process a line received from the service.
+ *
+ * Before parsing the whole message, we give the communicatord a chance
+ * to forward it as is to another local service. This saves a full parse
+ * and serialization of the message in the most common case.
+ *
+ * If the message cannot be forwarded that way, the normal processing
+ * happens (i.e. parse the message and call process_message()).
+ *
+ * \param[in] line  The line received from the service.
+ */
+void unix_connection::process_line(std::string const & line)
+{
+    base_connection::pointer_t conn(std::static_pointer_cast<unix_connection>(shared_from_this()));
+    if(f_server->forward_raw_message(
+              conn
+            , line
+            , f_named ? f_server_name : std::string()
+            , f_named ? get_name() : std::string()))
+    {
+        return;
+    }
+
+    local_stream_server_client_message_connection::process_line(line);
+}
+
+
 void unix_connection::process_message(ed::message & msg)
 {
     // make sure the destination knows who sent that message so it
@@ -153,6 +180,78 @@ void unix_connection::process_message(ed::message & msg)
 }
 
 
+/** \brief Send a message to this connection.
+ *
+ * When the output coalescing is turned on, the message is encoded and
+ * added to the output queue. It gets written along the other messages
+ * sent within this event loop iteration.
+ *
+ * \param[in] msg  The message to send.
+ * \param[in] cache  Whether the message can be cached (ignored here).
+ *
+ * \return true if the message was sent or queued.
+ */
+bool unix_connection::send_message(ed::message & msg, bool cache)
+{
+    if(is_output_coalescing())
+    {
+        return send_stream_message(msg);
+    }
+
+    return local_stream_server_client_message_connection::send_message(msg, cache);
+}
+
+
+/** \brief Check whether we have data to write.
+ *
+ * The messages may be waiting in the output queue or in the output
+ * buffer of the connection.
+ *
+ * \return true if the connection has data to write.
+ */
+bool unix_connection::is_writer() const
+{
+    return has_queued_output()
+        || local_stream_server_client_message_connection::is_writer();
+}
+
+
+/** \brief Write the output queue and buffer.
+ *
+ * The output queue is written first with a single system call. If the
+ * socket does not accept all the data, we wait for the next event loop
+ * iteration.
+ */
+void unix_connection::process_write()
+{
+    if(has_queued_output())
+    {
+        if(!flush_output())
+        {
+            process_error();
+            return;
+        }
+        if(has_queued_output())
+        {
+            return;
+        }
+    }
+
+    if(local_stream_server_client_message_connection::is_writer())
+    {
+        local_stream_server_client_message_connection::process_write();
+    }
+    else
+    {
+        // the buffer connection calls this function once its buffer
+        // is empty, we need to do the same for the output queue
+        // (i.e. this is how connections marked as done get removed)
+        //
+        process_empty_buffer();
+    }
+}
+
+
 /** \brief We are losing the connection, send a STATUS message.
  *
  * This function is called in all cases where the connection is
@@ -230,6 +329,14 @@ void unix_connection::process_invalid()
 }
 
 
+void unix_connection::connection_removed()
+{
+    local_stream_server_client_message_connection::connection_removed();
+
+    f_server->unregister_connection(std::dynamic_pointer_cast<base_connection>(shared_from_this()));
+}
+
+
 /** \brief Tell that the connection was given a real name.
  *
  * Whenever we receive an event through this connection,
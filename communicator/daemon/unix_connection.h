@@ -58,13 +58,18 @@ public:
 
     // local_stream_server_client_message_connection implementation
     //
+    virtual void        process_line(std::string const & line) override;
     virtual void        process_message(ed::message & msg) override;
+    virtual bool        send_message(ed::message & msg, bool cache = false) override;
+    virtual bool        is_writer() const override;
+    virtual void        process_write() override;
 
     void                send_status();
     virtual void        process_timeout() override;
     virtual void        process_error() override;
     virtual void        process_hup() override;
     virtual void        process_invalid() override;
+    virtual void        connection_removed() override;
     void                properly_named();
 
 private:
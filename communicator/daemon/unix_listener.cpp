@@ -130,6 +130,8 @@ void unix_listener::process_accept()
     service->set_name("client unix connection");
 
     service->set_server_name(f_server_name);
+    service->set_output_coalescing(f_server->get_output_coalescing());
+    f_server->apply_output_limits(service);
 
     if(!ed::communicator::instance()->add_connection(service))
     {
@@ -140,8 +142,10 @@ void unix_listener::process_accept()
             << "new client connection could not be added to the ed::communicator list of connections."
             << SNAP_LOG_SEND;
     }
-else
-SNAP_LOG_FATAL << "client unix connection was added to the ed::communicator" << SNAP_LOG_SEND;
+    else
+    {
+        f_server->register_connection(service);
+    }
 }
 
 
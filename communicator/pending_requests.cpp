@@ -0,0 +1,372 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Implementation of the pending_requests class.
+ *
+ * A request is a message which expects a reply. The sender adds a
+ * "correlation_id" parameter to the request. The replier copies that
+ * identifier in the "in_reply_to" parameter of its reply (see
+ * set_reply()). When the reply arrives, complete() finds the request
+ * and calls its callback directly, the dispatcher is not involved.
+ *
+ * Each request also has a deadline. The owner of the pending_requests
+ * object calls expire() once the next_deadline() is reached and the
+ * callbacks of the requests which did not receive a reply in time get
+ * called with REQUEST_STATUS_TIMEOUT.
+ *
+ * A status waiter is a request without a message. It gets completed
+ * by the first STATUS message reporting that its service reached the
+ * expected status (see status_changed()). It times out and gets canceled
+ * like the other requests.
+ *
+ * The dates are in microseconds, like the ed::timer dates.
+ */
+
+// self
+//
+#include    "communicator/pending_requests.h"
+
+#include    "communicator/names.h"
+
+
+// snaplogger
+//
+#include    <snaplogger/message.h>
+
+
+// C++
+//
+#include    <vector>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace communicator
+{
+
+
+
+/** \brief Add a request.
+ *
+ * This function saves the \p callback and returns the identifier
+ * to attach to the request with set_correlation_id().
+ *
+ * \param[in] callback  The function called with the reply or on timeout.
+ * \param[in] deadline  The date, in microseconds, when the request times out.
+ *
+ * \return The identifier of the new request.
+ */
+pending_requests::request_id_t pending_requests::add(
+      reply_callback_t const & callback
+    , std::int64_t deadline)
+{
+    ++f_next_id;
+    if(f_next_id == REQUEST_ID_NONE)
+    {
+        ++f_next_id;
+    }
+
+    request_t request;
+    request.f_callback = callback;
+    request.f_deadline = deadline;
+    f_requests[f_next_id] = request;
+    f_deadlines.insert(std::make_pair(deadline, f_next_id));
+
+    return f_next_id;
+}
+
+
+/** \brief Add a status waiter.
+ *
+ * The \p callback gets called with REQUEST_STATUS_REPLY and the STATUS
+ * message the first time status_changed() receives a message saying
+ * that \p service has \p status. Like a request, it gets called with
+ * REQUEST_STATUS_TIMEOUT once \p deadline is reached and with
+ * REQUEST_STATUS_CANCELED by cancel_all().
+ *
+ * \param[in] service  The name of the service to watch.
+ * \param[in] status  The expected status (i.e. "up").
+ * \param[in] callback  The function called once the status is reached.
+ * \param[in] deadline  The date, in microseconds, when the wait times out.
+ *
+ * \return The identifier of the waiter, which can be passed to cancel().
+ */
+pending_requests::request_id_t pending_requests::add_status_waiter(
+      std::string const & service
+    , std::string const & status
+    , reply_callback_t const & callback
+    , std::int64_t deadline)
+{
+    request_id_t const id(add(callback, deadline));
+    request_t & waiter(f_requests[id]);
+    waiter.f_service = service;
+    waiter.f_status = status;
+    return id;
+}
+
+
+/** \brief Forget about a request.
+ *
+ * The callback of the request does not get called. A reply received
+ * later is ignored.
+ *
+ * \param[in] id  The identifier of the request to cancel.
+ *
+ * \return true if the request was still pending.
+ */
+bool pending_requests::cancel(request_id_t id)
+{
+    auto it(f_requests.find(id));
+    if(it == f_requests.end())
+    {
+        return false;
+    }
+
+    f_deadlines.erase(std::make_pair(it->second.f_deadline, id));
+    f_requests.erase(it);
+    return true;
+}
+
+
+/** \brief Cancel all the pending requests.
+ *
+ * The callback of each request and status waiter gets called with
+ * REQUEST_STATUS_CANCELED. This is used when the connection goes away
+ * for good.
+ */
+void pending_requests::cancel_all()
+{
+    request_map_t requests;
+    requests.swap(f_requests);
+    f_deadlines.clear();
+
+    for(auto & r : requests)
+    {
+        ed::message empty;
+        r.second.f_callback(request_status_t::REQUEST_STATUS_CANCELED, empty);
+    }
+}
+
+
+/** \brief Route a reply to its request.
+ *
+ * If \p reply has an "in_reply_to" parameter, it is a reply to one of
+ * our requests. The request gets removed and its callback called with
+ * \p reply.
+ *
+ * A reply which arrives after its request timed out or was canceled
+ * is dropped.
+ *
+ * \param[in] reply  The message received.
+ *
+ * \return true if \p reply was a reply, false if it is any other message
+ * and needs to be dispatched.
+ */
+bool pending_requests::complete(ed::message & reply)
+{
+    if(!reply.has_parameter(g_name_communicator_param_in_reply_to))
+    {
+        return false;
+    }
+
+    std::string const value(reply.get_parameter(g_name_communicator_param_in_reply_to));
+    request_id_t id(REQUEST_ID_NONE);
+    for(char const c : value)
+    {
+        if(c < '0' || c > '9')
+        {
+            id = REQUEST_ID_NONE;
+            break;
+        }
+        id = id * 10 + (c - '0');
+    }
+
+    auto it(f_requests.find(id));
+    if(it == f_requests.end()
+    || !it->second.f_service.empty())
+    {
+        SNAP_LOG_DEBUG
+            << "dropping reply \""
+            << reply.get_command()
+            << "\" to unknown or timed out request \""
+            << value
+            << "\"."
+            << SNAP_LOG_SEND;
+        return true;
+    }
+
+    reply_callback_t const callback(it->second.f_callback);
+    f_deadlines.erase(std::make_pair(it->second.f_deadline, id));
+    f_requests.erase(it);
+
+    callback(request_status_t::REQUEST_STATUS_REPLY, reply);
+
+    return true;
+}
+
+
+/** \brief Complete the status waiters matching a STATUS message.
+ *
+ * The waiters of the service named in \p status which expect the status
+ * it reports get removed and their callback called with
+ * REQUEST_STATUS_REPLY and \p status.
+ *
+ * \param[in] status  The STATUS message received.
+ *
+ * \return The number of waiters which were completed.
+ */
+std::size_t pending_requests::status_changed(ed::message & status)
+{
+    if(!status.has_parameter(g_name_communicator_param_service)
+    || !status.has_parameter(g_name_communicator_param_status))
+    {
+        return 0;
+    }
+    std::string const service(status.get_parameter(g_name_communicator_param_service));
+    std::string const value(status.get_parameter(g_name_communicator_param_status));
+
+    // the callbacks may add new waiters, so first extract the ready ones
+    //
+    std::vector<reply_callback_t> ready;
+    for(auto it(f_requests.begin()); it != f_requests.end(); )
+    {
+        if(!it->second.f_service.empty()
+        && it->second.f_service == service
+        && it->second.f_status == value)
+        {
+            ready.push_back(it->second.f_callback);
+            f_deadlines.erase(std::make_pair(it->second.f_deadline, it->first));
+            it = f_requests.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for(auto const & callback : ready)
+    {
+        callback(request_status_t::REQUEST_STATUS_REPLY, status);
+    }
+
+    return ready.size();
+}
+
+
+/** \brief Time out the requests which reached their deadline.
+ *
+ * \param[in] now  The current date in microseconds.
+ *
+ * \return The number of requests which timed out.
+ */
+std::size_t pending_requests::expire(std::int64_t now)
+{
+    // the callbacks may add new requests, so first extract the expired ones
+    //
+    std::vector<reply_callback_t> expired;
+    while(!f_deadlines.empty()
+       && f_deadlines.begin()->first <= now)
+    {
+        auto it(f_requests.find(f_deadlines.begin()->second));
+        expired.push_back(it->second.f_callback);
+        f_requests.erase(it);
+        f_deadlines.erase(f_deadlines.begin());
+    }
+
+    for(auto const & callback : expired)
+    {
+        ed::message empty;
+        callback(request_status_t::REQUEST_STATUS_TIMEOUT, empty);
+    }
+
+    return expired.size();
+}
+
+
+/** \brief Get the date when the next request times out.
+ *
+ * \return The earliest deadline or -1 if no requests are pending.
+ */
+std::int64_t pending_requests::next_deadline() const
+{
+    if(f_deadlines.empty())
+    {
+        return -1;
+    }
+
+    return f_deadlines.begin()->first;
+}
+
+
+bool pending_requests::empty() const
+{
+    return f_requests.empty();
+}
+
+
+std::size_t pending_requests::size() const
+{
+    return f_requests.size();
+}
+
+
+/** \brief Attach a correlation identifier to a request.
+ *
+ * \param[in,out] request  The message being sent as a request.
+ * \param[in] id  The identifier returned by add().
+ */
+void pending_requests::set_correlation_id(ed::message & request, request_id_t id)
+{
+    request.add_parameter(g_name_communicator_param_correlation_id, std::to_string(id));
+}
+
+
+/** \brief Prepare a reply to a request.
+ *
+ * The service replying to a request calls this function so the
+ * \p reply goes back to the sender of \p request and includes the
+ * correlation identifier in its "in_reply_to" parameter.
+ *
+ * A \p request without a correlation identifier was not sent with
+ * communicator_connection::request(). In that case the reply is only
+ * addressed to the sender.
+ *
+ * \param[in] request  The request being replied to.
+ * \param[in,out] reply  The reply message.
+ */
+void pending_requests::set_reply(ed::message const & request, ed::message & reply)
+{
+    reply.set_server(request.get_sent_from_server());
+    reply.set_service(request.get_sent_from_service());
+    if(request.has_parameter(g_name_communicator_param_correlation_id))
+    {
+        reply.add_parameter(
+                  g_name_communicator_param_in_reply_to
+                , request.get_parameter(g_name_communicator_param_correlation_id));
+    }
+}
+
+
+
+} // namespace communicator
+// vim: ts=4 sw=4 et
@@ -0,0 +1,106 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#pragma once
+
+/** \file
+ * \brief Declaration of the pending_requests class.
+ *
+ * The pending_requests class keeps track of the requests sent by a
+ * client which are still waiting for a reply. Each request gets a
+ * correlation identifier which the replier copies in its reply.
+ *
+ * It also keeps track of the clients waiting for a service to reach a
+ * given status, which also time out and get canceled the same way.
+ */
+
+// eventdispatcher
+//
+#include    <eventdispatcher/message.h>
+
+
+// C++
+//
+#include    <cstdint>
+#include    <functional>
+#include    <map>
+#include    <set>
+#include    <string>
+
+
+
+namespace communicator
+{
+
+
+
+enum class request_status_t
+{
+    REQUEST_STATUS_REPLY,       // the reply was received
+    REQUEST_STATUS_TIMEOUT,     // no reply before the deadline
+    REQUEST_STATUS_CANCELED,    // the request was canceled (i.e. we are quitting)
+};
+
+
+class pending_requests
+{
+public:
+    typedef std::uint64_t       request_id_t;
+    typedef std::function<void(request_status_t status, ed::message & reply)>
+                                reply_callback_t;
+
+    static constexpr request_id_t   REQUEST_ID_NONE = 0;
+
+    request_id_t                add(reply_callback_t const & callback, std::int64_t deadline);
+    request_id_t                add_status_waiter(
+                                      std::string const & service
+                                    , std::string const & status
+                                    , reply_callback_t const & callback
+                                    , std::int64_t deadline);
+    bool                        cancel(request_id_t id);
+    void                        cancel_all();
+    bool                        complete(ed::message & reply);
+    std::size_t                 status_changed(ed::message & status);
+    std::size_t                 expire(std::int64_t now);
+    std::int64_t                next_deadline() const;
+    bool                        empty() const;
+    std::size_t                 size() const;
+
+    static void                 set_correlation_id(ed::message & request, request_id_t id);
+    static void                 set_reply(ed::message const & request, ed::message & reply);
+
+private:
+    struct request_t
+    {
+        reply_callback_t        f_callback = reply_callback_t();
+        std::int64_t            f_deadline = 0;
+        std::string             f_service = std::string();     // status waiters only
+        std::string             f_status = std::string();
+    };
+
+    typedef std::map<request_id_t, request_t>                       request_map_t;
+    typedef std::set<std::pair<std::int64_t, request_id_t>>         deadline_set_t;
+
+    request_map_t               f_requests = request_map_t();
+    deadline_set_t              f_deadlines = deadline_set_t();
+    request_id_t                f_next_id = REQUEST_ID_NONE;
+};
+
+
+
+} // namespace communicator
+// vim: ts=4 sw=4 et
@@ -319,15 +319,27 @@ void loadavg::msg_unregister_from_loadavg(ed::message & msg)
 
     // check whether all connections are now unregistered
     //
-    ed::connection::vector_t const & all_connections(f_communicator->get_connections());
-    if(all_connections.end() == std::find_if(
-            all_connections.begin(),
-            all_connections.end(),
-            [](auto const & c)
-            {
-                base_connection::pointer_t b(std::dynamic_pointer_cast<base_connection>(c));
-                return b->wants_loadavg();
-            }))
+    connection_registry const & registry(s->get_connection_registry());
+    bool wanted(false);
+    for(connection_kind_t const kind : {
+                  connection_kind_t::CONNECTION_KIND_SERVICE
+                , connection_kind_t::CONNECTION_KIND_UNIX
+                , connection_kind_t::CONNECTION_KIND_REMOTE })
+    {
+        connection_registry::connection_vector_t const & connections(registry.get_connections(kind));
+        if(std::any_of(
+                connections.begin(),
+                connections.end(),
+                [](auto const & c)
+                {
+                    return c->wants_loadavg();
+                }))
+        {
+            wanted = true;
+            break;
+        }
+    }
+    if(!wanted)
     {
         // no more connections requiring LOADAVG messages
         // so stop the timer
@@ -344,35 +356,27 @@ void loadavg::register_for_loadavg(std::string const & ip)
             , "127.0.0.1"
             , communicator::LOCAL_PORT  // the port is ignored, use a safe default
             , "tcp"));
-    ed::connection::vector_t const & all_connections(f_communicator->get_connections());
-    auto const & it(std::find_if(
-            all_connections.begin(),
-            all_connections.end(),
-            [address](auto const & conn)
-            {
-                remote_connection::pointer_t remote_conn(std::dynamic_pointer_cast<remote_connection>(conn));
-                if(remote_conn != nullptr)
-                {
-                    return remote_conn->get_connection_address() == address;
-                }
-                else
-                {
-                    service_connection::pointer_t service_conn(std::dynamic_pointer_cast<service_connection>(conn));
-                    if(service_conn != nullptr)
-                    {
-                        return service_conn->get_connection_address() == address;
-                    }
-                }
-
-                return false;
-            }));
-
-    if(it != all_connections.end())
+    communicatord::pointer_t s(plugins()->get_server<communicatord>());
+    connection_registry const & registry(s->get_connection_registry());
+    for(connection_kind_t const kind : {
+                  connection_kind_t::CONNECTION_KIND_REMOTE
+                , connection_kind_t::CONNECTION_KIND_SERVICE })
     {
-        // there is such a connection, send it a request for LOADAVG messages
-        //
-        base_connection::pointer_t conn(std::dynamic_pointer_cast<base_connection>(*it));
-        on_new_connection(conn);
+        connection_registry::connection_vector_t const & connections(registry.get_connections(kind));
+        auto const & it(std::find_if(
+                connections.begin(),
+                connections.end(),
+                [address](auto const & conn)
+                {
+                    return conn->get_connection_address() == address;
+                }));
+        if(it != connections.end())
+        {
+            // there is such a connection, send it a request for LOADAVG messages
+            //
+            on_new_connection(*it);
+            return;
+        }
     }
 }
 
@@ -390,18 +394,16 @@ void loadavg::on_new_connection(base_connection::pointer_t conn)
     register_message.set_sent_from_server(s->get_server_name());
     register_message.set_sent_from_service(communicator::g_name_communicator_service_communicatord);
 
-    remote_connection::pointer_t remote_conn(std::dynamic_pointer_cast<remote_connection>(conn));
-    if(remote_conn != nullptr)
+    switch(conn->get_connection_kind())
     {
-        remote_conn->send_message(register_message);
-    }
-    else
-    {
-        service_connection::pointer_t service_conn(std::dynamic_pointer_cast<service_connection>(conn));
-        if(service_conn != nullptr)
-        {
-            service_conn->send_message(register_message);
-        }
+    case connection_kind_t::CONNECTION_KIND_REMOTE:
+    case connection_kind_t::CONNECTION_KIND_SERVICE:
+        conn->send_message_to_connection(register_message);
+        break;
+
+    default:
+        break;
+
     }
 }
 
@@ -469,31 +471,19 @@ void loadavg::process_load_balancing()
                 , s->get_connection_address().to_ipv4or6_string(addr::STRING_IP_BRACKET_ADDRESS | addr::STRING_IP_PORT));
         load_avg.add_parameter(communicator::g_name_communicator_param_timestamp, snapdev::now());
 
-        ed::connection::vector_t const & all_connections(f_communicator->get_connections());
-        std::for_each(
-                all_connections.begin(),
-                all_connections.end(),
-                [&load_avg](auto const & connection)
+        connection_registry const & registry(s->get_connection_registry());
+        for(connection_kind_t const kind : {
+                      connection_kind_t::CONNECTION_KIND_REMOTE
+                    , connection_kind_t::CONNECTION_KIND_SERVICE })
+        {
+            for(auto const & conn : registry.get_connections(kind))
+            {
+                if(conn->wants_loadavg())
                 {
-                    base_connection::pointer_t base(std::dynamic_pointer_cast<base_connection>(connection));
-                    if(base
-                    && base->wants_loadavg())
-                    {
-                        remote_connection::pointer_t remote_conn(std::dynamic_pointer_cast<remote_connection>(connection));
-                        if(remote_conn != nullptr)
-                        {
-                            remote_conn->send_message(load_avg);
-                        }
-                        else
-                        {
-                            service_connection::pointer_t service_conn(std::dynamic_pointer_cast<service_connection>(connection));
-                            if(service_conn != nullptr)
-                            {
-                                service_conn->send_message(load_avg);
-                            }
-                        }
-                    }
-                });
+                    conn->send_message_to_connection(load_avg);
+                }
+            }
+        }
     }
     else if(!error_emitted)
     {
@@ -39,7 +39,7 @@ class test_connection
 {
 public:
     test_connection(communicator_daemon::communicatord * s)
-        : base_connection(s, false)
+        : base_connection(s, communicator_daemon::connection_kind_t::CONNECTION_KIND_SERVICE)
     {
     }
 
@@ -64,6 +64,61 @@ CATCH_TEST_CASE("base_connection", "[connection]")
         CATCH_REQUIRE(tc.get_server_name().empty());
     }
     CATCH_END_SECTION()
+
+    CATCH_START_SECTION("base_connection: encode a message once")
+    {
+        ed::message msg;
+        msg.set_server("*");
+        msg.set_service("images");
+        msg.set_command("RESIZE");
+        msg.add_parameter("size", "100x100");
+
+        communicator_daemon::base_connection::encoded_message_t encoded(
+                    communicator_daemon::base_connection::encode_message(msg));
+        CATCH_REQUIRE(encoded != nullptr);
+        CATCH_REQUIRE(*encoded == msg.to_message() + '\n');
+
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("base_connection: send one message to two connections")
+    {
+        ed::message msg;
+        msg.set_server("*");
+        msg.set_service("images");
+        msg.set_command("RESIZE");
+        msg.add_parameter("size", "100x100");
+
+        communicator_daemon::communicatord * s(nullptr);
+        test_connection first(s);
+        test_connection second(s);
+        first.set_output_coalescing(communicator_daemon::output_queue::DEFAULT_FLUSH_THRESHOLD);
+        second.set_output_coalescing(communicator_daemon::output_queue::DEFAULT_FLUSH_THRESHOLD);
+        CATCH_REQUIRE(first.can_send_raw_message());
+        CATCH_REQUIRE(second.can_send_raw_message());
+
+        // the first connection serializes the message
+        //
+        communicator_daemon::base_connection::encoded_message_t encoded;
+        CATCH_REQUIRE(first.send_encoded_message(msg, encoded));
+        CATCH_REQUIRE(encoded != nullptr);
+        CATCH_REQUIRE(*encoded == msg.to_message() + '\n');
+
+        // the second connection reuses that buffer
+        //
+        std::string const * const buffer(encoded.get());
+        CATCH_REQUIRE(second.send_encoded_message(msg, encoded));
+        CATCH_REQUIRE(encoded.get() == buffer);
+
+        // both queues hold a reference to that one buffer
+        //
+        CATCH_REQUIRE(encoded.use_count() == 3);
+        CATCH_REQUIRE(first.get_output_queue().count() == 1);
+        CATCH_REQUIRE(first.get_output_queue().size() == encoded->length());
+        CATCH_REQUIRE(second.get_output_queue().count() == 1);
+        CATCH_REQUIRE(second.get_output_queue().size() == encoded->length());
+    }
+    CATCH_END_SECTION()
 }
 
 
@@ -0,0 +1,110 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the broadcast_dedup class.
+ *
+ * This file implements tests to verify that the broadcast message
+ * identifiers are remembered until their timeout.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/broadcast_dedup.h>
+
+
+
+CATCH_TEST_CASE("broadcast_dedup", "[broadcast]")
+{
+    CATCH_START_SECTION("broadcast_dedup: duplicates")
+    {
+        communicator_daemon::broadcast_dedup d;
+        CATCH_REQUIRE(d.empty());
+        CATCH_REQUIRE_FALSE(d.contains("alpha-1"));
+
+        CATCH_REQUIRE(d.insert("alpha-1", 1010));
+        CATCH_REQUIRE(d.contains("alpha-1"));
+        CATCH_REQUIRE_FALSE(d.insert("alpha-1", 1010));
+        CATCH_REQUIRE_FALSE(d.contains("alpha-2"));
+        CATCH_REQUIRE_FALSE(d.contains("beta-1"));
+
+        // server names can include dashes and other identifiers get hashed
+        //
+        CATCH_REQUIRE(d.insert("web-server-1", 1010));
+        CATCH_REQUIRE(d.contains("web-server-1"));
+        CATCH_REQUIRE(d.insert("not a sequence", 1010));
+        CATCH_REQUIRE(d.contains("not a sequence"));
+        CATCH_REQUIRE(d.size() == 3);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("broadcast_dedup: expire")
+    {
+        communicator_daemon::broadcast_dedup d;
+        d.expire(1000);
+        CATCH_REQUIRE(d.insert("alpha-1", 1005));
+        CATCH_REQUIRE(d.insert("alpha-2", 1010));
+        CATCH_REQUIRE(d.insert("alpha-3", 1000 + communicator_daemon::broadcast_dedup::WHEEL_SIZE + 5));
+
+        d.expire(1005);
+        CATCH_REQUIRE(d.contains("alpha-1"));
+
+        d.expire(1006);
+        CATCH_REQUIRE_FALSE(d.contains("alpha-1"));
+        CATCH_REQUIRE(d.contains("alpha-2"));
+        CATCH_REQUIRE(d.contains("alpha-3"));
+
+        // the first turn of the wheel does not remove "alpha-3"
+        //
+        d.expire(1011);
+        CATCH_REQUIRE_FALSE(d.contains("alpha-2"));
+        CATCH_REQUIRE(d.contains("alpha-3"));
+
+        d.expire(1000 + communicator_daemon::broadcast_dedup::WHEEL_SIZE + 6);
+        CATCH_REQUIRE(d.empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("broadcast_dedup: grow")
+    {
+        communicator_daemon::broadcast_dedup d;
+        d.expire(1000);
+        for(int i(0); i < 1000; ++i)
+        {
+            CATCH_REQUIRE(d.insert("alpha-" + std::to_string(i), 1000 + i % 20));
+        }
+        CATCH_REQUIRE(d.size() == 1000);
+        CATCH_REQUIRE(d.capacity() >= 2000);
+
+        d.expire(1010);
+        CATCH_REQUIRE(d.size() == 500);
+        for(int i(0); i < 1000; ++i)
+        {
+            CATCH_REQUIRE(d.contains("alpha-" + std::to_string(i)) == (i % 20 >= 10));
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,562 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the message cache.
+ *
+ * This file implements tests to verify that the messages cached for a
+ * service are replayed in order once that service registers, that the
+ * messages time out, and that the limits of the cache are enforced.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/cache.h>
+
+
+
+CATCH_TEST_CASE("cache", "[cache]")
+{
+    CATCH_START_SECTION("cache: replay one service")
+    {
+        communicator_daemon::cache c;
+        CATCH_REQUIRE(c.empty());
+
+        for(int i(0); i < 10; ++i)
+        {
+            ed::message msg;
+            msg.set_command("COUNT");
+            msg.set_service(i % 2 == 0 ? "even" : "odd");
+            msg.add_parameter("value", std::to_string(i));
+            CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        }
+        CATCH_REQUIRE(c.size() == 10);
+        CATCH_REQUIRE(c.size("even") == 5);
+        CATCH_REQUIRE(c.size("odd") == 5);
+
+        std::vector<std::string> values;
+        c.process_messages(
+              "odd"
+            , [&values](ed::message & msg)
+              {
+                  CATCH_REQUIRE(msg.get_service() == "odd");
+                  values.push_back(msg.get_parameter("value"));
+                  return true;
+              });
+        CATCH_REQUIRE(values == std::vector<std::string>({ "1", "3", "5", "7", "9" }));
+        CATCH_REQUIRE(c.size() == 5);
+        CATCH_REQUIRE(c.size("odd") == 0);
+
+        // a message not accepted by the callback stays in the cache
+        //
+        c.process_messages(
+              "even"
+            , [](ed::message & msg)
+              {
+                  return msg.get_parameter("value") != "4";
+              });
+        CATCH_REQUIRE(c.size() == 1);
+        CATCH_REQUIRE(c.size("even") == 1);
+
+        c.process_messages(
+              "unknown"
+            , [](ed::message &)
+              {
+                  CATCH_REQUIRE(!"unexpected call");
+                  return true;
+              });
+        CATCH_REQUIRE(c.size() == 1);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache: do not cache")
+    {
+        communicator_daemon::cache c;
+
+        ed::message msg;
+        msg.set_command("PING");
+        msg.set_service("missing");
+        msg.add_parameter("cache", "no");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_IGNORE);
+
+        msg.add_parameter("cache", "no;reply");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_REPLY);
+        CATCH_REQUIRE(c.empty());
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("cache_parameter", "[cache]")
+{
+    CATCH_START_SECTION("cache_parameter: defaults")
+    {
+        communicator_daemon::cache_parameter param;
+        communicator_daemon::parse_cache_parameter("", param);
+        CATCH_REQUIRE_FALSE(param.f_no);
+        CATCH_REQUIRE_FALSE(param.f_reply);
+        CATCH_REQUIRE(param.f_ttl == communicator_daemon::cache_parameter::DEFAULT_TTL);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_parameter: options")
+    {
+        communicator_daemon::cache_parameter param;
+        communicator_daemon::parse_cache_parameter(";reply;;ttl=30;unknown=5", param);
+        CATCH_REQUIRE_FALSE(param.f_no);
+        CATCH_REQUIRE(param.f_reply);
+        CATCH_REQUIRE(param.f_ttl == 30);
+
+        communicator_daemon::parse_cache_parameter("no=true", param);
+        CATCH_REQUIRE(param.f_no);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_parameter: durations")
+    {
+        communicator_daemon::cache_parameter param;
+        communicator_daemon::parse_cache_parameter("ttl=2m", param);
+        CATCH_REQUIRE(param.f_ttl == 120);
+
+        communicator_daemon::parse_cache_parameter("ttl=3h", param);
+        CATCH_REQUIRE(param.f_ttl == 3 * 3600);
+
+        communicator_daemon::parse_cache_parameter("ttl=86400", param);
+        CATCH_REQUIRE(param.f_ttl == communicator_daemon::cache_parameter::MAX_TTL);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_parameter: invalid TTL")
+    {
+        for(char const * value : {
+                  "ttl=5"
+                , "ttl=86401"
+                , "ttl=abc"
+                , "ttl"
+                , "ttl=" })
+        {
+            communicator_daemon::cache_parameter param;
+            param.f_ttl = 123;
+            communicator_daemon::parse_cache_parameter(value, param);
+            CATCH_REQUIRE(param.f_ttl == communicator_daemon::cache_parameter::DEFAULT_TTL);
+        }
+
+        communicator_daemon::cache_parameter param;
+        communicator_daemon::parse_cache_parameter("=30;reply", param);
+        CATCH_REQUIRE(param.f_reply);
+        CATCH_REQUIRE(param.f_ttl == communicator_daemon::cache_parameter::DEFAULT_TTL);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("cache_timeout", "[cache]")
+{
+    CATCH_START_SECTION("cache_timeout: timing wheel levels")
+    {
+        communicator_daemon::cache c;
+        time_t const now(time(nullptr));
+
+        // one message per level of the timing wheel
+        //
+        std::int64_t const ttl[] = { 10, 3600, 86400 };
+        for(std::size_t i(0); i < std::size(ttl); ++i)
+        {
+            ed::message msg;
+            msg.set_command("COUNT");
+            msg.set_service(std::to_string(ttl[i]));
+            msg.add_parameter("cache", "ttl=" + std::to_string(ttl[i]));
+            CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        }
+        CATCH_REQUIRE(c.size() == 3);
+
+        // a message times out once the time is past its timeout; allow
+        // one second for the time() call in cache_message()
+        //
+        for(std::size_t i(0); i < std::size(ttl); ++i)
+        {
+            c.remove_old_messages(now + ttl[i]);
+            CATCH_REQUIRE(c.size() == 3 - i);
+            CATCH_REQUIRE(c.size(std::to_string(ttl[i])) == 1);
+
+            c.remove_old_messages(now + ttl[i] + 2);
+            CATCH_REQUIRE(c.size() == 2 - i);
+            CATCH_REQUIRE(c.size(std::to_string(ttl[i])) == 0);
+        }
+        CATCH_REQUIRE(c.empty());
+        CATCH_REQUIRE(c.get_bytes() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_timeout: sent messages leave the wheel")
+    {
+        communicator_daemon::cache c;
+        time_t const now(time(nullptr));
+
+        for(int i(0); i < 100; ++i)
+        {
+            ed::message msg;
+            msg.set_command("COUNT");
+            msg.set_service(i % 2 == 0 ? "even" : "odd");
+            msg.add_parameter("value", std::to_string(i));
+            msg.add_parameter("cache", "ttl=" + std::to_string(10 + i));
+            CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        }
+
+        c.process_messages(
+              "odd"
+            , [](ed::message &)
+              {
+                  return true;
+              });
+        CATCH_REQUIRE(c.size() == 50);
+
+        // the "even" messages with a TTL of 60 seconds or less time out
+        //
+        c.remove_old_messages(now + 62);
+        CATCH_REQUIRE(c.size() == 24);
+
+        std::vector<std::string> values;
+        c.process_messages(
+              "even"
+            , [&values](ed::message & msg)
+              {
+                  values.push_back(msg.get_parameter("value"));
+                  return false;
+              });
+        CATCH_REQUIRE(values.size() == 24);
+        CATCH_REQUIRE(values.front() == "52");
+        CATCH_REQUIRE(values.back() == "98");
+
+        c.remove_old_messages(now + 200);
+        CATCH_REQUIRE(c.empty());
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("cache_limits", "[cache]")
+{
+    CATCH_START_SECTION("cache_limits: eviction names")
+    {
+        for(auto const e : {
+                  communicator_daemon::eviction_t::EVICTION_OLDEST
+                , communicator_daemon::eviction_t::EVICTION_LOWEST_TTL
+                , communicator_daemon::eviction_t::EVICTION_REJECT })
+        {
+            communicator_daemon::eviction_t eviction(communicator_daemon::eviction_t::EVICTION_OLDEST);
+            CATCH_REQUIRE(communicator_daemon::string_to_eviction(communicator_daemon::eviction_to_string(e), eviction));
+            CATCH_REQUIRE(eviction == e);
+        }
+
+        communicator_daemon::eviction_t eviction(communicator_daemon::eviction_t::EVICTION_REJECT);
+        CATCH_REQUIRE_FALSE(communicator_daemon::string_to_eviction("newest", eviction));
+        CATCH_REQUIRE(eviction == communicator_daemon::eviction_t::EVICTION_REJECT);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_limits: evict oldest")
+    {
+        communicator_daemon::cache c;
+        c.set_limits(5, 0);
+        c.set_service_limits(4, 0);
+
+        std::vector<std::pair<std::string, bool>> evicted;
+        c.set_evicted_callback([&evicted](ed::message & msg, bool reply)
+            {
+                evicted.push_back(std::make_pair(msg.get_parameter("value"), reply));
+            });
+
+        for(int i(0); i < 10; ++i)
+        {
+            ed::message msg;
+            msg.set_command("COUNT");
+            msg.set_service(i < 6 ? "first" : "second");
+            msg.add_parameter("value", std::to_string(i));
+            if(i == 0)
+            {
+                msg.add_parameter("cache", "reply");
+            }
+            CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        }
+
+        // "first" is limited to 4 messages: 0 and 1 get evicted
+        // the cache is limited to 5 messages: 2, 3, and 4 get evicted
+        //
+        CATCH_REQUIRE(evicted == std::vector<std::pair<std::string, bool>>({
+                  { "0", true }
+                , { "1", false }
+                , { "2", false }
+                , { "3", false }
+                , { "4", false }
+            }));
+        CATCH_REQUIRE(c.size() == 5);
+        CATCH_REQUIRE(c.size("first") == 1);
+        CATCH_REQUIRE(c.size("second") == 4);
+        CATCH_REQUIRE(c.get_evicted() == 5);
+        CATCH_REQUIRE(c.get_rejected() == 0);
+
+        std::vector<std::string> values;
+        c.process_messages([&values](ed::message & msg)
+            {
+                values.push_back(msg.get_parameter("value"));
+                return true;
+            });
+        std::sort(values.begin(), values.end());
+        CATCH_REQUIRE(values == std::vector<std::string>({ "5", "6", "7", "8", "9" }));
+        CATCH_REQUIRE(c.empty());
+        CATCH_REQUIRE(c.get_bytes() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_limits: evict lowest TTL")
+    {
+        communicator_daemon::cache c;
+        c.set_limits(3, 0);
+        c.set_eviction(communicator_daemon::eviction_t::EVICTION_LOWEST_TTL);
+
+        std::vector<std::string> evicted;
+        c.set_evicted_callback([&evicted](ed::message & msg, bool reply)
+            {
+                CATCH_REQUIRE_FALSE(reply);
+                evicted.push_back(msg.get_parameter("value"));
+            });
+
+        int const ttl[] = { 300, 20, 600, 100, 900 };
+        for(int i(0); i < 5; ++i)
+        {
+            ed::message msg;
+            msg.set_command("COUNT");
+            msg.set_service(i % 2 == 0 ? "even" : "odd");
+            msg.add_parameter("value", std::to_string(i));
+            msg.add_parameter("cache", "ttl=" + std::to_string(ttl[i]));
+            CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        }
+        CATCH_REQUIRE(evicted == std::vector<std::string>({ "1", "3" }));
+        CATCH_REQUIRE(c.size() == 3);
+        CATCH_REQUIRE(c.size("even") == 3);
+        CATCH_REQUIRE(c.size("odd") == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_limits: reject")
+    {
+        communicator_daemon::cache c;
+        c.set_eviction(communicator_daemon::eviction_t::EVICTION_REJECT);
+        c.set_evicted_callback([](ed::message &, bool)
+            {
+                CATCH_REQUIRE(!"unexpected eviction");
+            });
+
+        ed::message msg;
+        msg.set_command("COUNT");
+        msg.set_service("full");
+        msg.add_parameter("value", "0");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        std::size_t const bytes(c.get_bytes());
+        CATCH_REQUIRE(bytes == msg.to_message().length());
+        CATCH_REQUIRE(c.get_bytes("full") == bytes);
+
+        c.set_service_limits(0, bytes * 2);
+
+        msg.add_parameter("value", "1");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+
+        msg.add_parameter("value", "2");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_IGNORE);
+
+        msg.add_parameter("cache", "reply");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_REPLY);
+
+        // another service still has room
+        //
+        msg.set_service("empty");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+
+        CATCH_REQUIRE(c.size() == 3);
+        CATCH_REQUIRE(c.get_rejected() == 2);
+        CATCH_REQUIRE(c.get_evicted() == 0);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("cache_coalesce", "[cache]")
+{
+    CATCH_START_SECTION("cache_coalesce: keep the newest signal")
+    {
+        communicator_daemon::cache c;
+        c.set_coalesce("PING", {});
+        c.set_evicted_callback([](ed::message &, bool)
+            {
+                CATCH_REQUIRE(!"unexpected eviction");
+            });
+
+        for(int i(0); i < 500; ++i)
+        {
+            ed::message msg;
+            msg.set_command("PING");
+            msg.set_service("sleepy");
+            msg.add_parameter("value", std::to_string(i));
+            CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+
+            msg.set_command("COUNT");
+            CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        }
+        CATCH_REQUIRE(c.size() == 501);
+        CATCH_REQUIRE(c.get_coalesced() == 499);
+
+        // the PING moved to the end of the queue
+        //
+        std::vector<std::string> commands;
+        c.process_messages(
+              "sleepy"
+            , [&commands](ed::message & msg)
+              {
+                  commands.push_back(msg.get_command() + msg.get_parameter("value"));
+                  return true;
+              });
+        CATCH_REQUIRE(commands.size() == 501);
+        CATCH_REQUIRE(commands[498] == "COUNT498");
+        CATCH_REQUIRE(commands[499] == "PING499");
+        CATCH_REQUIRE(commands[500] == "COUNT499");
+        CATCH_REQUIRE(c.empty());
+
+        // once sent, the next PING is cached again
+        //
+        ed::message msg;
+        msg.set_command("PING");
+        msg.set_service("sleepy");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        CATCH_REQUIRE(c.size() == 1);
+        CATCH_REQUIRE(c.get_coalesced() == 499);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_coalesce: key with parameters")
+    {
+        communicator_daemon::cache c;
+        c.set_coalesce("STATUS", { "service" });
+
+        char const * services[] = { "a", "b", "a", "c", "b", "a" };
+        for(std::size_t i(0); i < std::size(services); ++i)
+        {
+            ed::message msg;
+            msg.set_command("STATUS");
+            msg.set_service("monitor");
+            msg.add_parameter("service", services[i]);
+            msg.add_parameter("value", std::to_string(i));
+            CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        }
+
+        // a STATUS without a "service" is its own key
+        //
+        ed::message msg;
+        msg.set_command("STATUS");
+        msg.set_service("monitor");
+        msg.add_parameter("value", "6");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+
+        // the same key for another service is kept too
+        //
+        msg.set_service("other");
+        msg.add_parameter("service", "a");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+
+        CATCH_REQUIRE(c.size() == 5);
+        CATCH_REQUIRE(c.size("monitor") == 4);
+        CATCH_REQUIRE(c.get_coalesced() == 3);
+
+        std::vector<std::string> values;
+        c.process_messages(
+              "monitor"
+            , [&values](ed::message & m)
+              {
+                  values.push_back(m.get_parameter("value"));
+                  return false;
+              });
+        CATCH_REQUIRE(values == std::vector<std::string>({ "3", "4", "5", "6" }));
+
+        // timed out signals free their key
+        //
+        c.remove_old_messages(time(nullptr) + 100);
+        CATCH_REQUIRE(c.empty());
+        msg.set_service("monitor");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        CATCH_REQUIRE(c.size() == 1);
+        CATCH_REQUIRE(c.get_coalesced() == 3);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_coalesce: a rejected signal keeps the cached one")
+    {
+        communicator_daemon::cache c;
+        c.set_eviction(communicator_daemon::eviction_t::EVICTION_REJECT);
+        c.set_coalesce("PING", {});
+        c.set_evicted_callback([](ed::message &, bool)
+            {
+                CATCH_REQUIRE(!"unexpected eviction");
+            });
+
+        ed::message msg;
+        msg.set_command("PING");
+        msg.set_service("sleepy");
+        msg.add_parameter("value", "1");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        std::size_t const bytes(c.get_bytes());
+
+        // the service is full, yet a signal of the same size replaces
+        // the cached one
+        //
+        c.set_service_limits(1, bytes);
+        msg.add_parameter("value", "2");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+        CATCH_REQUIRE(c.size() == 1);
+        CATCH_REQUIRE(c.get_coalesced() == 1);
+        CATCH_REQUIRE(c.get_rejected() == 0);
+
+        // a larger signal does not fit, the cached one stays
+        //
+        msg.add_parameter("value", "300");
+        CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_IGNORE);
+        CATCH_REQUIRE(c.size() == 1);
+        CATCH_REQUIRE(c.get_bytes() == bytes);
+        CATCH_REQUIRE(c.get_coalesced() == 1);
+        CATCH_REQUIRE(c.get_rejected() == 1);
+
+        std::vector<std::string> values;
+        c.process_messages(
+              "sleepy"
+            , [&values](ed::message & m)
+              {
+                  values.push_back(m.get_parameter("value"));
+                  return true;
+              });
+        CATCH_REQUIRE(values == std::vector<std::string>({ "2" }));
+        CATCH_REQUIRE(c.empty());
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,298 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the cache journal.
+ *
+ * This file implements tests to verify that the messages saved in the
+ * journal are found again after a restart and that the compaction keeps
+ * the messages still in the cache.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/cache.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <fstream>
+
+
+// C
+//
+#include    <unistd.h>
+
+
+
+CATCH_TEST_CASE("cache_journal", "[cache]")
+{
+    CATCH_START_SECTION("cache_journal: replay after reopen")
+    {
+        std::string const filename(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/replay.journal");
+        unlink(filename.c_str());
+
+        {
+            communicator_daemon::cache_journal j;
+            CATCH_REQUIRE(j.open(filename));
+            CATCH_REQUIRE(j.is_open());
+            CATCH_REQUIRE(j.size() == 0);
+
+            for(std::uint64_t id(1); id <= 10; ++id)
+            {
+                CATCH_REQUIRE(j.append(id, 1000 + id, id == 3, "message " + std::to_string(id)));
+            }
+            j.remove(2);
+            j.remove(5);
+            j.remove(11);       // unknown, ignored
+            CATCH_REQUIRE(j.size() == 8);
+        }
+
+        communicator_daemon::cache_journal j;
+        CATCH_REQUIRE(j.open(filename));
+        CATCH_REQUIRE(j.size() == 8);
+
+        std::vector<std::uint64_t> ids;
+        j.replay([&ids](std::uint64_t id, time_t timeout, bool reply, std::string const & message)
+            {
+                CATCH_REQUIRE(timeout == static_cast<time_t>(1000 + id));
+                CATCH_REQUIRE(reply == (id == 3));
+                CATCH_REQUIRE(message == "message " + std::to_string(id));
+                ids.push_back(id);
+            });
+        CATCH_REQUIRE(ids == std::vector<std::uint64_t>({ 1, 3, 4, 6, 7, 8, 9, 10 }));
+
+        unlink(filename.c_str());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_journal: grow and compact")
+    {
+        std::string const filename(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/compact.journal");
+        unlink(filename.c_str());
+
+        communicator_daemon::cache_journal j;
+        CATCH_REQUIRE(j.open(filename));
+
+        std::string const message(1000, 'm');
+        for(std::uint64_t id(1); id <= 1000; ++id)
+        {
+            CATCH_REQUIRE(j.append(id, 5000, false, message + std::to_string(id)));
+            if(id % 10 != 0)
+            {
+                j.remove(id);
+            }
+        }
+        CATCH_REQUIRE(j.size() == 100);
+        CATCH_REQUIRE(j.get_used_bytes() > communicator_daemon::cache_journal::MINIMUM_SIZE);
+        CATCH_REQUIRE(j.needs_compaction());
+
+        std::size_t const before(j.get_used_bytes());
+        CATCH_REQUIRE(j.compact(before));
+        CATCH_REQUIRE_FALSE(j.is_compacting());
+        CATCH_REQUIRE(j.get_used_bytes() < before / 5);
+        CATCH_REQUIRE_FALSE(j.needs_compaction());
+        CATCH_REQUIRE(j.size() == 100);
+
+        // the journal still works after the compaction
+        //
+        CATCH_REQUIRE(j.append(1001, 5000, false, "last"));
+        j.remove(10);
+        j.close();
+
+        CATCH_REQUIRE(j.open(filename));
+        std::vector<std::uint64_t> ids;
+        j.replay([&ids](std::uint64_t id, time_t, bool, std::string const &)
+            {
+                ids.push_back(id);
+            });
+        CATCH_REQUIRE(ids.size() == 100);
+        CATCH_REQUIRE(ids.front() == 20);
+        CATCH_REQUIRE(ids.back() == 1001);
+
+        unlink(filename.c_str());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_journal: compact in steps")
+    {
+        std::string const filename(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/steps.journal");
+        unlink(filename.c_str());
+
+        communicator_daemon::cache_journal j;
+        CATCH_REQUIRE(j.open(filename));
+
+        std::string const message(1000, 'm');
+        for(std::uint64_t id(1); id <= 1000; ++id)
+        {
+            CATCH_REQUIRE(j.append(id, 5000, false, message + std::to_string(id)));
+            if(id % 10 != 0)
+            {
+                j.remove(id);
+            }
+        }
+        CATCH_REQUIRE(j.needs_compaction());
+
+        // the first step only reaches the first few messages
+        //
+        CATCH_REQUIRE_FALSE(j.compact(64 * 1024));
+        CATCH_REQUIRE(j.is_compacting());
+
+        // change the journal between two steps: 10 was already copied,
+        // 990 was not, and 1001 is appended after the end
+        //
+        j.remove(10);
+        j.remove(990);
+        CATCH_REQUIRE(j.append(1001, 5000, false, "new"));
+
+        std::size_t steps(1);
+        while(!j.compact(64 * 1024))
+        {
+            CATCH_REQUIRE(j.is_compacting());
+            ++steps;
+        }
+        CATCH_REQUIRE(steps > 2);
+        CATCH_REQUIRE_FALSE(j.is_compacting());
+        CATCH_REQUIRE(j.size() == 99);
+
+        // closing in the middle of a compaction keeps the journal as is
+        //
+        for(std::uint64_t id(2000); id < 2200; ++id)
+        {
+            CATCH_REQUIRE(j.append(id, 5000, false, message));
+            j.remove(id);
+        }
+        CATCH_REQUIRE(j.needs_compaction());
+        CATCH_REQUIRE_FALSE(j.compact(1024));
+        CATCH_REQUIRE(j.is_compacting());
+        j.close();
+        CATCH_REQUIRE(access((filename + ".tmp").c_str(), F_OK) != 0);
+
+        CATCH_REQUIRE(j.open(filename));
+        std::vector<std::uint64_t> ids;
+        j.replay([&ids](std::uint64_t id, time_t, bool, std::string const &)
+            {
+                ids.push_back(id);
+            });
+        CATCH_REQUIRE(ids.size() == 99);
+        CATCH_REQUIRE(ids.front() == 20);
+        CATCH_REQUIRE(ids[ids.size() - 2] == 1000);
+        CATCH_REQUIRE(ids.back() == 1001);
+        CATCH_REQUIRE(std::find(ids.begin(), ids.end(), 990) == ids.end());
+
+        unlink(filename.c_str());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_journal: not a journal")
+    {
+        std::string const filename(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/invalid.journal");
+        {
+            std::ofstream out(filename);
+            out << "this is not a cache journal\n";
+        }
+
+        communicator_daemon::cache_journal j;
+        CATCH_REQUIRE(j.open(filename));
+        CATCH_REQUIRE(j.size() == 0);
+        CATCH_REQUIRE(j.append(1, 5000, false, "first"));
+
+        unlink(filename.c_str());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("cache_journal: cache restart")
+    {
+        std::string const filename(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/cache.journal");
+        unlink(filename.c_str());
+
+        {
+            communicator_daemon::cache c;
+            CATCH_REQUIRE(c.open_journal(filename));
+            for(int i(0); i < 10; ++i)
+            {
+                ed::message msg;
+                msg.set_command("COUNT");
+                msg.set_service(i % 2 == 0 ? "even" : "odd");
+                msg.add_parameter("value", std::to_string(i));
+                CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+            }
+
+            // "odd" registered, its messages are not cached anymore
+            //
+            c.process_messages(
+                  "odd"
+                , [](ed::message &)
+                  {
+                      return true;
+                  });
+            CATCH_REQUIRE(c.size() == 5);
+        }
+
+        {
+            communicator_daemon::cache c;
+            CATCH_REQUIRE(c.open_journal(filename));
+            CATCH_REQUIRE(c.size() == 5);
+            CATCH_REQUIRE(c.size("odd") == 0);
+
+            std::vector<std::string> values;
+            c.process_messages(
+                  "even"
+                , [&values](ed::message & msg)
+                  {
+                      CATCH_REQUIRE(msg.get_command() == "COUNT");
+                      values.push_back(msg.get_parameter("value"));
+                      return true;
+                  });
+            CATCH_REQUIRE(values == std::vector<std::string>({ "0", "2", "4", "6", "8" }));
+
+            // new messages do not reuse the identifiers of the restored ones
+            //
+            ed::message msg;
+            msg.set_command("COUNT");
+            msg.set_service("even");
+            msg.add_parameter("value", "10");
+            CATCH_REQUIRE(c.cache_message(msg) == communicator_daemon::cache_message_t::CACHE_MESSAGE_CACHED);
+            CATCH_REQUIRE(c.size() == 1);
+        }
+
+        communicator_daemon::cache c;
+        CATCH_REQUIRE(c.open_journal(filename));
+        CATCH_REQUIRE(c.size() == 1);
+        c.process_messages(
+              "even"
+            , [](ed::message & msg)
+              {
+                  CATCH_REQUIRE(msg.get_parameter("value") == "10");
+                  return true;
+              });
+        CATCH_REQUIRE(c.empty());
+
+        unlink(filename.c_str());
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
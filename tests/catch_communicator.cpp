@@ -26,7 +26,9 @@
 // communicator
 //
 #include    <communicator/communicator_connection.h>
+#include    <communicator/coroutine.h>
 #include    <communicator/exception.h>
+#include    <communicator/names.h>
 #include    <communicator/version.h>
 
 
@@ -48,6 +50,12 @@
 #include    "catch_main.h"
 
 
+// C++
+//
+#include    <algorithm>
+#include    <stdexcept>
+
+
 
 namespace
 {
@@ -287,6 +295,46 @@ private:
 };
 
 
+// stands in for the std::coroutine_handle<> so the awaitables can be
+// tested without compiling the tests in C++20
+//
+struct test_handle
+{
+    int *                       f_resumed = nullptr;
+
+    void resume() const
+    {
+        ++*f_resumed;
+    }
+};
+
+
+// the deadlines of the requests use a private timer which is part of
+// the event loop only while requests are pending
+//
+ed::connection::pointer_t find_request_timer()
+{
+    for(auto const & c : ed::communicator::instance()->get_connections())
+    {
+        if(c->get_name() == "communicator_request_timer")
+        {
+            return c;
+        }
+    }
+    return ed::connection::pointer_t();
+}
+
+
+ed::message status_message(std::string const & service, std::string const & status)
+{
+    ed::message msg;
+    msg.set_command(communicator::g_name_communicator_cmd_status);
+    msg.add_parameter(communicator::g_name_communicator_param_service, service);
+    msg.add_parameter(communicator::g_name_communicator_param_status, status);
+    return msg;
+}
+
+
 class test_timer
     : public ed::timer
 {
@@ -491,4 +539,199 @@ CATCH_TEST_CASE("communicator_client_connection", "[client]")
 }
 
 
+CATCH_TEST_CASE("communicator_client_waiters", "[client]")
+{
+    CATCH_START_SECTION("communicator_client_waiters: wait for a status with a callback")
+    {
+        std::vector<std::string> const args = {
+            "test-service", // name of command
+            "--path-to-message-definitions",
+            SNAP_CATCH2_NAMESPACE::g_source_dir() + "/tests/message-definitions:"
+                + SNAP_CATCH2_NAMESPACE::g_source_dir() + "/daemon/message-definitions:"
+                + SNAP_CATCH2_NAMESPACE::g_dist_dir() + "/share/eventdispatcher/messages",
+        };
+        std::vector<char const *> args_strings;
+        for(auto const & arg : args)
+        {
+            args_strings.push_back(arg.c_str());
+        }
+        args_strings.push_back(nullptr);
+
+        // the messenger is not connected, the STATUS messages get
+        // dispatched directly
+        //
+        advgetopt::getopt opts(g_options_environment);
+        test_messenger::pointer_t messenger(std::make_shared<test_messenger>(
+                  opts
+                , args.size()
+                , const_cast<char **>(args_strings.data())
+                , test_messenger::sequence_t::SEQUENCE_SUCCESS));
+
+        std::vector<communicator::request_status_t> results;
+        auto const callback([&results](communicator::request_status_t status, ed::message & msg)
+            {
+                if(status == communicator::request_status_t::REQUEST_STATUS_REPLY)
+                {
+                    CATCH_REQUIRE(msg.get_parameter(communicator::g_name_communicator_param_service) == "cluckd");
+                }
+                results.push_back(status);
+            });
+
+        ed::connection::vector_t const & connections(ed::communicator::instance()->get_connections());
+        auto const in_communicator([]()
+            {
+                return find_request_timer() != nullptr;
+            });
+        CATCH_REQUIRE_FALSE(in_communicator());
+
+        CATCH_REQUIRE(messenger->wait_for_status("cluckd", "up", callback, std::chrono::minutes(1)) != communicator::pending_requests::REQUEST_ID_NONE);
+        CATCH_REQUIRE(messenger->pending_request_count() == 1);
+
+        // the request timer has to be in the event loop to time out the
+        // wait, the messenger itself is left alone
+        //
+        CATCH_REQUIRE(in_communicator());
+        CATCH_REQUIRE(std::find(connections.begin(), connections.end(), messenger) == connections.end());
+
+        ed::message down(status_message("cluckd", "down"));
+        messenger->get_dispatcher()->dispatch(down);
+        CATCH_REQUIRE(results.empty());
+
+        ed::message up(status_message("cluckd", "up"));
+        messenger->get_dispatcher()->dispatch(up);
+        CATCH_REQUIRE(results == std::vector<communicator::request_status_t>{ communicator::request_status_t::REQUEST_STATUS_REPLY });
+        CATCH_REQUIRE(messenger->pending_request_count() == 0);
+        CATCH_REQUIRE_FALSE(in_communicator());
+
+        // a canceled wait does not call the callback
+        //
+        communicator::pending_requests::request_id_t const id(messenger->wait_for_status("cluckd", "down", callback, std::chrono::minutes(1)));
+        CATCH_REQUIRE(messenger->cancel_request(id));
+        messenger->get_dispatcher()->dispatch(down);
+        CATCH_REQUIRE(results.size() == 1);
+
+        // the wait times out
+        //
+        messenger->wait_for_status("cluckd", "down", callback, std::chrono::microseconds(0));
+        find_request_timer()->process_timeout();
+        CATCH_REQUIRE(results.size() == 2);
+        CATCH_REQUIRE(results[1] == communicator::request_status_t::REQUEST_STATUS_TIMEOUT);
+
+        // closing the connection cancels the wait
+        //
+        messenger->wait_for_status("cluckd", "down", callback, std::chrono::minutes(1));
+        messenger->unregister_communicator(true);
+        CATCH_REQUIRE(results.size() == 3);
+        CATCH_REQUIRE(results[2] == communicator::request_status_t::REQUEST_STATUS_CANCELED);
+        CATCH_REQUIRE(messenger->pending_request_count() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("communicator_client_waiters: awaitables always resume")
+    {
+        std::vector<std::string> const args = {
+            "test-service", // name of command
+            "--path-to-message-definitions",
+            SNAP_CATCH2_NAMESPACE::g_source_dir() + "/tests/message-definitions:"
+                + SNAP_CATCH2_NAMESPACE::g_source_dir() + "/daemon/message-definitions:"
+                + SNAP_CATCH2_NAMESPACE::g_dist_dir() + "/share/eventdispatcher/messages",
+        };
+        std::vector<char const *> args_strings;
+        for(auto const & arg : args)
+        {
+            args_strings.push_back(arg.c_str());
+        }
+        args_strings.push_back(nullptr);
+
+        advgetopt::getopt opts(g_options_environment);
+        test_messenger::pointer_t messenger(std::make_shared<test_messenger>(
+                  opts
+                , args.size()
+                , const_cast<char **>(args_strings.data())
+                , test_messenger::sequence_t::SEQUENCE_SUCCESS));
+
+        int resumed(0);
+
+        // the status is reached
+        //
+        communicator::status_awaitable up(messenger->wait_for_status("prinbee", "up", std::chrono::minutes(1)));
+        CATCH_REQUIRE_FALSE(up.await_ready());
+        up.await_suspend(test_handle{ &resumed });
+        CATCH_REQUIRE(resumed == 0);
+        ed::message status(status_message("prinbee", "up"));
+        messenger->get_dispatcher()->dispatch(status);
+        CATCH_REQUIRE(resumed == 1);
+        communicator::request_result const up_result(up.await_resume());
+        CATCH_REQUIRE(static_cast<bool>(up_result));
+        CATCH_REQUIRE(up_result.f_reply.get_parameter(communicator::g_name_communicator_param_status) == "up");
+
+        // the wait times out
+        //
+        communicator::status_awaitable timeout(messenger->wait_for_status("prinbee", "down", std::chrono::microseconds(0)));
+        timeout.await_suspend(test_handle{ &resumed });
+        find_request_timer()->process_timeout();
+        CATCH_REQUIRE(resumed == 2);
+        communicator::request_result const timeout_result(timeout.await_resume());
+        CATCH_REQUIRE_FALSE(static_cast<bool>(timeout_result));
+        CATCH_REQUIRE(timeout_result.f_status == communicator::request_status_t::REQUEST_STATUS_TIMEOUT);
+
+        // the request cannot be sent, the coroutine does not get suspended
+        //
+        ed::message msg;
+        msg.set_service("cluckd");
+        msg.set_command("LOCK");
+        communicator::request_awaitable request(messenger->request(msg, std::chrono::seconds(1)));
+        CATCH_REQUIRE_FALSE(request.await_ready());
+        CATCH_REQUIRE_FALSE(request.await_suspend(test_handle{ &resumed }));
+        CATCH_REQUIRE(resumed == 2);
+        CATCH_REQUIRE(request.await_resume().f_status == communicator::request_status_t::REQUEST_STATUS_CANCELED);
+        CATCH_REQUIRE(messenger->pending_request_count() == 0);
+
+        // closing the connection resumes the coroutine
+        //
+        communicator::status_awaitable closed(messenger->wait_for_status("prinbee", "down", std::chrono::minutes(1)));
+        closed.await_suspend(test_handle{ &resumed });
+        messenger->unregister_communicator(true);
+        CATCH_REQUIRE(resumed == 3);
+        CATCH_REQUIRE(closed.await_resume().f_status == communicator::request_status_t::REQUEST_STATUS_CANCELED);
+
+        // destroying the connection resumes the coroutine
+        //
+        communicator::status_awaitable destroyed(messenger->wait_for_status("prinbee", "down", std::chrono::minutes(1)));
+        destroyed.await_suspend(test_handle{ &resumed });
+        CATCH_REQUIRE(find_request_timer() != nullptr);
+        messenger.reset();
+        CATCH_REQUIRE(resumed == 4);
+        CATCH_REQUIRE(destroyed.await_resume().f_status == communicator::request_status_t::REQUEST_STATUS_CANCELED);
+        CATCH_REQUIRE(find_request_timer() == nullptr);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("communicator_client_waiters: exceptions leaving a task are logged")
+    {
+        // the task promise calls this function from unhandled_exception()
+        // which must not let the exception go through the event loop
+        //
+        try
+        {
+            throw std::runtime_error("coroutine failed");
+        }
+        catch(...)
+        {
+            communicator::task_exception(std::current_exception());
+        }
+
+        try
+        {
+            throw 33;
+        }
+        catch(...)
+        {
+            communicator::task_exception(std::current_exception());
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
 // vim: ts=4 sw=4 et
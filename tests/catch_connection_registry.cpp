@@ -0,0 +1,280 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the connection_registry class.
+ *
+ * This file implements tests to verify that the connection_registry
+ * class properly sorts connections by kind.
+ *
+ * It also verifies that the fan-out of a message to 1,000 connections
+ * through the registry finds the same connections as the chain of
+ * dynamic_pointer_cast<>() the daemon used to go through. The
+ * connection-registry-benchmark tool times both loops.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/base_connection.h>
+#include    <communicator/daemon/connection_registry.h>
+
+
+
+namespace
+{
+
+
+// this mimics the ed::connection, the real connections derive from
+// an ed::connection and the base_connection
+//
+class fake_ed_connection
+{
+public:
+    typedef std::shared_ptr<fake_ed_connection> pointer_t;
+
+    virtual ~fake_ed_connection()
+    {
+    }
+};
+
+
+template<communicator_daemon::connection_kind_t kind>
+class test_connection
+    : public fake_ed_connection
+    , public communicator_daemon::base_connection
+{
+public:
+    test_connection()
+        : base_connection(nullptr, kind)
+    {
+    }
+
+    virtual int get_socket() const override
+    {
+        return -1;
+    }
+};
+
+
+typedef test_connection<communicator_daemon::connection_kind_t::CONNECTION_KIND_SERVICE>    test_service_connection;
+typedef test_connection<communicator_daemon::connection_kind_t::CONNECTION_KIND_UNIX>       test_unix_connection;
+typedef test_connection<communicator_daemon::connection_kind_t::CONNECTION_KIND_REMOTE>     test_remote_connection;
+
+
+} // no name namespace
+
+
+
+CATCH_TEST_CASE("connection_registry", "[connection]")
+{
+    CATCH_START_SECTION("connection_registry: add & remove connections")
+    {
+        communicator_daemon::connection_registry registry;
+        std::shared_ptr<test_service_connection> service(std::make_shared<test_service_connection>());
+        std::shared_ptr<test_unix_connection> unix_conn(std::make_shared<test_unix_connection>());
+        std::shared_ptr<test_remote_connection> remote(std::make_shared<test_remote_connection>());
+
+        CATCH_REQUIRE(registry.size() == 0);
+
+        registry.add_connection(service);
+        registry.add_connection(unix_conn);
+        registry.add_connection(remote);
+        registry.add_connection(remote);
+        registry.add_connection(nullptr);
+        CATCH_REQUIRE(registry.size() == 3);
+
+        CATCH_REQUIRE(registry.get_connections(communicator_daemon::connection_kind_t::CONNECTION_KIND_SERVICE).size() == 1);
+        CATCH_REQUIRE(registry.get_connections(communicator_daemon::connection_kind_t::CONNECTION_KIND_SERVICE)[0] == service);
+        CATCH_REQUIRE(registry.get_connections(communicator_daemon::connection_kind_t::CONNECTION_KIND_UNIX).size() == 1);
+        CATCH_REQUIRE(registry.get_connections(communicator_daemon::connection_kind_t::CONNECTION_KIND_UNIX)[0] == unix_conn);
+        CATCH_REQUIRE(registry.get_connections(communicator_daemon::connection_kind_t::CONNECTION_KIND_REMOTE).size() == 1);
+        CATCH_REQUIRE(registry.get_connections(communicator_daemon::connection_kind_t::CONNECTION_KIND_REMOTE)[0] == remote);
+        CATCH_REQUIRE(registry.get_connections(communicator_daemon::connection_kind_t::CONNECTION_KIND_PING).empty());
+
+        registry.remove_connection(unix_conn);
+        registry.remove_connection(unix_conn);
+        CATCH_REQUIRE(registry.size() == 2);
+        CATCH_REQUIRE(registry.get_connections(communicator_daemon::connection_kind_t::CONNECTION_KIND_UNIX).empty());
+
+        registry.remove_connection(service);
+        registry.remove_connection(remote);
+        CATCH_REQUIRE(registry.size() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("connection_registry: command subscribers")
+    {
+        communicator_daemon::connection_registry registry;
+        std::shared_ptr<test_service_connection> service(std::make_shared<test_service_connection>());
+        std::shared_ptr<test_unix_connection> unix_conn(std::make_shared<test_unix_connection>());
+        std::shared_ptr<test_unix_connection> unregistered(std::make_shared<test_unix_connection>());
+
+        registry.add_connection(service);
+        registry.add_connection(unix_conn);
+
+        service->add_commands("HELP,STATUS,STOP");
+        registry.add_commands(service);
+        unix_conn->add_commands("HELP,STOP");
+        registry.add_commands(unix_conn);
+        unregistered->add_commands("STATUS");
+        registry.add_commands(unregistered);
+
+        CATCH_REQUIRE(registry.get_subscribers("STATUS").size() == 1);
+        CATCH_REQUIRE(registry.get_subscribers("STATUS")[0] == service);
+        CATCH_REQUIRE(registry.get_subscribers("HELP").size() == 2);
+        CATCH_REQUIRE(registry.get_subscribers("UNKNOWN_COMMAND").empty());
+
+        // a second COMMANDS does not duplicate the entries
+        //
+        unix_conn->add_commands("STATUS");
+        registry.add_commands(unix_conn);
+        CATCH_REQUIRE(registry.get_subscribers("STATUS").size() == 2);
+        CATCH_REQUIRE(registry.get_subscribers("STOP").size() == 2);
+
+        registry.remove_connection(service);
+        CATCH_REQUIRE(registry.get_subscribers("STATUS").size() == 1);
+        CATCH_REQUIRE(registry.get_subscribers("STATUS")[0] == unix_conn);
+
+        registry.remove_connection(unix_conn);
+        CATCH_REQUIRE(registry.get_subscribers("STATUS").empty());
+        CATCH_REQUIRE(registry.get_subscribers("HELP").empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("connection_registry: connection kind")
+    {
+        std::shared_ptr<test_unix_connection> unix_conn(std::make_shared<test_unix_connection>());
+        CATCH_REQUIRE(unix_conn->get_connection_kind() == communicator_daemon::connection_kind_t::CONNECTION_KIND_UNIX);
+        CATCH_REQUIRE_FALSE(unix_conn->is_udp());
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("connection_registry_fan_out", "[connection]")
+{
+    CATCH_START_SECTION("connection_registry_fan_out: fan-out to 1,000 connections")
+    {
+        std::size_t const connection_count(1'000);
+
+        // create a mix of connections similar to what a busy daemon
+        // would have: mainly local services and a few remote daemons
+        //
+        std::vector<fake_ed_connection::pointer_t> all_connections;
+        communicator_daemon::connection_registry registry;
+        for(std::size_t idx(0); idx < connection_count; ++idx)
+        {
+            fake_ed_connection::pointer_t c;
+            communicator_daemon::base_connection::pointer_t b;
+            switch(idx % 10)
+            {
+            case 0:
+                {
+                    std::shared_ptr<test_remote_connection> r(std::make_shared<test_remote_connection>());
+                    c = r;
+                    b = r;
+                }
+                break;
+
+            case 1:
+            case 2:
+            case 3:
+                {
+                    std::shared_ptr<test_service_connection> s(std::make_shared<test_service_connection>());
+                    c = s;
+                    b = s;
+                }
+                break;
+
+            default:
+                {
+                    std::shared_ptr<test_unix_connection> u(std::make_shared<test_unix_connection>());
+                    c = u;
+                    b = u;
+                }
+                break;
+
+            }
+            b->add_commands("STATUS");
+            all_connections.push_back(c);
+            registry.add_connection(b);
+        }
+
+        // before: go through all the connections and check the type
+        //         using dynamic_pointer_cast<>() like the daemon did
+        //
+        std::size_t before_count(0);
+        for(auto const & nc : all_connections)
+        {
+            std::shared_ptr<test_unix_connection> u(std::dynamic_pointer_cast<test_unix_connection>(nc));
+            if(u != nullptr)
+            {
+                if(u->understand_command("STATUS"))
+                {
+                    ++before_count;
+                }
+                continue;
+            }
+            std::shared_ptr<test_service_connection> s(std::dynamic_pointer_cast<test_service_connection>(nc));
+            if(s != nullptr)
+            {
+                if(s->understand_command("STATUS"))
+                {
+                    ++before_count;
+                }
+                continue;
+            }
+            std::shared_ptr<test_remote_connection> rc(std::dynamic_pointer_cast<test_remote_connection>(nc));
+            if(rc != nullptr)
+            {
+                // remote connections are not local services
+                continue;
+            }
+        }
+
+        // after: only go through the local connections using the registry
+        //
+        std::size_t after_count(0);
+        for(communicator_daemon::connection_kind_t const kind : {
+                      communicator_daemon::connection_kind_t::CONNECTION_KIND_UNIX
+                    , communicator_daemon::connection_kind_t::CONNECTION_KIND_SERVICE })
+        {
+            for(auto const & c : registry.get_connections(kind))
+            {
+                if(c->understand_command("STATUS"))
+                {
+                    ++after_count;
+                }
+            }
+        }
+
+        // both loops must find the same connections
+        //
+        CATCH_REQUIRE(before_count == after_count);
+        CATCH_REQUIRE(after_count == connection_count * 9 / 10);
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,203 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the dissemination class.
+ *
+ * This file implements tests to verify the selection of the neighbors
+ * which receive a broadcast message. The tools/broadcast_benchmark.cpp
+ * tool compares the strategies in simulated clusters.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/dissemination.h>
+#include    <communicator/daemon/neighbor_ids.h>
+
+
+// C++
+//
+#include    <algorithm>
+
+
+
+CATCH_TEST_CASE("dissemination", "[broadcast]")
+{
+    CATCH_START_SECTION("dissemination: flood")
+    {
+        communicator_daemon::dissemination d;
+        CATCH_REQUIRE(d.get_strategy() == communicator_daemon::strategy_t::STRATEGY_FLOOD);
+        CATCH_REQUIRE(d.get_max_hops() == communicator_daemon::dissemination::FLOOD_MAX_HOPS);
+
+        bool flood(false);
+        CATCH_REQUIRE(d.select({ 3, -1, 7 }, 0, 0, 10, flood) == std::vector<std::size_t>({ 0, 1, 2 }));
+        CATCH_REQUIRE_FALSE(flood);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("dissemination: tree")
+    {
+        communicator_daemon::dissemination d;
+        d.set_strategy(communicator_daemon::strategy_t::STRATEGY_TREE);
+        d.set_fanout(2);
+
+        // members 0 to 9, originator is 5 so 5 has rank 0, 6 rank 1, etc.
+        //
+        std::vector<std::int32_t> all;
+        for(std::int32_t id(0); id < 10; ++id)
+        {
+            all.push_back(id);
+        }
+
+        // the originator sends to ranks 1 and 2 (ids 6 and 7)
+        //
+        bool flood(false);
+        CATCH_REQUIRE(d.select(all, 5, 5, 10, flood) == std::vector<std::size_t>({ 6, 7 }));
+        CATCH_REQUIRE_FALSE(flood);
+
+        // rank 1 (id 6) sends to ranks 3 and 4 (ids 8 and 9)
+        //
+        CATCH_REQUIRE(d.select(all, 6, 5, 10, flood) == std::vector<std::size_t>({ 8, 9 }));
+        CATCH_REQUIRE_FALSE(flood);
+
+        // rank 4 (id 9) sends to rank 9 (id 4), rank 10 does not exist
+        //
+        CATCH_REQUIRE(d.select(all, 9, 5, 10, flood) == std::vector<std::size_t>({ 4 }));
+
+        // a leaf sends nothing
+        //
+        CATCH_REQUIRE(d.select(all, 4, 5, 10, flood).empty());
+        CATCH_REQUIRE_FALSE(flood);
+
+        // id 9 is not connected to us, flood instead
+        //
+        CATCH_REQUIRE(d.select({ 1, 2, 8 }, 6, 5, 10, flood) == std::vector<std::size_t>({ 0, 1, 2 }));
+        CATCH_REQUIRE(flood);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("dissemination: gossip")
+    {
+        communicator_daemon::dissemination d;
+        d.set_strategy(communicator_daemon::strategy_t::STRATEGY_GOSSIP);
+        d.set_redundancy(3);
+
+        // ceil(ln(100)) + 3
+        //
+        CATCH_REQUIRE(d.get_fanout(100) == 8);
+
+        std::vector<std::int32_t> all;
+        for(std::int32_t id(0); id < 100; ++id)
+        {
+            all.push_back(id);
+        }
+        bool flood(false);
+        std::vector<std::size_t> selected(d.select(all, 0, 0, 100, flood));
+        CATCH_REQUIRE(selected.size() == 8);
+        std::sort(selected.begin(), selected.end());
+        CATCH_REQUIRE(std::unique(selected.begin(), selected.end()) == selected.end());
+
+        d.set_fanout(200);
+        CATCH_REQUIRE(d.select(all, 0, 0, 100, flood).size() == 100);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("dissemination: tree with different members")
+    {
+        communicator_daemon::dissemination d;
+        d.set_strategy(communicator_daemon::strategy_t::STRATEGY_TREE);
+        d.set_fanout(2);
+
+        // the originator (10.0.0.1) does not yet know about 10.0.0.3
+        //
+        communicator_daemon::neighbor_ids sender;
+        sender.set_members({ "10.0.0.1", "10.0.0.2", "10.0.0.4", "10.0.0.5", "10.0.0.6" });
+        communicator_daemon::neighbor_ids receiver;
+        receiver.set_members({ "10.0.0.1", "10.0.0.2", "10.0.0.3", "10.0.0.4", "10.0.0.5", "10.0.0.6" });
+
+        // the originator sends to ranks 1 and 2 of its own list
+        //
+        std::vector<std::string> const sender_candidates({ "10.0.0.2", "10.0.0.4", "10.0.0.5", "10.0.0.6" });
+        std::vector<std::int32_t> ids;
+        for(auto const & a : sender_candidates)
+        {
+            ids.push_back(sender.get_id(a));
+        }
+        bool flood(false);
+        std::vector<std::size_t> const selected(d.select(
+                  ids
+                , sender.get_id("10.0.0.1")
+                , sender.get_id("10.0.0.1")
+                , sender.size()
+                , flood));
+        CATCH_REQUIRE(selected == std::vector<std::size_t>({ 0, 1 }));
+        CATCH_REQUIRE_FALSE(flood);
+
+        communicator_daemon::neighbor_ids::informed_t informed;
+        sender.insert(informed, "10.0.0.1");
+        for(auto const idx : selected)
+        {
+            sender.insert(informed, sender_candidates[idx]);
+        }
+        std::string const encoded(sender.encode(informed));
+
+        // with its own list, 10.0.0.4 has rank 3 and no children while
+        // 10.0.0.3 has rank 2 and expects the message from the originator
+        // which does not know about it: nobody would send it the message
+        //
+        std::vector<std::int32_t> const receiver_candidates({
+                  receiver.get_id("10.0.0.3")
+                , receiver.get_id("10.0.0.5")
+                , receiver.get_id("10.0.0.6") });
+        CATCH_REQUIRE(d.select(
+                  receiver_candidates
+                , receiver.get_id("10.0.0.4")
+                , receiver.get_id("10.0.0.1")
+                , receiver.size()
+                , flood).empty());
+        CATCH_REQUIRE_FALSE(flood);
+
+        // the digest tells the receiver that the lists differ so it
+        // floods instead
+        //
+        communicator_daemon::neighbor_ids::informed_t const decoded(receiver.decode(encoded));
+        CATCH_REQUIRE_FALSE(decoded.f_same_members);
+        flood = !decoded.f_same_members;
+        CATCH_REQUIRE(d.select(
+                  receiver_candidates
+                , receiver.get_id("10.0.0.4")
+                , receiver.get_id("10.0.0.1")
+                , receiver.size()
+                , flood) == std::vector<std::size_t>({ 0, 1, 2 }));
+        CATCH_REQUIRE(flood);
+
+        // with the same list, the tree is used
+        //
+        communicator_daemon::neighbor_ids::informed_t const same(sender.decode(encoded));
+        CATCH_REQUIRE(same.f_same_members);
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
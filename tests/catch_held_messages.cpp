@@ -0,0 +1,158 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the held_messages class.
+ *
+ * This file implements tests to verify that the bulk messages get
+ * written in batches and that the messages held in between are limited.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/held_messages.h>
+
+
+
+namespace
+{
+
+
+
+ed::message bulk_message(int value)
+{
+    ed::message msg;
+    msg.set_command("DATA");
+    msg.set_service("backup");
+    msg.add_parameter("value", value);
+    return msg;
+}
+
+
+
+} // no name namespace
+
+
+
+CATCH_TEST_CASE("held_messages", "[connection]")
+{
+    CATCH_START_SECTION("held_messages: batches")
+    {
+        communicator_daemon::held_messages held;
+
+        // the first batch gets sent immediately
+        //
+        for(std::size_t count(0); count < communicator_daemon::held_messages::BULK_BATCH; ++count)
+        {
+            CATCH_REQUIRE(held.add_to_batch());
+        }
+        CATCH_REQUIRE_FALSE(held.add_to_batch());
+
+        for(int value(0); value < 100; ++value)
+        {
+            held.push(bulk_message(value), value % 2 == 0);
+        }
+        CATCH_REQUIRE(held.count() == 100);
+
+        // nothing more is sent until the buffer is empty
+        //
+        communicator_daemon::held_messages::held_message_t m;
+        CATCH_REQUIRE_FALSE(held.next(m));
+
+        // the next batch comes out in order
+        //
+        held.end_batch();
+        int expected(0);
+        while(held.next(m))
+        {
+            CATCH_REQUIRE(m.f_message.get_parameter("value") == std::to_string(expected));
+            CATCH_REQUIRE(m.f_cache == (expected % 2 == 0));
+            ++expected;
+        }
+        CATCH_REQUIRE(expected == static_cast<int>(communicator_daemon::held_messages::BULK_BATCH));
+        CATCH_REQUIRE(held.count() == 100 - communicator_daemon::held_messages::BULK_BATCH);
+
+        // a new bulk message cannot go ahead of the held ones
+        //
+        held.end_batch();
+        CATCH_REQUIRE_FALSE(held.add_to_batch());
+
+        // a lost connection takes them all
+        //
+        communicator_daemon::held_messages::queue_t const released(held.release());
+        CATCH_REQUIRE(released.size() == 100 - communicator_daemon::held_messages::BULK_BATCH);
+        CATCH_REQUIRE(released.front().f_message.get_parameter("value") == std::to_string(expected));
+        CATCH_REQUIRE(held.empty());
+        CATCH_REQUIRE(held.add_to_batch());
+        CATCH_REQUIRE(held.get_dropped() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("held_messages: limits")
+    {
+        communicator_daemon::held_messages held;
+        CATCH_REQUIRE_FALSE(held.is_full());
+
+        held.set_limits(3, 0);
+        for(int value(0); value < 3; ++value)
+        {
+            CATCH_REQUIRE_FALSE(held.is_full());
+            held.push(bulk_message(value), false);
+        }
+        CATCH_REQUIRE(held.is_full());
+        CATCH_REQUIRE(held.size() == 0);
+
+        held.drop_newest();
+        CATCH_REQUIRE(held.count() == 3);
+        CATCH_REQUIRE(held.get_dropped() == 1);
+
+        CATCH_REQUIRE(held.drop_oldest());
+        CATCH_REQUIRE(held.count() == 2);
+        CATCH_REQUIRE(held.get_dropped() == 2);
+        held.push(bulk_message(3), false);
+
+        communicator_daemon::held_messages::held_message_t m;
+        CATCH_REQUIRE(held.next(m));
+        CATCH_REQUIRE(m.f_message.get_parameter("value") == "1");
+
+        // the number of bytes is limited too
+        //
+        std::size_t const size(bulk_message(0).to_message().length());
+        communicator_daemon::held_messages bytes;
+        bytes.set_limits(0, size * 2);
+        bytes.push(bulk_message(0), false);
+        CATCH_REQUIRE(bytes.size() == size);
+        CATCH_REQUIRE_FALSE(bytes.is_full());
+        bytes.push(bulk_message(1), false);
+        CATCH_REQUIRE(bytes.is_full());
+        CATCH_REQUIRE(bytes.drop_oldest());
+        CATCH_REQUIRE(bytes.size() == size);
+        CATCH_REQUIRE(bytes.next(m));
+        CATCH_REQUIRE(bytes.size() == 0);
+        CATCH_REQUIRE(m.f_message.get_parameter("value") == "1");
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,87 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator
+//
+#include    <communicator/interned_names.h>
+#include    <communicator/names.h>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+
+CATCH_TEST_CASE("interned_names", "[names]")
+{
+    CATCH_START_SECTION("interned_names: all names are found")
+    {
+        for(std::size_t idx(0); idx < std::size(communicator::detail::g_command_names); ++idx)
+        {
+            CATCH_REQUIRE(static_cast<std::size_t>(communicator::intern_command(communicator::detail::g_command_names[idx])) == idx + 1);
+        }
+        for(std::size_t idx(0); idx < std::size(communicator::detail::g_parameter_names); ++idx)
+        {
+            CATCH_REQUIRE(static_cast<std::size_t>(communicator::intern_parameter(communicator::detail::g_parameter_names[idx])) == idx + 1);
+        }
+        for(std::size_t idx(0); idx < std::size(communicator::detail::g_service_names); ++idx)
+        {
+            CATCH_REQUIRE(static_cast<std::size_t>(communicator::intern_service(communicator::detail::g_service_names[idx])) == idx + 1);
+        }
+        for(std::size_t idx(0); idx < std::size(communicator::detail::g_server_names); ++idx)
+        {
+            CATCH_REQUIRE(static_cast<std::size_t>(communicator::intern_server(communicator::detail::g_server_names[idx])) == idx + 1);
+        }
+        for(std::size_t idx(0); idx < std::size(communicator::detail::g_dictionary_values); ++idx)
+        {
+            CATCH_REQUIRE(communicator::intern_dictionary_value(communicator::detail::g_dictionary_values[idx]) == idx + 1);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("interned_names: match the atomic names")
+    {
+        CATCH_REQUIRE(communicator::intern_command(communicator::g_name_communicator_cmd_status) == communicator::command_id_t::COMMAND_ID_STATUS);
+        CATCH_REQUIRE(communicator::intern_parameter(communicator::g_name_communicator_param_framing) == communicator::parameter_id_t::PARAMETER_ID_FRAMING);
+        CATCH_REQUIRE(communicator::intern_service(communicator::g_name_communicator_service_communicatord) == communicator::service_id_t::SERVICE_ID_COMMUNICATORD);
+        CATCH_REQUIRE(communicator::intern_service(communicator::g_name_communicator_service_public_broadcast) == communicator::service_id_t::SERVICE_ID_PUBLIC_BROADCAST);
+        CATCH_REQUIRE(communicator::intern_server(communicator::g_name_communicator_server_remote) == communicator::server_id_t::SERVER_ID_REMOTE);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("interned_names: unknown names")
+    {
+        CATCH_REQUIRE(communicator::intern_command("") == communicator::command_id_t::COMMAND_ID_UNKNOWN);
+        CATCH_REQUIRE(communicator::intern_command("status") == communicator::command_id_t::COMMAND_ID_UNKNOWN);
+        CATCH_REQUIRE(communicator::intern_parameter("my_address") == communicator::parameter_id_t::PARAMETER_ID_UNKNOWN);
+        CATCH_REQUIRE(communicator::intern_service("my_service") == communicator::service_id_t::SERVICE_ID_UNKNOWN);
+        CATCH_REQUIRE(communicator::intern_server("snap1") == communicator::server_id_t::SERVER_ID_UNKNOWN);
+        CATCH_REQUIRE(communicator::intern_dictionary_value("snap1") == 0);
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,347 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the link_codec class.
+ *
+ * This file implements tests to verify the negotiation of the framing
+ * of the daemon links and the encoding of the messages in the compact
+ * framing, with and without the dictionary compression.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/link_codec.h>
+#include    <communicator/daemon/link_dictionary.h>
+
+
+// communicator
+//
+#include    <communicator/names.h>
+
+
+// eventdispatcher
+//
+#include    <eventdispatcher/message.h>
+
+
+
+CATCH_TEST_CASE("link_codec", "[message]")
+{
+    CATCH_START_SECTION("link_codec: negotiation")
+    {
+        std::string const framing(communicator_daemon::link_codec::get_framing_name());
+        CATCH_REQUIRE(framing.length() == 17);
+        CATCH_REQUIRE(framing.substr(0, 9) == "compact2-");
+
+        CATCH_REQUIRE(communicator_daemon::link_codec::negotiate_framing(framing) == framing);
+        CATCH_REQUIRE(communicator_daemon::link_codec::negotiate_framing("compact9-00000000, " + framing) == framing);
+        CATCH_REQUIRE(communicator_daemon::link_codec::negotiate_framing("compact2-00000000") == "text");
+        CATCH_REQUIRE(communicator_daemon::link_codec::negotiate_framing(std::string()) == "text");
+
+        communicator_daemon::link_codec codec;
+        CATCH_REQUIRE_FALSE(codec.is_compact());
+        CATCH_REQUIRE_FALSE(codec.is_decoding());
+
+        codec.offer_framing();
+        CATCH_REQUIRE_FALSE(codec.is_compact());
+        CATCH_REQUIRE(codec.is_decoding());
+
+        codec.set_framing(framing);
+        CATCH_REQUIRE(codec.is_compact());
+        CATCH_REQUIRE(codec.is_decoding());
+
+        codec.reset();
+        CATCH_REQUIRE_FALSE(codec.is_compact());
+        CATCH_REQUIRE_FALSE(codec.is_decoding());
+
+        codec.offer_framing();
+        codec.set_framing("text");
+        CATCH_REQUIRE_FALSE(codec.is_compact());
+        CATCH_REQUIRE_FALSE(codec.is_decoding());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("link_codec: well known names")
+    {
+        ed::message msg;
+        msg.set_sent_from_server("snap1");
+        msg.set_sent_from_service(communicator::g_name_communicator_service_communicatord);
+        msg.set_service(communicator::g_name_communicator_service_cluster);
+        msg.set_command(communicator::g_name_communicator_cmd_hangup);
+        msg.add_parameter(communicator::g_name_communicator_param_broadcast_hops, 1);
+        msg.add_parameter(communicator::g_name_communicator_param_server_name, "snap2");
+
+        communicator_daemon::link_codec codec;
+        ed::message compact(codec.encode(msg));
+        CATCH_REQUIRE(compact.to_message() == "<snap1:_2 _1/_17 _3=1;_48=snap2");
+        CATCH_REQUIRE(compact.to_message().length() < msg.to_message().length());
+
+        ed::message decoded;
+        CATCH_REQUIRE(decoded.from_message(compact.to_message()));
+        CATCH_REQUIRE(codec.decode(decoded));
+        CATCH_REQUIRE(decoded.to_message() == msg.to_message());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("link_codec: other names")
+    {
+        ed::message msg;
+        msg.set_service("cluckd");
+        msg.set_command("LOCK");
+        msg.add_parameter("object_name", "abc");
+        msg.add_parameter("_private", "yes");
+        msg.add_parameter(communicator::g_name_communicator_param_ip, "10.0.0.1");
+
+        communicator_daemon::link_codec codec;
+        ed::message compact(codec.encode(msg));
+        CATCH_REQUIRE(compact.get_service() == "cluckd");
+        CATCH_REQUIRE(compact.get_command() == "_LOCK");
+        CATCH_REQUIRE(compact.has_parameter("object_name"));
+        CATCH_REQUIRE(compact.has_parameter("__private"));
+
+        // an identifier is not used when it is not shorter than the name
+        //
+        CATCH_REQUIRE(compact.has_parameter("ip"));
+
+        ed::message decoded;
+        CATCH_REQUIRE(decoded.from_message(compact.to_message()));
+        CATCH_REQUIRE(codec.decode(decoded));
+        CATCH_REQUIRE(decoded.to_message() == msg.to_message());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("link_codec: text messages are left alone")
+    {
+        ed::message msg;
+        msg.set_service("cluckd");
+        msg.set_command("LOCK");
+        msg.add_parameter("_1", "abc");
+        std::string const line(msg.to_message());
+
+        communicator_daemon::link_codec codec;
+        CATCH_REQUIRE(codec.decode(msg));
+        CATCH_REQUIRE(msg.to_message() == line);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("link_codec: compression negotiation")
+    {
+        std::string const compression(communicator_daemon::link_codec::get_compression_name());
+        CATCH_REQUIRE(communicator_daemon::link_codec::negotiate_compression(compression) == compression);
+        CATCH_REQUIRE(communicator_daemon::link_codec::negotiate_compression("zlib, " + compression) == compression);
+        CATCH_REQUIRE(communicator_daemon::link_codec::negotiate_compression("zlib").empty());
+        CATCH_REQUIRE(communicator_daemon::link_codec::negotiate_compression(std::string()).empty());
+
+        communicator_daemon::link_codec codec;
+        codec.set_framing(communicator_daemon::link_codec::get_framing_name());
+        codec.set_compression(compression);
+        CATCH_REQUIRE_FALSE(codec.is_compressing());
+
+        codec.allow_compression(true);
+        CATCH_REQUIRE(codec.is_compression_allowed());
+        codec.set_compression(compression);
+        CATCH_REQUIRE(codec.is_compressing());
+
+        codec.reset();
+        CATCH_REQUIRE_FALSE(codec.is_compressing());
+        CATCH_REQUIRE(codec.is_compression_allowed());
+
+        // the compression requires the compact framing
+        //
+        codec.set_compression(compression);
+        CATCH_REQUIRE_FALSE(codec.is_compressing());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("link_codec: escape the introducers")
+    {
+        ed::message msg;
+        msg.set_server("_snap2");
+        msg.set_service("cluckd");
+        msg.set_command("LOCK");
+        msg.add_parameter("object_name", "@abc");
+
+        communicator_daemon::link_codec codec;
+        ed::message compact(codec.encode(msg));
+        CATCH_REQUIRE(compact.get_server() == "__snap2");
+        CATCH_REQUIRE(compact.get_parameter("object_name") == "@@abc");
+
+        ed::message decoded;
+        CATCH_REQUIRE(decoded.from_message(compact.to_message()));
+        CATCH_REQUIRE(codec.decode(decoded));
+        CATCH_REQUIRE(decoded.to_message() == msg.to_message());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("link_codec: dictionary")
+    {
+        communicator_daemon::link_codec sender;
+        sender.allow_compression(true);
+        sender.set_framing(communicator_daemon::link_codec::get_framing_name());
+        sender.set_compression(communicator_daemon::link_codec::get_compression_name());
+
+        communicator_daemon::link_codec receiver;
+        receiver.offer_framing();
+
+        std::size_t const first(communicator_daemon::link_dictionary::get_static_size() + 1);
+        std::string const snap1("_" + std::to_string(first));
+        std::string const lock_name("@" + std::to_string(first + 1));
+
+        std::string lines[3];
+        for(std::size_t idx(0); idx < std::size(lines); ++idx)
+        {
+            ed::message msg;
+            msg.set_sent_from_server("snap1");
+            msg.set_sent_from_service("cluckd");
+            msg.set_service("cluckd");
+            msg.set_command("LOCK");
+            msg.add_parameter("object_name", "website-lock");
+            msg.add_parameter("status", communicator::g_name_communicator_value_up);
+
+            ed::message compact(sender.encode(msg));
+            lines[idx] = compact.to_message();
+
+            ed::message decoded;
+            CATCH_REQUIRE(decoded.from_message(lines[idx]));
+            CATCH_REQUIRE(receiver.decode(decoded));
+            CATCH_REQUIRE(decoded.to_message() == msg.to_message());
+
+            switch(idx)
+            {
+            case 0:
+                // first sighting, values sent as is
+                //
+                CATCH_REQUIRE(compact.get_sent_from_server() == "snap1");
+                CATCH_REQUIRE(compact.get_parameter("object_name") == "website-lock");
+                CATCH_REQUIRE_FALSE(compact.has_parameter("_0"));
+                break;
+
+            case 1:
+                // second sighting, values defined and referenced
+                //
+                CATCH_REQUIRE(compact.get_sent_from_server() == snap1);
+                CATCH_REQUIRE(compact.get_parameter("object_name") == lock_name);
+                CATCH_REQUIRE(compact.get_parameter("_0")
+                        == std::to_string(first) + ":5:snap1"
+                         + std::to_string(first + 1) + ":12:website-lock");
+                break;
+
+            default:
+                // references only
+                //
+                CATCH_REQUIRE(compact.get_sent_from_server() == snap1);
+                CATCH_REQUIRE(compact.get_parameter("object_name") == lock_name);
+                CATCH_REQUIRE_FALSE(compact.has_parameter("_0"));
+                break;
+
+            }
+        }
+        CATCH_REQUIRE(lines[2].length() < lines[0].length());
+
+        // the control messages only use the preset dictionary
+        //
+        ed::message msg;
+        msg.set_sent_from_server("snap1");
+        msg.set_sent_from_service("cluckd");
+        msg.set_service("cluckd");
+        msg.set_command("LOCK");
+        msg.add_parameter("object_name", "website-lock");
+        ed::message compact(sender.encode(msg, true));
+        CATCH_REQUIRE(compact.get_sent_from_server() == "snap1");
+        CATCH_REQUIRE(compact.get_parameter("object_name") == "website-lock");
+
+        // a receiver which missed the definitions cannot decode the
+        // references
+        //
+        communicator_daemon::link_codec late;
+        ed::message decoded;
+        CATCH_REQUIRE(decoded.from_message(lines[2]));
+        CATCH_REQUIRE_FALSE(late.decode(decoded));
+
+        // after a reset, the dictionary is empty again
+        //
+        receiver.reset();
+        CATCH_REQUIRE(decoded.from_message(lines[2]));
+        CATCH_REQUIRE_FALSE(receiver.decode(decoded));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("link_codec: invalid definitions")
+    {
+        std::size_t const first(communicator_daemon::link_dictionary::get_static_size() + 1);
+        char const * const definitions[] =
+        {
+            "abc",
+            "1:5:snap1",
+            "99999:5:snap1",
+        };
+        for(auto const & d : definitions)
+        {
+            communicator_daemon::link_codec codec;
+            ed::message msg;
+            msg.set_command("_17");
+            msg.add_parameter("_0", d);
+            CATCH_REQUIRE_FALSE(codec.decode(msg));
+        }
+
+        communicator_daemon::link_codec codec;
+        ed::message too_short;
+        too_short.set_command("_17");
+        too_short.add_parameter("_0", std::to_string(first) + ":9:snap1");
+        CATCH_REQUIRE_FALSE(codec.decode(too_short));
+
+        ed::message bad_reference;
+        bad_reference.set_command("_17");
+        bad_reference.add_parameter("object_name", "@12x");
+        CATCH_REQUIRE_FALSE(codec.decode(bad_reference));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("link_codec: invalid identifiers")
+    {
+        communicator_daemon::link_codec codec;
+
+        ed::message out_of_range;
+        out_of_range.set_command("_9999");
+        CATCH_REQUIRE_FALSE(codec.decode(out_of_range));
+
+        ed::message zero;
+        zero.set_command("_0");
+        CATCH_REQUIRE_FALSE(codec.decode(zero));
+
+        ed::message bad_parameter;
+        bad_parameter.set_command("_17");
+        bad_parameter.add_parameter("_9999", "abc");
+        CATCH_REQUIRE_FALSE(codec.decode(bad_parameter));
+
+        ed::message bad_service;
+        bad_service.set_service("_12x");
+        bad_service.set_command("_17");
+        CATCH_REQUIRE_FALSE(codec.decode(bad_service));
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,144 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the neighbor_ids class.
+ *
+ * This file implements tests to verify the encoding of the informed
+ * neighbors of a broadcast message.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/neighbor_ids.h>
+
+
+// C++
+//
+#include    <algorithm>
+
+
+
+CATCH_TEST_CASE("neighbor_ids", "[broadcast]")
+{
+    CATCH_START_SECTION("neighbor_ids: bitmap")
+    {
+        std::vector<std::string> members;
+        for(int i(1); i <= 200; ++i)
+        {
+            members.push_back("10.0.0." + std::to_string(i));
+        }
+
+        communicator_daemon::neighbor_ids ids;
+        ids.set_members(members);
+        CATCH_REQUIRE(ids.size() == 200);
+        CATCH_REQUIRE(ids.get_id("10.0.0.1") == 0);
+        CATCH_REQUIRE(ids.get_id("10.0.0.5") >= 0);
+        CATCH_REQUIRE(ids.get_id("10.0.1.1") == -1);
+
+        communicator_daemon::neighbor_ids::informed_t informed;
+        CATCH_REQUIRE(ids.encode(informed).empty());
+        CATCH_REQUIRE(ids.insert(informed, "10.0.0.5"));
+        CATCH_REQUIRE_FALSE(ids.insert(informed, "10.0.0.5"));
+        CATCH_REQUIRE(ids.insert(informed, "10.0.0.17"));
+
+        // 1 + 16 + 1 + 200 / 4 characters
+        //
+        std::string const encoded(ids.encode(informed));
+        CATCH_REQUIRE(encoded.length() == 68);
+
+        // the members are sorted so the order does not matter
+        //
+        communicator_daemon::neighbor_ids other;
+        std::reverse(members.begin(), members.end());
+        other.set_members(members);
+        CATCH_REQUIRE(other.get_digest() == ids.get_digest());
+
+        communicator_daemon::neighbor_ids::informed_t const decoded(other.decode(encoded));
+        CATCH_REQUIRE(decoded.f_same_members);
+        CATCH_REQUIRE(other.contains(decoded, "10.0.0.5"));
+        CATCH_REQUIRE(other.contains(decoded, "10.0.0.17"));
+        CATCH_REQUIRE_FALSE(other.contains(decoded, "10.0.0.6"));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("neighbor_ids: different members")
+    {
+        communicator_daemon::neighbor_ids ids;
+        ids.set_members({ "10.0.0.1", "10.0.0.2", "10.0.0.3" });
+        communicator_daemon::neighbor_ids::informed_t informed;
+        CATCH_REQUIRE(ids.insert(informed, "10.0.0.2"));
+
+        // a daemon with another list of members cannot use the bitmap
+        //
+        communicator_daemon::neighbor_ids other;
+        other.set_members({ "10.0.0.1", "10.0.0.2", "10.0.0.4" });
+        communicator_daemon::neighbor_ids::informed_t const decoded(other.decode(ids.encode(informed)));
+        CATCH_REQUIRE(decoded.f_bits.empty());
+        CATCH_REQUIRE_FALSE(decoded.f_same_members);
+        CATCH_REQUIRE_FALSE(other.contains(decoded, "10.0.0.2"));
+
+        CATCH_REQUIRE(ids.decode("b1234:00").f_bits.empty());
+        CATCH_REQUIRE(ids.decode("x").f_bits.empty());
+        CATCH_REQUIRE(ids.decode("fzz").f_bits.empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("neighbor_ids: Bloom filter")
+    {
+        std::vector<std::string> members;
+        for(std::size_t i(0); i <= communicator_daemon::neighbor_ids::BITMAP_LIMIT; ++i)
+        {
+            members.push_back("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256));
+        }
+
+        communicator_daemon::neighbor_ids ids;
+        ids.set_members(members);
+
+        communicator_daemon::neighbor_ids::informed_t informed;
+        CATCH_REQUIRE(ids.insert(informed, "10.0.0.1"));
+        CATCH_REQUIRE(informed.f_bloom);
+        CATCH_REQUIRE_FALSE(ids.insert(informed, "10.0.0.1"));
+
+        // the filter also works with addresses which are not members
+        //
+        CATCH_REQUIRE(ids.insert(informed, "192.168.1.1"));
+
+        std::string const encoded(ids.encode(informed));
+        CATCH_REQUIRE(encoded[0] == 'f');
+        CATCH_REQUIRE(ids.decode(encoded).f_same_members);
+
+        // the filter remains usable with other members, but the digest
+        // tells that the list of members differs
+        //
+        communicator_daemon::neighbor_ids other;
+        communicator_daemon::neighbor_ids::informed_t const decoded(other.decode(encoded));
+        CATCH_REQUIRE_FALSE(decoded.f_same_members);
+        CATCH_REQUIRE(other.contains(decoded, "10.0.0.1"));
+        CATCH_REQUIRE(other.contains(decoded, "192.168.1.1"));
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
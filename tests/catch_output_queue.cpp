@@ -0,0 +1,183 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the output_queue class.
+ *
+ * This file implements tests to verify that the output_queue writes
+ * all the queued messages in order with a minimum number of system
+ * calls.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/output_queue.h>
+
+
+// C
+//
+#include    <sys/socket.h>
+#include    <unistd.h>
+
+
+
+CATCH_TEST_CASE("output_queue", "[connection]")
+{
+    CATCH_START_SECTION("output_queue: coalesce messages")
+    {
+        int sv[2];
+        CATCH_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+        communicator_daemon::output_queue queue;
+        queue.set_flush_threshold(100);
+        CATCH_REQUIRE(queue.empty());
+
+        std::string expected;
+        communicator_daemon::output_queue::buffer_t msg(std::make_shared<std::string const>("STATUS status=up\n"));
+        for(int count(0); count < 5; ++count)
+        {
+            CATCH_REQUIRE_FALSE(queue.push(msg));
+            expected += *msg;
+        }
+        CATCH_REQUIRE(queue.size() == expected.length());
+
+        // one system call for all the messages
+        //
+        CATCH_REQUIRE(queue.flush(sv[0]) == static_cast<ssize_t>(expected.length()));
+        CATCH_REQUIRE(queue.empty());
+        CATCH_REQUIRE(queue.get_messages() == 5);
+        CATCH_REQUIRE(queue.get_syscalls() == 1);
+        CATCH_REQUIRE(queue.get_syscalls_saved() == 4);
+
+        std::string received(expected.length(), '\0');
+        CATCH_REQUIRE(read(sv[1], received.data(), received.length()) == static_cast<ssize_t>(expected.length()));
+        CATCH_REQUIRE(received == expected);
+
+        // the threshold is reached
+        //
+        for(int count(0); count < 5; ++count)
+        {
+            CATCH_REQUIRE_FALSE(queue.push(msg));
+        }
+        CATCH_REQUIRE(queue.push(msg));
+        CATCH_REQUIRE(queue.needs_flush());
+
+        // the peer is gone
+        //
+        close(sv[1]);
+        CATCH_REQUIRE(queue.flush(sv[0]) == -1);
+        queue.clear();
+        CATCH_REQUIRE(queue.empty());
+        CATCH_REQUIRE(queue.size() == 0);
+
+        close(sv[0]);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("output_queue: limits")
+    {
+        int sv[2];
+        CATCH_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+        communicator_daemon::output_queue queue;
+        CATCH_REQUIRE_FALSE(queue.has_limits());
+        queue.set_limits(3, 0);
+        CATCH_REQUIRE(queue.has_limits());
+
+        for(int count(0); count < 3; ++count)
+        {
+            CATCH_REQUIRE_FALSE(queue.is_full());
+            queue.push(std::make_shared<std::string const>("MSG" + std::to_string(count) + "\n"));
+        }
+        CATCH_REQUIRE(queue.is_full());
+
+        // drop-newest only counts the message
+        //
+        queue.drop_newest();
+        CATCH_REQUIRE(queue.get_dropped() == 1);
+        CATCH_REQUIRE(queue.size() == 15);
+
+        // drop-oldest makes room by removing MSG0
+        //
+        CATCH_REQUIRE(queue.drop_oldest());
+        CATCH_REQUIRE(queue.get_dropped() == 2);
+        queue.push(std::make_shared<std::string const>("MSG3\n"));
+        CATCH_REQUIRE(queue.is_full());
+
+        CATCH_REQUIRE(queue.flush(sv[0]) == 15);
+        std::string received(15, '\0');
+        CATCH_REQUIRE(read(sv[1], received.data(), received.length()) == 15);
+        CATCH_REQUIRE(received == "MSG1\nMSG2\nMSG3\n");
+
+        // a byte limit
+        //
+        queue.set_limits(0, 10);
+        queue.push(std::make_shared<std::string const>("0123456789\n"));
+        CATCH_REQUIRE(queue.is_full());
+        CATCH_REQUIRE(queue.drop_oldest());
+        CATCH_REQUIRE(queue.empty());
+
+        close(sv[0]);
+        close(sv[1]);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("output_queue: priority lane")
+    {
+        int sv[2];
+        CATCH_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+        communicator_daemon::output_queue queue;
+        queue.set_limits(2, 0);
+        queue.push(std::make_shared<std::string const>("BULK1\n"));
+        queue.push(std::make_shared<std::string const>("BULK2\n"));
+        CATCH_REQUIRE(queue.is_full());
+
+        // control messages go ahead of the bulk messages
+        //
+        queue.push(std::make_shared<std::string const>("STOP\n"), true);
+        queue.push(std::make_shared<std::string const>("SHUTDOWN\n"), true);
+        CATCH_REQUIRE(queue.count() == 4);
+
+        // only the bulk messages can be dropped
+        //
+        CATCH_REQUIRE_FALSE(queue.drop_oldest());
+        CATCH_REQUIRE(queue.get_dropped() == 2);
+        queue.push(std::make_shared<std::string const>("BULK3\n"));
+
+        std::string const expected("STOP\nSHUTDOWN\nBULK3\n");
+        CATCH_REQUIRE(queue.flush(sv[0]) == static_cast<ssize_t>(expected.length()));
+        CATCH_REQUIRE(queue.empty());
+
+        std::string received(expected.length(), '\0');
+        CATCH_REQUIRE(read(sv[1], received.data(), received.length()) == static_cast<ssize_t>(expected.length()));
+        CATCH_REQUIRE(received == expected);
+
+        close(sv[0]);
+        close(sv[1]);
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
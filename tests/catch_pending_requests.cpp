@@ -0,0 +1,226 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the pending_requests class.
+ *
+ * This file implements tests to verify that replies get routed to the
+ * matching request and that requests time out.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator
+//
+#include    <communicator/names.h>
+#include    <communicator/pending_requests.h>
+
+
+
+CATCH_TEST_CASE("pending_requests", "[client]")
+{
+    CATCH_START_SECTION("pending_requests: replies are routed to their request")
+    {
+        communicator::pending_requests requests;
+        std::vector<std::string> results;
+        auto const callback([&results](communicator::request_status_t status, ed::message & reply)
+            {
+                CATCH_REQUIRE(status == communicator::request_status_t::REQUEST_STATUS_REPLY);
+                results.push_back(reply.get_parameter("value"));
+            });
+
+        ed::message first;
+        first.set_sent_from_server("snap1");
+        first.set_sent_from_service("client");
+        first.set_command("GET");
+        communicator::pending_requests::set_correlation_id(first, requests.add(callback, 1'000));
+
+        ed::message second;
+        second.set_sent_from_server("snap1");
+        second.set_sent_from_service("client");
+        second.set_command("GET");
+        communicator::pending_requests::set_correlation_id(second, requests.add(callback, 2'000));
+        CATCH_REQUIRE(requests.size() == 2);
+        CATCH_REQUIRE(requests.next_deadline() == 1'000);
+
+        // reply to the second request first
+        //
+        ed::message reply;
+        reply.set_command("VALUE");
+        communicator::pending_requests::set_reply(second, reply);
+        reply.add_parameter("value", "second");
+        CATCH_REQUIRE(reply.get_server() == "snap1");
+        CATCH_REQUIRE(reply.get_service() == "client");
+        CATCH_REQUIRE(requests.complete(reply));
+        CATCH_REQUIRE(results == std::vector<std::string>{ "second" });
+        CATCH_REQUIRE(requests.size() == 1);
+
+        // a duplicate reply is dropped
+        //
+        CATCH_REQUIRE(requests.complete(reply));
+        CATCH_REQUIRE(results.size() == 1);
+
+        ed::message reply2;
+        reply2.set_command("VALUE");
+        communicator::pending_requests::set_reply(first, reply2);
+        reply2.add_parameter("value", "first");
+        CATCH_REQUIRE(requests.complete(reply2));
+        CATCH_REQUIRE(results == std::vector<std::string>{ "second", "first" });
+        CATCH_REQUIRE(requests.empty());
+        CATCH_REQUIRE(requests.next_deadline() == -1);
+
+        // other messages are not replies
+        //
+        ed::message other;
+        other.set_command("VALUE");
+        CATCH_REQUIRE_FALSE(requests.complete(other));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("pending_requests: timeout & cancel")
+    {
+        communicator::pending_requests requests;
+        int timeouts(0);
+        int canceled(0);
+        auto const callback([&timeouts, &canceled](communicator::request_status_t status, ed::message & reply)
+            {
+                CATCH_REQUIRE(reply.get_command().empty());
+                switch(status)
+                {
+                case communicator::request_status_t::REQUEST_STATUS_TIMEOUT:
+                    ++timeouts;
+                    break;
+
+                case communicator::request_status_t::REQUEST_STATUS_CANCELED:
+                    ++canceled;
+                    break;
+
+                default:
+                    CATCH_FAIL("unexpected status");
+
+                }
+            });
+
+        communicator::pending_requests::request_id_t const a(requests.add(callback, 1'000));
+        communicator::pending_requests::request_id_t const b(requests.add(callback, 1'000));
+        communicator::pending_requests::request_id_t const c(requests.add(callback, 3'000));
+        requests.add(callback, 5'000);
+        CATCH_REQUIRE(a != b);
+
+        CATCH_REQUIRE(requests.expire(999) == 0);
+        CATCH_REQUIRE(requests.expire(1'000) == 2);
+        CATCH_REQUIRE(timeouts == 2);
+        CATCH_REQUIRE(requests.next_deadline() == 3'000);
+
+        // a canceled request does not call its callback
+        //
+        CATCH_REQUIRE(requests.cancel(c));
+        CATCH_REQUIRE_FALSE(requests.cancel(c));
+        CATCH_REQUIRE(requests.expire(4'000) == 0);
+        CATCH_REQUIRE(requests.next_deadline() == 5'000);
+
+        // a reply after the timeout is dropped
+        //
+        ed::message late;
+        late.set_command("VALUE");
+        late.add_parameter(communicator::g_name_communicator_param_in_reply_to, std::to_string(a));
+        CATCH_REQUIRE(requests.complete(late));
+        CATCH_REQUIRE(timeouts == 2);
+
+        requests.cancel_all();
+        CATCH_REQUIRE(canceled == 1);
+        CATCH_REQUIRE(requests.empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("pending_requests: status waiters")
+    {
+        communicator::pending_requests requests;
+        std::vector<std::string> results;
+        auto const callback([&results](communicator::request_status_t status, ed::message & msg)
+            {
+                switch(status)
+                {
+                case communicator::request_status_t::REQUEST_STATUS_REPLY:
+                    CATCH_REQUIRE(msg.get_command() == "STATUS");
+                    results.push_back("reply:" + msg.get_parameter(communicator::g_name_communicator_param_service));
+                    break;
+
+                case communicator::request_status_t::REQUEST_STATUS_TIMEOUT:
+                    results.push_back("timeout");
+                    break;
+
+                case communicator::request_status_t::REQUEST_STATUS_CANCELED:
+                    results.push_back("canceled");
+                    break;
+
+                }
+            });
+
+        communicator::pending_requests::request_id_t const up(requests.add_status_waiter("cluckd", "up", callback, 1'000));
+        requests.add_status_waiter("cluckd", "down", callback, 2'000);
+        requests.add_status_waiter("prinbee", "up", callback, 3'000);
+        requests.add(callback, 4'000);
+        CATCH_REQUIRE(requests.size() == 4);
+
+        // a reply cannot complete a status waiter
+        //
+        ed::message reply;
+        reply.set_command("VALUE");
+        reply.add_parameter(communicator::g_name_communicator_param_in_reply_to, std::to_string(up));
+        CATCH_REQUIRE(requests.complete(reply));
+        CATCH_REQUIRE(results.empty());
+
+        // only the waiters with that service and status are completed
+        //
+        ed::message status;
+        status.set_command("STATUS");
+        status.add_parameter(communicator::g_name_communicator_param_service, "cluckd");
+        status.add_parameter(communicator::g_name_communicator_param_status, "up");
+        CATCH_REQUIRE(requests.status_changed(status) == 1);
+        CATCH_REQUIRE(results == std::vector<std::string>{ "reply:cluckd" });
+        CATCH_REQUIRE(requests.status_changed(status) == 0);
+        CATCH_REQUIRE(requests.size() == 3);
+        CATCH_REQUIRE(requests.next_deadline() == 2'000);
+
+        // a STATUS without a status is ignored
+        //
+        ed::message invalid;
+        invalid.set_command("STATUS");
+        invalid.add_parameter(communicator::g_name_communicator_param_service, "cluckd");
+        CATCH_REQUIRE(requests.status_changed(invalid) == 0);
+
+        // waiters time out like requests
+        //
+        CATCH_REQUIRE(requests.expire(2'000) == 1);
+        CATCH_REQUIRE(results == std::vector<std::string>{ "reply:cluckd", "timeout" });
+
+        // and get canceled with the requests
+        //
+        requests.cancel_all();
+        CATCH_REQUIRE(results == std::vector<std::string>{ "reply:cluckd", "timeout", "canceled", "canceled" });
+        CATCH_REQUIRE(requests.empty());
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,130 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the raw_message class.
+ *
+ * This file implements tests to verify that the raw_message class
+ * parses the header of a message and regenerates the message with
+ * the parameters untouched.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/raw_message.h>
+
+
+// eventdispatcher
+//
+#include    <eventdispatcher/message.h>
+
+
+
+CATCH_TEST_CASE("raw_message", "[message]")
+{
+    CATCH_START_SECTION("raw_message: full header")
+    {
+        std::string const line("<snap1:images lock:cluckd/LOCK object_name=abc;pid=12");
+        communicator_daemon::raw_message raw;
+        CATCH_REQUIRE(raw.parse(line));
+        CATCH_REQUIRE(raw.get_sent_from_server() == "snap1");
+        CATCH_REQUIRE(raw.get_sent_from_service() == "images");
+        CATCH_REQUIRE(raw.get_server() == "lock");
+        CATCH_REQUIRE(raw.get_service() == "cluckd");
+        CATCH_REQUIRE(raw.get_command() == "LOCK");
+
+        // the fields are not copied, they point into the line
+        //
+        CATCH_REQUIRE(raw.get_sent_from_server().data() == line.data() + 1);
+        CATCH_REQUIRE(raw.get_service().data() == line.data() + 19);
+        CATCH_REQUIRE(raw.get_command().data() == line.data() + 26);
+
+        CATCH_REQUIRE(raw.has_parameter("pid"));
+        CATCH_REQUIRE(raw.has_parameter("object_name"));
+        CATCH_REQUIRE_FALSE(raw.has_parameter("name"));
+        CATCH_REQUIRE(raw.to_message(std::string(), std::string()) == line);
+        CATCH_REQUIRE(raw.to_message("snap2", "pagelist") == "<snap2:pagelist lock:cluckd/LOCK object_name=abc;pid=12");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("raw_message: short headers")
+    {
+        communicator_daemon::raw_message raw;
+
+        std::string const service_only("cluckd/STATUS");
+        CATCH_REQUIRE(raw.parse(service_only));
+        CATCH_REQUIRE(raw.get_server().empty());
+        CATCH_REQUIRE(raw.get_service() == "cluckd");
+        CATCH_REQUIRE(raw.get_command() == "STATUS");
+        CATCH_REQUIRE(raw.to_message("snap1", "images") == "<snap1:images cluckd/STATUS");
+
+        std::string const command_only("HELP");
+        CATCH_REQUIRE(raw.parse(command_only));
+        CATCH_REQUIRE(raw.get_service().empty());
+        CATCH_REQUIRE(raw.get_command() == "HELP");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("raw_message: same result as ed::message")
+    {
+        ed::message msg;
+        msg.set_sent_from_server("snap1");
+        msg.set_sent_from_service("images");
+        msg.set_server("snap2");
+        msg.set_service("cluckd");
+        msg.set_command("LOCK");
+        msg.add_parameter("object_name", "some;value=with special\nchars");
+        msg.add_parameter("timeout", 123);
+        std::string const line(msg.to_message());
+
+        communicator_daemon::raw_message raw;
+        CATCH_REQUIRE(raw.parse(line));
+        CATCH_REQUIRE(raw.get_server() == "snap2");
+        CATCH_REQUIRE(raw.get_service() == "cluckd");
+        CATCH_REQUIRE(raw.get_command() == "LOCK");
+
+        ed::message copy;
+        CATCH_REQUIRE(copy.from_message(raw.to_message("snap3", "pagelist")));
+        CATCH_REQUIRE(copy.get_sent_from_server() == "snap3");
+        CATCH_REQUIRE(copy.get_sent_from_service() == "pagelist");
+        CATCH_REQUIRE(copy.get_server() == "snap2");
+        CATCH_REQUIRE(copy.get_service() == "cluckd");
+        CATCH_REQUIRE(copy.get_command() == "LOCK");
+        CATCH_REQUIRE(copy.get_parameter("object_name") == "some;value=with special\nchars");
+        CATCH_REQUIRE(copy.get_integer_parameter("timeout") == 123);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("raw_message: invalid headers")
+    {
+        communicator_daemon::raw_message raw;
+        CATCH_REQUIRE_FALSE(raw.parse(std::string()));
+        CATCH_REQUIRE_FALSE(raw.parse("lowercase"));
+        CATCH_REQUIRE_FALSE(raw.parse("<no_space"));
+        CATCH_REQUIRE_FALSE(raw.parse("server:service HELP"));
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,337 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the routing_table class.
+ *
+ * This file implements tests to verify that the routing_table
+ * class properly finds and forgets connections.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/base_connection.h>
+#include    <communicator/daemon/routing_table.h>
+
+
+// C++
+//
+#include    <map>
+#include    <thread>
+
+
+// C
+//
+#include    <sys/socket.h>
+#include    <unistd.h>
+
+
+
+namespace
+{
+
+
+class test_connection
+    : public communicator_daemon::base_connection
+{
+public:
+    test_connection(int s = -1)
+        : base_connection(nullptr, communicator_daemon::connection_kind_t::CONNECTION_KIND_SERVICE)
+        , f_socket(s)
+    {
+    }
+
+    virtual int get_socket() const override
+    {
+        return f_socket;
+    }
+
+private:
+    int         f_socket = -1;
+};
+
+
+} // no name namespace
+
+
+
+CATCH_TEST_CASE("routing_table", "[routing]")
+{
+    CATCH_START_SECTION("routing_table: local services")
+    {
+        communicator_daemon::routing_table routes;
+        std::shared_ptr<test_connection> a(std::make_shared<test_connection>());
+        std::shared_ptr<test_connection> b(std::make_shared<test_connection>());
+
+        CATCH_REQUIRE(routes.find_local_service("lock") == nullptr);
+
+        routes.add_local_service("lock", a);
+        routes.add_local_service("images", b);
+        CATCH_REQUIRE(routes.find_local_service("lock") == a);
+        CATCH_REQUIRE(routes.find_local_service("images") == b);
+        CATCH_REQUIRE(routes.get_local_service_names() == std::vector<std::string>({ "images", "lock" }));
+
+        // the first registered connection is kept
+        //
+        routes.add_local_service("lock", b);
+        CATCH_REQUIRE(routes.find_local_service("lock") == a);
+
+        // b cannot unregister a
+        //
+        routes.remove_local_service("lock", b);
+        CATCH_REQUIRE(routes.find_local_service("lock") == a);
+
+        routes.remove_local_service("lock", a);
+        CATCH_REQUIRE(routes.find_local_service("lock") == nullptr);
+        CATCH_REQUIRE(routes.get_local_service_names() == std::vector<std::string>({ "images" }));
+
+        routes.remove_connection(b);
+        CATCH_REQUIRE(routes.find_local_service("images") == nullptr);
+        CATCH_REQUIRE(routes.get_local_service_names().empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("routing_table: several local instances")
+    {
+        communicator_daemon::routing_table routes;
+        std::shared_ptr<test_connection> a(std::make_shared<test_connection>());
+        std::shared_ptr<test_connection> b(std::make_shared<test_connection>());
+        std::shared_ptr<test_connection> c(std::make_shared<test_connection>());
+
+        routes.add_local_service("images", a);
+        routes.add_local_service("images", b);
+        routes.add_local_service("images", c);
+        routes.add_local_service("images", b);     // ignored, already registered
+        CATCH_REQUIRE(routes.find_local_instances("images").size() == 3);
+
+        // by default the first instance gets everything
+        //
+        for(int count(0); count < 5; ++count)
+        {
+            CATCH_REQUIRE(routes.select_local_service("images") == a);
+        }
+
+        // round robin goes through each instance in turn
+        //
+        routes.set_local_delivery("images", communicator_daemon::delivery_t::DELIVERY_ROUND_ROBIN);
+        CATCH_REQUIRE(routes.get_shard_parameter("images").empty());
+        std::map<communicator_daemon::base_connection::pointer_t, int> hits;
+        for(int count(0); count < 30; ++count)
+        {
+            ++hits[routes.select_local_service("images")];
+        }
+        CATCH_REQUIRE(hits.size() == 3);
+        CATCH_REQUIRE(hits[a] == 10);
+        CATCH_REQUIRE(hits[b] == 10);
+        CATCH_REQUIRE(hits[c] == 10);
+
+        // the same key always goes to the same instance
+        //
+        routes.set_local_delivery("images", communicator_daemon::delivery_t::DELIVERY_HASH, "user");
+        CATCH_REQUIRE(routes.get_shard_parameter("images") == "user");
+        std::map<std::string, communicator_daemon::base_connection::pointer_t> owners;
+        hits.clear();
+        for(int key(0); key < 300; ++key)
+        {
+            std::string const value("user-" + std::to_string(key));
+            owners[value] = routes.select_local_service("images", value);
+            CATCH_REQUIRE(routes.select_local_service("images", value) == owners[value]);
+            ++hits[owners[value]];
+        }
+        CATCH_REQUIRE(hits.size() == 3);
+
+        // only the keys of the instance which goes away move
+        //
+        routes.remove_local_service("images", b);
+        for(auto const & o : owners)
+        {
+            communicator_daemon::base_connection::pointer_t const conn(routes.select_local_service("images", o.first));
+            if(o.second == b)
+            {
+                CATCH_REQUIRE(conn != b);
+            }
+            else
+            {
+                CATCH_REQUIRE(conn == o.second);
+            }
+        }
+
+        // expired instances are ignored
+        //
+        owners.clear();
+        hits.clear();
+        a.reset();
+        CATCH_REQUIRE(routes.select_local_service("images", "user-1") == c);
+        CATCH_REQUIRE(routes.find_local_instances("images").size() == 1);
+
+        routes.remove_connection(c);
+        CATCH_REQUIRE(routes.select_local_service("images") == nullptr);
+        CATCH_REQUIRE(routes.get_shard_parameter("images").empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("routing_table: least outstanding")
+    {
+        // the bytes not read by the peer are counted even once they
+        // left the output queue
+        //
+        int busy[2];
+        int idle[2];
+        CATCH_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, busy) == 0);
+        CATCH_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, idle) == 0);
+
+        communicator_daemon::routing_table routes;
+        std::shared_ptr<test_connection> a(std::make_shared<test_connection>(busy[0]));
+        std::shared_ptr<test_connection> b(std::make_shared<test_connection>(idle[0]));
+        routes.add_local_service("images", a);
+        routes.add_local_service("images", b);
+        routes.set_local_delivery("images", communicator_daemon::delivery_t::DELIVERY_LEAST_OUTSTANDING);
+
+        CATCH_REQUIRE(a->get_pending_output() == 0);
+        CATCH_REQUIRE(b->get_pending_output() == 0);
+
+        // the bytes written are counted right away, without waiting
+        // for the next read of the kernel buffer size
+        //
+        a->set_output_coalescing(1);
+        communicator_daemon::base_connection::encoded_message_t const data(
+                std::make_shared<std::string const>("RESIZE service=images;width=100\n"));
+        ssize_t const size(static_cast<ssize_t>(data->length()));
+        CATCH_REQUIRE(a->send_raw_message(data));
+        CATCH_REQUIRE_FALSE(a->has_queued_output());
+        CATCH_REQUIRE(a->get_pending_output() >= static_cast<std::size_t>(size));
+
+        for(int count(0); count < 5; ++count)
+        {
+            CATCH_REQUIRE(routes.select_local_service("images") == b);
+        }
+
+        // the kernel buffer is checked again after PENDING_OUTPUT_REFRESH
+        // and still has the data (a Unix socket counts a little more than
+        // the data itself)
+        //
+        std::this_thread::sleep_for(communicator_daemon::base_connection::PENDING_OUTPUT_REFRESH * 2);
+        CATCH_REQUIRE(a->get_pending_output() >= static_cast<std::size_t>(size));
+
+        // once the peer read its data, both instances share the load
+        //
+        char buf[256];
+        CATCH_REQUIRE(read(busy[1], buf, sizeof(buf)) == size);
+        std::this_thread::sleep_for(communicator_daemon::base_connection::PENDING_OUTPUT_REFRESH * 2);
+        CATCH_REQUIRE(a->get_pending_output() == 0);
+        std::map<communicator_daemon::base_connection::pointer_t, int> hits;
+        for(int count(0); count < 10; ++count)
+        {
+            ++hits[routes.select_local_service("images")];
+        }
+        CATCH_REQUIRE(hits[a] == 5);
+        CATCH_REQUIRE(hits[b] == 5);
+
+        close(busy[0]);
+        close(busy[1]);
+        close(idle[0]);
+        close(idle[1]);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("routing_table: remote servers")
+    {
+        communicator_daemon::routing_table routes;
+        std::shared_ptr<test_connection> a(std::make_shared<test_connection>());
+        std::shared_ptr<test_connection> b(std::make_shared<test_connection>());
+
+        routes.add_remote_server("alpha", a);
+        routes.add_remote_server("beta", b);
+        routes.add_remote_server(std::string(), b);
+        CATCH_REQUIRE(routes.find_remote_server("alpha") == a);
+        CATCH_REQUIRE(routes.find_remote_server("beta") == b);
+        CATCH_REQUIRE(routes.find_remote_server("gamma") == nullptr);
+        CATCH_REQUIRE(routes.get_remote_connections().size() == 2);
+
+        routes.remove_connection(a);
+        CATCH_REQUIRE(routes.find_remote_server("alpha") == nullptr);
+        CATCH_REQUIRE(routes.get_remote_connections().size() == 1);
+
+        // expired connections are ignored
+        //
+        b.reset();
+        CATCH_REQUIRE(routes.find_remote_server("beta") == nullptr);
+        CATCH_REQUIRE(routes.get_remote_connections().empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("routing_table: remote services")
+    {
+        communicator_daemon::routing_table routes;
+        std::shared_ptr<test_connection> a(std::make_shared<test_connection>());
+        std::shared_ptr<test_connection> b(std::make_shared<test_connection>());
+
+        a->set_services("cluckd,images");
+        a->set_services_heard_of("fluid_settings");
+        b->set_services("images");
+        routes.set_remote_services(a);
+        routes.set_remote_services(b);
+
+        CATCH_REQUIRE(routes.find_remote_service("cluckd").size() == 1);
+        CATCH_REQUIRE(routes.find_remote_service("cluckd")[0] == a);
+        CATCH_REQUIRE(routes.find_remote_service("images").size() == 2);
+
+        // heard of is used only when no remote hosts the service
+        //
+        CATCH_REQUIRE(routes.find_remote_service("fluid_settings").size() == 1);
+        CATCH_REQUIRE(routes.find_remote_service("fluid_settings")[0] == a);
+
+        // unknown services return an empty list (caller floods)
+        //
+        CATCH_REQUIRE(routes.find_remote_service("unknown").empty());
+
+        // a new CONNECT/ACCEPT does not duplicate entries
+        //
+        routes.set_remote_services(b);
+        CATCH_REQUIRE(routes.find_remote_service("images").size() == 2);
+
+        // a SERVICES message replaces the lists of the connection
+        //
+        a->set_services("cluckd");
+        a->set_services_heard_of("");
+        routes.set_remote_services(a);
+        CATCH_REQUIRE(routes.find_remote_service("images").size() == 1);
+        CATCH_REQUIRE(routes.find_remote_service("images")[0] == b);
+        CATCH_REQUIRE(routes.find_remote_service("fluid_settings").empty());
+        CATCH_REQUIRE(routes.find_remote_service("cluckd").size() == 1);
+
+        routes.remove_connection(a);
+        CATCH_REQUIRE(routes.find_remote_service("cluckd").empty());
+        CATCH_REQUIRE(routes.find_remote_service("fluid_settings").empty());
+        CATCH_REQUIRE(routes.find_remote_service("images").size() == 1);
+
+        // stale (expired) entries are ignored
+        //
+        b.reset();
+        CATCH_REQUIRE(routes.find_remote_service("images").empty());
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,114 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Verify the topic_matcher class.
+ *
+ * This file implements tests to verify that the subscription patterns
+ * match the expected topics.
+ */
+
+// self
+//
+#include    "catch_main.h"
+
+
+// communicator daemon
+//
+#include    <communicator/daemon/topic_matcher.h>
+
+
+
+CATCH_TEST_CASE("topic_matcher", "[subscription]")
+{
+    CATCH_START_SECTION("topic_matcher: validation")
+    {
+        CATCH_REQUIRE(communicator_daemon::topic_matcher::is_valid_pattern("images.*.done"));
+        CATCH_REQUIRE(communicator_daemon::topic_matcher::is_valid_pattern("images.#"));
+        CATCH_REQUIRE(communicator_daemon::topic_matcher::is_valid_pattern("#"));
+        CATCH_REQUIRE_FALSE(communicator_daemon::topic_matcher::is_valid_pattern(""));
+        CATCH_REQUIRE_FALSE(communicator_daemon::topic_matcher::is_valid_pattern("images..done"));
+        CATCH_REQUIRE_FALSE(communicator_daemon::topic_matcher::is_valid_pattern("images.#.done"));
+        CATCH_REQUIRE_FALSE(communicator_daemon::topic_matcher::is_valid_pattern("images.re size"));
+
+        CATCH_REQUIRE(communicator_daemon::topic_matcher::is_valid_topic("images.resize.done"));
+        CATCH_REQUIRE_FALSE(communicator_daemon::topic_matcher::is_valid_topic("images.*"));
+        CATCH_REQUIRE_FALSE(communicator_daemon::topic_matcher::is_valid_topic("images.#"));
+        CATCH_REQUIRE_FALSE(communicator_daemon::topic_matcher::is_valid_topic("images."));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("topic_matcher: match")
+    {
+        communicator_daemon::topic_matcher m;
+        CATCH_REQUIRE(m.empty());
+        CATCH_REQUIRE_FALSE(m.match("images"));
+
+        CATCH_REQUIRE(m.add("images.*.done"));
+        CATCH_REQUIRE(m.match("images.resize.done"));
+        CATCH_REQUIRE_FALSE(m.match("images.resize"));
+        CATCH_REQUIRE_FALSE(m.match("images.resize.done.now"));
+
+        CATCH_REQUIRE(m.add("logs.#"));
+        CATCH_REQUIRE(m.match("logs"));
+        CATCH_REQUIRE(m.match("logs.apache.error"));
+        CATCH_REQUIRE_FALSE(m.match("log"));
+
+        CATCH_REQUIRE(m.get_patterns() == std::vector<std::string>({ "images.*.done", "logs.#" }));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("topic_matcher: reference counting")
+    {
+        communicator_daemon::topic_matcher m;
+        CATCH_REQUIRE(m.add("images.*.done"));
+        CATCH_REQUIRE_FALSE(m.add("images.*.done"));
+        CATCH_REQUIRE(m.has_pattern("images.*.done"));
+
+        // the first remove() only decrements the counter
+        //
+        CATCH_REQUIRE_FALSE(m.remove("images.*.done"));
+        CATCH_REQUIRE(m.match("images.crop.done"));
+
+        CATCH_REQUIRE(m.remove("images.*.done"));
+        CATCH_REQUIRE_FALSE(m.match("images.crop.done"));
+        CATCH_REQUIRE_FALSE(m.remove("images.*.done"));
+        CATCH_REQUIRE(m.empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("topic_matcher: copy")
+    {
+        communicator_daemon::topic_matcher m;
+        CATCH_REQUIRE(m.add("logs.#"));
+
+        communicator_daemon::topic_matcher c(m);
+        CATCH_REQUIRE(c.match("logs.kernel"));
+
+        m.clear();
+        CATCH_REQUIRE_FALSE(m.match("logs.kernel"));
+        CATCH_REQUIRE(c.match("logs.kernel"));
+
+        c = m;
+        CATCH_REQUIRE_FALSE(c.match("logs.kernel"));
+    }
+    CATCH_END_SECTION()
+}
+
+
+// vim: ts=4 sw=4 et
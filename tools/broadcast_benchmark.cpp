@@ -0,0 +1,294 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Compare the broadcast dissemination strategies.
+ *
+ * This tool simulates the forwarding of one broadcast message in a
+ * cluster of 10, 100, and 500 communicator daemons using the same code
+ * as the daemon (dissemination and neighbor_ids classes). It reports
+ * the number of messages sent per broadcast, the number of duplicates
+ * received, the largest number of messages sent by one daemon, and the
+ * number of hops needed to reach all the daemons. One hop is one
+ * network latency. The coverage is the percentage of daemons reached
+ * by the worst run; it is always 1.000 for flood and tree but gossip,
+ * which is best effort, sometimes misses a daemon.
+ *
+ * Two topologies are simulated: a full mesh, where all the daemons are
+ * connected to each other, and a sparse cluster where each daemon is
+ * connected to 8 random daemons. In the sparse cluster, the tree falls
+ * back to flooding.
+ *
+ * \code
+ *     broadcast-benchmark [<runs>]
+ * \endcode
+ */
+
+// communicator
+//
+#include    <communicator/daemon/dissemination.h>
+#include    <communicator/daemon/neighbor_ids.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <deque>
+#include    <iomanip>
+#include    <iostream>
+#include    <random>
+#include    <set>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace
+{
+
+
+
+constexpr std::size_t const     g_sparse_degree = 8;
+
+
+struct result_t
+{
+    double                      f_messages = 0.0;
+    double                      f_duplicates = 0.0;
+    double                      f_max_sends = 0.0;
+    double                      f_hops = 0.0;
+    double                      f_informed_size = 0.0;
+    double                      f_coverage = 1.0;       // worst run
+};
+
+
+struct pending_t
+{
+    std::size_t                 f_to = 0;
+    int                         f_hops = 0;
+    bool                        f_flood = false;
+    communicator_daemon::neighbor_ids::informed_t
+                                f_informed = communicator_daemon::neighbor_ids::informed_t();
+};
+
+
+std::vector<std::vector<std::size_t>> make_topology(std::size_t nodes, bool mesh, std::mt19937 & random)
+{
+    std::vector<std::set<std::size_t>> links(nodes);
+    if(mesh)
+    {
+        for(std::size_t a(0); a < nodes; ++a)
+        {
+            for(std::size_t b(0); b < nodes; ++b)
+            {
+                if(a != b)
+                {
+                    links[a].insert(b);
+                }
+            }
+        }
+    }
+    else
+    {
+        // a ring guarantees the cluster is connected
+        //
+        std::uniform_int_distribution<std::size_t> pick(0, nodes - 1);
+        for(std::size_t a(0); a < nodes; ++a)
+        {
+            std::size_t const b((a + 1) % nodes);
+            links[a].insert(b);
+            links[b].insert(a);
+            while(links[a].size() < std::min(g_sparse_degree, nodes - 1))
+            {
+                std::size_t const c(pick(random));
+                if(c != a)
+                {
+                    links[a].insert(c);
+                    links[c].insert(a);
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<std::size_t>> result(nodes);
+    for(std::size_t a(0); a < nodes; ++a)
+    {
+        result[a].assign(links[a].begin(), links[a].end());
+    }
+    return result;
+}
+
+
+result_t simulate(
+      communicator_daemon::strategy_t strategy
+    , std::size_t nodes
+    , bool mesh
+    , std::size_t runs)
+{
+    std::mt19937 random(static_cast<std::mt19937::result_type>(nodes * 2 + (mesh ? 1 : 0)));
+
+    std::vector<std::string> addresses(nodes);
+    for(std::size_t n(0); n < nodes; ++n)
+    {
+        addresses[n] = "10.0." + std::to_string(n / 250) + "." + std::to_string(n % 250 + 1);
+    }
+    communicator_daemon::neighbor_ids ids;
+    ids.set_members(addresses);
+
+    communicator_daemon::dissemination d;
+    d.set_strategy(strategy);
+
+    result_t result;
+    for(std::size_t r(0); r < runs; ++r)
+    {
+        std::vector<std::vector<std::size_t>> const links(make_topology(nodes, mesh, random));
+        std::size_t const origin(r % nodes);
+
+        std::vector<int> reached(nodes, -1);
+        std::vector<std::size_t> sends(nodes, 0);
+        std::size_t messages(0);
+        std::size_t duplicates(0);
+        std::size_t informed_size(0);
+
+        std::deque<pending_t> queue;
+        queue.push_back(pending_t{ origin, 0, false, {} });
+        while(!queue.empty())
+        {
+            pending_t msg(std::move(queue.front()));
+            queue.pop_front();
+
+            std::size_t const u(msg.f_to);
+            if(reached[u] >= 0)
+            {
+                ++duplicates;
+                continue;
+            }
+            reached[u] = msg.f_hops;
+            if(msg.f_hops >= d.get_max_hops())
+            {
+                continue;
+            }
+
+            std::vector<std::size_t> neighbors;
+            std::vector<std::int32_t> candidates;
+            for(auto const v : links[u])
+            {
+                if(!ids.contains(msg.f_informed, addresses[v]))
+                {
+                    neighbors.push_back(v);
+                    candidates.push_back(ids.get_id(addresses[v]));
+                }
+            }
+
+            bool flood(msg.f_flood);
+            std::vector<std::size_t> const selected(d.select(
+                      candidates
+                    , ids.get_id(addresses[u])
+                    , ids.get_id(addresses[origin])
+                    , ids.size()
+                    , flood));
+            if(selected.empty())
+            {
+                continue;
+            }
+
+            pending_t forward;
+            forward.f_hops = msg.f_hops + 1;
+            forward.f_flood = flood;
+            forward.f_informed = msg.f_informed;
+            ids.insert(forward.f_informed, addresses[u]);
+            for(auto const s : selected)
+            {
+                ids.insert(forward.f_informed, addresses[neighbors[s]]);
+            }
+            informed_size = std::max(informed_size, ids.encode(forward.f_informed).length());
+            for(auto const s : selected)
+            {
+                forward.f_to = neighbors[s];
+                queue.push_back(forward);
+            }
+            messages += selected.size();
+            sends[u] += selected.size();
+        }
+
+        std::size_t const count(nodes - std::count(reached.begin(), reached.end(), -1));
+        result.f_messages += static_cast<double>(messages) / runs;
+        result.f_duplicates += static_cast<double>(duplicates) / runs;
+        result.f_max_sends += static_cast<double>(*std::max_element(sends.begin(), sends.end())) / runs;
+        result.f_hops += static_cast<double>(*std::max_element(reached.begin(), reached.end())) / runs;
+        result.f_informed_size += static_cast<double>(informed_size) / runs;
+        result.f_coverage = std::min(result.f_coverage, static_cast<double>(count) / nodes);
+    }
+
+    return result;
+}
+
+
+
+} // no name namespace
+
+
+
+int main(int argc, char * argv[])
+{
+    std::size_t runs(20);
+    if(argc > 1)
+    {
+        runs = std::max(1, std::atoi(argv[1]));
+    }
+
+    std::cout
+        << "strategy  topology  nodes  messages  duplicates  max-sends  hops   informed  coverage\n"
+        << std::fixed;
+    for(auto const mesh : { true, false })
+    {
+        for(auto const nodes : { 10, 100, 500 })
+        {
+            for(auto const strategy : {
+                          communicator_daemon::strategy_t::STRATEGY_FLOOD
+                        , communicator_daemon::strategy_t::STRATEGY_TREE
+                        , communicator_daemon::strategy_t::STRATEGY_GOSSIP })
+            {
+                result_t const r(simulate(strategy, nodes, mesh, runs));
+                std::cout
+                    << std::left
+                    << std::setw(10) << communicator_daemon::strategy_to_string(strategy)
+                    << std::setw(10) << (mesh ? "mesh" : "sparse")
+                    << std::right
+                    << std::setw(5) << nodes
+                    << std::setprecision(1)
+                    << std::setw(10) << r.f_messages
+                    << std::setw(12) << r.f_duplicates
+                    << std::setw(11) << r.f_max_sends
+                    << std::setw(6) << r.f_hops
+                    << std::setw(11) << r.f_informed_size
+                    << std::setprecision(3)
+                    << std::setw(10) << r.f_coverage
+                    << '\n';
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,243 @@
+// Copyright (c) 2011-2025  Made to Order Software Corp.  All Rights Reserved
+//
+// https://snapwebsites.org/project/communicator
+// contact@m2osw.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/** \file
+ * \brief Compare the fan-out of a message with and without the registry.
+ *
+ * This tool measures the time it takes to find the local services which
+ * understand a command among 1,000 connections (by default). Before the
+ * connection_registry, the daemon went through all of its connections
+ * and used a chain of dynamic_pointer_cast<>() to find the type of each
+ * one. With the registry, it only goes through the local connections.
+ *
+ * The mix of connections is similar to what a busy daemon has: 60% Unix
+ * connections, 30% TCP connections, and 10% remote daemons.
+ *
+ * \code
+ *     connection-registry-benchmark [<connections> [<rounds>]]
+ * \endcode
+ */
+
+// communicator
+//
+#include    <communicator/daemon/base_connection.h>
+#include    <communicator/daemon/connection_registry.h>
+
+
+// C++
+//
+#include    <algorithm>
+#include    <chrono>
+#include    <iomanip>
+#include    <iostream>
+#include    <memory>
+#include    <vector>
+
+
+// last include
+//
+#include    <snapdev/poison.h>
+
+
+
+namespace
+{
+
+
+
+// this mimics the ed::connection, the real connections derive from
+// an ed::connection and the base_connection
+//
+class fake_ed_connection
+{
+public:
+    typedef std::shared_ptr<fake_ed_connection> pointer_t;
+
+    virtual ~fake_ed_connection()
+    {
+    }
+};
+
+
+template<communicator_daemon::connection_kind_t kind>
+class test_connection
+    : public fake_ed_connection
+    , public communicator_daemon::base_connection
+{
+public:
+    test_connection()
+        : base_connection(nullptr, kind)
+    {
+    }
+
+    virtual int get_socket() const override
+    {
+        return -1;
+    }
+};
+
+
+typedef test_connection<communicator_daemon::connection_kind_t::CONNECTION_KIND_SERVICE>    test_service_connection;
+typedef test_connection<communicator_daemon::connection_kind_t::CONNECTION_KIND_UNIX>       test_unix_connection;
+typedef test_connection<communicator_daemon::connection_kind_t::CONNECTION_KIND_REMOTE>     test_remote_connection;
+
+
+
+} // no name namespace
+
+
+
+int main(int argc, char * argv[])
+{
+    std::size_t connection_count(1'000);
+    std::size_t rounds(1'000);
+    if(argc > 1)
+    {
+        connection_count = std::max(1, std::atoi(argv[1]));
+    }
+    if(argc > 2)
+    {
+        rounds = std::max(1, std::atoi(argv[2]));
+    }
+
+    std::vector<fake_ed_connection::pointer_t> all_connections;
+    communicator_daemon::connection_registry registry;
+    for(std::size_t idx(0); idx < connection_count; ++idx)
+    {
+        fake_ed_connection::pointer_t c;
+        communicator_daemon::base_connection::pointer_t b;
+        switch(idx % 10)
+        {
+        case 0:
+            {
+                std::shared_ptr<test_remote_connection> r(std::make_shared<test_remote_connection>());
+                c = r;
+                b = r;
+            }
+            break;
+
+        case 1:
+        case 2:
+        case 3:
+            {
+                std::shared_ptr<test_service_connection> s(std::make_shared<test_service_connection>());
+                c = s;
+                b = s;
+            }
+            break;
+
+        default:
+            {
+                std::shared_ptr<test_unix_connection> u(std::make_shared<test_unix_connection>());
+                c = u;
+                b = u;
+            }
+            break;
+
+        }
+        b->add_commands("STATUS");
+        all_connections.push_back(c);
+        registry.add_connection(b);
+    }
+
+    // before: go through all the connections and check the type
+    //         using dynamic_pointer_cast<>() like the daemon did
+    //
+    std::size_t before_count(0);
+    auto const before_start(std::chrono::steady_clock::now());
+    for(std::size_t r(0); r < rounds; ++r)
+    {
+        for(auto const & nc : all_connections)
+        {
+            std::shared_ptr<test_unix_connection> u(std::dynamic_pointer_cast<test_unix_connection>(nc));
+            if(u != nullptr)
+            {
+                if(u->understand_command("STATUS"))
+                {
+                    ++before_count;
+                }
+                continue;
+            }
+            std::shared_ptr<test_service_connection> s(std::dynamic_pointer_cast<test_service_connection>(nc));
+            if(s != nullptr)
+            {
+                if(s->understand_command("STATUS"))
+                {
+                    ++before_count;
+                }
+                continue;
+            }
+            std::shared_ptr<test_remote_connection> rc(std::dynamic_pointer_cast<test_remote_connection>(nc));
+            if(rc != nullptr)
+            {
+                // remote connections are not local services
+                continue;
+            }
+        }
+    }
+    auto const before_end(std::chrono::steady_clock::now());
+
+    // after: only go through the local connections using the registry
+    //
+    std::size_t after_count(0);
+    auto const after_start(std::chrono::steady_clock::now());
+    for(std::size_t r(0); r < rounds; ++r)
+    {
+        for(communicator_daemon::connection_kind_t const kind : {
+                      communicator_daemon::connection_kind_t::CONNECTION_KIND_UNIX
+                    , communicator_daemon::connection_kind_t::CONNECTION_KIND_SERVICE })
+        {
+            for(auto const & c : registry.get_connections(kind))
+            {
+                if(c->understand_command("STATUS"))
+                {
+                    ++after_count;
+                }
+            }
+        }
+    }
+    auto const after_end(std::chrono::steady_clock::now());
+
+    if(before_count != after_count)
+    {
+        std::cerr
+            << "error: the registry found "
+            << after_count / rounds
+            << " connections instead of "
+            << before_count / rounds
+            << ".\n";
+        return 1;
+    }
+
+    std::chrono::duration<double, std::micro> const before_duration(before_end - before_start);
+    std::chrono::duration<double, std::micro> const after_duration(after_end - after_start);
+    std::cout
+        << "fan-out to " << connection_count << " connections ("
+        << after_count / rounds << " local services, "
+        << rounds << " rounds):\n"
+        << std::fixed << std::setprecision(2)
+        << "  dynamic_pointer_cast<>() chain: "
+        << std::setw(10) << before_duration.count() / rounds << " us per fan-out\n"
+        << "  connection registry:            "
+        << std::setw(10) << after_duration.count() / rounds << " us per fan-out\n";
+
+    return 0;
+}
+
+
+// vim: ts=4 sw=4 et